@@ -1,11 +1,13 @@
 workspace "Basics of DirectX 12"
    configurations { "Debug", "Release" }
    language "C++"
+   cppdialect "C++17"
    architecture "x64"
-   systemversion "latest"
-   toolset "v142"
    optimize "Speed"
-   links { "d3d12", "dxgi", "d3dcompiler" }
+   filter("system:windows")
+      systemversion "latest"
+      toolset "v142"
+      links { "d3d12", "dxgi", "d3dcompiler" }
    filter("configurations:Debug")
       defines({ "DEBUG" })
       symbols("On")
@@ -16,6 +18,103 @@ workspace "Basics of DirectX 12"
       symbols("On")
       targetdir ("bin/release")
 
+   -- Backend independent code, also builds on Linux
+   project "RHI"
+      kind "StaticLib"
+      includedirs { "src" }
+      files { "src/rhi.h", "src/rhi_commands.h", "src/rhi_commands.cpp" }
+      files { "src/rhi_null.h", "src/rhi_null.cpp" }
+      files { "src/frame_recorder.h", "src/frame_recorder.cpp" }
+      files { "src/frame_ring.h", "src/frame_ring.cpp" }
+      files { "src/upload_ring.h", "src/upload_ring.cpp" }
+      files { "src/stream_copy.h", "src/stream_copy.cpp" }
+      files { "src/constant_buffer_manager.h", "src/constant_buffer_manager.cpp" }
+      files { "src/tlsf_allocator.h", "src/tlsf_allocator.cpp" }
+      files { "src/gpu_heap_allocator.h", "src/gpu_heap_allocator.cpp" }
+      files { "src/copy_uploader.h", "src/copy_uploader.cpp" }
+      files { "src/descriptor_allocator.h", "src/descriptor_allocator.cpp" }
+      files { "src/deferred_release.h", "src/deferred_release.cpp" }
+      files { "src/readback_ring.h", "src/readback_ring.cpp" }
+      files { "src/pipeline_cache.h", "src/pipeline_cache.cpp" }
+      files { "src/shader_cache.h", "src/shader_cache.cpp" }
+      files { "src/shader_permutations.h", "src/shader_permutations.cpp" }
+      files { "src/parallel_for.h", "src/parallel_for.cpp" }
+      files { "src/vertex_layout.h", "src/vertex_formats.h", "src/vertex_formats.cpp" }
+      files { "src/root_signature_layout.h" }
+      files { "src/render_graph.h", "src/render_graph.cpp" }
+      files { "src/overdraw_counter.h", "src/overdraw_counter.cpp" }
+      files { "src/frustum_culler.h", "src/frustum_culler.cpp" }
+      files { "src/occlusion_culler.h", "src/occlusion_culler.cpp" }
+      files { "src/pvs.h", "src/pvs.cpp" }
+      files { "src/pvs_baker.h", "src/pvs_baker.cpp" }
+      files { "src/draw_sorter.h", "src/draw_sorter.cpp" }
+      files { "src/state_filter.h", "src/state_filter.cpp" }
+      files { "src/frame_capture.h", "src/frame_capture.cpp" }
+      files { "src/frame_replay.h", "src/frame_replay.cpp" }
+
+   project "Frame replay"
+      kind "ConsoleApp"
+      includedirs { "src" }
+      links { "RHI" }
+      files { "src/replay_main.cpp" }
+
+   -- CPU tests of the backend independent code on the null backend, returns non-zero on failure
+   project "Tests"
+      kind "ConsoleApp"
+      includedirs { "src", "tests" }
+      links { "RHI" }
+      files { "tests/test.h", "tests/test_main.cpp" }
+      files { "tests/state_filter_tests.cpp" }
+      files { "tests/frame_ring_tests.cpp" }
+      files { "tests/upload_ring_tests.cpp" }
+      files { "tests/copy_uploader_tests.cpp" }
+      files { "tests/tlsf_allocator_tests.cpp" }
+      files { "tests/descriptor_allocator_tests.cpp" }
+      files { "tests/deferred_release_tests.cpp" }
+      files { "tests/readback_ring_tests.cpp" }
+      files { "tests/pipeline_cache_tests.cpp" }
+      files { "tests/shader_cache_tests.cpp" }
+      files { "tests/shader_permutations_tests.cpp" }
+      files { "tests/constant_buffer_manager_tests.cpp" }
+      files { "tests/parallel_for_tests.cpp" }
+      files { "tests/render_graph_tests.cpp" }
+      files { "tests/frustum_culler_tests.cpp" }
+      files { "tests/occlusion_culler_tests.cpp" }
+      files { "tests/draw_sorter_tests.cpp" }
+      files { "tests/frame_capture_tests.cpp" }
+      files { "tests/vertex_layout_tests.cpp" }
+      files { "tests/frame_recorder_tests.cpp" }
+      files { "tests/overdraw_counter_tests.cpp" }
+      files { "tests/pvs_tests.cpp" }
+
+   -- CPU benchmarks of the backend independent code, checks that compared variants agree
+   project "Bench"
+      kind "ConsoleApp"
+      includedirs { "src", "bench" }
+      links { "RHI" }
+      files { "bench/bench.h", "bench/bench_main.cpp" }
+      files { "bench/tlsf_bench.cpp" }
+      files { "bench/shader_compile_bench.cpp" }
+      files { "bench/stream_copy_bench.cpp" }
+      files { "bench/record_frame_bench.cpp" }
+      files { "bench/frustum_bench.cpp" }
+      files { "bench/draw_sorter_bench.cpp" }
+
+   -- Compiles shaders with DXC at build time, dxc must be on the PATH
+   project "Shader compiler"
+      kind "ConsoleApp"
+      includedirs { "src" }
+      links { "RHI" }
+      files { "src/shader_compile_main.cpp" }
+
+   -- Bakes the model's potentially visible set at build time
+   project "PVS baker"
+      kind "ConsoleApp"
+      includedirs { "src" }
+      includedirs { "libs/tinyobjloader" }
+      links { "RHI" }
+      files { "src/pvs_bake_main.cpp" }
+
    project "DX12 installation check"
       kind "ConsoleApp"
       entrypoint "WinMainCRTStartup"
@@ -30,7 +129,10 @@ workspace "Basics of DirectX 12"
       includedirs { "src" }
       includedirs { "libs/D3DX12" }
       includedirs { "libs/tinyobjloader" }
+      links { "RHI" }
+      dependson { "Shader compiler", "PVS baker" }
       files { "src/dx12_labs.h" }
+      files { "src/rhi_d3d12.h", "src/rhi_d3d12.cpp" }
       files { "src/renderer.h", "src/renderer.cpp"}
       files { "src/win32_window.h", "src/win32_window.cpp"}
       files { "src/win32_window_main.cpp" }
@@ -38,5 +140,9 @@ workspace "Basics of DirectX 12"
       postbuildcommands {
          "{COPY} shaders/shaders.hlsl %{cfg.buildtarget.directory}",
          "{COPY} models/CornellBox-Original.obj %{cfg.buildtarget.directory}",
-         "{COPY} models/CornellBox-Original.mtl %{cfg.buildtarget.directory}"
+         "{COPY} models/CornellBox-Original.mtl %{cfg.buildtarget.directory}",
+         "\"%{cfg.buildtarget.directory}/Shader compiler\" --vertex-format Standard --output %{cfg.buildtarget.directory}/shader_cache.bin shaders/shaders.hlsl"
+            .. " VSMain:vs_6_0 VSDepth:vs_6_0 PSMain:ps_6_0::BUMP_MAPPING+POINT_LIGHT,POINT_LIGHT"
+            .. " VSMain:vs_6_0:BINDLESS VSDepth:vs_6_0:BINDLESS PSMain:ps_6_0:BINDLESS:BUMP_MAPPING+POINT_LIGHT,POINT_LIGHT",
+         "\"%{cfg.buildtarget.directory}/PVS baker\" --output %{cfg.buildtarget.directory}/pvs.bin models/CornellBox-Original.obj"
        }
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+// Minimal benchmark registry for the Bench project. BENCHMARK defines a case that prints its own
+// timings, a case throws std::runtime_error when the variants it compares disagree.
+struct BenchmarkRegistration
+{
+	BenchmarkRegistration(const char* name, void (*function)());
+};
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static BenchmarkRegistration name##_registration(#name, name); \
+	static void name()
+
+// Throws when two variants of the measured code produce different results
+#define BENCH_REQUIRE(condition) \
+	do { \
+		if (!(condition)) \
+			throw std::runtime_error(std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": " #condition " failed"); \
+	} while (false)
+
+// Fastest of repetitions runs of function in milliseconds, the minimum is the least noisy estimate
+template <class Function>
+double MeasureMs(unsigned repetitions, Function&& function)
+{
+	double best = 0.0;
+	for (unsigned i = 0; i < repetitions; i++) {
+		const auto start = std::chrono::steady_clock::now();
+		function();
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (i == 0 || ms < best)
+			best = ms;
+	}
+	return best;
+}
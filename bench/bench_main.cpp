@@ -0,0 +1,55 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <vector>
+
+namespace
+{
+	struct Benchmark
+	{
+		const char* name;
+		void (*function)();
+	};
+
+	// Function local so registrations in other translation units can't run before it exists
+	std::vector<Benchmark>& GetBenchmarks()
+	{
+		static std::vector<Benchmark> benchmarks;
+		return benchmarks;
+	}
+}
+
+BenchmarkRegistration::BenchmarkRegistration(const char* name, void (*function)())
+{
+	GetBenchmarks().push_back({ name, function });
+}
+
+// Runs every benchmark whose name contains one of the arguments, or all of them without arguments
+int main(int argc, char** argv)
+{
+	size_t run = 0;
+	size_t failed = 0;
+	for (const Benchmark& benchmark : GetBenchmarks()) {
+		bool selected = argc < 2;
+		for (int i = 1; i < argc && !selected; i++)
+			selected = strstr(benchmark.name, argv[i]) != nullptr;
+		if (!selected)
+			continue;
+
+		run++;
+		printf("%s\n", benchmark.name);
+		try
+		{
+			benchmark.function();
+		}
+		catch (const std::exception& e)
+		{
+			failed++;
+			printf("[FAILED] %s\n  %s\n", benchmark.name, e.what());
+		}
+		fflush(stdout);
+	}
+	return failed == 0 && run > 0 ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+#include "bench.h"
+
+#include "draw_sorter.h"
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+BENCHMARK(DrawSorterAgainstStableSort)
+{
+	std::mt19937_64 random(3);
+	std::uniform_real_distribution<float> distance(0.f, 100.f);
+	ThreadPool pool;
+	DrawSorter inline_sorter(pool, 1);
+	DrawSorter pool_sorter(pool);
+	// On a single thread pool both sorters would sort the same way
+	std::vector<DrawSorter*> sorters = { &inline_sorter };
+	if (pool_sorter.GetThreadCount() > 1)
+		sorters.push_back(&pool_sorter);
+	else
+		printf("  1 pool thread, only the inline sorter runs\n");
+
+	for (size_t count : { 10000u, 100000u, 1000000u }) {
+		// A scene's worth of pipelines and materials, the pass digit is shared and skipped
+		std::vector<DrawPacket> packets(count);
+		for (size_t i = 0; i < count; i++) {
+			const uint64_t key = DrawKey::Make(0, static_cast<uint32_t>(random() % 8), static_cast<uint32_t>(random() % 256),
+				DrawKey::QuantizeDepth(distance(random), 100.f));
+			packets[i] = { key, static_cast<uint32_t>(i) };
+		}
+
+		std::vector<DrawPacket> reference, sorted;
+		const double stable_sort_ms = MeasureMs(5, [&] {
+			reference = packets;
+			std::stable_sort(reference.begin(), reference.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+		});
+		auto same_as_reference = [&] {
+			for (size_t i = 0; i < count; i++) {
+				if (sorted[i].key != reference[i].key || sorted[i].draw != reference[i].draw)
+					return false;
+			}
+			return true;
+		};
+
+		printf("  %zu packets: std::stable_sort %.3f ms", count, stable_sort_ms);
+		for (DrawSorter* sorter : sorters) {
+			const double radix_ms = MeasureMs(5, [&] {
+				sorted = packets;
+				sorter->Sort(sorted);
+			});
+			BENCH_REQUIRE(sorted.size() == count && same_as_reference());
+			// Lists too short for a block per thread fall back to fewer blocks, one runs inline
+			const uint32_t blocks = sorter->GetStats().blocks;
+			printf(", radix on %u thread%s %.3f ms (%u digit passes, ", sorter->GetThreadCount(), sorter->GetThreadCount() == 1 ? "" : "s",
+				radix_ms, sorter->GetStats().digit_passes);
+			if (blocks == 1)
+				printf("inline)");
+			else
+				printf("%u blocks)", blocks);
+		}
+		printf("\n");
+	}
+}
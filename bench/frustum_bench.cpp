@@ -0,0 +1,78 @@
+#include "bench.h"
+
+#include "frustum_culler.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// Left handed look-to view and 60 degree perspective, row major for row vectors like DirectXMath
+	void MakeViewProjection(float x, float z, float yaw, float* view_projection)
+	{
+		const float forward[3] = { std::sin(yaw), 0.f, std::cos(yaw) };
+		const float right[3] = { forward[2], 0.f, -forward[0] };
+		const float h = 1.f / std::tan(3.14159265f / 6.f);
+		const float aspect = 16.f / 9.f;
+		const float near_plane = .1f;
+		const float far_plane = 100.f;
+		const float depth = far_plane / (far_plane - near_plane);
+		// View rows are right, up and forward with the eye at (x, 0, z), projected right away
+		const float right_eye = -(right[0] * x + right[2] * z);
+		const float forward_eye = -(forward[0] * x + forward[2] * z);
+		const float matrix[16] = {
+			right[0] * h / aspect, 0.f, forward[0] * depth, forward[0],
+			0.f, h, 0.f, 0.f,
+			right[2] * h / aspect, 0.f, forward[2] * depth, forward[2],
+			right_eye * h / aspect, 0.f, forward_eye * depth - near_plane * depth, forward_eye };
+		for (int i = 0; i < 16; i++)
+			view_projection[i] = matrix[i];
+	}
+}
+
+BENCHMARK(FrustumCullKernels)
+{
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> position(-200.f, 200.f);
+	std::uniform_real_distribution<float> size(.1f, 4.f);
+	const bool avx2 = IsCullKernelSupported(CullKernel::Avx2);
+	if (!avx2)
+		printf("  AVX2 isn't supported, timing the scalar kernel only\n");
+
+	// A count that isn't a multiple of the AVX2 batch checks the tail as well
+	for (size_t count : { 100003u, 1000000u }) {
+		FrustumCuller culler;
+		for (size_t i = 0; i < count; i++) {
+			const float x = position(random), y = position(random) * .1f, z = position(random), s = size(random);
+			culler.Add({ { x - s, y - s, z - s }, { x + s, y + 2 * s, z + s } });
+		}
+
+		// Both kernels must report the same boxes in the same order from every camera
+		size_t total_visible = 0;
+		for (int camera = 0; camera < 16; camera++) {
+			float view_projection[16];
+			MakeViewProjection(position(random) * .2f, position(random) * .2f, camera * .4f, view_projection);
+			std::vector<uint32_t> scalar, vectorized;
+			culler.Cull(CullKernel::Scalar, view_projection, scalar);
+			total_visible += scalar.size();
+			if (avx2) {
+				culler.Cull(CullKernel::Avx2, view_projection, vectorized);
+				BENCH_REQUIRE(scalar == vectorized);
+			}
+		}
+		BENCH_REQUIRE(total_visible > 0 && total_visible < count * 16);
+
+		float view_projection[16];
+		MakeViewProjection(0.f, 0.f, 0.f, view_projection);
+		std::vector<uint32_t> visible;
+		const double scalar_ms = MeasureMs(10, [&] { culler.Cull(CullKernel::Scalar, view_projection, visible); });
+		printf("  %zu boxes, %zu visible: scalar %.0f us (%.2f ns per box)", count, visible.size(), scalar_ms * 1000.0, scalar_ms * 1e6 / count);
+		if (avx2) {
+			const double avx2_ms = MeasureMs(10, [&] { culler.Cull(CullKernel::Avx2, view_projection, visible); });
+			printf(", AVX2 %.0f us (%.2f ns per box), %.1fx", avx2_ms * 1000.0, avx2_ms * 1e6 / count, scalar_ms / avx2_ms);
+		}
+		printf("\n");
+	}
+}
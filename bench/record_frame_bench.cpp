@@ -0,0 +1,131 @@
+#include "bench.h"
+
+#include "frame_recorder.h"
+#include "parallel_for.h"
+#include "rhi_null.h"
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace
+{
+	// The scene pass on the null device, one pipeline and a render target
+	struct NullScene
+	{
+		RHI::NullDevice device;
+		std::unique_ptr<RHI::RootSignature> root_signature = device.CreateRootSignature();
+		std::unique_ptr<RHI::PipelineState> pipeline = device.CreatePipelineState();
+		RHI::PipelineState* pipelines[1] = { pipeline.get() };
+		FrameContext frame = {};
+
+		NullScene()
+		{
+			frame.root_signature = root_signature.get();
+			frame.rtv = { 1 };
+			frame.view_port = { 0.f, 0.f, 1280.f, 720.f, 0.f, 1.f };
+			frame.scissor_rect = { 0, 0, 1280, 720 };
+			frame.pipeline_states = pipelines;
+		}
+	};
+
+	std::vector<DrawItem> MakeDraws(uint32_t count)
+	{
+		std::vector<DrawItem> draws;
+		for (uint32_t i = 0; i < count; i++)
+			draws.push_back({ i * 3, 3, (1ull << 32) + i * 256ull, 0, 0 });
+		return draws;
+	}
+}
+
+BENCHMARK(RecordFrameParallelScaling)
+{
+	// Recording onto null command lists measures only the CPU side of RecordFrameParallel
+	NullScene scene;
+	RHI::NullDevice& device = scene.device;
+	const FrameContext& frame = scene.frame;
+
+	const uint32_t frame_count = 50;
+	for (uint32_t draw_count : { 2000u, 20000u }) {
+		const std::vector<DrawItem> draws = MakeDraws(draw_count);
+
+		printf("  %u draws:\n", draw_count);
+		for (uint32_t list_count : { 1u, 2u, 4u, 8u }) {
+			auto allocator = device.CreateCommandAllocator(RHI::CommandListType::Direct);
+			std::vector<std::unique_ptr<RHI::CommandList>> lists;
+			std::vector<RHI::CommandList*> list_pointers;
+			for (uint32_t i = 0; i < list_count; i++) {
+				lists.push_back(device.CreateCommandList(RHI::CommandListType::Direct, allocator.get(), nullptr));
+				list_pointers.push_back(lists.back().get());
+			}
+			auto record_frames = [&](ThreadPool* persistent) {
+				for (uint32_t i = 0; i < frame_count; i++) {
+					for (RHI::CommandList* list : list_pointers) {
+						list->Close();
+						list->Reset(allocator.get(), nullptr);
+					}
+					// A pool per frame starts and joins its threads like the old per-call ParallelFor
+					std::unique_ptr<ThreadPool> per_frame;
+					if (!persistent)
+						per_frame = std::make_unique<ThreadPool>(list_count);
+					RecordFrameParallel(persistent ? *persistent : *per_frame, list_pointers.data(), list_count, frame, draws);
+				}
+			};
+
+			ThreadPool pool(list_count);
+			const double persistent_ms = MeasureMs(3, [&] { record_frames(&pool); }) / frame_count;
+			const double per_frame_ms = MeasureMs(3, [&] { record_frames(nullptr); }) / frame_count;
+			uint64_t recorded = 0;
+			for (RHI::CommandList* list : list_pointers)
+				recorded += static_cast<RHI::RecordingCommandList*>(list)->GetStream().GetCommandCount(RHI::CommandId::DrawInstanced);
+			BENCH_REQUIRE(recorded == draw_count);
+			printf("    %u lists: %.3f ms per frame on a persistent pool, %.3f ms starting threads every frame\n",
+				list_count, persistent_ms, per_frame_ms);
+		}
+	}
+}
+
+BENCHMARK(RecordFrameWithBundle)
+{
+	// Per frame CPU cost of recording every draw against executing a bundle recorded once,
+	// and the cost of that one-off recording when the draws change
+	NullScene scene;
+	RHI::NullDevice& device = scene.device;
+	auto allocator = device.CreateCommandAllocator(RHI::CommandListType::Direct);
+	auto list = device.CreateCommandList(RHI::CommandListType::Direct, allocator.get(), nullptr);
+	auto bundle_allocator = device.CreateCommandAllocator(RHI::CommandListType::Bundle);
+	auto bundle = device.CreateCommandList(RHI::CommandListType::Bundle, bundle_allocator.get(), nullptr);
+
+	for (uint32_t draw_count : { 1000u, 10000u, 100000u }) {
+		const std::vector<DrawItem> draws = MakeDraws(draw_count);
+		const double bundle_ms = MeasureMs(20, [&] {
+			bundle->Reset(bundle_allocator.get(), nullptr);
+			RecordDraws(*bundle, scene.frame, draws.data(), draws.size());
+			bundle->Close();
+		});
+
+		auto record = [&](bool with_bundle) {
+			list->Reset(allocator.get(), nullptr);
+			if (with_bundle)
+				RecordFrameWithBundle(*list, scene.frame, bundle.get());
+			else
+				RecordFrame(*list, scene.frame, draws);
+			list->Close();
+		};
+		// Both lists must draw the same when executed
+		uint64_t draw_calls[2] = {};
+		for (bool with_bundle : { false, true }) {
+			record(with_bundle);
+			auto queue = device.CreateCommandQueue(RHI::CommandListType::Direct);
+			RHI::CommandList* lists[] = { list.get() };
+			queue->ExecuteCommandLists(1, lists);
+			draw_calls[with_bundle] = static_cast<RHI::NullCommandQueue*>(queue.get())->GetStats().draw_calls;
+		}
+		BENCH_REQUIRE(draw_calls[0] == draw_count && draw_calls[1] == draw_count);
+
+		const double record_ms = MeasureMs(20, [&] { record(false); });
+		const double with_bundle_ms = MeasureMs(20, [&] { record(true); });
+		printf("  %6u draws: %.4f ms recording every draw, %.4f ms with the bundle, %.3f ms to record the bundle\n",
+			draw_count, record_ms, with_bundle_ms, bundle_ms);
+	}
+}
@@ -0,0 +1,80 @@
+#include "bench.h"
+
+#include "parallel_for.h"
+#include "shader_cache.h"
+#include "shader_permutations.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// The variants the build compiles from shaders.hlsl, with and without bindless
+	std::vector<ShaderVariant> GetBuildVariants()
+	{
+		const ShaderPermutationSet features = ShaderPermutationSet::Parse("BUMP_MAPPING+POINT_LIGHT,POINT_LIGHT");
+		std::vector<ShaderVariant> variants;
+		for (const char* defines : { "", ":BINDLESS" }) {
+			variants.push_back(ParseShaderVariant(std::string("VSMain:vs_6_0") + defines));
+			variants.push_back(ParseShaderVariant(std::string("VSDepth:vs_6_0") + defines));
+			const ShaderVariant base = ParseShaderVariant(std::string("PSMain:ps_6_0") + defines);
+			for (uint32_t permutation : features.GetDistinctPermutations()) {
+				ShaderVariant variant = base;
+				variant.defines = features.GetDefines(permutation, base.defines);
+				variants.push_back(variant);
+			}
+		}
+		return variants;
+	}
+}
+
+BENCHMARK(ShaderCompileThroughput)
+{
+	// The shader compiler tool's path: one DXC process per variant, run from a parallel loop.
+	// Runs from the repository or from the build output, where the build copies shaders.hlsl.
+	std::string source_path;
+	for (const char* candidate : { "shaders/shaders.hlsl", "shaders.hlsl" }) {
+		if (std::filesystem::exists(candidate)) {
+			source_path = candidate;
+			break;
+		}
+	}
+	const char* dxc_variable = std::getenv("DXC");
+	const std::string dxc = dxc_variable ? dxc_variable : "dxc";
+	if (source_path.empty() || !IsDxcAvailable(dxc)) {
+		printf("  skipped, needs %s on the PATH or in DXC and shaders.hlsl in the working directory\n", dxc.c_str());
+		return;
+	}
+
+	const std::vector<ShaderVariant> variants = GetBuildVariants();
+	const std::string output_prefix = (std::filesystem::temp_directory_path() / "shader_compile_bench.tmp").string();
+	std::vector<size_t> bytecode_sizes;
+	// DXC is CPU bound, more processes than hardware threads only queue up
+	const uint32_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+	for (uint32_t thread_count = 1; thread_count <= hardware_threads; thread_count *= 2) {
+		std::vector<size_t> sizes(variants.size());
+		const double ms = MeasureMs(1, [&] {
+			ParallelFor(variants.size(), thread_count, [&](size_t i) {
+				const std::string bytecode_path = output_prefix + std::to_string(i);
+				const int result = std::system(GetDxcCommandLine(dxc, variants[i], source_path, bytecode_path).c_str());
+				{
+					std::ifstream file(bytecode_path, std::ios::binary);
+					sizes[i] = std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()).size();
+				}
+				std::remove(bytecode_path.c_str());
+				BENCH_REQUIRE(result == 0 && sizes[i] > 0);
+			});
+		});
+		// Every thread count compiles the same shaders
+		if (bytecode_sizes.empty())
+			bytecode_sizes = sizes;
+		BENCH_REQUIRE(sizes == bytecode_sizes);
+		printf("  %u threads: %zu variants in %.0f ms, %.1f variants/s\n", thread_count, variants.size(), ms, variants.size() * 1000.0 / ms);
+	}
+}
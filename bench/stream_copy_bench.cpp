@@ -0,0 +1,57 @@
+#include "bench.h"
+
+#include "stream_copy.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	// Start of a 64 byte aligned range of size bytes within storage
+	uint8_t* AlignedRange(std::vector<uint8_t>& storage, size_t size)
+	{
+		storage.resize(size + 64);
+		const uintptr_t address = reinterpret_cast<uintptr_t>(storage.data());
+		return storage.data() + ((64 - address % 64) % 64);
+	}
+}
+
+BENCHMARK(StreamCopyKernels)
+{
+	// Ordinary cached memory stands in for the write-combined upload heap, so streaming only pays
+	// off once a copy outgrows the caches. Every iteration is fenced like a Flush.
+	printf("  %-8s", "size");
+	const StreamKernel kernels[] = { StreamKernel::Memcpy, StreamKernel::Sse2, StreamKernel::Avx };
+	for (StreamKernel kernel : kernels)
+		printf(" %8s", GetStreamKernelName(kernel));
+	printf("  GB/s\n");
+
+	for (size_t size : { size_t(256), size_t(64) * 1024, size_t(64) * 1024 * 1024 }) {
+		std::vector<uint8_t> source_storage, destination_storage;
+		uint8_t* source = AlignedRange(source_storage, size);
+		uint8_t* destination = AlignedRange(destination_storage, size);
+		for (size_t i = 0; i < size; i++)
+			source[i] = static_cast<uint8_t>(i * 7);
+
+		const size_t iterations = std::max<size_t>(1, (size_t(256) * 1024 * 1024) / size);
+		printf("  %-8zu", size);
+		for (StreamKernel kernel : kernels) {
+			if (!IsStreamKernelSupported(kernel)) {
+				printf(" %8s", "-");
+				continue;
+			}
+			memset(destination, 0, size);
+			const double ms = MeasureMs(3, [&] {
+				for (size_t i = 0; i < iterations; i++) {
+					StreamCopy(kernel, destination, source, size);
+					StreamFence();
+				}
+			});
+			BENCH_REQUIRE(memcmp(destination, source, size) == 0);
+			printf(" %8.1f", size * iterations / (ms * 1e6));
+		}
+		printf("\n");
+	}
+}
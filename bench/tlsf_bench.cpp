@@ -0,0 +1,75 @@
+#include "bench.h"
+
+#include "tlsf_allocator.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	struct Operation
+	{
+		bool allocate;
+		uint64_t size;
+		uint64_t alignment;
+		uint32_t slot;
+	};
+
+	// Random allocations and frees that keep about live_count blocks alive, generated up front so
+	// the timed loop only runs the allocator
+	std::vector<Operation> MakeOperations(uint32_t count, uint32_t live_count, uint32_t seed)
+	{
+		std::mt19937 random(seed);
+		std::vector<Operation> operations;
+		std::vector<uint32_t> live;
+		uint32_t next_slot = 0;
+		for (uint32_t i = 0; i < count; i++) {
+			const bool allocate = live.empty() || (live.size() < live_count ? random() % 4 != 0 : random() % 4 == 0);
+			if (allocate) {
+				const uint64_t size = random() % 8 ? 1 + random() % (64 * 1024) : 1 + random() % (1024 * 1024);
+				operations.push_back({ true, size, uint64_t(1) << (8 + random() % 9), next_slot });
+				live.push_back(next_slot++);
+			}
+			else {
+				const size_t index = random() % live.size();
+				operations.push_back({ false, 0, 0, live[index] });
+				live[index] = live.back();
+				live.pop_back();
+			}
+		}
+		return operations;
+	}
+}
+
+BENCHMARK(TlsfAllocateFree)
+{
+	const uint32_t operation_count = 400000;
+	const uint64_t capacity = 4ull * 1024 * 1024 * 1024;
+	for (uint32_t live_count : { 256u, 4096u, 32768u }) {
+		const std::vector<Operation> operations = MakeOperations(operation_count, live_count, 5);
+		std::vector<TlsfAllocator::Allocation> slots(operations.size());
+		uint64_t failures = 0;
+		TlsfAllocator::Stats stats = {};
+		const double ms = MeasureMs(5, [&] {
+			TlsfAllocator allocator(capacity, 256);
+			failures = 0;
+			for (const Operation& operation : operations) {
+				TlsfAllocator::Allocation& slot = slots[operation.slot];
+				if (operation.allocate) {
+					if (!allocator.Allocate(operation.size, operation.alignment, slot)) {
+						slot.block = TlsfAllocator::invalid_block;
+						failures++;
+					}
+				}
+				else if (slot.block != TlsfAllocator::invalid_block) {
+					allocator.Free(slot);
+				}
+			}
+			stats = allocator.GetStats();
+		});
+		BENCH_REQUIRE(failures == 0);
+		printf("  %6u live: %7.1f ns per operation, %u free blocks, fragmentation %.3f\n",
+			live_count, ms * 1e6 / operation_count, stats.free_blocks, stats.fragmentation);
+	}
+}
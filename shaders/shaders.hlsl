@@ -1,7 +1,23 @@
+#ifdef BINDLESS
+struct ObjectConstants
+{
+	float4x4 mvpMatrix;
+};
+
+// Index of the draw's constant buffer view in the shader visible heap
+cbuffer DrawConstants: register(b0)
+{
+	uint constantsIndex;
+}
+ConstantBuffer<ObjectConstants> objectConstants[]: register(b0, space1);
+
+#define mvpMatrix objectConstants[constantsIndex].mvpMatrix
+#else
 cbuffer ConstantBuffer: register(b0)
 {
 	float4x4 mvpMatrix;
 }
+#endif
 
 struct PSInput
 {
@@ -11,39 +27,69 @@ struct PSInput
 	float3 origin : POSITION;
 };
 
-PSInput VSMain(float4 position : POSITION, float4 color : COLOR, float3 norm : NORMAL)
+// Vertex inputs, generated from the C++ vertex format when compiled by the renderer or the shader compiler
+#ifndef VERTEX_INPUT
+#define VERTEX_INPUT float3 position : POSITION, float4 color : COLOR, float3 norm : NORMAL
+#endif
+
+// Shared by both vertex shaders, the colour pass tests EQUAL against the depth the pre-pass wrote
+float4 TransformPosition(float3 position)
+{
+	precise float4 result = mul(mvpMatrix, float4(position, 1));
+	return result;
+}
+
+PSInput VSMain(VERTEX_INPUT)
 {
 	PSInput result;
 
-	result.position = mul(mvpMatrix, position);
+	result.position = TransformPosition(position);
 	result.color = color;
 	result.norm = norm;
-	result.origin = position.xyz / position.w;
+	result.origin = position;
 
 	return result;
 }
 
-float4 PSMain(PSInput input) : SV_TARGET
+// Depth pre-pass, outputs only the position and runs without a pixel shader
+float4 VSDepth(VERTEX_INPUT) : SV_POSITION
 {
-	float3 light = float3(0.,0., 0);
+	return TransformPosition(position);
+}
 
+// Pixel shader features, compiled as 0 or 1 per permutation and all enabled by default.
+// Bump mapping only perturbs the normal used by the point light, so it's declared as requiring
+// POINT_LIGHT and the permutations with it alone aren't built.
+#ifndef BUMP_MAPPING
+#define BUMP_MAPPING 1
+#endif
+#ifndef POINT_LIGHT
+#define POINT_LIGHT 1
+#endif
+
+float4 PSMain(PSInput input) : SV_TARGET
+{
 	float4 diff = input.color / 2.;
+	float4 col = float4(0, 0, 0, 0);
 
+#if POINT_LIGHT
+	float3 light = float3(0.,0., 0);
+	float3 alt_norm = input.norm;
 
+#if BUMP_MAPPING
 	float alpha = ((0 - input.origin.x) * (0 - input.origin.x) + (2- input.origin.y) * (2-input.origin.y) + input.origin.z * input.origin.z) * 10;
 	
 
 	float3 shx = cross(float3(1, 1, 0), input.norm);
 	float3 shy = cross(shx, input.norm);
-	float3 alt_norm = input.norm + (shx * sin(alpha) / 9.) + (shy * cos(alpha) / 9.);
+	alt_norm = input.norm + (shx * sin(alpha) / 9.) + (shy * cos(alpha) / 9.);
+#endif
 
 	float3 to_light = light - input.origin.xyz;
 	float k = abs(dot(to_light, alt_norm) / length(to_light) / length(alt_norm));
-	float4 col = k * diff;
-
+	col = k * diff;
+#endif
 
-	if (input.position.z <= 0)
-		return float4(0, 0, 0, 0); 
 	return diff + col;
 	//return float4(abs(input.norm) / 2. + float3(.5, .5, .5), 1);
 }
@@ -0,0 +1,85 @@
+#include "constant_buffer_manager.h"
+
+#include <stdexcept>
+
+ConstantBufferManager::ConstantBufferManager(RHI::Device& device, uint32_t capacity, uint32_t frame_count)
+	: capacity((capacity + block_alignment - 1) & ~(block_alignment - 1)), frame_count(frame_count),
+	kernel(GetBestStreamKernel()), shadow(this->capacity, 0)
+{
+	if (this->capacity == 0 || frame_count == 0)
+		throw std::invalid_argument("Constant buffer manager without memory");
+	if (frame_count > max_frame_count)
+		throw std::invalid_argument("Too many frame copies for the constant buffer manager");
+	buffer = device.CreateBuffer(RHI::HeapType::Upload, static_cast<uint64_t>(this->capacity) * frame_count, RHI::ResourceState::GenericRead);
+	// Stays mapped, write-combined on most hardware so it is only ever written
+	mapped = static_cast<uint8_t*>(buffer->Map());
+	for (uint32_t frame = 0; frame < frame_count; frame++)
+		StreamCopy(kernel, mapped + static_cast<uint64_t>(frame) * this->capacity, shadow.data(), this->capacity);
+	StreamFence();
+}
+
+ConstantBufferManager::~ConstantBufferManager()
+{
+	buffer->Unmap();
+}
+
+uint32_t ConstantBufferManager::Allocate(uint32_t size)
+{
+	const uint32_t aligned_size = (size + block_alignment - 1) & ~(block_alignment - 1);
+	if (size == 0 || aligned_size > capacity - used)
+		throw std::runtime_error("Constant buffer manager is full");
+	blocks.push_back({ used, aligned_size, 0 });
+	used += aligned_size;
+	return static_cast<uint32_t>(blocks.size() - 1);
+}
+
+bool ConstantBufferManager::Update(uint32_t block, const void* data, uint32_t size, uint32_t offset)
+{
+	if (block >= blocks.size())
+		throw std::out_of_range("Unknown constant buffer block");
+	Block& target = blocks[block];
+	if (offset > target.size || size > target.size - offset)
+		throw std::out_of_range("Update past the end of a constant buffer block");
+
+	stats.updates++;
+	// Comparing against cached shadow memory is far cheaper than writing upload memory
+	uint8_t* contents = shadow.data() + target.offset + offset;
+	if (memcmp(contents, data, size) == 0) {
+		stats.unchanged_updates++;
+		return false;
+	}
+	memcpy(contents, data, size);
+	if (target.stale_frames == 0)
+		dirty.push_back(block);
+	target.stale_frames = frame_count == 32 ? ~0u : (1u << frame_count) - 1;
+	return true;
+}
+
+void ConstantBufferManager::BeginFrame(uint32_t frame_index)
+{
+	this->frame_index = frame_index % frame_count;
+}
+
+uint64_t ConstantBufferManager::Flush()
+{
+	const uint32_t frame_bit = 1u << frame_index;
+	uint64_t written = 0;
+	size_t kept = 0;
+	for (uint32_t block : dirty) {
+		Block& target = blocks[block];
+		if (target.stale_frames & frame_bit) {
+			// Whole blocks keep the stores aligned and the destination is never read
+			StreamCopy(kernel, mapped + GetOffset(block), shadow.data() + target.offset, target.size);
+			target.stale_frames &= ~frame_bit;
+			written += target.size;
+			stats.written_blocks++;
+		}
+		if (target.stale_frames)
+			dirty[kept++] = block;
+	}
+	dirty.resize(kept);
+	if (written)
+		StreamFence();
+	stats.written_bytes += written;
+	return written;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "rhi.h"
+#include "stream_copy.h"
+
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Persistent constant buffers with one copy per frame in flight.
+// Updates land in a CPU shadow copy and only mark a block dirty when its contents change.
+// Flush streams the dirty blocks into the current frame's copy with non-temporal stores, so
+// the upload heap is never read and frames where nothing changed write nothing at all.
+class ConstantBufferManager
+{
+public:
+	static const uint32_t block_alignment = 256;
+	static const uint32_t max_frame_count = 32;
+
+	struct Stats
+	{
+		uint64_t updates;
+		// Updates that matched the shadow copy and wrote nothing
+		uint64_t unchanged_updates;
+		uint64_t written_blocks;
+		uint64_t written_bytes;
+	};
+
+	ConstantBufferManager(RHI::Device& device, uint32_t capacity, uint32_t frame_count);
+	~ConstantBufferManager();
+	ConstantBufferManager(const ConstantBufferManager&) = delete;
+	ConstantBufferManager& operator=(const ConstantBufferManager&) = delete;
+
+	// Reserves size bytes in every frame copy, zero filled, throws std::runtime_error when full
+	uint32_t Allocate(uint32_t size);
+
+	// Returns whether the block changed
+	bool Update(uint32_t block, const void* data, uint32_t size, uint32_t offset = 0);
+	template <class T>
+	bool Update(uint32_t block, const T& data)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Constants are compared and copied bytewise");
+		return Update(block, &data, sizeof(T));
+	}
+
+	// Selects the copy recorded draws read, the GPU must be done with the frame that last used it
+	void BeginFrame(uint32_t frame_index);
+	// Writes the blocks the current copy is missing, returns how many bytes were written
+	uint64_t Flush();
+
+	// Location of the block in the current frame's copy
+	uint64_t GetGpuAddress(uint32_t block) const { return buffer->GetGpuAddress() + GetOffset(block); }
+	uint64_t GetOffset(uint32_t block) const { return static_cast<uint64_t>(frame_index) * capacity + blocks[block].offset; }
+	uint64_t GetOffset(uint32_t block, uint32_t frame) const { return static_cast<uint64_t>(frame) * capacity + blocks[block].offset; }
+	uint32_t GetSize(uint32_t block) const { return blocks[block].size; }
+	// Latest contents of the block, including updates not flushed yet
+	const void* GetData(uint32_t block) const { return shadow.data() + blocks[block].offset; }
+
+	RHI::Resource* GetResource() const { return buffer.get(); }
+	uint32_t GetFrameCount() const { return frame_count; }
+	uint32_t GetDirtyCount() const { return static_cast<uint32_t>(dirty.size()); }
+	const Stats& GetStats() const { return stats; }
+
+private:
+	struct Block
+	{
+		uint32_t offset;
+		uint32_t size;
+		// Bit per frame copy that still holds old contents
+		uint32_t stale_frames;
+	};
+
+	std::unique_ptr<RHI::Resource> buffer;
+	uint8_t* mapped;
+	uint32_t capacity;
+	uint32_t frame_count;
+	uint32_t frame_index = 0;
+	uint32_t used = 0;
+	StreamKernel kernel;
+	std::vector<uint8_t> shadow;
+	std::vector<Block> blocks;
+	// Blocks with stale copies, so Flush doesn't walk clean blocks
+	std::vector<uint32_t> dirty;
+	Stats stats = {};
+};
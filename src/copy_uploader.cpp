@@ -0,0 +1,113 @@
+#include "copy_uploader.h"
+
+#include <algorithm>
+
+CopyUploader::CopyUploader(RHI::Device& device, uint64_t staging_capacity)
+	: device(device), staging(device, staging_capacity)
+{
+	queue = device.CreateCommandQueue(RHI::CommandListType::Copy);
+	allocator = device.CreateCommandAllocator(RHI::CommandListType::Copy);
+	command_list = device.CreateCommandList(RHI::CommandListType::Copy, allocator.get(), nullptr);
+	command_list->Close();
+	fence = device.CreateFence(0);
+}
+
+std::unique_ptr<RHI::Resource> CopyUploader::CreateBuffer(const void* data, uint64_t size)
+{
+	std::unique_ptr<RHI::Resource> buffer = device.CreateBuffer(RHI::HeapType::Default, size, RHI::ResourceState::Common);
+	Upload(buffer.get(), 0, data, size);
+	return buffer;
+}
+
+void CopyUploader::Upload(RHI::Resource* dest, uint64_t dest_offset, const void* data, uint64_t size)
+{
+	// Uploads larger than the staging ring go through it in pieces
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	while (size > 0) {
+		const uint64_t chunk = std::min(size, staging.GetRing().GetCapacity());
+		UploadAllocation allocation = AllocateStaging(chunk);
+		memcpy(allocation.cpu_address, bytes, static_cast<size_t>(chunk));
+
+		BeginRecording();
+		command_list->CopyBufferRegion(dest, dest_offset, allocation.resource, allocation.offset, chunk);
+		uploaded_bytes += chunk;
+
+		bytes += chunk;
+		dest_offset += chunk;
+		size -= chunk;
+	}
+}
+
+uint64_t CopyUploader::Submit()
+{
+	if (!recording)
+		return fence_value;
+
+	command_list->Close();
+	RHI::CommandList* lists[] = { command_list.get() };
+	queue->ExecuteCommandLists(1, lists);
+	queue->Signal(fence.get(), ++fence_value);
+	recording = false;
+
+	staging.EndFrame(fence_value);
+	in_flight.push_back({ std::move(allocator), fence_value });
+	return fence_value;
+}
+
+void CopyUploader::QueueWait(RHI::CommandQueue& queue) const
+{
+	if (fence_value > 0)
+		queue.Wait(fence.get(), fence_value);
+}
+
+void CopyUploader::Retire()
+{
+	const uint64_t completed = fence->GetCompletedValue();
+	staging.Retire(completed);
+	while (!in_flight.empty() && in_flight.front().fence_value <= completed) {
+		free_allocators.push_back(std::move(in_flight.front().allocator));
+		in_flight.pop_front();
+	}
+}
+
+void CopyUploader::WaitForIdle()
+{
+	Submit();
+	fence->Wait(fence_value);
+	Retire();
+}
+
+void CopyUploader::BeginRecording()
+{
+	if (recording)
+		return;
+
+	// The allocator of a submission is reused only after the copy queue is done with it
+	if (!allocator) {
+		Retire();
+		if (!free_allocators.empty()) {
+			allocator = std::move(free_allocators.back());
+			free_allocators.pop_back();
+		}
+		else {
+			allocator = device.CreateCommandAllocator(RHI::CommandListType::Copy);
+		}
+	}
+	allocator->Reset();
+	command_list->Reset(allocator.get(), nullptr);
+	recording = true;
+}
+
+UploadAllocation CopyUploader::AllocateStaging(uint64_t size)
+{
+	// Copies between buffers have no placement requirement beyond 4 bytes
+	const uint64_t alignment = 4;
+	Retire();
+	UploadAllocation allocation;
+	if (staging.TryAllocate(size, alignment, allocation))
+		return allocation;
+
+	// The ring is full of pending copies, flush them and start over
+	WaitForIdle();
+	return staging.Allocate(size, alignment);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "upload_ring.h"
+
+#include <deque>
+#include <vector>
+
+// Uploads static data into default heap buffers through a dedicated copy queue.
+// Data is staged in an UploadRing and copied asynchronously, other queues
+// synchronise with QueueWait instead of blocking the CPU.
+// Buffers are created in the common state: they are promoted to copy dest on the
+// copy queue and decay back once the copy completes, so no barriers are needed.
+class CopyUploader
+{
+public:
+	CopyUploader(RHI::Device& device, uint64_t staging_capacity);
+
+	// Creates a default heap buffer holding data once the next Submit completes
+	std::unique_ptr<RHI::Resource> CreateBuffer(const void* data, uint64_t size);
+	// Copies data into a default heap buffer the GPU is not using
+	void Upload(RHI::Resource* dest, uint64_t dest_offset, const void* data, uint64_t size);
+
+	// Executes the recorded copies, returns the fence value that marks their completion
+	uint64_t Submit();
+	// Makes queue wait on the GPU until every submitted copy has completed
+	void QueueWait(RHI::CommandQueue& queue) const;
+	// Recycles staging memory and allocators of completed submissions
+	void Retire();
+	// Submits pending copies and blocks until the copy queue is idle
+	void WaitForIdle();
+
+	RHI::CommandQueue* GetQueue() const { return queue.get(); }
+	RHI::Fence* GetFence() const { return fence.get(); }
+	uint64_t GetSubmittedFenceValue() const { return fence_value; }
+	uint64_t GetUploadedBytes() const { return uploaded_bytes; }
+	const RingAllocator& GetStaging() const { return staging.GetRing(); }
+
+private:
+	struct Submission
+	{
+		std::unique_ptr<RHI::CommandAllocator> allocator;
+		uint64_t fence_value;
+	};
+
+	RHI::Device& device;
+	std::unique_ptr<RHI::CommandQueue> queue;
+	std::unique_ptr<RHI::CommandList> command_list;
+	std::unique_ptr<RHI::CommandAllocator> allocator;
+	std::unique_ptr<RHI::Fence> fence;
+	uint64_t fence_value = 0;
+	bool recording = false;
+	uint64_t uploaded_bytes = 0;
+
+	UploadRing staging;
+	std::deque<Submission> in_flight;
+	std::vector<std::unique_ptr<RHI::CommandAllocator>> free_allocators;
+
+	void BeginRecording();
+	UploadAllocation AllocateStaging(uint64_t size);
+};
@@ -0,0 +1,25 @@
+#include "deferred_release.h"
+
+size_t DeferredReleaseQueue::Collect(uint64_t completed_fence_value)
+{
+	size_t count = 0;
+	while (!pending.empty() && pending.front().fence_value <= completed_fence_value) {
+		// Popping first keeps the queue consistent if a release defers something else
+		std::unique_ptr<Releasable> item = std::move(pending.front().item);
+		pending.pop_front();
+		item.reset();
+		count++;
+	}
+	released_count += count;
+	return count;
+}
+
+void DeferredReleaseQueue::Flush()
+{
+	while (!pending.empty()) {
+		std::unique_ptr<Releasable> item = std::move(pending.front().item);
+		pending.pop_front();
+		item.reset();
+		released_count++;
+	}
+}
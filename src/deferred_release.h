@@ -0,0 +1,66 @@
+#pragma once
+
+#include "rhi.h"
+
+#include <deque>
+#include <type_traits>
+
+// Holds on to objects the GPU may still use until a fence value completes.
+// Anything replaced or destroyed while frames are in flight is queued with the fence
+// value of the last submission that can reference it and freed by Collect, which
+// never blocks. Releases are expected in non-decreasing fence value order.
+class DeferredReleaseQueue
+{
+public:
+	DeferredReleaseQueue() = default;
+	DeferredReleaseQueue(const DeferredReleaseQueue&) = delete;
+	DeferredReleaseQueue& operator=(const DeferredReleaseQueue&) = delete;
+	~DeferredReleaseQueue() { Flush(); }
+
+	template <class T>
+	void Release(std::unique_ptr<T> object, uint64_t fence_value)
+	{
+		static_assert(std::is_base_of<RHI::Object, T>::value, "Only RHI objects can be released");
+		if (object)
+			Defer([object = std::move(object)]() mutable { object.reset(); }, fence_value);
+	}
+
+	// Runs release once fence_value completes, for descriptors, heap blocks and other handles
+	template <class F>
+	void Defer(F&& release, uint64_t fence_value)
+	{
+		pending.push_back({ fence_value, std::make_unique<Callback<std::decay_t<F>>>(std::forward<F>(release)) });
+	}
+
+	// Frees everything tagged with a fence value up to completed_fence_value, returns how many
+	size_t Collect(uint64_t completed_fence_value);
+	// Frees everything, the GPU must be idle
+	void Flush();
+
+	size_t GetPendingCount() const { return pending.size(); }
+	uint64_t GetReleasedCount() const { return released_count; }
+
+private:
+	struct Releasable
+	{
+		virtual ~Releasable() = default;
+	};
+
+	// Releasing happens in the destructor so move-only captures work
+	template <class F>
+	struct Callback : Releasable
+	{
+		explicit Callback(F release) : release(std::move(release)) {}
+		~Callback() override { release(); }
+		F release;
+	};
+
+	struct Entry
+	{
+		uint64_t fence_value;
+		std::unique_ptr<Releasable> item;
+	};
+
+	std::deque<Entry> pending;
+	uint64_t released_count = 0;
+};
@@ -0,0 +1,60 @@
+#include "descriptor_allocator.h"
+
+#include <stdexcept>
+
+DescriptorAllocator::DescriptorAllocator(RHI::Device& device, RHI::DescriptorHeapType type, bool shader_visible,
+	uint32_t persistent_capacity, uint32_t transient_capacity_per_frame, uint32_t frames_in_flight)
+	: persistent_capacity(persistent_capacity), allocated(persistent_capacity, false),
+	transient_capacity(frames_in_flight ? transient_capacity_per_frame : 0), frame_count(frames_in_flight)
+{
+	const uint32_t capacity = persistent_capacity + transient_capacity * frame_count;
+	if (capacity == 0)
+		throw std::invalid_argument("Descriptor heap without descriptors");
+	heap = device.CreateDescriptorHeap(type, capacity, shader_visible);
+	transient_begin = persistent_capacity;
+}
+
+uint32_t DescriptorAllocator::AllocatePersistent()
+{
+	uint32_t index;
+	if (!free_list.empty()) {
+		index = free_list.back();
+		free_list.pop_back();
+	}
+	else if (persistent_high_water < persistent_capacity) {
+		index = persistent_high_water++;
+	}
+	else {
+		throw std::runtime_error("Persistent descriptor region is full");
+	}
+
+	allocated[index] = true;
+	persistent_used++;
+	return index;
+}
+
+void DescriptorAllocator::FreePersistent(uint32_t index)
+{
+	if (index >= persistent_capacity || !allocated[index])
+		throw std::logic_error("Freeing a descriptor that is not allocated");
+	allocated[index] = false;
+	persistent_used--;
+	free_list.push_back(index);
+}
+
+uint32_t DescriptorAllocator::AllocateTransient(uint32_t count)
+{
+	if (transient_used + count > transient_capacity)
+		throw std::runtime_error("Per-frame descriptor region is full");
+	const uint32_t index = transient_begin + transient_used;
+	transient_used += count;
+	return index;
+}
+
+void DescriptorAllocator::BeginFrame(uint32_t frame_index)
+{
+	if (frame_count == 0)
+		return;
+	transient_begin = persistent_capacity + (frame_index % frame_count) * transient_capacity;
+	transient_used = 0;
+}
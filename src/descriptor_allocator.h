@@ -0,0 +1,51 @@
+#pragma once
+
+#include "rhi.h"
+
+#include <vector>
+
+// Owns one descriptor heap split into two regions:
+// - persistent descriptors, allocated and freed individually through a free list
+// - a linear region per frame in flight for descriptors that live for one frame,
+//   reset in bulk by BeginFrame once the frame ring has retired that frame
+// Indices are relative to the heap start, so shaders can index the heap directly.
+class DescriptorAllocator
+{
+public:
+	DescriptorAllocator(RHI::Device& device, RHI::DescriptorHeapType type, bool shader_visible,
+		uint32_t persistent_capacity, uint32_t transient_capacity_per_frame = 0, uint32_t frames_in_flight = 0);
+
+	// Throws std::runtime_error when the persistent region is full
+	uint32_t AllocatePersistent();
+	// The caller must ensure the GPU no longer reads the descriptor
+	void FreePersistent(uint32_t index);
+
+	// Returns the first of count consecutive descriptors valid until the frame slot is reused
+	uint32_t AllocateTransient(uint32_t count = 1);
+	// Resets the linear region of frame_index, its previous frame must have completed
+	void BeginFrame(uint32_t frame_index);
+
+	RHI::DescriptorHeap* GetHeap() const { return heap.get(); }
+	RHI::CpuDescriptorHandle GetCpuHandle(uint32_t index) const { return heap->GetCpuHandle(index); }
+	RHI::GpuDescriptorHandle GetGpuHandle(uint32_t index) const { return heap->GetGpuHandle(index); }
+
+	uint32_t GetPersistentCapacity() const { return persistent_capacity; }
+	uint32_t GetPersistentUsed() const { return persistent_used; }
+	uint32_t GetTransientCapacity() const { return transient_capacity; }
+	uint32_t GetTransientUsed() const { return transient_used; }
+
+private:
+	std::unique_ptr<RHI::DescriptorHeap> heap;
+
+	uint32_t persistent_capacity;
+	uint32_t persistent_used = 0;
+	// Never allocated slots above the high water mark need no free list entries
+	uint32_t persistent_high_water = 0;
+	std::vector<uint32_t> free_list;
+	std::vector<bool> allocated;
+
+	uint32_t transient_capacity;
+	uint32_t frame_count;
+	uint32_t transient_begin = 0;
+	uint32_t transient_used = 0;
+};
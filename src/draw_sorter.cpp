@@ -0,0 +1,108 @@
+#include "draw_sorter.h"
+
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+uint32_t DrawKey::QuantizeDepth(float distance, float far_plane)
+{
+	const uint32_t last = (1u << depth_bits) - 1;
+	if (!(distance > 0.f))
+		return 0;
+	if (!(distance < far_plane))
+		return last;
+	return static_cast<uint32_t>(static_cast<double>(distance) / far_plane * last);
+}
+
+DrawSorter::DrawSorter(ThreadPool& pool, uint32_t max_threads)
+	: pool(pool), max_threads(max_threads)
+{
+}
+
+uint32_t DrawSorter::GetThreadCount() const
+{
+	return max_threads ? std::min(max_threads, pool.GetThreadCount()) : pool.GetThreadCount();
+}
+
+void DrawSorter::Sort(std::vector<DrawPacket>& packets)
+{
+	const auto start = std::chrono::steady_clock::now();
+	const size_t count = packets.size();
+	stats = {};
+	stats.packets = count;
+	if (count < 2)
+		return;
+
+	const size_t blocks = std::max<size_t>(1, std::min<size_t>(GetThreadCount(), count / min_block_size));
+	stats.blocks = static_cast<uint32_t>(blocks);
+	auto block_first = [count, blocks](size_t block) { return count * block / blocks; };
+	// A single block is the whole list, it runs right here
+	auto for_each_block = [&](const std::function<void(size_t)>& task) {
+		if (blocks == 1)
+			task(0);
+		else
+			pool.ParallelFor(blocks, task, static_cast<uint32_t>(blocks));
+	};
+
+	// One read counts every digit, digits whose values all fall in one bucket are skipped
+	digit_counts.assign(blocks * digit_count * radix, 0);
+	for_each_block([&](size_t block) {
+		uint32_t* counts = digit_counts.data() + block * digit_count * radix;
+		for (size_t i = block_first(block); i < block_first(block + 1); i++) {
+			const uint64_t key = packets[i].key;
+			for (uint32_t digit = 0; digit < digit_count; digit++)
+				counts[digit * radix + ((key >> (digit * 8)) & (radix - 1))]++;
+		}
+	});
+
+	scratch.resize(count);
+	offsets.resize(blocks * radix);
+	const uint64_t first_key = packets[0].key;
+	std::vector<DrawPacket>* source = &packets;
+	std::vector<DrawPacket>* destination = &scratch;
+	for (uint32_t digit = 0; digit < digit_count; digit++) {
+		const uint32_t shift = digit * 8;
+		const uint32_t first_value = static_cast<uint32_t>(first_key >> shift) & (radix - 1);
+		size_t first_value_count = 0;
+		for (size_t block = 0; block < blocks; block++)
+			first_value_count += digit_counts[(block * digit_count + digit) * radix + first_value];
+		if (first_value_count == count)
+			continue;
+
+		// Counts from the first read only hold for the packets' original order
+		if (stats.digit_passes > 0) {
+			for_each_block([&](size_t block) {
+				uint32_t* counts = digit_counts.data() + (block * digit_count + digit) * radix;
+				std::fill(counts, counts + radix, 0);
+				const DrawPacket* input = source->data();
+				for (size_t i = block_first(block); i < block_first(block + 1); i++)
+					counts[(input[i].key >> shift) & (radix - 1)]++;
+			});
+		}
+
+		// Blocks of a value follow each other in block order, which keeps the sort stable
+		size_t offset = 0;
+		for (uint32_t value = 0; value < radix; value++) {
+			for (size_t block = 0; block < blocks; block++) {
+				offsets[block * radix + value] = offset;
+				offset += digit_counts[(block * digit_count + digit) * radix + value];
+			}
+		}
+
+		for_each_block([&](size_t block) {
+			size_t* block_offsets = offsets.data() + block * radix;
+			const DrawPacket* input = source->data();
+			DrawPacket* output = destination->data();
+			for (size_t i = block_first(block); i < block_first(block + 1); i++)
+				output[block_offsets[(input[i].key >> shift) & (radix - 1)]++] = input[i];
+		});
+		std::swap(source, destination);
+		stats.digit_passes++;
+	}
+
+	if (source != &packets)
+		packets.swap(scratch);
+	stats.sort_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Packed sort key of a draw. Keys compare as integers, so draws sorted by key are grouped by
+// pass, then pipeline, then material, and front to back within a group. Fields are masked to
+// their width.
+namespace DrawKey
+{
+	constexpr uint32_t pass_bits = 4;
+	constexpr uint32_t pipeline_bits = 16;
+	constexpr uint32_t material_bits = 20;
+	constexpr uint32_t depth_bits = 24;
+
+	constexpr uint32_t depth_shift = 0;
+	constexpr uint32_t material_shift = depth_shift + depth_bits;
+	constexpr uint32_t pipeline_shift = material_shift + material_bits;
+	constexpr uint32_t pass_shift = pipeline_shift + pipeline_bits;
+	static_assert(pass_shift + pass_bits == 64, "Draw key fields must fill 64 bits");
+
+	constexpr uint64_t Field(uint32_t value, uint32_t bits, uint32_t shift)
+	{
+		return (static_cast<uint64_t>(value) & ((uint64_t(1) << bits) - 1)) << shift;
+	}
+
+	constexpr uint64_t Make(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t depth)
+	{
+		return Field(pass, pass_bits, pass_shift) | Field(pipeline, pipeline_bits, pipeline_shift)
+			| Field(material, material_bits, material_shift) | Field(depth, depth_bits, depth_shift);
+	}
+
+	constexpr uint32_t GetPass(uint64_t key) { return static_cast<uint32_t>(key >> pass_shift) & ((1u << pass_bits) - 1); }
+	constexpr uint32_t GetPipeline(uint64_t key) { return static_cast<uint32_t>(key >> pipeline_shift) & ((1u << pipeline_bits) - 1); }
+	constexpr uint32_t GetMaterial(uint64_t key) { return static_cast<uint32_t>(key >> material_shift) & ((1u << material_bits) - 1); }
+	constexpr uint32_t GetDepth(uint64_t key) { return static_cast<uint32_t>(key >> depth_shift) & ((1u << depth_bits) - 1); }
+
+	// Depth bucket of a distance from the camera, nearer draws get smaller buckets. Distances
+	// past far_plane share the last bucket.
+	uint32_t QuantizeDepth(float distance, float far_plane);
+}
+
+struct DrawPacket
+{
+	uint64_t key;
+	// Index of the draw the packet stands for
+	uint32_t draw;
+};
+
+// Sorts draw packets by key with a least significant digit radix sort, a byte per pass. Every
+// pass splits the packets into contiguous blocks on the threads of a pool that count their
+// digits, then scatter them to offsets from the prefix sum of the counts. Digits all packets
+// share, such as the pass of a frame with a single pass, are skipped. Lists too short for two
+// blocks sort on the calling thread without waking the pool.
+class DrawSorter
+{
+public:
+	struct Stats
+	{
+		size_t packets;
+		// Digit passes that moved packets, out of 8
+		uint32_t digit_passes;
+		uint32_t blocks;
+		double sort_ms;
+	};
+
+	// Sorts on up to max_threads threads of pool, 0 uses all of them. The pool must outlive the sorter.
+	explicit DrawSorter(ThreadPool& pool, uint32_t max_threads = 0);
+
+	// Stable, packets with equal keys keep their order
+	void Sort(std::vector<DrawPacket>& packets);
+
+	const Stats& GetStats() const { return stats; }
+	// Threads a list large enough for them sorts on
+	uint32_t GetThreadCount() const;
+
+private:
+	static const uint32_t radix = 256;
+	static const uint32_t digit_count = 8;
+	// Blocks smaller than this cost more in waking pool threads than they save
+	static const size_t min_block_size = 32 * 1024;
+
+	ThreadPool& pool;
+	uint32_t max_threads;
+	Stats stats = {};
+	std::vector<DrawPacket> scratch;
+	// radix counts per block, turned into the block's first output index per digit value
+	std::vector<size_t> offsets;
+	std::vector<uint32_t> digit_counts;
+};
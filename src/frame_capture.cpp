@@ -0,0 +1,219 @@
+#include "frame_capture.h"
+
+#include <fstream>
+#include <stdexcept>
+
+using namespace Capture;
+
+template <class T>
+void FrameCapture::AddChunk(ChunkType type, const T& record, const void* extra, size_t extra_size)
+{
+	ChunkHeader header = { type, 0, sizeof(T) + extra_size };
+	const size_t offset = data.size();
+	data.resize(offset + sizeof(header) + sizeof(T) + extra_size);
+	memcpy(data.data() + offset, &header, sizeof(header));
+	memcpy(data.data() + offset + sizeof(header), &record, sizeof(T));
+	if (extra_size)
+		memcpy(data.data() + offset + sizeof(header) + sizeof(T), extra, extra_size);
+}
+
+void FrameCapture::AddResource(RHI::Resource* resource, RHI::HeapType heap_type)
+{
+	ResourceRecord record = {};
+	record.id = resource->GetId();
+	record.heap_type = heap_type;
+	record.desc = resource->GetDesc();
+	record.gpu_address = resource->GetDesc().dimension == RHI::ResourceDimension::Buffer ? resource->GetGpuAddress() : 0;
+	AddChunk(ChunkType::Resource, record);
+}
+
+void FrameCapture::AddDescriptorHeap(RHI::DescriptorHeap* heap)
+{
+	DescriptorHeapRecord record = {};
+	record.id = heap->GetId();
+	record.type = heap->GetType();
+	record.capacity = heap->GetCapacity();
+	record.increment_size = heap->GetIncrementSize();
+	record.cpu_start = heap->GetCpuStart().ptr;
+	record.gpu_start = heap->GetGpuStart().ptr;
+	AddChunk(ChunkType::DescriptorHeap, record);
+}
+
+void FrameCapture::AddRootSignature(RHI::RootSignature* root_signature)
+{
+	AddChunk(ChunkType::RootSignature, ObjectRecord{ root_signature->GetId() });
+}
+
+void FrameCapture::AddPipelineState(RHI::PipelineState* pipeline_state)
+{
+	AddChunk(ChunkType::PipelineState, ObjectRecord{ pipeline_state->GetId() });
+}
+
+void FrameCapture::AddConstantBufferView(RHI::DescriptorHeap* heap, uint32_t index, RHI::Resource* resource, uint64_t offset, uint32_t size)
+{
+	AddChunk(ChunkType::View, ViewRecord{ ViewType::ConstantBuffer, heap->GetId(), index, resource->GetId(), offset, size, 0 });
+}
+
+void FrameCapture::AddRenderTargetView(RHI::DescriptorHeap* heap, uint32_t index, RHI::Resource* resource)
+{
+	AddChunk(ChunkType::View, ViewRecord{ ViewType::RenderTarget, heap->GetId(), index, resource->GetId(), 0, 0, 0 });
+}
+
+void FrameCapture::AddDepthStencilView(RHI::DescriptorHeap* heap, uint32_t index, RHI::Resource* resource, bool read_only)
+{
+	const ViewType type = read_only ? ViewType::ReadOnlyDepthStencil : ViewType::DepthStencil;
+	AddChunk(ChunkType::View, ViewRecord{ type, heap->GetId(), index, resource->GetId(), 0, 0, 0 });
+}
+
+void FrameCapture::AddResourceData(RHI::Resource* resource, uint64_t offset, const void* data, uint64_t size)
+{
+	AddChunk(ChunkType::ResourceData, ResourceDataRecord{ resource->GetId(), 0, offset, size }, data, static_cast<size_t>(size));
+}
+
+void FrameCapture::AddCommandList(RHI::CommandListType type, const RHI::CommandStream& stream)
+{
+	AddChunk(ChunkType::CommandList, CommandListRecord{ type, 0 }, stream.GetData().data(), stream.GetData().size());
+}
+
+void FrameCapture::AddBundle(RHI::CommandList* bundle, const RHI::CommandStream& stream)
+{
+	AddChunk(ChunkType::CommandList, CommandListRecord{ RHI::CommandListType::Bundle, bundle->GetId() }, stream.GetData().data(), stream.GetData().size());
+}
+
+void FrameCapture::EndFrame()
+{
+	AddChunk(ChunkType::FrameEnd, FrameEndRecord{ frame_count++ });
+}
+
+void FrameCapture::Save(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		throw std::runtime_error("Can't open " + path + " for writing");
+
+	FileHeader header = { magic, version };
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	if (!file)
+		throw std::runtime_error("Failed to write " + path);
+}
+
+void CaptureCommandList::Reset(RHI::CommandAllocator* allocator, RHI::PipelineState* initial_state)
+{
+	inner->Reset(allocator, initial_state);
+	recorder.Reset(allocator, initial_state);
+}
+
+void CaptureCommandList::Close()
+{
+	inner->Close();
+	recorder.Close();
+}
+
+void CaptureCommandList::SetPipelineState(RHI::PipelineState* pipeline_state)
+{
+	inner->SetPipelineState(pipeline_state);
+	recorder.SetPipelineState(pipeline_state);
+}
+
+void CaptureCommandList::SetGraphicsRootSignature(RHI::RootSignature* root_signature)
+{
+	inner->SetGraphicsRootSignature(root_signature);
+	recorder.SetGraphicsRootSignature(root_signature);
+}
+
+void CaptureCommandList::SetDescriptorHeaps(uint32_t count, RHI::DescriptorHeap* const* heaps)
+{
+	inner->SetDescriptorHeaps(count, heaps);
+	recorder.SetDescriptorHeaps(count, heaps);
+}
+
+void CaptureCommandList::SetGraphicsRootDescriptorTable(uint32_t index, RHI::GpuDescriptorHandle base)
+{
+	inner->SetGraphicsRootDescriptorTable(index, base);
+	recorder.SetGraphicsRootDescriptorTable(index, base);
+}
+
+void CaptureCommandList::SetGraphicsRootConstantBufferView(uint32_t index, uint64_t address)
+{
+	inner->SetGraphicsRootConstantBufferView(index, address);
+	recorder.SetGraphicsRootConstantBufferView(index, address);
+}
+
+void CaptureCommandList::SetGraphicsRoot32BitConstants(uint32_t index, uint32_t count, const void* data, uint32_t dest_offset)
+{
+	inner->SetGraphicsRoot32BitConstants(index, count, data, dest_offset);
+	recorder.SetGraphicsRoot32BitConstants(index, count, data, dest_offset);
+}
+
+void CaptureCommandList::RSSetViewports(uint32_t count, const RHI::Viewport* viewports)
+{
+	inner->RSSetViewports(count, viewports);
+	recorder.RSSetViewports(count, viewports);
+}
+
+void CaptureCommandList::RSSetScissorRects(uint32_t count, const RHI::Rect* rects)
+{
+	inner->RSSetScissorRects(count, rects);
+	recorder.RSSetScissorRects(count, rects);
+}
+
+void CaptureCommandList::ResourceBarrier(uint32_t count, const RHI::ResourceBarrier* barriers)
+{
+	inner->ResourceBarrier(count, barriers);
+	recorder.ResourceBarrier(count, barriers);
+}
+
+void CaptureCommandList::OMSetRenderTargets(uint32_t count, const RHI::CpuDescriptorHandle* rtvs, const RHI::CpuDescriptorHandle* dsv)
+{
+	inner->OMSetRenderTargets(count, rtvs, dsv);
+	recorder.OMSetRenderTargets(count, rtvs, dsv);
+}
+
+void CaptureCommandList::ClearRenderTargetView(RHI::CpuDescriptorHandle rtv, const float color[4])
+{
+	inner->ClearRenderTargetView(rtv, color);
+	recorder.ClearRenderTargetView(rtv, color);
+}
+
+void CaptureCommandList::ClearDepthStencilView(RHI::CpuDescriptorHandle dsv, float depth)
+{
+	inner->ClearDepthStencilView(dsv, depth);
+	recorder.ClearDepthStencilView(dsv, depth);
+}
+
+void CaptureCommandList::IASetPrimitiveTopology(RHI::PrimitiveTopology topology)
+{
+	inner->IASetPrimitiveTopology(topology);
+	recorder.IASetPrimitiveTopology(topology);
+}
+
+void CaptureCommandList::IASetVertexBuffers(uint32_t start_slot, uint32_t count, const RHI::VertexBufferView* views)
+{
+	inner->IASetVertexBuffers(start_slot, count, views);
+	recorder.IASetVertexBuffers(start_slot, count, views);
+}
+
+void CaptureCommandList::DrawInstanced(uint32_t vertex_count, uint32_t instance_count, uint32_t start_vertex, uint32_t start_instance)
+{
+	inner->DrawInstanced(vertex_count, instance_count, start_vertex, start_instance);
+	recorder.DrawInstanced(vertex_count, instance_count, start_vertex, start_instance);
+}
+
+void CaptureCommandList::CopyBufferRegion(RHI::Resource* dst, uint64_t dst_offset, RHI::Resource* src, uint64_t src_offset, uint64_t size)
+{
+	inner->CopyBufferRegion(dst, dst_offset, src, src_offset, size);
+	recorder.CopyBufferRegion(dst, dst_offset, src, src_offset, size);
+}
+
+void CaptureCommandList::CopyTextureToBuffer(RHI::Resource* dst, uint64_t dst_offset, uint32_t dst_row_pitch, RHI::Resource* src)
+{
+	inner->CopyTextureToBuffer(dst, dst_offset, dst_row_pitch, src);
+	recorder.CopyTextureToBuffer(dst, dst_offset, dst_row_pitch, src);
+}
+
+void CaptureCommandList::ExecuteBundle(RHI::CommandList* bundle)
+{
+	inner->ExecuteBundle(bundle);
+	recorder.ExecuteBundle(bundle);
+}
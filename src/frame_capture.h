@@ -0,0 +1,119 @@
+#pragma once
+
+#include "rhi.h"
+#include "rhi_commands.h"
+
+#include <string>
+#include <vector>
+
+// Binary capture of recorded frames.
+// A capture is a flat list of chunks: object declarations, resource uploads,
+// command streams and frame ends, in the order they happened.
+namespace Capture
+{
+	const uint32_t magic = 'D' | ('X' << 8) | ('C' << 16) | ('P' << 24);
+	// 2 added the barrier type, 3 depth stencil views and clears
+	const uint32_t version = 3;
+
+	enum class ChunkType : uint32_t
+	{
+		Resource,
+		DescriptorHeap,
+		RootSignature,
+		PipelineState,
+		View,
+		ResourceData,
+		CommandList,
+		FrameEnd
+	};
+
+	enum class ViewType : uint32_t
+	{
+		ConstantBuffer,
+		RenderTarget,
+		DepthStencil,
+		ReadOnlyDepthStencil
+	};
+
+	struct FileHeader { uint32_t magic; uint32_t version; };
+	struct ChunkHeader { ChunkType type; uint32_t reserved; uint64_t size; };
+
+	struct ResourceRecord { uint32_t id; RHI::HeapType heap_type; RHI::ResourceDesc desc; uint64_t gpu_address; };
+	struct DescriptorHeapRecord { uint32_t id; RHI::DescriptorHeapType type; uint32_t capacity; uint32_t increment_size; uint64_t cpu_start; uint64_t gpu_start; };
+	struct ObjectRecord { uint32_t id; };
+	struct ViewRecord { ViewType type; uint32_t heap; uint32_t index; uint32_t resource; uint64_t offset; uint32_t size; uint32_t padding; };
+	// Followed by size bytes
+	struct ResourceDataRecord { uint32_t resource; uint32_t padding; uint64_t offset; uint64_t size; };
+	// Followed by the command stream, bundles are recorded once and executed from later lists by id
+	struct CommandListRecord { RHI::CommandListType type; uint32_t bundle; };
+	struct FrameEndRecord { uint32_t frame; };
+}
+
+class FrameCapture
+{
+public:
+	void AddResource(RHI::Resource* resource, RHI::HeapType heap_type);
+	void AddDescriptorHeap(RHI::DescriptorHeap* heap);
+	void AddRootSignature(RHI::RootSignature* root_signature);
+	void AddPipelineState(RHI::PipelineState* pipeline_state);
+	void AddConstantBufferView(RHI::DescriptorHeap* heap, uint32_t index, RHI::Resource* resource, uint64_t offset, uint32_t size);
+	void AddRenderTargetView(RHI::DescriptorHeap* heap, uint32_t index, RHI::Resource* resource);
+	void AddDepthStencilView(RHI::DescriptorHeap* heap, uint32_t index, RHI::Resource* resource, bool read_only);
+	void AddResourceData(RHI::Resource* resource, uint64_t offset, const void* data, uint64_t size);
+	void AddCommandList(RHI::CommandListType type, const RHI::CommandStream& stream);
+	// Must come before the lists that execute the bundle
+	void AddBundle(RHI::CommandList* bundle, const RHI::CommandStream& stream);
+	void EndFrame();
+
+	void Save(const std::string& path) const;
+
+	uint32_t GetFrameCount() const { return frame_count; }
+	size_t GetSize() const { return data.size(); }
+
+private:
+	std::vector<uint8_t> data;
+	uint32_t frame_count = 0;
+
+	template <class T>
+	void AddChunk(Capture::ChunkType type, const T& record, const void* extra = nullptr, size_t extra_size = 0);
+};
+
+// Forwards every call to the wrapped command list and records it for a FrameCapture
+class CaptureCommandList : public RHI::CommandList
+{
+public:
+	explicit CaptureCommandList(RHI::CommandList* inner) : inner(inner) {}
+
+	void Reset(RHI::CommandAllocator* allocator, RHI::PipelineState* initial_state) override;
+	void Close() override;
+
+	void SetPipelineState(RHI::PipelineState* pipeline_state) override;
+	void SetGraphicsRootSignature(RHI::RootSignature* root_signature) override;
+	void SetDescriptorHeaps(uint32_t count, RHI::DescriptorHeap* const* heaps) override;
+	void SetGraphicsRootDescriptorTable(uint32_t index, RHI::GpuDescriptorHandle base) override;
+	void SetGraphicsRootConstantBufferView(uint32_t index, uint64_t address) override;
+	void SetGraphicsRoot32BitConstants(uint32_t index, uint32_t count, const void* data, uint32_t dest_offset) override;
+
+	void RSSetViewports(uint32_t count, const RHI::Viewport* viewports) override;
+	void RSSetScissorRects(uint32_t count, const RHI::Rect* rects) override;
+	void ResourceBarrier(uint32_t count, const RHI::ResourceBarrier* barriers) override;
+
+	void OMSetRenderTargets(uint32_t count, const RHI::CpuDescriptorHandle* rtvs, const RHI::CpuDescriptorHandle* dsv) override;
+	void ClearRenderTargetView(RHI::CpuDescriptorHandle rtv, const float color[4]) override;
+	void ClearDepthStencilView(RHI::CpuDescriptorHandle dsv, float depth) override;
+
+	void IASetPrimitiveTopology(RHI::PrimitiveTopology topology) override;
+	void IASetVertexBuffers(uint32_t start_slot, uint32_t count, const RHI::VertexBufferView* views) override;
+	void DrawInstanced(uint32_t vertex_count, uint32_t instance_count, uint32_t start_vertex, uint32_t start_instance) override;
+
+	void CopyBufferRegion(RHI::Resource* dst, uint64_t dst_offset, RHI::Resource* src, uint64_t src_offset, uint64_t size) override;
+	void CopyTextureToBuffer(RHI::Resource* dst, uint64_t dst_offset, uint32_t dst_row_pitch, RHI::Resource* src) override;
+
+	void ExecuteBundle(RHI::CommandList* bundle) override;
+
+	const RHI::CommandStream& GetStream() const { return recorder.GetStream(); }
+
+private:
+	RHI::CommandList* inner;
+	RHI::RecordingCommandList recorder;
+};
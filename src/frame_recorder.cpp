@@ -0,0 +1,82 @@
+#include "frame_recorder.h"
+
+#include "parallel_for.h"
+
+#include <stdexcept>
+
+void RecordFrame(RHI::CommandList& command_list, const FrameContext& frame, const std::vector<DrawItem>& draws)
+{
+	RecordPassBegin(command_list, frame);
+	RecordPassState(command_list, frame);
+	RecordDraws(command_list, frame, draws.data(), draws.size());
+}
+
+void RecordFrameWithBundle(RHI::CommandList& command_list, const FrameContext& frame, RHI::CommandList* bundle)
+{
+	RecordPassBegin(command_list, frame);
+	RecordPassState(command_list, frame);
+	command_list.ExecuteBundle(bundle);
+}
+
+void RecordPassBegin(RHI::CommandList& command_list, const FrameContext& frame)
+{
+	const float clear_color[4] = { 0.f, 0.f, 0.f, 1.f };
+	if (frame.rtv.ptr)
+		command_list.ClearRenderTargetView(frame.rtv, clear_color);
+	if (frame.dsv.ptr && frame.clear_depth)
+		command_list.ClearDepthStencilView(frame.dsv, 1.f);
+}
+
+void RecordPassState(RHI::CommandList& command_list, const FrameContext& frame)
+{
+	command_list.RSSetViewports(1, &frame.view_port);
+	command_list.RSSetScissorRects(1, &frame.scissor_rect);
+	command_list.OMSetRenderTargets(frame.rtv.ptr ? 1 : 0, frame.rtv.ptr ? &frame.rtv : nullptr, frame.dsv.ptr ? &frame.dsv : nullptr);
+	// Bundles setting descriptor tables need the executing list to have bound the same heap
+	if (frame.bindless_heap)
+		command_list.SetDescriptorHeaps(1, &frame.bindless_heap);
+}
+
+void RecordDraws(RHI::CommandList& command_list, const FrameContext& frame, const DrawItem* draws, size_t count)
+{
+	// Set initial state, command lists and bundles don't inherit it from each other
+	command_list.SetGraphicsRootSignature(frame.root_signature);
+	if (frame.bindless_heap) {
+		// The whole heap is bound once, draws only pass indices
+		command_list.SetDescriptorHeaps(1, &frame.bindless_heap);
+		SceneRootSignature::Bindless::SetGraphicsDescriptorTable<SceneRootSignature::ObjectConstantsTable>(command_list, frame.bindless_heap->GetGpuStart());
+	}
+	command_list.IASetPrimitiveTopology(RHI::PrimitiveTopology::TriangleList);
+	command_list.IASetVertexBuffers(0, 1, &frame.vertex_buffer_view);
+
+	// Record commands
+	for (size_t i = 0; i < count; i++) {
+		const DrawItem& draw = draws[i];
+		if (frame.pipeline_states)
+			command_list.SetPipelineState(frame.pipeline_states[draw.features]);
+		// Draws sharing constants rebind the same value, the state filter drops those
+		if (frame.bindless_heap)
+			SceneRootSignature::Bindless::SetGraphicsConstants<SceneRootSignature::DrawIndex>(command_list, draw.descriptor_index);
+		else
+			SceneRootSignature::Bound::SetGraphicsConstantBufferView<SceneRootSignature::ObjectConstants>(command_list, draw.constants);
+		command_list.DrawInstanced(draw.vertex_count, 1, draw.start_vertex, 0);
+	}
+}
+
+void RecordFrameParallel(ThreadPool& pool, RHI::CommandList* const* command_lists, uint32_t list_count, const FrameContext& frame,
+	const std::vector<DrawItem>& draws)
+{
+	if (list_count == 0)
+		throw std::invalid_argument("Recording a frame without command lists");
+
+	pool.ParallelFor(list_count, [&](size_t list) {
+		// Contiguous chunks keep the draw order once the lists execute in order
+		const size_t first = draws.size() * list / list_count;
+		const size_t last = draws.size() * (list + 1) / list_count;
+		RHI::CommandList& command_list = *command_lists[list];
+		if (list == 0)
+			RecordPassBegin(command_list, frame);
+		RecordPassState(command_list, frame);
+		RecordDraws(command_list, frame, draws.data() + first, last - first);
+	}, list_count);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "rhi.h"
+#include "root_signature_layout.h"
+
+#include <vector>
+
+class ThreadPool;
+
+// Root signatures RecordFrame binds against, bindless frames use Bindless and the rest Bound
+namespace SceneRootSignature
+{
+	constexpr RHI::RootSignatureFlags flags = RHI::RootSignatureFlags::AllowInputAssemblerInputLayout
+		| RHI::RootSignatureFlags::DenyHullShaderRootAccess
+		| RHI::RootSignatureFlags::DenyDomainShaderRootAccess
+		| RHI::RootSignatureFlags::DenyGeometryShaderRootAccess
+		| RHI::RootSignatureFlags::DenyPixelShaderRootAccess;
+
+	// Constants live in ConstantBufferManager blocks and are bound per draw without descriptors
+	using ObjectConstants = RootSignatureLayout::ConstantBufferView<0, 0,
+		RHI::RootDescriptorFlags::DataStaticWhileSetAtExecute, RHI::ShaderVisibility::Vertex>;
+	using Bound = RootSignatureLayout::Layout<flags, ObjectConstants>;
+
+	// Draws pass the index of their constant buffer view, the table covers the whole heap
+	using DrawIndex = RootSignatureLayout::Constants<0, 1, 0, RHI::ShaderVisibility::Vertex>;
+	using ObjectConstantsTable = RootSignatureLayout::Table<RHI::ShaderVisibility::Vertex,
+		RootSignatureLayout::CbvRange<0, RHI::descriptor_range_unbounded, 1,
+			RHI::DescriptorRangeFlags::DescriptorsVolatile | RHI::DescriptorRangeFlags::DataStaticWhileSetAtExecute>>;
+	using Bindless = RootSignatureLayout::Layout<flags, DrawIndex, ObjectConstantsTable>;
+}
+
+struct DrawItem
+{
+	uint32_t start_vertex;
+	uint32_t vertex_count;
+	// GPU address of the draw's constants, bound as SceneRootSignature::ObjectConstants
+	uint64_t constants;
+	// Index of the draw's constant buffer view in the bindless heap, passed as SceneRootSignature::DrawIndex
+	uint32_t descriptor_index;
+	// Shader permutation of the draw, indexes FrameContext::pipeline_states
+	uint32_t features;
+};
+
+// Everything PopulateCommandList needs to record a frame, independent of the backend
+struct FrameContext
+{
+	RHI::RootSignature* root_signature;
+	// When set, draws index this heap through SceneRootSignature::Bindless instead of binding constants
+	RHI::DescriptorHeap* bindless_heap;
+	// Must be in the RenderTarget state, the render graph transitions it around the pass.
+	// Depth only passes leave it 0.
+	RHI::CpuDescriptorHandle rtv;
+	// 0 for passes without depth. Writable views must be in the DepthWrite state, read only ones in DepthRead.
+	RHI::CpuDescriptorHandle dsv;
+	// Passes testing against the depth an earlier pass wrote keep it
+	bool clear_depth;
+	RHI::Viewport view_port;
+	RHI::Rect scissor_rect;
+	RHI::VertexBufferView vertex_buffer_view;
+	// Pipeline per feature mask, when null draws keep the pipeline the list was reset with
+	RHI::PipelineState* const* pipeline_states;
+};
+
+// Records the scene pass between Reset and Close of command_list
+void RecordFrame(RHI::CommandList& command_list, const FrameContext& frame, const std::vector<DrawItem>& draws);
+
+// The pieces of RecordFrame. RecordPassBegin clears the targets, RecordPassState sets what every list of the pass needs and bundles
+// can't set. RecordDraws binds everything the draws need using only commands bundles allow, so
+// chunks of the draw list can go to separate command lists or into a bundle. Without pipeline
+// states a bundle draws with the pipeline it was reset with.
+void RecordPassBegin(RHI::CommandList& command_list, const FrameContext& frame);
+void RecordPassState(RHI::CommandList& command_list, const FrameContext& frame);
+void RecordDraws(RHI::CommandList& command_list, const FrameContext& frame, const DrawItem* draws, size_t count);
+
+// Records the scene pass around a closed bundle holding RecordDraws of the static draws
+void RecordFrameWithBundle(RHI::CommandList& command_list, const FrameContext& frame, RHI::CommandList* bundle);
+
+// Splits draws into list_count contiguous chunks recorded concurrently on the pool's threads.
+// The lists must be reset and are left open. The first list also begins the pass, so executing
+// them in order in one ExecuteCommandLists matches RecordFrame.
+void RecordFrameParallel(ThreadPool& pool, RHI::CommandList* const* command_lists, uint32_t list_count, const FrameContext& frame,
+	const std::vector<DrawItem>& draws);
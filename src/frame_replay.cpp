@@ -0,0 +1,441 @@
+#include "frame_replay.h"
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+using namespace Capture;
+
+namespace
+{
+	double ElapsedMs(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	template <class T>
+	const T& Read(const uint8_t* payload, size_t size)
+	{
+		if (size < sizeof(T))
+			throw std::runtime_error("Truncated capture record");
+		return *reinterpret_cast<const T*>(payload);
+	}
+}
+
+FrameReplay::FrameReplay(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		throw std::runtime_error("Can't open " + path);
+	file_data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+	const FileHeader& header = Read<FileHeader>(file_data.data(), file_data.size());
+	if (header.magic != magic || header.version != version)
+		throw std::runtime_error(path + " is not a supported frame capture");
+
+	size_t offset = sizeof(FileHeader);
+	while (offset < file_data.size()) {
+		const ChunkHeader& chunk = Read<ChunkHeader>(file_data.data() + offset, file_data.size() - offset);
+		offset += sizeof(ChunkHeader);
+		if (file_data.size() - offset < chunk.size)
+			throw std::runtime_error("Truncated capture chunk");
+		chunks.push_back({ chunk.type, file_data.data() + offset, static_cast<size_t>(chunk.size) });
+		offset += static_cast<size_t>(chunk.size);
+
+		if (chunk.type == ChunkType::FrameEnd)
+			frame_count++;
+	}
+}
+
+template <class T>
+T* FrameReplay::Lookup(std::unordered_map<uint32_t, std::unique_ptr<T>>& objects, uint32_t id)
+{
+	auto it = objects.find(id);
+	if (it == objects.end())
+		throw std::runtime_error("Capture references an undeclared object " + std::to_string(id));
+	return it->second.get();
+}
+
+void FrameReplay::Prepare(RHI::Device& target, RootSignatureFactory root_signature_factory, PipelineStateFactory pipeline_state_factory)
+{
+	device = &target;
+	queue = device->CreateCommandQueue(RHI::CommandListType::Direct);
+	frame_ring = std::make_unique<FrameRing>(*device, frames_in_flight);
+	allocators.clear();
+	for (uint32_t i = 0; i < frames_in_flight; i++)
+		allocators.push_back(device->CreateCommandAllocator(RHI::CommandListType::Direct));
+	command_list = device->CreateCommandList(RHI::CommandListType::Direct, allocators[0].get(), nullptr);
+	command_list->Close();
+	uploader = std::make_unique<CopyUploader>(*device, staging_size);
+	queue_fence = device->CreateFence(0);
+
+	for (const Chunk& chunk : chunks) {
+		switch (chunk.type)
+		{
+		case ChunkType::Resource:
+		{
+			const ResourceRecord& record = Read<ResourceRecord>(chunk.payload, chunk.size);
+			std::unique_ptr<RHI::Resource> resource;
+			if (record.desc.dimension == RHI::ResourceDimension::Buffer) {
+				RHI::ResourceState state = record.heap_type == RHI::HeapType::Upload ? RHI::ResourceState::GenericRead
+					: record.heap_type == RHI::HeapType::Readback ? RHI::ResourceState::CopyDest : RHI::ResourceState::Common;
+				resource = device->CreateBuffer(record.heap_type, record.desc.width, state);
+				buffer_ranges.push_back({ record.gpu_address, record.desc.width, resource.get() });
+			}
+			else {
+				resource = device->CreateTexture2D(static_cast<uint32_t>(record.desc.width), record.desc.height, record.desc.format,
+					RHI::ResourceState::Present);
+			}
+			resource_heap_types[record.id] = record.heap_type;
+			resources[record.id] = std::move(resource);
+			break;
+		}
+		case ChunkType::DescriptorHeap:
+		{
+			const DescriptorHeapRecord& record = Read<DescriptorHeapRecord>(chunk.payload, chunk.size);
+			auto heap = device->CreateDescriptorHeap(record.type, record.capacity, record.gpu_start != 0);
+			heap_ranges.push_back({ record, heap.get() });
+			heaps[record.id] = std::move(heap);
+			break;
+		}
+		case ChunkType::RootSignature:
+		{
+			const ObjectRecord& record = Read<ObjectRecord>(chunk.payload, chunk.size);
+			root_signatures[record.id] = root_signature_factory(record.id);
+			break;
+		}
+		case ChunkType::PipelineState:
+		{
+			const ObjectRecord& record = Read<ObjectRecord>(chunk.payload, chunk.size);
+			pipeline_states[record.id] = pipeline_state_factory(record.id);
+			break;
+		}
+		case ChunkType::View:
+			CreateView(Read<ViewRecord>(chunk.payload, chunk.size));
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+std::vector<ReplayFrameTiming> FrameReplay::Run()
+{
+	if (!device)
+		throw std::logic_error("FrameReplay::Prepare must be called before Run");
+
+	std::vector<ReplayFrameTiming> timings;
+	ReplayFrameTiming frame = {};
+	std::chrono::steady_clock::time_point first_submit;
+	bool submitted = false;
+
+	allocators[frame_ring->GetFrameIndex()]->Reset();
+	for (const Chunk& chunk : chunks) {
+		if (chunk.type == ChunkType::ResourceData) {
+			auto start = std::chrono::steady_clock::now();
+			const ResourceDataRecord& record = Read<ResourceDataRecord>(chunk.payload, chunk.size);
+			if (chunk.size - sizeof(record) < record.size)
+				throw std::runtime_error("Truncated resource data");
+			UploadResourceData(record, chunk.payload + sizeof(record));
+			frame.upload_ms += ElapsedMs(start);
+		}
+		else if (chunk.type == ChunkType::CommandList) {
+			const CommandListRecord& record = Read<CommandListRecord>(chunk.payload, chunk.size);
+			const uint8_t* stream = chunk.payload + sizeof(record);
+			const size_t stream_size = chunk.size - sizeof(record);
+			auto start = std::chrono::steady_clock::now();
+			if (record.type == RHI::CommandListType::Bundle) {
+				// Only recorded here, the lists executing it are submitted
+				frame.commands += ReplayBundle(record.bundle, stream, stream_size);
+				frame.record_ms += ElapsedMs(start);
+				continue;
+			}
+
+			RHI::CommandList* target = command_list.get();
+			if (state_filter) {
+				state_filter->SetInner(target);
+				target = state_filter.get();
+			}
+			frame.commands += ReplayCommandList(target, allocators[frame_ring->GetFrameIndex()].get(), stream, stream_size);
+			frame.record_ms += ElapsedMs(start);
+
+			if (!submitted) {
+				first_submit = std::chrono::steady_clock::now();
+				submitted = true;
+			}
+			SubmitUploads();
+			RHI::CommandList* lists[] = { command_list.get() };
+			queue->ExecuteCommandLists(1, lists);
+		}
+		else if (chunk.type == ChunkType::FrameEnd) {
+			if (!submitted)
+				first_submit = std::chrono::steady_clock::now();
+			SubmitUploads();
+			// Only blocks when the frame ring wraps onto a frame still on the GPU
+			frame_ring->MoveToNextFrame(*queue);
+			frame.execute_ms = ElapsedMs(first_submit);
+			timings.push_back(frame);
+
+			frame = {};
+			submitted = false;
+			allocators[frame_ring->GetFrameIndex()]->Reset();
+			uploader->Retire();
+		}
+	}
+
+	Flush();
+	return timings;
+}
+
+uint64_t FrameReplay::TranslateAddress(uint64_t address) const
+{
+	if (address == 0)
+		return 0;
+	for (const BufferRange& range : buffer_ranges) {
+		if (address >= range.captured_address && address - range.captured_address < range.size)
+			return range.resource->GetGpuAddress() + (address - range.captured_address);
+	}
+	throw std::runtime_error("Capture references an address outside of every captured buffer");
+}
+
+RHI::CpuDescriptorHandle FrameReplay::TranslateCpuHandle(uint64_t handle) const
+{
+	for (const HeapRange& range : heap_ranges) {
+		const uint64_t span = static_cast<uint64_t>(range.captured.capacity) * range.captured.increment_size;
+		if (handle >= range.captured.cpu_start && handle - range.captured.cpu_start < span)
+			return range.heap->GetCpuHandle(static_cast<uint32_t>((handle - range.captured.cpu_start) / range.captured.increment_size));
+	}
+	throw std::runtime_error("Capture references a CPU descriptor outside of every captured heap");
+}
+
+RHI::GpuDescriptorHandle FrameReplay::TranslateGpuHandle(uint64_t handle) const
+{
+	for (const HeapRange& range : heap_ranges) {
+		const uint64_t span = static_cast<uint64_t>(range.captured.capacity) * range.captured.increment_size;
+		if (range.captured.gpu_start != 0 && handle >= range.captured.gpu_start && handle - range.captured.gpu_start < span)
+			return range.heap->GetGpuHandle(static_cast<uint32_t>((handle - range.captured.gpu_start) / range.captured.increment_size));
+	}
+	throw std::runtime_error("Capture references a GPU descriptor outside of every captured heap");
+}
+
+void FrameReplay::CreateView(const ViewRecord& view)
+{
+	RHI::DescriptorHeap* heap = Lookup(heaps, view.heap);
+	RHI::Resource* resource = Lookup(resources, view.resource);
+	if (view.type == ViewType::ConstantBuffer)
+		device->CreateConstantBufferView(resource->GetGpuAddress() + view.offset, view.size, heap->GetCpuHandle(view.index));
+	else if (view.type == ViewType::RenderTarget)
+		device->CreateRenderTargetView(resource, heap->GetCpuHandle(view.index));
+	else
+		device->CreateDepthStencilView(resource, heap->GetCpuHandle(view.index), view.type == ViewType::ReadOnlyDepthStencil);
+}
+
+void FrameReplay::UploadResourceData(const ResourceDataRecord& record, const uint8_t* bytes)
+{
+	RHI::Resource* resource = Lookup(resources, record.resource);
+	if (record.offset + record.size > resource->GetDesc().width)
+		throw std::runtime_error("Resource data outside of resource bounds");
+
+	if (resource_heap_types[record.resource] == RHI::HeapType::Upload) {
+		uint8_t* mapped = static_cast<uint8_t*>(resource->Map());
+		memcpy(mapped + record.offset, bytes, static_cast<size_t>(record.size));
+		resource->Unmap();
+		return;
+	}
+
+	// Default heap contents go through the copy queue, submitted before the next direct queue work
+	uploader->Upload(resource, record.offset, bytes, record.size);
+	uploads_pending = true;
+}
+
+void FrameReplay::SubmitUploads()
+{
+	if (!uploads_pending)
+		return;
+
+	// Copies must not overwrite data that earlier direct queue work still reads
+	queue->Signal(queue_fence.get(), ++queue_fence_value);
+	uploader->GetQueue()->Wait(queue_fence.get(), queue_fence_value);
+	uploader->Submit();
+	uploader->QueueWait(*queue);
+	uploads_pending = false;
+}
+
+size_t FrameReplay::ReplayBundle(uint32_t id, const uint8_t* stream, size_t size)
+{
+	auto it = bundles.find(id);
+	if (it == bundles.end()) {
+		auto allocator = device->CreateCommandAllocator(RHI::CommandListType::Bundle);
+		auto bundle = device->CreateCommandList(RHI::CommandListType::Bundle, allocator.get(), nullptr);
+		bundle->Close();
+		bundle_allocators[id] = std::move(allocator);
+		it = bundles.emplace(id, std::move(bundle)).first;
+	}
+	else {
+		// Re-recorded bundles are rare, a scene change, so waiting beats tracking the frames using it
+		frame_ring->WaitForIdle(*queue);
+	}
+	bundle_allocators[id]->Reset();
+	// Bundles replay unfiltered, they inherit state the filter can't see from the executing list
+	return ReplayCommandList(it->second.get(), bundle_allocators[id].get(), stream, size);
+}
+
+size_t FrameReplay::ReplayCommandList(RHI::CommandList* target, RHI::CommandAllocator* allocator, const uint8_t* stream, size_t size)
+{
+	using namespace RHI;
+
+	size_t commands = 0;
+	target->Reset(allocator, nullptr);
+
+	ForEachCommand(stream, size, [&](const CommandHeader& header, const uint8_t* payload) {
+		commands++;
+		switch (header.id)
+		{
+		case CommandId::SetPipelineState:
+		{
+			auto& command = Read<Commands::SetPipelineState>(payload, header.size);
+			target->SetPipelineState(Lookup(pipeline_states, command.pipeline_state));
+			break;
+		}
+		case CommandId::SetGraphicsRootSignature:
+		{
+			auto& command = Read<Commands::SetGraphicsRootSignature>(payload, header.size);
+			target->SetGraphicsRootSignature(Lookup(root_signatures, command.root_signature));
+			break;
+		}
+		case CommandId::SetDescriptorHeaps:
+		{
+			auto& command = Read<Commands::SetDescriptorHeaps>(payload, header.size);
+			const uint32_t* ids = reinterpret_cast<const uint32_t*>(payload + sizeof(command));
+			DescriptorHeap* bound[2] = {};
+			for (uint32_t i = 0; i < command.count && i < 2; i++)
+				bound[i] = Lookup(heaps, ids[i]);
+			target->SetDescriptorHeaps(command.count, bound);
+			break;
+		}
+		case CommandId::SetGraphicsRootDescriptorTable:
+		{
+			auto& command = Read<Commands::SetGraphicsRootDescriptorTable>(payload, header.size);
+			target->SetGraphicsRootDescriptorTable(command.index, TranslateGpuHandle(command.base));
+			break;
+		}
+		case CommandId::SetGraphicsRootConstantBufferView:
+		{
+			auto& command = Read<Commands::SetGraphicsRootConstantBufferView>(payload, header.size);
+			target->SetGraphicsRootConstantBufferView(command.index, TranslateAddress(command.address));
+			break;
+		}
+		case CommandId::SetGraphicsRoot32BitConstants:
+		{
+			auto& command = Read<Commands::SetGraphicsRoot32BitConstants>(payload, header.size);
+			target->SetGraphicsRoot32BitConstants(command.index, command.count, payload + sizeof(command), command.dest_offset);
+			break;
+		}
+		case CommandId::RSSetViewports:
+		{
+			auto& command = Read<Commands::RSSetViewports>(payload, header.size);
+			target->RSSetViewports(command.count, reinterpret_cast<const Viewport*>(payload + sizeof(command)));
+			break;
+		}
+		case CommandId::RSSetScissorRects:
+		{
+			auto& command = Read<Commands::RSSetScissorRects>(payload, header.size);
+			target->RSSetScissorRects(command.count, reinterpret_cast<const Rect*>(payload + sizeof(command)));
+			break;
+		}
+		case CommandId::ResourceBarrier:
+		{
+			auto& command = Read<Commands::ResourceBarrier>(payload, header.size);
+			const Commands::Barrier* records = reinterpret_cast<const Commands::Barrier*>(payload + sizeof(command));
+			std::vector<RHI::ResourceBarrier> barriers(command.count);
+			for (uint32_t i = 0; i < command.count; i++)
+				barriers[i] = { Lookup(resources, records[i].resource), records[i].before, records[i].after, records[i].type };
+			target->ResourceBarrier(command.count, barriers.data());
+			break;
+		}
+		case CommandId::OMSetRenderTargets:
+		{
+			auto& command = Read<Commands::OMSetRenderTargets>(payload, header.size);
+			const uint64_t* handles = reinterpret_cast<const uint64_t*>(payload + sizeof(command));
+			CpuDescriptorHandle rtvs[8] = {};
+			for (uint32_t i = 0; i < command.count && i < 8; i++)
+				rtvs[i] = TranslateCpuHandle(handles[i]);
+			CpuDescriptorHandle dsv = command.has_dsv ? TranslateCpuHandle(command.dsv) : CpuDescriptorHandle{ 0 };
+			target->OMSetRenderTargets(command.count, rtvs, command.has_dsv ? &dsv : nullptr);
+			break;
+		}
+		case CommandId::ClearRenderTargetView:
+		{
+			auto& command = Read<Commands::ClearRenderTargetView>(payload, header.size);
+			target->ClearRenderTargetView(TranslateCpuHandle(command.rtv), command.color);
+			break;
+		}
+		case CommandId::ClearDepthStencilView:
+		{
+			auto& command = Read<Commands::ClearDepthStencilView>(payload, header.size);
+			target->ClearDepthStencilView(TranslateCpuHandle(command.dsv), command.depth);
+			break;
+		}
+		case CommandId::IASetPrimitiveTopology:
+		{
+			auto& command = Read<Commands::IASetPrimitiveTopology>(payload, header.size);
+			target->IASetPrimitiveTopology(command.topology);
+			break;
+		}
+		case CommandId::IASetVertexBuffers:
+		{
+			auto& command = Read<Commands::IASetVertexBuffers>(payload, header.size);
+			const VertexBufferView* captured = reinterpret_cast<const VertexBufferView*>(payload + sizeof(command));
+			std::vector<VertexBufferView> views(captured, captured + command.count);
+			for (VertexBufferView& view : views)
+				view.buffer_location = TranslateAddress(view.buffer_location);
+			target->IASetVertexBuffers(command.start_slot, command.count, views.data());
+			break;
+		}
+		case CommandId::DrawInstanced:
+		{
+			auto& command = Read<Commands::DrawInstanced>(payload, header.size);
+			target->DrawInstanced(command.vertex_count, command.instance_count, command.start_vertex, command.start_instance);
+			break;
+		}
+		case CommandId::CopyBufferRegion:
+		{
+			auto& command = Read<Commands::CopyBufferRegion>(payload, header.size);
+			target->CopyBufferRegion(Lookup(resources, command.dst), command.dst_offset,
+				Lookup(resources, command.src), command.src_offset, command.size);
+			break;
+		}
+		case CommandId::CopyTextureToBuffer:
+		{
+			auto& command = Read<Commands::CopyTextureToBuffer>(payload, header.size);
+			target->CopyTextureToBuffer(Lookup(resources, command.dst), command.dst_offset, command.dst_row_pitch,
+				Lookup(resources, command.src));
+			break;
+		}
+		case CommandId::ExecuteBundle:
+		{
+			auto& command = Read<Commands::ExecuteBundle>(payload, header.size);
+			target->ExecuteBundle(Lookup(bundles, command.bundle));
+			break;
+		}
+		default:
+			throw std::runtime_error("Unknown command in capture");
+		}
+	});
+
+	target->Close();
+	return commands;
+}
+
+void FrameReplay::EnableStateFilter()
+{
+	state_filter = std::make_unique<StateFilterCommandList>();
+}
+
+void FrameReplay::Flush()
+{
+	SubmitUploads();
+	uploader->WaitForIdle();
+	frame_ring->WaitForIdle(*queue);
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "copy_uploader.h"
+#include "frame_capture.h"
+#include "frame_ring.h"
+#include "state_filter.h"
+
+#include <functional>
+#include <unordered_map>
+
+struct ReplayFrameTiming
+{
+	// Time spent decoding and recording command lists
+	double record_ms;
+	// Time from the first submission until the frame fence completed
+	double execute_ms;
+	// Time spent applying resource uploads
+	double upload_ms;
+	size_t commands;
+};
+
+// Replays a FrameCapture file against any RHI device.
+// Objects are recreated on the target device and captured descriptor handles
+// and GPU addresses are translated to the new objects.
+class FrameReplay
+{
+public:
+	using RootSignatureFactory = std::function<std::unique_ptr<RHI::RootSignature>(uint32_t captured_id)>;
+	using PipelineStateFactory = std::function<std::unique_ptr<RHI::PipelineState>(uint32_t captured_id)>;
+
+	explicit FrameReplay(const std::string& path);
+
+	// Root signatures and pipeline states are not serialised, the factories provide stand-ins
+	void Prepare(RHI::Device& device, RootSignatureFactory root_signature_factory, PipelineStateFactory pipeline_state_factory);
+
+	// Replays every captured frame once
+	std::vector<ReplayFrameTiming> Run();
+
+	// Records replayed commands through a StateFilterCommandList
+	void EnableStateFilter();
+	const StateFilterStats* GetStateFilterStats() const { return state_filter ? &state_filter->GetStats() : nullptr; }
+
+	// Must be called before Prepare, frames only wait for the GPU when the ring wraps
+	void SetFramesInFlight(uint32_t count) { frames_in_flight = count; }
+
+	uint32_t GetFrameCount() const { return frame_count; }
+	RHI::CommandQueue* GetQueue() const { return queue.get(); }
+	const FrameRing* GetFrameRing() const { return frame_ring.get(); }
+
+private:
+	struct Chunk
+	{
+		Capture::ChunkType type;
+		const uint8_t* payload;
+		size_t size;
+	};
+
+	struct BufferRange
+	{
+		uint64_t captured_address;
+		uint64_t size;
+		RHI::Resource* resource;
+	};
+
+	struct HeapRange
+	{
+		Capture::DescriptorHeapRecord captured;
+		RHI::DescriptorHeap* heap;
+	};
+
+	std::vector<uint8_t> file_data;
+	std::vector<Chunk> chunks;
+	uint32_t frame_count = 0;
+
+	RHI::Device* device = nullptr;
+	std::unique_ptr<RHI::CommandQueue> queue;
+	uint32_t frames_in_flight = 1;
+	std::unique_ptr<FrameRing> frame_ring;
+	std::vector<std::unique_ptr<RHI::CommandAllocator>> allocators;
+	std::unique_ptr<RHI::CommandList> command_list;
+	// Captured bundle id to the bundle replaying it, each with an allocator of its own
+	// since a bundle outlives the frame it was recorded in
+	std::unordered_map<uint32_t, std::unique_ptr<RHI::CommandList>> bundles;
+	std::unordered_map<uint32_t, std::unique_ptr<RHI::CommandAllocator>> bundle_allocators;
+
+	// Default heap uploads, ordered against the direct queue with queue_fence
+	static const uint64_t staging_size = 16 * 1024 * 1024;
+	std::unique_ptr<CopyUploader> uploader;
+	std::unique_ptr<RHI::Fence> queue_fence;
+	uint64_t queue_fence_value = 0;
+	bool uploads_pending = false;
+	std::unique_ptr<StateFilterCommandList> state_filter;
+
+	std::unordered_map<uint32_t, std::unique_ptr<RHI::Resource>> resources;
+	std::unordered_map<uint32_t, std::unique_ptr<RHI::DescriptorHeap>> heaps;
+	std::unordered_map<uint32_t, std::unique_ptr<RHI::RootSignature>> root_signatures;
+	std::unordered_map<uint32_t, std::unique_ptr<RHI::PipelineState>> pipeline_states;
+	std::unordered_map<uint32_t, RHI::HeapType> resource_heap_types;
+	std::vector<BufferRange> buffer_ranges;
+	std::vector<HeapRange> heap_ranges;
+
+	template <class T>
+	T* Lookup(std::unordered_map<uint32_t, std::unique_ptr<T>>& objects, uint32_t id);
+
+	uint64_t TranslateAddress(uint64_t address) const;
+	RHI::CpuDescriptorHandle TranslateCpuHandle(uint64_t handle) const;
+	RHI::GpuDescriptorHandle TranslateGpuHandle(uint64_t handle) const;
+
+	void CreateView(const Capture::ViewRecord& view);
+	void UploadResourceData(const Capture::ResourceDataRecord& record, const uint8_t* bytes);
+	size_t ReplayCommandList(RHI::CommandList* target, RHI::CommandAllocator* allocator, const uint8_t* stream, size_t size);
+	size_t ReplayBundle(uint32_t id, const uint8_t* stream, size_t size);
+	void SubmitUploads();
+	void Flush();
+};
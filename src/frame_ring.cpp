@@ -0,0 +1,35 @@
+#include "frame_ring.h"
+
+#include <stdexcept>
+
+FrameRing::FrameRing(RHI::Device& device, uint32_t frames_in_flight)
+{
+	if (frames_in_flight == 0)
+		throw std::invalid_argument("At least one frame must be in flight");
+	fence = device.CreateFence(0);
+	frame_fence_values.resize(frames_in_flight, 0);
+}
+
+void FrameRing::MoveToNextFrame(RHI::CommandQueue& queue)
+{
+	// Schedule a signal for the frame that was just submitted
+	queue.Signal(fence.get(), next_fence_value);
+	frame_fence_values[frame_index] = next_fence_value;
+	next_fence_value++;
+
+	frame_index = (frame_index + 1) % GetFrameCount();
+
+	// Wait only if the GPU still uses the resources of the next slot
+	const uint64_t slot_fence_value = frame_fence_values[frame_index];
+	if (fence->GetCompletedValue() < slot_fence_value) {
+		stall_count++;
+		fence->Wait(slot_fence_value);
+	}
+}
+
+void FrameRing::WaitForIdle(RHI::CommandQueue& queue)
+{
+	queue.Signal(fence.get(), next_fence_value);
+	fence->Wait(next_fence_value);
+	next_fence_value++;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "rhi.h"
+
+#include <vector>
+
+// Tracks the fence value that retires each frame in flight.
+// The CPU only waits when it wraps around onto a frame the GPU hasn't finished yet.
+class FrameRing
+{
+public:
+	FrameRing(RHI::Device& device, uint32_t frames_in_flight);
+
+	// Signals the end of the current frame on queue and moves to the next slot,
+	// waiting for the GPU only if that slot is still in use
+	void MoveToNextFrame(RHI::CommandQueue& queue);
+	// Waits for every submitted frame to finish
+	void WaitForIdle(RHI::CommandQueue& queue);
+
+	uint32_t GetFrameCount() const { return static_cast<uint32_t>(frame_fence_values.size()); }
+	uint32_t GetFrameIndex() const { return frame_index; }
+
+	RHI::Fence* GetFence() const { return fence.get(); }
+	// Fence value the current frame will be signalled with
+	uint64_t GetCurrentFenceValue() const { return next_fence_value; }
+	uint64_t GetCompletedFenceValue() const { return fence->GetCompletedValue(); }
+
+	// Number of times MoveToNextFrame had to block
+	uint64_t GetStallCount() const { return stall_count; }
+
+private:
+	std::unique_ptr<RHI::Fence> fence;
+	std::vector<uint64_t> frame_fence_values;
+	uint32_t frame_index = 0;
+	uint64_t next_fence_value = 1;
+	uint64_t stall_count = 0;
+};
@@ -0,0 +1,233 @@
+#include "frustum_culler.h"
+
+#include <array>
+#include <bitset>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define FRUSTUM_CULLER_X64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX2 in functions that ask for it, MSVC always can
+#if defined(__GNUC__)
+#define FRUSTUM_CULLER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define FRUSTUM_CULLER_TARGET_AVX2
+#endif
+
+namespace
+{
+	struct Plane
+	{
+		float a;
+		float b;
+		float c;
+		float d;
+	};
+
+	// Points inside have a non-negative distance to every plane. Clip space x = dot([p 1], column 0)
+	// and so on, the planes are sums and differences of the columns.
+	std::array<Plane, 6> ExtractPlanes(const float* m)
+	{
+		auto column = [m](int j) { return Plane{ m[j], m[4 + j], m[8 + j], m[12 + j] }; };
+		auto add = [](const Plane& p, const Plane& q) { return Plane{ p.a + q.a, p.b + q.b, p.c + q.c, p.d + q.d }; };
+		auto sub = [](const Plane& p, const Plane& q) { return Plane{ p.a - q.a, p.b - q.b, p.c - q.c, p.d - q.d }; };
+		const Plane x = column(0);
+		const Plane y = column(1);
+		const Plane z = column(2);
+		const Plane w = column(3);
+		return { add(w, x), sub(w, x), add(w, y), sub(w, y), z, sub(w, z) };
+	}
+
+	size_t CullScalar(const std::array<Plane, 6>& planes, const float* cx, const float* cy, const float* cz,
+		const float* ex, const float* ey, const float* ez, size_t count, uint32_t* visible)
+	{
+		size_t visible_count = 0;
+		for (size_t i = 0; i < count; i++) {
+			bool outside = false;
+			for (const Plane& plane : planes) {
+				// The box is outside when even its corner furthest along the normal is behind the plane
+				const float distance = plane.a * cx[i] + plane.b * cy[i] + plane.c * cz[i] + plane.d;
+				const float radius = std::fabs(plane.a) * ex[i] + std::fabs(plane.b) * ey[i] + std::fabs(plane.c) * ez[i];
+				if (distance + radius < 0.f) {
+					outside = true;
+					break;
+				}
+			}
+			if (!outside)
+				visible[visible_count++] = static_cast<uint32_t>(i);
+		}
+		return visible_count;
+	}
+
+#ifdef FRUSTUM_CULLER_X64
+	bool HasAvx2()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		// The OS must also save the upper register halves
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+			return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+	// For every mask of visible lanes, the lanes to move to the front as 4 bit fields
+	std::array<uint32_t, 256> BuildPackTable()
+	{
+		std::array<uint32_t, 256> table = {};
+		for (uint32_t mask = 0; mask < 256; mask++) {
+			uint32_t packed = 0;
+			uint32_t slot = 0;
+			for (uint32_t lane = 0; lane < 8; lane++) {
+				if (mask & (1u << lane))
+					packed |= lane << (4 * slot++);
+			}
+			table[mask] = packed;
+		}
+		return table;
+	}
+
+	const std::array<uint32_t, 256> pack_table = BuildPackTable();
+
+	FRUSTUM_CULLER_TARGET_AVX2 size_t CullAvx2(const std::array<Plane, 6>& planes, const float* cx, const float* cy, const float* cz,
+		const float* ex, const float* ey, const float* ez, size_t count, uint32_t* visible)
+	{
+		__m256 a[6], b[6], c[6], d[6], abs_a[6], abs_b[6], abs_c[6];
+		for (size_t p = 0; p < 6; p++) {
+			a[p] = _mm256_set1_ps(planes[p].a);
+			b[p] = _mm256_set1_ps(planes[p].b);
+			c[p] = _mm256_set1_ps(planes[p].c);
+			d[p] = _mm256_set1_ps(planes[p].d);
+			abs_a[p] = _mm256_set1_ps(std::fabs(planes[p].a));
+			abs_b[p] = _mm256_set1_ps(std::fabs(planes[p].b));
+			abs_c[p] = _mm256_set1_ps(std::fabs(planes[p].c));
+		}
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256i lane_shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+		const __m256i lane_bits = _mm256_set1_epi32(7);
+
+		size_t visible_count = 0;
+		for (size_t i = 0; i < count; i += 8) {
+			const __m256 x = _mm256_loadu_ps(cx + i);
+			const __m256 y = _mm256_loadu_ps(cy + i);
+			const __m256 z = _mm256_loadu_ps(cz + i);
+			const __m256 rx = _mm256_loadu_ps(ex + i);
+			const __m256 ry = _mm256_loadu_ps(ey + i);
+			const __m256 rz = _mm256_loadu_ps(ez + i);
+			__m256 outside = zero;
+			for (size_t p = 0; p < 6; p++) {
+				const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[p], x), _mm256_mul_ps(b[p], y)),
+					_mm256_add_ps(_mm256_mul_ps(c[p], z), d[p]));
+				const __m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(abs_a[p], rx), _mm256_mul_ps(abs_b[p], ry)),
+					_mm256_mul_ps(abs_c[p], rz));
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_LT_OQ));
+			}
+
+			// Lanes past the last box are padding
+			uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_ps(outside)) & 0xff;
+			if (count - i < 8)
+				mask &= (1u << (count - i)) - 1;
+
+			// Moves the indices of the visible lanes to the front, the caller leaves room for a full store
+			const __m256i lanes = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(pack_table[mask])), lane_shifts), lane_bits);
+			const __m256i indices = _mm256_add_epi32(lanes, _mm256_set1_epi32(static_cast<int>(i)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(visible + visible_count), indices);
+			visible_count += std::bitset<8>(mask).count();
+		}
+		return visible_count;
+	}
+#endif
+}
+
+const char* GetCullKernelName(CullKernel kernel)
+{
+	switch (kernel) {
+	case CullKernel::Scalar: return "scalar";
+	case CullKernel::Avx2: return "avx2";
+	}
+	return "unknown";
+}
+
+bool IsCullKernelSupported(CullKernel kernel)
+{
+	switch (kernel) {
+	case CullKernel::Scalar:
+		return true;
+#ifdef FRUSTUM_CULLER_X64
+	case CullKernel::Avx2: {
+		static const bool avx2 = HasAvx2();
+		return avx2;
+	}
+#endif
+	default:
+		return false;
+	}
+}
+
+CullKernel GetBestCullKernel()
+{
+	if (IsCullKernelSupported(CullKernel::Avx2))
+		return CullKernel::Avx2;
+	return CullKernel::Scalar;
+}
+
+uint32_t FrustumCuller::Add(const Aabb& box)
+{
+	// Grow eight lanes at a time, the kernel loads whole blocks
+	if (count % 8 == 0) {
+		for (std::vector<float>* lanes : { &center_x, &center_y, &center_z, &extent_x, &extent_y, &extent_z })
+			lanes->resize(count + 8, 0.f);
+	}
+	center_x[count] = (box.min[0] + box.max[0]) * .5f;
+	center_y[count] = (box.min[1] + box.max[1]) * .5f;
+	center_z[count] = (box.min[2] + box.max[2]) * .5f;
+	extent_x[count] = (box.max[0] - box.min[0]) * .5f;
+	extent_y[count] = (box.max[1] - box.min[1]) * .5f;
+	extent_z[count] = (box.max[2] - box.min[2]) * .5f;
+	return static_cast<uint32_t>(count++);
+}
+
+void FrustumCuller::Clear()
+{
+	for (std::vector<float>* lanes : { &center_x, &center_y, &center_z, &extent_x, &extent_y, &extent_z })
+		lanes->clear();
+	count = 0;
+}
+
+size_t FrustumCuller::Cull(CullKernel kernel, const float* view_projection, std::vector<uint32_t>& visible) const
+{
+	if (!IsCullKernelSupported(kernel))
+		throw std::invalid_argument(std::string("Culling kernel not supported: ") + GetCullKernelName(kernel));
+
+	const std::array<Plane, 6> planes = ExtractPlanes(view_projection);
+	// Room for the kernel's last full store
+	visible.resize(count + 8);
+	size_t visible_count = 0;
+	switch (kernel) {
+#ifdef FRUSTUM_CULLER_X64
+	case CullKernel::Avx2:
+		visible_count = CullAvx2(planes, center_x.data(), center_y.data(), center_z.data(), extent_x.data(), extent_y.data(), extent_z.data(),
+			count, visible.data());
+		break;
+#endif
+	default:
+		visible_count = CullScalar(planes, center_x.data(), center_y.data(), center_z.data(), extent_x.data(), extent_y.data(), extent_z.data(),
+			count, visible.data());
+		break;
+	}
+	visible.resize(visible_count);
+	return visible_count;
+}
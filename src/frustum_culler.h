@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Tests axis aligned boxes against the six planes of a view-projection frustum.
+// Boxes are kept as centers and extents in separate arrays, so the AVX2 kernel tests eight
+// boxes against a plane with a few instructions and packs the indices of the visible ones.
+// The test is conservative: boxes near a frustum corner may pass while outside.
+enum class CullKernel
+{
+	Scalar,
+	Avx2
+};
+
+const char* GetCullKernelName(CullKernel kernel);
+bool IsCullKernelSupported(CullKernel kernel);
+// Widest kernel the CPU supports
+CullKernel GetBestCullKernel();
+
+struct Aabb
+{
+	float min[3];
+	float max[3];
+};
+
+class FrustumCuller
+{
+public:
+	// Returns the index Cull reports the box by, boxes are numbered in the order they are added
+	uint32_t Add(const Aabb& box);
+	void Clear();
+	size_t GetCount() const { return count; }
+
+	// view_projection is row major and transforms row vectors, as DirectXMath matrices do, into
+	// D3D clip space where 0 <= z <= w. Replaces visible with the indices of the boxes inside or
+	// crossing the frustum in ascending order and returns how many there are.
+	size_t Cull(CullKernel kernel, const float* view_projection, std::vector<uint32_t>& visible) const;
+	size_t Cull(const float* view_projection, std::vector<uint32_t>& visible) const { return Cull(GetBestCullKernel(), view_projection, visible); }
+
+private:
+	// Padded to a multiple of eight so the kernel never reads past the end
+	std::vector<float> center_x;
+	std::vector<float> center_y;
+	std::vector<float> center_z;
+	std::vector<float> extent_x;
+	std::vector<float> extent_y;
+	std::vector<float> extent_z;
+	size_t count = 0;
+};
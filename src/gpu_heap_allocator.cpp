@@ -0,0 +1,99 @@
+#include "gpu_heap_allocator.h"
+
+#include <stdexcept>
+
+GpuHeapAllocator::GpuHeapAllocator(RHI::Device& device, uint64_t page_size)
+	: device(device), page_size((page_size + RHI::default_placement_alignment - 1) & ~(RHI::default_placement_alignment - 1))
+{
+}
+
+GpuAllocation GpuHeapAllocator::CreateBuffer(RHI::HeapType heap_type, uint64_t size, RHI::ResourceState initial_state)
+{
+	GpuAllocation allocation;
+	const uint64_t alignment = RHI::default_placement_alignment;
+
+	if (size > page_size) {
+		const uint64_t dedicated_size = (size + alignment - 1) & ~(alignment - 1);
+		allocation.page = AddPage(heap_type, dedicated_size, true);
+		pages[allocation.page]->allocator.Allocate(size, alignment, allocation.block);
+	}
+	else {
+		// First fit over the pages of this heap type, a new page only when all are full
+		for (uint32_t i = 0; i < pages.size() && allocation.page == ~0u; i++) {
+			Page* page = pages[i].get();
+			if (page && !page->dedicated && page->heap->GetType() == heap_type && page->allocator.Allocate(size, alignment, allocation.block))
+				allocation.page = i;
+		}
+		if (allocation.page == ~0u) {
+			allocation.page = AddPage(heap_type, page_size, false);
+			if (!pages[allocation.page]->allocator.Allocate(size, alignment, allocation.block))
+				throw std::runtime_error("Buffer does not fit in an empty heap page");
+		}
+	}
+
+	Page& page = *pages[allocation.page];
+	allocation.resource = device.CreatePlacedBuffer(page.heap.get(), allocation.block.offset, size, initial_state);
+	return allocation;
+}
+
+void GpuHeapAllocator::Release(GpuAllocation& allocation)
+{
+	if (!allocation.resource)
+		return;
+
+	// The resource goes first, it must not outlive its memory
+	allocation.resource.reset();
+	Page& page = *pages[allocation.page];
+	page.allocator.Free(allocation.block);
+	if (page.dedicated) {
+		pages[allocation.page].reset();
+		unused_pages.push_back(allocation.page);
+	}
+	allocation.page = ~0u;
+}
+
+GpuHeapAllocator::Stats GpuHeapAllocator::GetStats() const
+{
+	Stats stats = {};
+	uint64_t free_bytes = 0;
+	uint64_t largest_free_total = 0;
+	for (const TlsfAllocator::Stats& page : GetPageStats()) {
+		if (page.capacity == 0)
+			continue;
+		stats.pages++;
+		stats.heap_bytes += page.capacity;
+		stats.used_bytes += page.used;
+		stats.allocations += page.allocations;
+		stats.free_blocks += page.free_blocks;
+		stats.compaction_bytes += page.compaction_bytes;
+		if (page.largest_free_block > stats.largest_free_block)
+			stats.largest_free_block = page.largest_free_block;
+		free_bytes += page.capacity - page.used;
+		largest_free_total += page.largest_free_block;
+	}
+	stats.fragmentation = free_bytes ? 1.0 - static_cast<double>(largest_free_total) / free_bytes : 0.0;
+	return stats;
+}
+
+std::vector<TlsfAllocator::Stats> GpuHeapAllocator::GetPageStats() const
+{
+	std::vector<TlsfAllocator::Stats> stats(pages.size(), TlsfAllocator::Stats{});
+	for (size_t i = 0; i < pages.size(); i++) {
+		if (pages[i])
+			stats[i] = pages[i]->allocator.GetStats();
+	}
+	return stats;
+}
+
+uint32_t GpuHeapAllocator::AddPage(RHI::HeapType heap_type, uint64_t size, bool dedicated)
+{
+	auto page = std::unique_ptr<Page>(new Page{ device.CreateHeap(heap_type, size), TlsfAllocator(size, RHI::default_placement_alignment), dedicated });
+	if (!unused_pages.empty()) {
+		const uint32_t index = unused_pages.back();
+		unused_pages.pop_back();
+		pages[index] = std::move(page);
+		return index;
+	}
+	pages.push_back(std::move(page));
+	return static_cast<uint32_t>(pages.size() - 1);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "rhi.h"
+#include "tlsf_allocator.h"
+
+#include <vector>
+
+// A buffer placed into one of GpuHeapAllocator's heaps.
+// Must be handed back with GpuHeapAllocator::Release once the GPU no longer uses it.
+struct GpuAllocation
+{
+	std::unique_ptr<RHI::Resource> resource;
+	uint32_t page = ~0u;
+	TlsfAllocator::Allocation block = {};
+};
+
+// Places buffers into large heaps instead of creating a committed resource each.
+// Every page is one RHI::Heap of a single heap type managed by a TlsfAllocator.
+// Buffers larger than a page get a dedicated page that is destroyed on release.
+class GpuHeapAllocator
+{
+public:
+	static const uint64_t default_page_size = 64 * 1024 * 1024;
+
+	struct Stats
+	{
+		uint32_t pages;
+		uint64_t heap_bytes;
+		uint64_t used_bytes;
+		uint32_t allocations;
+		uint32_t free_blocks;
+		uint64_t largest_free_block;
+		uint64_t compaction_bytes;
+		// Free space outside each page's largest free block, relative to all free space
+		double fragmentation;
+	};
+
+	// Every allocation must be released before the allocator is destroyed
+	explicit GpuHeapAllocator(RHI::Device& device, uint64_t page_size = default_page_size);
+
+	GpuAllocation CreateBuffer(RHI::HeapType heap_type, uint64_t size, RHI::ResourceState initial_state);
+	// Destroys the buffer and returns its memory to the page
+	void Release(GpuAllocation& allocation);
+
+	Stats GetStats() const;
+	// Per page allocator statistics, empty entries for destroyed dedicated pages
+	std::vector<TlsfAllocator::Stats> GetPageStats() const;
+
+private:
+	struct Page
+	{
+		std::unique_ptr<RHI::Heap> heap;
+		TlsfAllocator allocator;
+		bool dedicated;
+	};
+
+	RHI::Device& device;
+	uint64_t page_size;
+	std::vector<std::unique_ptr<Page>> pages;
+	std::vector<uint32_t> unused_pages;
+
+	uint32_t AddPage(RHI::HeapType heap_type, uint64_t size, bool dedicated);
+};
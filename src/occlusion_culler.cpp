@@ -0,0 +1,342 @@
+#include "occlusion_culler.h"
+
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define OCCLUSION_CULLER_X64
+#include <immintrin.h>
+#endif
+
+// GCC and Clang only emit AVX2 in functions that ask for it, MSVC always can
+#if defined(__GNUC__)
+#define OCCLUSION_CULLER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define OCCLUSION_CULLER_TARGET_AVX2
+#endif
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	struct ClipVertex
+	{
+		float x;
+		float y;
+		float z;
+		float w;
+	};
+
+	// A pixel center at px is inside the edge when c - dy * px is positive, or zero on a top-left edge
+	struct EdgeSetup
+	{
+		float c;
+		float dy;
+		bool top_left;
+	};
+
+	// Boxes tested per task, enough to amortize handing out indices
+	const size_t boxes_per_task = 64;
+
+	ClipVertex Transform(const float* m, float x, float y, float z)
+	{
+		return { x * m[0] + y * m[4] + z * m[8] + m[12], x * m[1] + y * m[5] + z * m[9] + m[13],
+			x * m[2] + y * m[6] + z * m[10] + m[14], x * m[3] + y * m[7] + z * m[11] + m[15] };
+	}
+
+	// Keeps the part of the polygon where distance is positive
+	template <class Distance>
+	size_t ClipPolygon(const ClipVertex* input, size_t count, ClipVertex* output, Distance distance)
+	{
+		size_t output_count = 0;
+		for (size_t i = 0; i < count; i++) {
+			const ClipVertex& a = input[i];
+			const ClipVertex& b = input[(i + 1) % count];
+			const float da = distance(a);
+			const float db = distance(b);
+			if (da >= 0.f)
+				output[output_count++] = a;
+			if ((da >= 0.f) != (db >= 0.f)) {
+				const float t = da / (da - db);
+				output[output_count++] = { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t };
+			}
+		}
+		return output_count;
+	}
+
+	void RasterizeSpanScalar(float* row, int32_t x0, int32_t x1, const EdgeSetup* edges, float z_row, float zx)
+	{
+		for (int32_t x = x0; x <= x1; x++) {
+			const float px = x + .5f;
+			bool covered = true;
+			for (int e = 0; e < 3; e++) {
+				const float w = edges[e].c - edges[e].dy * px;
+				covered = covered && (w > 0.f || (w == 0.f && edges[e].top_left));
+			}
+			const float z = z_row + zx * px;
+			if (covered && z < row[x])
+				row[x] = z;
+		}
+	}
+
+#ifdef OCCLUSION_CULLER_X64
+	// Eight pixels per step under a mask of the covered ones. Rows are a multiple of eight pixels,
+	// steps start at multiples of eight and never leave the row.
+	OCCLUSION_CULLER_TARGET_AVX2 void RasterizeSpanAvx2(float* row, int32_t x0, int32_t x1, const EdgeSetup* edges, float z_row, float zx)
+	{
+		const __m256 lane_offsets = _mm256_setr_ps(.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 first = _mm256_set1_ps(static_cast<float>(x0));
+		const __m256 last = _mm256_set1_ps(static_cast<float>(x1) + 1.f);
+		__m256 c[3], dy[3], top_left[3];
+		for (int e = 0; e < 3; e++) {
+			c[e] = _mm256_set1_ps(edges[e].c);
+			dy[e] = _mm256_set1_ps(edges[e].dy);
+			top_left[e] = edges[e].top_left ? _mm256_castsi256_ps(_mm256_set1_epi32(-1)) : zero;
+		}
+		const __m256 z_start = _mm256_set1_ps(z_row);
+		const __m256 z_step = _mm256_set1_ps(zx);
+
+		for (int32_t x = x0 & ~7; x <= x1; x += 8) {
+			const __m256 px = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), lane_offsets);
+			__m256 mask = _mm256_and_ps(_mm256_cmp_ps(px, first, _CMP_GT_OQ), _mm256_cmp_ps(px, last, _CMP_LT_OQ));
+			for (int e = 0; e < 3; e++) {
+				const __m256 w = _mm256_sub_ps(c[e], _mm256_mul_ps(dy[e], px));
+				const __m256 inside = _mm256_or_ps(_mm256_cmp_ps(w, zero, _CMP_GT_OQ), _mm256_and_ps(_mm256_cmp_ps(w, zero, _CMP_EQ_OQ), top_left[e]));
+				mask = _mm256_and_ps(mask, inside);
+			}
+			if (_mm256_testz_ps(mask, mask))
+				continue;
+			const __m256 z = _mm256_add_ps(z_start, _mm256_mul_ps(z_step, px));
+			const __m256 stored = _mm256_loadu_ps(row + x);
+			_mm256_storeu_ps(row + x, _mm256_blendv_ps(stored, _mm256_min_ps(stored, z), mask));
+		}
+	}
+#endif
+}
+
+OcclusionCuller::OcclusionCuller(ThreadPool& pool, uint32_t width, uint32_t height, uint32_t max_threads, CullKernel kernel)
+	: pool(pool), width(width), height(height), max_threads(max_threads), kernel(kernel), view_projection(),
+	depth(static_cast<size_t>(width) * height, 1.f), tile_depth(static_cast<size_t>(width / tile_size) * (height / tile_size), 1.f)
+{
+	if (width == 0 || height == 0 || width % tile_size != 0 || height % tile_size != 0)
+		throw std::invalid_argument("Occlusion culler size must be a non-zero multiple of the tile size");
+	if (!IsCullKernelSupported(kernel))
+		throw std::invalid_argument(std::string("Culling kernel not supported: ") + GetCullKernelName(kernel));
+}
+
+void OcclusionCuller::Begin(const float* view_projection)
+{
+	std::copy(view_projection, view_projection + 16, this->view_projection);
+	triangles.clear();
+	stats = {};
+}
+
+void OcclusionCuller::AddOccluder(const float* positions, size_t vertex_count)
+{
+	if (vertex_count % 3 != 0)
+		throw std::invalid_argument("Occluders are triangle lists");
+
+	const Clock::time_point start = Clock::now();
+	for (size_t i = 0; i < vertex_count; i += 3) {
+		// Clipping a triangle against two planes adds at most two vertices
+		ClipVertex polygon[5];
+		ClipVertex clipped[5];
+		for (size_t v = 0; v < 3; v++) {
+			const float* position = positions + (i + v) * 3;
+			polygon[v] = Transform(view_projection, position[0], position[1], position[2]);
+		}
+		size_t count = ClipPolygon(polygon, 3, clipped, [](const ClipVertex& v) { return v.z; });
+		count = ClipPolygon(clipped, count, polygon, [](const ClipVertex& v) { return v.w - v.z; });
+		for (size_t v = 1; v + 1 < count; v++)
+			AddTriangle(&polygon[0].x, &polygon[v].x, &polygon[v + 1].x);
+	}
+	stats.rasterize_ms += MillisecondsSince(start);
+}
+
+void OcclusionCuller::AddTriangle(const float* a, const float* b, const float* c)
+{
+	if (a[3] <= 0.f || b[3] <= 0.f || c[3] <= 0.f)
+		return;
+	Triangle triangle;
+	float z[3];
+	const float* vertices[3] = { a, b, c };
+	for (int v = 0; v < 3; v++) {
+		triangle.x[v] = (vertices[v][0] / vertices[v][3] * .5f + .5f) * width;
+		triangle.y[v] = (.5f - vertices[v][1] / vertices[v][3] * .5f) * height;
+		z[v] = vertices[v][2] / vertices[v][3];
+	}
+
+	// Counter-clockwise and degenerate triangles are culled
+	const float dx1 = triangle.x[1] - triangle.x[0];
+	const float dy1 = triangle.y[1] - triangle.y[0];
+	const float dx2 = triangle.x[2] - triangle.x[0];
+	const float dy2 = triangle.y[2] - triangle.y[0];
+	const float area = dx1 * dy2 - dy1 * dx2;
+	if (!(area > 0.f))
+		return;
+
+	triangle.zx = ((z[1] - z[0]) * dy2 - (z[2] - z[0]) * dy1) / area;
+	triangle.zy = (dx1 * (z[2] - z[0]) - dx2 * (z[1] - z[0])) / area;
+	triangle.z0 = z[0] - triangle.zx * triangle.x[0] - triangle.zy * triangle.y[0];
+
+	const float min_y = std::min(triangle.y[0], std::min(triangle.y[1], triangle.y[2]));
+	const float max_y = std::max(triangle.y[0], std::max(triangle.y[1], triangle.y[2]));
+	const float min_x = std::min(triangle.x[0], std::min(triangle.x[1], triangle.x[2]));
+	const float max_x = std::max(triangle.x[0], std::max(triangle.x[1], triangle.x[2]));
+	triangle.min_y = std::max(0, static_cast<int32_t>(std::floor(min_y - .5f)));
+	triangle.max_y = std::min(static_cast<int32_t>(height) - 1, static_cast<int32_t>(std::ceil(max_y - .5f)));
+	if (triangle.min_y > triangle.max_y || max_x < 0.f || min_x > static_cast<float>(width))
+		return;
+	triangles.push_back(triangle);
+	stats.occluder_triangles++;
+}
+
+void OcclusionCuller::Rasterize()
+{
+	const Clock::time_point start = Clock::now();
+	// Bands are one tile high, no two threads write the same pixels or tiles. A single band runs inline.
+	pool.ParallelFor(height / tile_size, [this](size_t band) { RasterizeBand(static_cast<uint32_t>(band)); }, max_threads);
+	stats.rasterize_ms += MillisecondsSince(start);
+}
+
+void OcclusionCuller::RasterizeBand(uint32_t band)
+{
+	const int32_t band_top = static_cast<int32_t>(band * tile_size);
+	const int32_t band_bottom = band_top + static_cast<int32_t>(tile_size) - 1;
+	std::fill(depth.begin() + static_cast<size_t>(band_top) * width, depth.begin() + static_cast<size_t>(band_bottom + 1) * width, 1.f);
+
+	for (const Triangle& triangle : triangles) {
+		if (triangle.max_y < band_top || triangle.min_y > band_bottom)
+			continue;
+
+		// Edge functions of the clockwise triangle are positive inside, see OverdrawCounter
+		float edge_dx[3];
+		EdgeSetup edges[3];
+		for (int e = 0; e < 3; e++) {
+			const int from = (e + 1) % 3;
+			const int to = (e + 2) % 3;
+			edge_dx[e] = triangle.x[to] - triangle.x[from];
+			edges[e].dy = triangle.y[to] - triangle.y[from];
+			edges[e].top_left = edges[e].dy < 0.f || (edges[e].dy == 0.f && edge_dx[e] > 0.f);
+		}
+		const float min_x = std::min(triangle.x[0], std::min(triangle.x[1], triangle.x[2]));
+		const float max_x = std::max(triangle.x[0], std::max(triangle.x[1], triangle.x[2]));
+		const int32_t x0 = std::max(0, static_cast<int32_t>(std::floor(min_x - .5f)));
+		const int32_t x1 = std::min(static_cast<int32_t>(width) - 1, static_cast<int32_t>(std::ceil(max_x - .5f)));
+
+		const int32_t y0 = std::max(band_top, triangle.min_y);
+		const int32_t y1 = std::min(band_bottom, triangle.max_y);
+		for (int32_t y = y0; y <= y1; y++) {
+			const float py = y + .5f;
+			for (int e = 0; e < 3; e++) {
+				const int from = (e + 1) % 3;
+				edges[e].c = edge_dx[e] * (py - triangle.y[from]) + edges[e].dy * triangle.x[from];
+			}
+			float* row = depth.data() + static_cast<size_t>(y) * width;
+			const float z_row = triangle.z0 + triangle.zy * py;
+#ifdef OCCLUSION_CULLER_X64
+			if (kernel == CullKernel::Avx2) {
+				RasterizeSpanAvx2(row, x0, x1, edges, z_row, triangle.zx);
+				continue;
+			}
+#endif
+			RasterizeSpanScalar(row, x0, x1, edges, z_row, triangle.zx);
+		}
+	}
+
+	// The farthest depth of each tile, tests skip tiles nearer than a box without reading its pixels
+	const uint32_t tiles_x = width / tile_size;
+	for (uint32_t tile = 0; tile < tiles_x; tile++) {
+		float farthest = 0.f;
+		for (int32_t y = band_top; y <= band_bottom; y++) {
+			const float* row = depth.data() + static_cast<size_t>(y) * width + tile * tile_size;
+			for (uint32_t x = 0; x < tile_size; x++)
+				farthest = std::max(farthest, row[x]);
+		}
+		tile_depth[static_cast<size_t>(band) * tiles_x + tile] = farthest;
+	}
+}
+
+size_t OcclusionCuller::Test(const Aabb* boxes, const uint32_t* candidates, size_t candidate_count, std::vector<uint32_t>& visible)
+{
+	const Clock::time_point start = Clock::now();
+	visible_flags.resize(candidate_count);
+	// Up to boxes_per_task candidates are tested inline without waking the pool
+	pool.ParallelFor((candidate_count + boxes_per_task - 1) / boxes_per_task, [&](size_t task) {
+		const size_t last = std::min(candidate_count, (task + 1) * boxes_per_task);
+		for (size_t i = task * boxes_per_task; i < last; i++)
+			visible_flags[i] = IsVisible(boxes[candidates[i]]);
+	}, max_threads);
+
+	visible.clear();
+	for (size_t i = 0; i < candidate_count; i++) {
+		if (visible_flags[i])
+			visible.push_back(candidates[i]);
+	}
+	stats.tested_boxes += static_cast<uint32_t>(candidate_count);
+	stats.occluded_boxes += static_cast<uint32_t>(candidate_count - visible.size());
+	stats.test_ms += MillisecondsSince(start);
+	return visible.size();
+}
+
+bool OcclusionCuller::IsVisible(const Aabb& box) const
+{
+	float min_x = INFINITY;
+	float max_x = -INFINITY;
+	float min_y = INFINITY;
+	float max_y = -INFINITY;
+	float min_z = INFINITY;
+	for (int corner = 0; corner < 8; corner++) {
+		const ClipVertex v = Transform(view_projection, corner & 1 ? box.max[0] : box.min[0], corner & 2 ? box.max[1] : box.min[1],
+			corner & 4 ? box.max[2] : box.min[2]);
+		// Boxes crossing the near plane cover the view, there is nothing in front of them to hide them
+		if (v.z < 0.f || v.w <= 0.f)
+			return true;
+		const float x = (v.x / v.w * .5f + .5f) * width;
+		const float y = (.5f - v.y / v.w * .5f) * height;
+		min_x = std::min(min_x, x);
+		max_x = std::max(max_x, x);
+		min_y = std::min(min_y, y);
+		max_y = std::max(max_y, y);
+		min_z = std::min(min_z, v.z / v.w);
+	}
+
+	// Every pixel the box may touch, one more on each side for occluder edges sampled at pixel centers
+	const int32_t x0 = std::max(0, static_cast<int32_t>(std::floor(min_x)) - 1);
+	const int32_t x1 = std::min(static_cast<int32_t>(width) - 1, static_cast<int32_t>(std::ceil(max_x)));
+	const int32_t y0 = std::max(0, static_cast<int32_t>(std::floor(min_y)) - 1);
+	const int32_t y1 = std::min(static_cast<int32_t>(height) - 1, static_cast<int32_t>(std::ceil(max_y)));
+	if (x0 > x1 || y0 > y1)
+		return false;
+
+	const uint32_t tiles_x = width / tile_size;
+	for (int32_t tile_y = y0 / static_cast<int32_t>(tile_size); tile_y <= y1 / static_cast<int32_t>(tile_size); tile_y++) {
+		for (int32_t tile_x = x0 / static_cast<int32_t>(tile_size); tile_x <= x1 / static_cast<int32_t>(tile_size); tile_x++) {
+			if (tile_depth[static_cast<size_t>(tile_y) * tiles_x + tile_x] < min_z)
+				continue;
+			const int32_t px0 = std::max(x0, tile_x * static_cast<int32_t>(tile_size));
+			const int32_t px1 = std::min(x1, (tile_x + 1) * static_cast<int32_t>(tile_size) - 1);
+			const int32_t py0 = std::max(y0, tile_y * static_cast<int32_t>(tile_size));
+			const int32_t py1 = std::min(y1, (tile_y + 1) * static_cast<int32_t>(tile_size) - 1);
+			for (int32_t y = py0; y <= py1; y++) {
+				const float* row = depth.data() + static_cast<size_t>(y) * width;
+				for (int32_t x = px0; x <= px1; x++) {
+					if (row[x] >= min_z)
+						return true;
+				}
+			}
+		}
+	}
+	return false;
+}
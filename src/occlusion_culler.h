@@ -0,0 +1,82 @@
+#pragma once
+
+#include "frustum_culler.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Software occlusion culling against a low resolution depth buffer of large occluders.
+// Occluder triangles are rasterized in spans of eight pixels under a coverage mask, on the threads
+// of a pool that each own a band of tile rows. Every 8x8 tile then keeps the farthest depth in it,
+// box tests skip tiles entirely nearer than the box and only look at pixels of the rest.
+// Occluder edges are sampled at the culler's resolution, so objects peeking out from behind
+// an occluder by less than one of its pixels may be culled.
+class OcclusionCuller
+{
+public:
+	static const uint32_t tile_size = 8;
+
+	struct Stats
+	{
+		// Front facing occluder triangles after clipping, per frame
+		uint32_t occluder_triangles;
+		uint32_t tested_boxes;
+		uint32_t occluded_boxes;
+		double rasterize_ms;
+		double test_ms;
+	};
+
+	// width and height must be multiples of tile_size. Rasterizing and testing run on up to
+	// max_threads threads of pool, 0 uses all of them. The pool must outlive the culler.
+	OcclusionCuller(ThreadPool& pool, uint32_t width, uint32_t height, uint32_t max_threads = 0, CullKernel kernel = GetBestCullKernel());
+
+	// Starts a frame seen through view_projection, row major as FrustumCuller takes it
+	void Begin(const float* view_projection);
+	// Triangle list of tightly packed object space xyz positions. Clockwise triangles are front
+	// facing as in the default rasterizer state, back faces don't occlude since they aren't drawn.
+	void AddOccluder(const float* positions, size_t vertex_count);
+	// Rasterizes the occluders added since Begin
+	void Rasterize();
+	// Replaces visible with the candidates whose box isn't hidden by the occluders, in order.
+	// Candidates index boxes.
+	size_t Test(const Aabb* boxes, const uint32_t* candidates, size_t candidate_count, std::vector<uint32_t>& visible);
+
+	const Stats& GetStats() const { return stats; }
+	uint32_t GetWidth() const { return width; }
+	uint32_t GetHeight() const { return height; }
+	// Depth of a pixel after Rasterize, 1 where no occluder covers it
+	float GetDepth(uint32_t x, uint32_t y) const { return depth[static_cast<size_t>(y) * width + x]; }
+
+private:
+	// Screen space triangle with depth as a plane, z = z0 + zx * x + zy * y
+	struct Triangle
+	{
+		float x[3];
+		float y[3];
+		float z0;
+		float zx;
+		float zy;
+		int32_t min_y;
+		int32_t max_y;
+	};
+
+	ThreadPool& pool;
+	uint32_t width;
+	uint32_t height;
+	uint32_t max_threads;
+	CullKernel kernel;
+	float view_projection[16];
+	std::vector<float> depth;
+	// Farthest depth of every tile
+	std::vector<float> tile_depth;
+	std::vector<Triangle> triangles;
+	std::vector<uint8_t> visible_flags;
+	Stats stats = {};
+
+	void AddTriangle(const float* a, const float* b, const float* c);
+	void RasterizeBand(uint32_t band);
+	bool IsVisible(const Aabb& box) const;
+};
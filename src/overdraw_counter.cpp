@@ -0,0 +1,140 @@
+#include "overdraw_counter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+	struct ScreenVertex
+	{
+		float x;
+		float y;
+		float z;
+	};
+
+	// Twice the signed area of abp, positive when p is to the right of a->b on a y-down screen
+	float Edge(const ScreenVertex& a, const ScreenVertex& b, float x, float y)
+	{
+		return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+	}
+
+	// Top-left rule: pixel centers exactly on a top or left edge belong to the triangle
+	bool IsTopLeft(const ScreenVertex& a, const ScreenVertex& b)
+	{
+		return b.y < a.y || (b.y == a.y && b.x > a.x);
+	}
+
+	bool Covers(float edge, bool top_left)
+	{
+		return edge > 0.f || (edge == 0.f && top_left);
+	}
+
+	// Keeps the part of the polygon where distance is positive
+	template <class Distance>
+	void ClipPolygon(const std::vector<OverdrawCounter::ClipVertex>& input, std::vector<OverdrawCounter::ClipVertex>& output, Distance distance)
+	{
+		output.clear();
+		for (size_t i = 0; i < input.size(); i++) {
+			const OverdrawCounter::ClipVertex& a = input[i];
+			const OverdrawCounter::ClipVertex& b = input[(i + 1) % input.size()];
+			const float da = distance(a);
+			const float db = distance(b);
+			if (da >= 0.f)
+				output.push_back(a);
+			if ((da >= 0.f) != (db >= 0.f)) {
+				const float t = da / (da - db);
+				output.push_back({ a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t });
+			}
+		}
+	}
+}
+
+OverdrawCounter::OverdrawCounter(uint32_t width, uint32_t height) : width(width), height(height), depth(static_cast<size_t>(width) * height, 1.f)
+{
+	if (width == 0 || height == 0)
+		throw std::invalid_argument("Overdraw counter without pixels");
+}
+
+void OverdrawCounter::ClearDepth(float value)
+{
+	std::fill(depth.begin(), depth.end(), value);
+}
+
+void OverdrawCounter::Draw(const ClipVertex* vertices, size_t vertex_count, const Pass& pass)
+{
+	if (vertex_count % 3 != 0)
+		throw std::invalid_argument("Overdraw counter draws triangle lists");
+
+	for (size_t i = 0; i < vertex_count; i += 3) {
+		stats.triangles++;
+		// Only the depth range needs clipping, x and y are clamped to the target while rasterizing
+		polygon.assign(vertices + i, vertices + i + 3);
+		ClipPolygon(polygon, clipped, [](const ClipVertex& v) { return v.z; });
+		ClipPolygon(clipped, polygon, [](const ClipVertex& v) { return v.w - v.z; });
+		if (polygon.size() < 3) {
+			stats.culled_triangles++;
+			continue;
+		}
+
+		const uint64_t covered = stats.covered_pixels;
+		for (size_t j = 1; j + 1 < polygon.size(); j++)
+			RasterizeTriangle(polygon[0], polygon[j], polygon[j + 1], pass);
+		if (stats.covered_pixels == covered)
+			stats.culled_triangles++;
+	}
+}
+
+void OverdrawCounter::RasterizeTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, const Pass& pass)
+{
+	if (a.w <= 0.f || b.w <= 0.f || c.w <= 0.f)
+		return;
+	auto to_screen = [this](const ClipVertex& v) {
+		return ScreenVertex{ (v.x / v.w * .5f + .5f) * width, (.5f - v.y / v.w * .5f) * height, v.z / v.w };
+	};
+	const ScreenVertex s0 = to_screen(a);
+	const ScreenVertex s1 = to_screen(b);
+	const ScreenVertex s2 = to_screen(c);
+
+	// Counter-clockwise and degenerate triangles are culled
+	const float area = Edge(s0, s1, s2.x, s2.y);
+	if (!(area > 0.f))
+		return;
+
+	const float min_x = std::min(s0.x, std::min(s1.x, s2.x));
+	const float max_x = std::max(s0.x, std::max(s1.x, s2.x));
+	const float min_y = std::min(s0.y, std::min(s1.y, s2.y));
+	const float max_y = std::max(s0.y, std::max(s1.y, s2.y));
+	const int32_t x0 = std::max(0, static_cast<int32_t>(std::floor(min_x - .5f)));
+	const int32_t x1 = std::min(static_cast<int32_t>(width) - 1, static_cast<int32_t>(std::ceil(max_x - .5f)));
+	const int32_t y0 = std::max(0, static_cast<int32_t>(std::floor(min_y - .5f)));
+	const int32_t y1 = std::min(static_cast<int32_t>(height) - 1, static_cast<int32_t>(std::ceil(max_y - .5f)));
+
+	const bool top_left0 = IsTopLeft(s1, s2);
+	const bool top_left1 = IsTopLeft(s2, s0);
+	const bool top_left2 = IsTopLeft(s0, s1);
+	for (int32_t y = y0; y <= y1; y++) {
+		const float py = y + .5f;
+		for (int32_t x = x0; x <= x1; x++) {
+			const float px = x + .5f;
+			const float w0 = Edge(s1, s2, px, py);
+			const float w1 = Edge(s2, s0, px, py);
+			const float w2 = Edge(s0, s1, px, py);
+			if (!Covers(w0, top_left0) || !Covers(w1, top_left1) || !Covers(w2, top_left2))
+				continue;
+			stats.covered_pixels++;
+
+			// Depth is affine in screen space, the same vertices always give the same depth
+			const float z = (w0 * s0.z + w1 * s1.z + w2 * s2.z) / area;
+			float& stored = depth[static_cast<size_t>(y) * width + x];
+			const bool passed = pass.test == DepthTest::None || (pass.test == DepthTest::Less && z < stored)
+				|| (pass.test == DepthTest::Equal && z == stored);
+			if (!passed)
+				continue;
+			if (pass.shade)
+				stats.shaded_pixels++;
+			if (pass.depth_write)
+				stored = z;
+		}
+	}
+}
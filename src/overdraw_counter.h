@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Software rasterizer that counts pixel shader invocations, to measure what depth testing and a
+// depth pre-pass save. Triangles come as triangle lists in clip space and are clipped to the
+// depth range, culled like the default rasterizer state (clockwise triangles are front facing)
+// and sampled at pixel centers with the top-left rule. Pixel shaders run after the depth test
+// as with early-Z, without a depth test every covered pixel shades.
+class OverdrawCounter
+{
+public:
+	struct ClipVertex
+	{
+		float x;
+		float y;
+		float z;
+		float w;
+	};
+
+	enum class DepthTest
+	{
+		None,
+		Less,
+		Equal
+	};
+
+	struct Pass
+	{
+		DepthTest test;
+		bool depth_write;
+		// Depth only passes have no pixel shader
+		bool shade;
+	};
+
+	struct Stats
+	{
+		uint64_t triangles;
+		// Triangles the cull mode or clipping removed entirely
+		uint64_t culled_triangles;
+		// Pixels covered by triangles, before the depth test
+		uint64_t covered_pixels;
+		uint64_t shaded_pixels;
+	};
+
+	OverdrawCounter(uint32_t width, uint32_t height);
+
+	void ClearDepth(float value = 1.f);
+	void Draw(const ClipVertex* vertices, size_t vertex_count, const Pass& pass);
+
+	const Stats& GetStats() const { return stats; }
+	void ResetStats() { stats = {}; }
+	// Pixel shader invocations per pixel of the target
+	double GetOverdraw() const { return static_cast<double>(stats.shaded_pixels) / (static_cast<double>(width) * height); }
+
+private:
+	uint32_t width;
+	uint32_t height;
+	std::vector<float> depth;
+	Stats stats = {};
+	// Polygons of the triangle being clipped
+	std::vector<ClipVertex> polygon;
+	std::vector<ClipVertex> clipped;
+
+	void RasterizeTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, const Pass& pass);
+};
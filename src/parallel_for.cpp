@@ -0,0 +1,138 @@
+#include "parallel_for.h"
+
+#include <algorithm>
+
+namespace
+{
+	// Pool whose loop the current thread is running, nested loops on it run inline
+	thread_local const ThreadPool* current_pool = nullptr;
+}
+
+void ParallelFor(size_t count, uint32_t thread_count, const std::function<void(size_t)>& task)
+{
+	if (thread_count == 0)
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	const size_t worker_count = std::min<size_t>(thread_count, count);
+
+	std::atomic<size_t> next(0);
+	std::exception_ptr error;
+	std::mutex error_mutex;
+	auto work = [&]() {
+		for (size_t i = next++; i < count; i = next++) {
+			try
+			{
+				task(i);
+			}
+			catch (...)
+			{
+				// Remaining indices are skipped once anything failed
+				std::lock_guard<std::mutex> lock(error_mutex);
+				if (!error)
+					error = std::current_exception();
+				next = count;
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < worker_count; i++)
+		workers.emplace_back(work);
+	work();
+	for (std::thread& worker : workers)
+		worker.join();
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+ThreadPool::ThreadPool(uint32_t thread_count)
+{
+	if (thread_count == 0)
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	for (uint32_t i = 1; i < thread_count; i++)
+		workers.emplace_back(&ThreadPool::WorkerMain, this, i - 1);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& task, uint32_t max_threads)
+{
+	const uint32_t thread_count = max_threads ? std::min(max_threads, GetThreadCount()) : GetThreadCount();
+	if (count <= 1 || thread_count == 1 || current_pool == this) {
+		for (size_t i = 0; i < count; i++)
+			task(i);
+		return;
+	}
+
+	std::lock_guard<std::mutex> loop_lock(loop_mutex);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->task = &task;
+		this->count = count;
+		next = 0;
+		error = nullptr;
+		loop_workers = static_cast<uint32_t>(std::min<size_t>(thread_count, count)) - 1;
+		busy_workers = loop_workers;
+		generation++;
+	}
+	wake.notify_all();
+
+	current_pool = this;
+	Work();
+	current_pool = nullptr;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return busy_workers == 0; });
+	this->task = nullptr;
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void ThreadPool::WorkerMain(uint32_t index)
+{
+	current_pool = this;
+	uint64_t seen_generation = 0;
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		wake.wait(lock, [&] { return stopping || generation != seen_generation; });
+		if (stopping)
+			return;
+		seen_generation = generation;
+		// A loop doesn't start before every worker of the previous one is done, so none is missed
+		if (index >= loop_workers)
+			continue;
+
+		lock.unlock();
+		Work();
+		lock.lock();
+		if (--busy_workers == 0)
+			done.notify_one();
+	}
+}
+
+void ThreadPool::Work()
+{
+	for (size_t i = next++; i < count; i = next++) {
+		try
+		{
+			(*task)(i);
+		}
+		catch (...)
+		{
+			// Remaining indices are skipped once anything failed
+			std::lock_guard<std::mutex> lock(error_mutex);
+			if (!error)
+				error = std::current_exception();
+			next = count;
+		}
+	}
+}
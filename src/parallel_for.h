@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs task(i) for every i in [0, count) on up to thread_count threads, including the caller.
+// Indices are handed out one at a time, so uneven tasks balance. The first exception a task
+// throws is rethrown once every thread has stopped. A thread_count of 0 uses every hardware thread.
+// Starts and joins its threads on every call, per-frame work should use a ThreadPool instead.
+void ParallelFor(size_t count, uint32_t thread_count, const std::function<void(size_t)>& task);
+
+// Worker threads that live as long as the pool, for work that runs every frame.
+// ParallelFor has the same contract as the free function, the caller takes part in the work.
+// Calls from several threads run one after another, and a task calling back into its own pool
+// runs the nested loop inline instead of waiting on itself.
+class ThreadPool
+{
+public:
+	// thread_count includes the calling thread, 0 uses every hardware thread
+	explicit ThreadPool(uint32_t thread_count = 0);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(workers.size()) + 1; }
+	// A max_threads of 0 uses every thread of the pool
+	void ParallelFor(size_t count, const std::function<void(size_t)>& task, uint32_t max_threads = 0);
+
+private:
+	std::vector<std::thread> workers;
+	// Held for a whole loop, so only one runs at a time
+	std::mutex loop_mutex;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	uint64_t generation = 0;
+	bool stopping = false;
+	// Workers with an index below loop_workers take part in the current loop
+	uint32_t loop_workers = 0;
+	uint32_t busy_workers = 0;
+
+	const std::function<void(size_t)>* task = nullptr;
+	size_t count = 0;
+	std::atomic<size_t> next{ 0 };
+	std::mutex error_mutex;
+	std::exception_ptr error;
+
+	void WorkerMain(uint32_t index);
+	void Work();
+};
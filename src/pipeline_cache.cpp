@@ -0,0 +1,92 @@
+#include "pipeline_cache.h"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+bool PipelineCache::Load(const std::string& path)
+{
+	entries.clear();
+	dirty = false;
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	FileHeader header;
+	if (data.size() < sizeof(header))
+		return false;
+	memcpy(&header, data.data(), sizeof(header));
+	if (header.magic != magic || header.version != version)
+		return false;
+
+	size_t offset = sizeof(header);
+	for (uint64_t i = 0; i < header.count; i++) {
+		EntryHeader entry;
+		if (data.size() - offset < sizeof(entry))
+			break;
+		memcpy(&entry, data.data() + offset, sizeof(entry));
+		offset += sizeof(entry);
+		if (data.size() - offset < entry.size)
+			break;
+		entries[entry.key].assign(data.begin() + offset, data.begin() + offset + static_cast<size_t>(entry.size));
+		offset += static_cast<size_t>(entry.size);
+	}
+
+	// A truncated file is thrown away as a whole rather than trusted partially
+	if (entries.size() != header.count) {
+		entries.clear();
+		return false;
+	}
+	return true;
+}
+
+void PipelineCache::Save(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		throw std::runtime_error("Can't open " + path + " for writing");
+
+	FileHeader header = { magic, version, entries.size() };
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (const auto& entry : entries) {
+		EntryHeader entry_header = { entry.first, entry.second.size() };
+		file.write(reinterpret_cast<const char*>(&entry_header), sizeof(entry_header));
+		file.write(reinterpret_cast<const char*>(entry.second.data()), entry.second.size());
+	}
+	if (!file)
+		throw std::runtime_error("Failed to write " + path);
+}
+
+const std::vector<uint8_t>* PipelineCache::Find(uint64_t key)
+{
+	auto it = entries.find(key);
+	if (it == entries.end()) {
+		misses++;
+		return nullptr;
+	}
+	hits++;
+	return &it->second;
+}
+
+void PipelineCache::Store(uint64_t key, const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	entries[key].assign(bytes, bytes + size);
+	dirty = true;
+}
+
+void PipelineCache::Clear()
+{
+	dirty = dirty || !entries.empty();
+	entries.clear();
+}
+
+PipelineCache::Stats PipelineCache::GetStats() const
+{
+	Stats stats = { hits, misses, entries.size(), 0 };
+	for (const auto& entry : entries)
+		stats.bytes += entry.second.size();
+	return stats;
+}
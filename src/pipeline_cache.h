@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Incremental 64-bit FNV-1a hash for pipeline cache keys.
+// Values are hashed by their bytes, so structs must not contain padding or pointers.
+class Hasher
+{
+public:
+	Hasher& Add(const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= prime;
+		}
+		return *this;
+	}
+
+	template <class T>
+	Hasher& Add(const T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value && !std::is_pointer<T>::value, "Only plain values can be hashed");
+		return Add(&value, sizeof(value));
+	}
+
+	// Hashes the length too, so consecutive strings can't run into each other
+	Hasher& AddString(const char* string)
+	{
+		const size_t length = string ? strlen(string) : 0;
+		Add(length);
+		return Add(string, length);
+	}
+
+	uint64_t Get() const { return hash; }
+
+private:
+	static const uint64_t offset_basis = 0xcbf29ce484222325ull;
+	static const uint64_t prime = 0x100000001b3ull;
+	uint64_t hash = offset_basis;
+};
+
+// Blobs keyed by 64-bit hashes that persist across runs in a single file:
+// serialized root signatures, cached pipeline states or a whole driver pipeline library.
+// A missing, outdated or corrupted file just starts an empty cache.
+class PipelineCache
+{
+public:
+	static const uint32_t magic = 'D' | ('X' << 8) | ('P' << 16) | ('C' << 24);
+	static const uint32_t version = 1;
+
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		size_t entries;
+		uint64_t bytes;
+	};
+
+	// Returns false and leaves the cache empty if the file can't be used
+	bool Load(const std::string& path);
+	// Throws std::runtime_error if the file can't be written
+	void Save(const std::string& path) const;
+
+	// Returns nullptr on a miss, the blob stays valid until the key is stored again or the cache is cleared
+	const std::vector<uint8_t>* Find(uint64_t key);
+	void Store(uint64_t key, const void* data, size_t size);
+	void Clear();
+
+	// Only the stored content, hit and miss counters are not persisted
+	bool IsDirty() const { return dirty; }
+	Stats GetStats() const;
+
+private:
+	struct FileHeader { uint32_t magic; uint32_t version; uint64_t count; };
+	struct EntryHeader { uint64_t key; uint64_t size; };
+
+	std::unordered_map<uint64_t, std::vector<uint8_t>> entries;
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	bool dirty = false;
+};
@@ -0,0 +1,175 @@
+#include "pvs.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace
+{
+	// Bounds a baker can reasonably fill, and that keep cell numbers in 32 bits
+	const uint64_t max_cell_count = 1u << 24;
+}
+
+void PotentiallyVisibleSet::Reset(const Aabb& bounds, float cell_size, uint32_t shape_count)
+{
+	if (!(cell_size > 0.f))
+		throw std::invalid_argument("Potentially visible set cells must have a size");
+	uint32_t cells[3];
+	for (int axis = 0; axis < 3; axis++) {
+		const float size = bounds.max[axis] - bounds.min[axis];
+		if (!(size >= 0.f))
+			throw std::invalid_argument("Potentially visible set bounds are inverted");
+		const float count = std::ceil(size / cell_size);
+		if (count > static_cast<float>(max_cell_count))
+			throw std::invalid_argument("Potentially visible set has too many cells, use larger ones");
+		cells[axis] = count < 1.f ? 1 : static_cast<uint32_t>(count);
+	}
+	if (!Allocate(bounds.min, cells, cell_size, shape_count, SIZE_MAX))
+		throw std::invalid_argument("Potentially visible set has too many cells, use larger ones");
+}
+
+bool PotentiallyVisibleSet::Allocate(const float* min, const uint32_t* cells, float cell_size, uint32_t shape_count, uint64_t max_size)
+{
+	uint64_t count = 1;
+	for (int axis = 0; axis < 3; axis++)
+		count *= cells[axis];
+	if (count == 0 || count > max_cell_count || !(cell_size > 0.f))
+		return false;
+	// In 64 bits, shape counts near 2^32 would wrap to no bytes at all
+	const uint64_t cell_bytes = (static_cast<uint64_t>(shape_count) + 7) / 8;
+	if (count * cell_bytes > max_size || count * cell_bytes > SIZE_MAX)
+		return false;
+
+	// The grid covers the bounds with whole cells
+	for (int axis = 0; axis < 3; axis++) {
+		this->cells[axis] = cells[axis];
+		bounds.min[axis] = min[axis];
+		bounds.max[axis] = min[axis] + cells[axis] * cell_size;
+	}
+	this->cell_size = cell_size;
+	this->shape_count = shape_count;
+	cell_count = static_cast<uint32_t>(count);
+	bytes_per_cell = static_cast<uint32_t>(cell_bytes);
+	bits.assign(static_cast<size_t>(cell_count) * bytes_per_cell, 0);
+	return true;
+}
+
+uint32_t PotentiallyVisibleSet::FindCell(float x, float y, float z) const
+{
+	const float position[3] = { x, y, z };
+	uint32_t index[3];
+	for (int axis = 0; axis < 3; axis++) {
+		const float cell = std::floor((position[axis] - bounds.min[axis]) / cell_size);
+		if (!(cell >= 0.f) || cell >= static_cast<float>(cells[axis]))
+			return no_cell;
+		index[axis] = static_cast<uint32_t>(cell);
+	}
+	return (index[2] * cells[1] + index[1]) * cells[0] + index[0];
+}
+
+Aabb PotentiallyVisibleSet::GetCellBounds(uint32_t cell) const
+{
+	const uint32_t index[3] = { cell % cells[0], cell / cells[0] % cells[1], cell / cells[0] / cells[1] };
+	Aabb cell_bounds;
+	for (int axis = 0; axis < 3; axis++) {
+		cell_bounds.min[axis] = bounds.min[axis] + index[axis] * cell_size;
+		cell_bounds.max[axis] = cell_bounds.min[axis] + cell_size;
+	}
+	return cell_bounds;
+}
+
+void PotentiallyVisibleSet::Compress(std::vector<uint8_t>& data) const
+{
+	data.clear();
+	for (size_t i = 0; i < bits.size();) {
+		const uint8_t value = Difference(i);
+		if (value != 0) {
+			data.push_back(value);
+			i++;
+			continue;
+		}
+		uint8_t run = 0;
+		while (i < bits.size() && Difference(i) == 0 && run < 255) {
+			run++;
+			i++;
+		}
+		data.push_back(0);
+		data.push_back(run);
+	}
+}
+
+bool PotentiallyVisibleSet::Decompress(const uint8_t* data, size_t size)
+{
+	// Differences are written first and applied once the whole stream decoded, bits starts zeroed
+	size_t written = 0;
+	for (size_t i = 0; i < size; i++) {
+		if (data[i] != 0) {
+			if (written == bits.size())
+				return false;
+			bits[written++] = data[i];
+			continue;
+		}
+		if (++i == size || data[i] == 0 || bits.size() - written < data[i])
+			return false;
+		written += data[i];
+	}
+	if (written != bits.size())
+		return false;
+	for (size_t i = bytes_per_cell; i < bits.size(); i++)
+		bits[i] ^= bits[i - bytes_per_cell];
+	return true;
+}
+
+size_t PotentiallyVisibleSet::GetCompressedSize() const
+{
+	std::vector<uint8_t> data;
+	Compress(data);
+	return data.size();
+}
+
+bool PotentiallyVisibleSet::Load(const std::string& path)
+{
+	*this = PotentiallyVisibleSet();
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	FileHeader header;
+	if (data.size() < sizeof(header))
+		return false;
+	memcpy(&header, data.data(), sizeof(header));
+	if (header.magic != magic || header.version != version || data.size() - sizeof(header) != header.data_size)
+		return false;
+
+	// A corrupt header mustn't allocate more than the data can expand to, a zero byte and its
+	// run length expand to at most 255 bytes and any other byte to one
+	const uint64_t max_size = header.data_size / 2 * 255 + header.data_size % 2;
+	// Whatever doesn't match the header exactly is thrown away as a whole
+	if (!Allocate(header.bounds_min, header.cells, header.cell_size, header.shape_count, max_size)
+		|| !Decompress(data.data() + sizeof(header), static_cast<size_t>(header.data_size))) {
+		*this = PotentiallyVisibleSet();
+		return false;
+	}
+	return true;
+}
+
+void PotentiallyVisibleSet::Save(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		throw std::runtime_error("Can't open " + path + " for writing");
+
+	std::vector<uint8_t> data;
+	Compress(data);
+	FileHeader header = { magic, version, shape_count, { cells[0], cells[1], cells[2] },
+		{ bounds.min[0], bounds.min[1], bounds.min[2] }, cell_size, data.size() };
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	if (!file)
+		throw std::runtime_error("Failed to write " + path);
+}
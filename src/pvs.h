@@ -0,0 +1,70 @@
+#pragma once
+
+#include "frustum_culler.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Potentially visible set of a static scene: the space the camera moves in is split into a grid
+// of cells and every cell holds a bit per shape seen from anywhere in it. Files keep the bitsets
+// compressed, Load expands them so lookups are a shift and a mask.
+class PotentiallyVisibleSet
+{
+public:
+	static const uint32_t magic = 'D' | ('X' << 8) | ('P' << 16) | ('V' << 24);
+	static const uint32_t version = 1;
+	static const uint32_t no_cell = ~0u;
+
+	// Every shape starts hidden from every cell
+	void Reset(const Aabb& bounds, float cell_size, uint32_t shape_count);
+
+	// Returns false and leaves the set empty if the file can't be used
+	bool Load(const std::string& path);
+	// Throws std::runtime_error if the file can't be written
+	void Save(const std::string& path) const;
+	bool IsEmpty() const { return cell_count == 0; }
+
+	// no_cell outside the bounds, where nothing is known
+	uint32_t FindCell(float x, float y, float z) const;
+	bool IsVisible(uint32_t cell, uint32_t shape) const { return (bits[static_cast<size_t>(cell) * bytes_per_cell + shape / 8] >> (shape % 8)) & 1; }
+	void SetVisible(uint32_t cell, uint32_t shape) { bits[static_cast<size_t>(cell) * bytes_per_cell + shape / 8] |= static_cast<uint8_t>(1u << (shape % 8)); }
+
+	const Aabb& GetBounds() const { return bounds; }
+	// Bounds of a cell, cells are numbered x fastest, then y, then z
+	Aabb GetCellBounds(uint32_t cell) const;
+	float GetCellSize() const { return cell_size; }
+	uint32_t GetCellCount() const { return cell_count; }
+	uint32_t GetShapeCount() const { return shape_count; }
+	// Size of the bitsets as Save compresses them
+	size_t GetCompressedSize() const;
+	size_t GetUncompressedSize() const { return bits.size(); }
+
+private:
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t shape_count;
+		uint32_t cells[3];
+		float bounds_min[3];
+		float cell_size;
+		uint64_t data_size;
+	};
+
+	Aabb bounds = {};
+	float cell_size = 0.f;
+	uint32_t cells[3] = {};
+	uint32_t cell_count = 0;
+	uint32_t shape_count = 0;
+	uint32_t bytes_per_cell = 0;
+	std::vector<uint8_t> bits;
+
+	// Fails rather than allocating more than max_size bytes of bitsets
+	bool Allocate(const float* min, const uint32_t* cells, float cell_size, uint32_t shape_count, uint64_t max_size);
+	// Neighbouring cells mostly see the same shapes, files store each cell's difference from the
+	// previous one. A zero byte is followed by the length of the run of zero bytes it starts.
+	uint8_t Difference(size_t i) const { return i < bytes_per_cell ? bits[i] : bits[i] ^ bits[i - bytes_per_cell]; }
+	void Compress(std::vector<uint8_t>& data) const;
+	bool Decompress(const uint8_t* data, size_t size);
+};
@@ -0,0 +1,103 @@
+#include "pvs_baker.h"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Bakes the potentially visible set of a model for the renderer, headless so it runs on build machines.
+// Shapes are numbered like the renderer's draws: in file order, skipping shapes without faces.
+int main(int argc, char** argv)
+{
+	const char* model_path = nullptr;
+	const char* output = nullptr;
+	// In model units, the camera may leave the model by margin on every side
+	float cell_size = .25f;
+	float margin = 1.f;
+	PvsBaker::Settings settings = {};
+	settings.samples_per_cell = 16;
+	settings.targets_per_shape = 32;
+	settings.seed = 1;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+			output = argv[++i];
+		else if (strcmp(argv[i], "--cell-size") == 0 && i + 1 < argc)
+			cell_size = static_cast<float>(atof(argv[++i]));
+		else if (strcmp(argv[i], "--margin") == 0 && i + 1 < argc)
+			margin = std::max(0.f, static_cast<float>(atof(argv[++i])));
+		else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+			settings.samples_per_cell = static_cast<uint32_t>(std::max(1, atoi(argv[++i])));
+		else if (strcmp(argv[i], "--targets") == 0 && i + 1 < argc)
+			settings.targets_per_shape = static_cast<uint32_t>(std::max(0, atoi(argv[++i])));
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			settings.thread_count = static_cast<uint32_t>(std::max(1, atoi(argv[++i])));
+		else if (!model_path)
+			model_path = argv[i];
+	}
+
+	if (!model_path || !output) {
+		printf("Usage: %s [--cell-size S] [--margin M] [--samples N] [--targets N] [--threads N] --output <pvs file> <model.obj>\n", argv[0]);
+		return 1;
+	}
+
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn;
+	std::string err;
+	std::string directory(model_path);
+	directory = directory.substr(0, directory.find_last_of("/\\") + 1);
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, model_path, directory.c_str())) {
+		printf("Can't load %s: %s\n", model_path, err.c_str());
+		return 1;
+	}
+
+	try
+	{
+		PvsBaker baker;
+		Aabb bounds = { { INFINITY, INFINITY, INFINITY }, { -INFINITY, -INFINITY, -INFINITY } };
+		std::vector<float> positions;
+		for (const tinyobj::shape_t& shape : shapes) {
+			positions.clear();
+			for (const tinyobj::index_t& index : shape.mesh.indices) {
+				for (int axis = 0; axis < 3; axis++) {
+					const float value = attrib.vertices[3 * index.vertex_index + axis];
+					positions.push_back(value);
+					bounds.min[axis] = std::min(bounds.min[axis], value);
+					bounds.max[axis] = std::max(bounds.max[axis], value);
+				}
+			}
+			if (!positions.empty())
+				baker.AddShape(positions.data(), positions.size() / 3);
+		}
+		if (baker.GetShapeCount() == 0) {
+			printf("%s has no faces\n", model_path);
+			return 1;
+		}
+
+		for (int axis = 0; axis < 3; axis++) {
+			settings.bounds.min[axis] = bounds.min[axis] - margin;
+			settings.bounds.max[axis] = bounds.max[axis] + margin;
+		}
+		settings.cell_size = cell_size;
+		const PotentiallyVisibleSet pvs = baker.Bake(settings);
+		pvs.Save(output);
+
+		const PvsBaker::Stats& stats = baker.GetStats();
+		printf("%u shapes, %u cells of %g, %.2f shapes visible per cell\n", baker.GetShapeCount(), pvs.GetCellCount(), pvs.GetCellSize(),
+			static_cast<double>(stats.visible_pairs) / pvs.GetCellCount());
+		printf("%llu rays in %.0f ms, %.2f Mrays/s\n", static_cast<unsigned long long>(stats.rays), stats.bake_ms,
+			stats.bake_ms > 0 ? stats.rays / stats.bake_ms / 1000.0 : 0.0);
+		printf("%zu bytes of bitsets compressed to %zu\n", pvs.GetUncompressedSize(), pvs.GetCompressedSize());
+	}
+	catch (const std::exception& e)
+	{
+		printf("%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,276 @@
+#include "pvs_baker.h"
+
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+namespace
+{
+	const uint32_t max_leaf_triangles = 4;
+	// Hits this close to either end of a ray belong to the surfaces it connects
+	const float ray_epsilon = 1e-4f;
+
+	struct Target
+	{
+		float position[3];
+		uint32_t triangle;
+	};
+
+	void Cross(const float* a, const float* b, float* result)
+	{
+		result[0] = a[1] * b[2] - a[2] * b[1];
+		result[1] = a[2] * b[0] - a[0] * b[2];
+		result[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	float Dot(const float* a, const float* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// Slab test of the segment origin + t * direction, 0 <= t <= 1
+	bool IntersectsSegment(const Aabb& box, const float* origin, const float* inverse_direction)
+	{
+		float t_min = 0.f;
+		float t_max = 1.f;
+		for (int axis = 0; axis < 3; axis++) {
+			float t0 = (box.min[axis] - origin[axis]) * inverse_direction[axis];
+			float t1 = (box.max[axis] - origin[axis]) * inverse_direction[axis];
+			if (t0 > t1)
+				std::swap(t0, t1);
+			// NaN from a zero direction on the slab's plane keeps the previous bounds
+			t_min = t0 > t_min ? t0 : t_min;
+			t_max = t1 < t_max ? t1 : t_max;
+			if (t_min > t_max)
+				return false;
+		}
+		return true;
+	}
+}
+
+void PvsBaker::AddShape(const float* positions, size_t vertex_count)
+{
+	if (vertex_count % 3 != 0)
+		throw std::invalid_argument("Shapes are triangle lists");
+
+	shape_first_triangle.push_back(static_cast<uint32_t>(triangles.size()));
+	for (size_t i = 0; i < vertex_count; i += 3) {
+		const float* v0 = positions + i * 3;
+		Triangle triangle;
+		for (int axis = 0; axis < 3; axis++) {
+			triangle.v0[axis] = v0[axis];
+			triangle.edge1[axis] = v0[3 + axis] - v0[axis];
+			triangle.edge2[axis] = v0[6 + axis] - v0[axis];
+		}
+		triangles.push_back(triangle);
+	}
+	nodes.clear();
+}
+
+void PvsBaker::BuildBvh()
+{
+	node_triangles.resize(triangles.size());
+	for (uint32_t i = 0; i < triangles.size(); i++)
+		node_triangles[i] = i;
+	nodes.clear();
+	nodes.push_back({});
+	BuildNode(0, 0, static_cast<uint32_t>(triangles.size()));
+}
+
+void PvsBaker::BuildNode(uint32_t node, uint32_t first, uint32_t count)
+{
+	Aabb bounds = { { INFINITY, INFINITY, INFINITY }, { -INFINITY, -INFINITY, -INFINITY } };
+	Aabb centers = bounds;
+	for (uint32_t i = first; i < first + count; i++) {
+		const Triangle& triangle = triangles[node_triangles[i]];
+		for (int axis = 0; axis < 3; axis++) {
+			const float a = triangle.v0[axis];
+			const float b = a + triangle.edge1[axis];
+			const float c = a + triangle.edge2[axis];
+			bounds.min[axis] = std::min(bounds.min[axis], std::min(a, std::min(b, c)));
+			bounds.max[axis] = std::max(bounds.max[axis], std::max(a, std::max(b, c)));
+			const float center = (a + b + c) / 3.f;
+			centers.min[axis] = std::min(centers.min[axis], center);
+			centers.max[axis] = std::max(centers.max[axis], center);
+		}
+	}
+	nodes[node].bounds = bounds;
+
+	int axis = 0;
+	for (int i = 1; i < 3; i++) {
+		if (centers.max[i] - centers.min[i] > centers.max[axis] - centers.min[axis])
+			axis = i;
+	}
+	if (count <= max_leaf_triangles || centers.max[axis] == centers.min[axis]) {
+		nodes[node].first = first;
+		nodes[node].triangle_count = count;
+		return;
+	}
+
+	// Median split along the axis the centers spread most on
+	const uint32_t half = count / 2;
+	auto center = [this, axis](uint32_t index) {
+		const Triangle& triangle = triangles[index];
+		return 3.f * triangle.v0[axis] + triangle.edge1[axis] + triangle.edge2[axis];
+	};
+	std::nth_element(node_triangles.begin() + first, node_triangles.begin() + first + half, node_triangles.begin() + first + count,
+		[&center](uint32_t a, uint32_t b) { return center(a) < center(b); });
+
+	const uint32_t children = static_cast<uint32_t>(nodes.size());
+	nodes[node].first = children;
+	nodes[node].triangle_count = 0;
+	nodes.push_back({});
+	nodes.push_back({});
+	BuildNode(children, first, half);
+	BuildNode(children + 1, first + half, count - half);
+}
+
+bool PvsBaker::IsBlocked(const float* from, const float* to, uint32_t ignored) const
+{
+	const float direction[3] = { to[0] - from[0], to[1] - from[1], to[2] - from[2] };
+	const float inverse_direction[3] = { 1.f / direction[0], 1.f / direction[1], 1.f / direction[2] };
+
+	uint32_t stack[64];
+	uint32_t stack_size = 0;
+	stack[stack_size++] = 0;
+	while (stack_size > 0) {
+		const Node& node = nodes[stack[--stack_size]];
+		if (!IntersectsSegment(node.bounds, from, inverse_direction))
+			continue;
+		if (node.triangle_count == 0) {
+			stack[stack_size++] = node.first;
+			stack[stack_size++] = node.first + 1;
+			continue;
+		}
+
+		for (uint32_t i = node.first; i < node.first + node.triangle_count; i++) {
+			const uint32_t index = node_triangles[i];
+			if (index == ignored)
+				continue;
+			// Moller-Trumbore, a positive determinant means the ray hits the front face
+			const Triangle& triangle = triangles[index];
+			float p[3];
+			Cross(direction, triangle.edge2, p);
+			const float determinant = Dot(triangle.edge1, p);
+			if (!(determinant > 0.f))
+				continue;
+			const float inverse_determinant = 1.f / determinant;
+			const float offset[3] = { from[0] - triangle.v0[0], from[1] - triangle.v0[1], from[2] - triangle.v0[2] };
+			const float u = Dot(offset, p) * inverse_determinant;
+			if (u < 0.f || u > 1.f)
+				continue;
+			float q[3];
+			Cross(offset, triangle.edge1, q);
+			const float v = Dot(direction, q) * inverse_determinant;
+			if (v < 0.f || u + v > 1.f)
+				continue;
+			const float t = Dot(triangle.edge2, q) * inverse_determinant;
+			if (t > ray_epsilon && t < 1.f - ray_epsilon)
+				return true;
+		}
+	}
+	return false;
+}
+
+PotentiallyVisibleSet PvsBaker::Bake(const Settings& settings)
+{
+	const auto start = std::chrono::steady_clock::now();
+	stats = {};
+	PotentiallyVisibleSet pvs;
+	pvs.Reset(settings.bounds, settings.cell_size, GetShapeCount());
+	if (triangles.empty())
+		return pvs;
+	BuildBvh();
+
+	// The same targets serve every cell: every triangle's center and random points weighted by area
+	std::mt19937 target_random(settings.seed);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+	std::vector<std::vector<Target>> targets(GetShapeCount());
+	for (uint32_t shape = 0; shape < GetShapeCount(); shape++) {
+		const uint32_t first = shape_first_triangle[shape];
+		const uint32_t last = shape + 1 < GetShapeCount() ? shape_first_triangle[shape + 1] : static_cast<uint32_t>(triangles.size());
+		std::vector<float> cumulative_area;
+		float area = 0.f;
+		for (uint32_t i = first; i < last; i++) {
+			const Triangle& triangle = triangles[i];
+			float normal[3];
+			Cross(triangle.edge1, triangle.edge2, normal);
+			area += std::sqrt(Dot(normal, normal));
+			cumulative_area.push_back(area);
+			targets[shape].push_back({ { triangle.v0[0] + (triangle.edge1[0] + triangle.edge2[0]) / 3.f,
+				triangle.v0[1] + (triangle.edge1[1] + triangle.edge2[1]) / 3.f, triangle.v0[2] + (triangle.edge1[2] + triangle.edge2[2]) / 3.f }, i });
+		}
+		for (uint32_t target = 0; target < settings.targets_per_shape && area > 0.f; target++) {
+			const size_t offset = std::lower_bound(cumulative_area.begin(), cumulative_area.end(), unit(target_random) * area) - cumulative_area.begin();
+			const uint32_t index = first + static_cast<uint32_t>(std::min(offset, cumulative_area.size() - 1));
+			const Triangle& triangle = triangles[index];
+			// Uniform over the triangle, points past the diagonal are mirrored back
+			float u = unit(target_random);
+			float v = unit(target_random);
+			if (u + v > 1.f) {
+				u = 1.f - u;
+				v = 1.f - v;
+			}
+			targets[shape].push_back({ { triangle.v0[0] + u * triangle.edge1[0] + v * triangle.edge2[0],
+				triangle.v0[1] + u * triangle.edge1[1] + v * triangle.edge2[1], triangle.v0[2] + u * triangle.edge1[2] + v * triangle.edge2[2] }, index });
+		}
+	}
+
+	std::atomic<uint64_t> rays(0);
+	std::atomic<uint64_t> visible_pairs(0);
+	ParallelFor(pvs.GetCellCount(), settings.thread_count, [&](size_t cell) {
+		// Seeded per cell so the result doesn't depend on which thread bakes it
+		std::mt19937 random(settings.seed ^ static_cast<uint32_t>(cell * 0x9e3779b9u));
+		const Aabb bounds = pvs.GetCellBounds(static_cast<uint32_t>(cell));
+		std::vector<std::array<float, 3>> samples;
+		for (uint32_t sample = 0; sample < std::max(settings.samples_per_cell, 8u); sample++) {
+			std::array<float, 3> point;
+			for (int axis = 0; axis < 3; axis++) {
+				const float t = sample < 8 ? static_cast<float>((sample >> axis) & 1) : unit(random);
+				point[axis] = bounds.min[axis] + t * (bounds.max[axis] - bounds.min[axis]);
+			}
+			samples.push_back(point);
+		}
+
+		uint64_t cell_rays = 0;
+		uint64_t cell_visible = 0;
+		for (uint32_t shape = 0; shape < GetShapeCount(); shape++) {
+			bool visible = false;
+			for (const Target& target : targets[shape]) {
+				const Triangle& triangle = triangles[target.triangle];
+				float normal[3];
+				Cross(triangle.edge1, triangle.edge2, normal);
+				for (const std::array<float, 3>& sample : samples) {
+					// Back faces aren't drawn, the target must face the sample
+					const float offset[3] = { sample[0] - triangle.v0[0], sample[1] - triangle.v0[1], sample[2] - triangle.v0[2] };
+					if (!(Dot(normal, offset) > 0.f))
+						continue;
+					cell_rays++;
+					if (!IsBlocked(sample.data(), target.position, target.triangle)) {
+						visible = true;
+						break;
+					}
+				}
+				if (visible)
+					break;
+			}
+			if (visible) {
+				pvs.SetVisible(static_cast<uint32_t>(cell), shape);
+				cell_visible++;
+			}
+		}
+		rays += cell_rays;
+		visible_pairs += cell_visible;
+	});
+
+	stats.rays = rays;
+	stats.visible_pairs = visible_pairs;
+	stats.bake_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return pvs;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "pvs.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bakes a PotentiallyVisibleSet by casting rays from points in every cell to points on every
+// shape. A shape is visible from a cell once one ray reaches it unblocked, cells bake in parallel.
+// Only front faces block rays and receive them, clockwise as seen from the ray's origin as in
+// the default rasterizer state, so shapes behind walls that are only drawn from inside stay
+// visible from outside. Visibility is sampled, shapes seen only through gaps narrower than the
+// samples can be missed.
+class PvsBaker
+{
+public:
+	struct Settings
+	{
+		// Space the camera can be in, in the shapes' coordinates
+		Aabb bounds;
+		float cell_size;
+		// Ray origins per cell, the first eight are its corners
+		uint32_t samples_per_cell;
+		// Ray targets per shape spread over its area, besides every triangle's center
+		uint32_t targets_per_shape;
+		uint32_t seed;
+		// 0 uses every hardware thread
+		uint32_t thread_count;
+	};
+
+	struct Stats
+	{
+		uint64_t rays;
+		// Visible shapes summed over the cells
+		uint64_t visible_pairs;
+		double bake_ms;
+	};
+
+	// Triangle list of tightly packed xyz positions, shapes are numbered in the order they are added
+	void AddShape(const float* positions, size_t vertex_count);
+	uint32_t GetShapeCount() const { return static_cast<uint32_t>(shape_first_triangle.size()); }
+
+	PotentiallyVisibleSet Bake(const Settings& settings);
+	const Stats& GetStats() const { return stats; }
+
+private:
+	struct Triangle
+	{
+		float v0[3];
+		float edge1[3];
+		float edge2[3];
+	};
+
+	struct Node
+	{
+		Aabb bounds;
+		// Leaves hold triangle_count entries of node_triangles from first, inner nodes have their children at first and first + 1
+		uint32_t first;
+		uint32_t triangle_count;
+	};
+
+	std::vector<Triangle> triangles;
+	std::vector<uint32_t> shape_first_triangle;
+	std::vector<Node> nodes;
+	// Triangle indices the leaves refer to, in BVH order
+	std::vector<uint32_t> node_triangles;
+	Stats stats = {};
+
+	void BuildBvh();
+	void BuildNode(uint32_t node, uint32_t first, uint32_t count);
+	// Whether a front face other than ignored lies strictly between from and to
+	bool IsBlocked(const float* from, const float* to, uint32_t ignored) const;
+};
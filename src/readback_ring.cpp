@@ -0,0 +1,83 @@
+#include "readback_ring.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+ReadbackRing::ReadbackRing(RHI::Device& device, uint32_t slot_count)
+	: device(device), slots(slot_count)
+{
+	if (slot_count == 0)
+		throw std::invalid_argument("Readback ring without slots");
+}
+
+std::future<ReadbackImage> ReadbackRing::ReadTexture(RHI::CommandList& list, RHI::Resource* texture, uint64_t fence_value)
+{
+	const RHI::ResourceDesc& desc = texture->GetDesc();
+	if (desc.dimension != RHI::ResourceDimension::Texture2D)
+		throw std::invalid_argument("Only 2D textures can be read back");
+	if (!HasFreeSlot())
+		throw std::runtime_error("Every readback slot is still in flight");
+
+	const uint32_t alignment = RHI::texture_data_pitch_alignment;
+	const uint64_t row_size = static_cast<uint64_t>(desc.width) * RHI::GetFormatSize(desc.format);
+	const uint32_t row_pitch = static_cast<uint32_t>((row_size + alignment - 1) & ~static_cast<uint64_t>(alignment - 1));
+	const uint64_t size = static_cast<uint64_t>(row_pitch) * desc.height;
+
+	// Slots grow to the largest texture they have seen and are only replaced while free
+	Slot& slot = slots[next_slot];
+	if (slot.size < size) {
+		slot.buffer = device.CreateBuffer(RHI::HeapType::Readback, size, RHI::ResourceState::CopyDest);
+		slot.size = size;
+	}
+	list.CopyTextureToBuffer(slot.buffer.get(), 0, row_pitch, texture);
+
+	pending.push_back({ fence_value, next_slot, row_pitch, desc, {} });
+	next_slot = (next_slot + 1) % static_cast<uint32_t>(slots.size());
+	return pending.back().promise.get_future();
+}
+
+size_t ReadbackRing::Poll(uint64_t completed_fence_value)
+{
+	size_t count = 0;
+	while (!pending.empty() && pending.front().fence_value <= completed_fence_value) {
+		Request request = std::move(pending.front());
+		pending.pop_front();
+
+		ReadbackImage image;
+		image.width = static_cast<uint32_t>(request.desc.width);
+		image.height = request.desc.height;
+		image.format = request.desc.format;
+		const size_t row_size = static_cast<size_t>(image.width) * RHI::GetFormatSize(image.format);
+		image.pixels.resize(row_size * image.height);
+
+		RHI::Resource* buffer = slots[request.slot].buffer.get();
+		const uint8_t* data = static_cast<const uint8_t*>(buffer->Map());
+		for (uint32_t row = 0; row < image.height; row++)
+			memcpy(image.pixels.data() + row_size * row, data + static_cast<size_t>(request.row_pitch) * row, row_size);
+		buffer->Unmap();
+
+		request.promise.set_value(std::move(image));
+		count++;
+	}
+	resolved_count += count;
+	return count;
+}
+
+void SaveImagePpm(const ReadbackImage& image, const std::string& path)
+{
+	if (image.format != RHI::Format::R8G8B8A8Unorm)
+		throw std::invalid_argument("Only R8G8B8A8 images can be saved as PPM");
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		throw std::runtime_error("Failed to open " + path);
+
+	file << "P6\n" << image.width << " " << image.height << "\n255\n";
+	std::vector<uint8_t> row(static_cast<size_t>(image.width) * 3);
+	for (uint32_t y = 0; y < image.height; y++) {
+		const uint8_t* pixel = image.pixels.data() + static_cast<size_t>(image.width) * 4 * y;
+		for (uint32_t x = 0; x < image.width; x++)
+			memcpy(&row[static_cast<size_t>(x) * 3], pixel + static_cast<size_t>(x) * 4, 3);
+		file.write(reinterpret_cast<const char*>(row.data()), row.size());
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "rhi.h"
+
+#include <deque>
+#include <future>
+#include <string>
+#include <vector>
+
+// Tightly packed copy of a 2D texture read back from the GPU
+struct ReadbackImage
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	RHI::Format format = RHI::Format::Unknown;
+	std::vector<uint8_t> pixels;
+};
+
+// Reads textures back without stalling the CPU on the GPU.
+// ReadTexture records a copy into one of a fixed number of readback-heap buffers and
+// returns a future; Poll resolves it once the fence value of the submission completes,
+// usually a few frames later. Copies are expected in non-decreasing fence value order.
+class ReadbackRing
+{
+public:
+	ReadbackRing(RHI::Device& device, uint32_t slot_count);
+
+	// The texture must be in the CopySource state and fence_value must be signaled after
+	// list is executed. Throws std::runtime_error when every slot is still pending.
+	std::future<ReadbackImage> ReadTexture(RHI::CommandList& list, RHI::Resource* texture, uint64_t fence_value);
+	bool HasFreeSlot() const { return pending.size() < slots.size(); }
+
+	// Resolves every copy with a fence value up to completed_fence_value, returns how many
+	size_t Poll(uint64_t completed_fence_value);
+
+	size_t GetPendingCount() const { return pending.size(); }
+	uint64_t GetResolvedCount() const { return resolved_count; }
+
+private:
+	struct Slot
+	{
+		std::unique_ptr<RHI::Resource> buffer;
+		uint64_t size = 0;
+	};
+
+	struct Request
+	{
+		uint64_t fence_value;
+		uint32_t slot;
+		uint32_t row_pitch;
+		RHI::ResourceDesc desc;
+		std::promise<ReadbackImage> promise;
+	};
+
+	RHI::Device& device;
+	std::vector<Slot> slots;
+	// Slots are reused in order, so the oldest pending request always owns the next slot
+	uint32_t next_slot = 0;
+	std::deque<Request> pending;
+	uint64_t resolved_count = 0;
+};
+
+// Writes an R8G8B8A8 image as a binary PPM, dropping alpha
+void SaveImagePpm(const ReadbackImage& image, const std::string& path);
@@ -0,0 +1,574 @@
+#include "render_graph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+	const uint32_t write_states = static_cast<uint32_t>(RHI::ResourceState::RenderTarget) | static_cast<uint32_t>(RHI::ResourceState::UnorderedAccess)
+		| static_cast<uint32_t>(RHI::ResourceState::DepthWrite) | static_cast<uint32_t>(RHI::ResourceState::CopyDest);
+
+	// States compute command lists may use and transition between
+	const uint32_t compute_states = static_cast<uint32_t>(RHI::ResourceState::VertexAndConstantBuffer)
+		| static_cast<uint32_t>(RHI::ResourceState::UnorderedAccess) | static_cast<uint32_t>(RHI::ResourceState::NonPixelShaderResource)
+		| static_cast<uint32_t>(RHI::ResourceState::CopyDest) | static_cast<uint32_t>(RHI::ResourceState::CopySource);
+
+	bool IsComputeState(RHI::ResourceState state)
+	{
+		return (static_cast<uint32_t>(state) & ~compute_states) == 0;
+	}
+
+	bool IsReadState(RHI::ResourceState state)
+	{
+		return state != RHI::ResourceState::Common && (static_cast<uint32_t>(state) & write_states) == 0;
+	}
+
+	// Read states combine, a resource in a combined read state serves each of them
+	bool Satisfies(RHI::ResourceState current, RHI::ResourceState required)
+	{
+		if (current == required)
+			return true;
+		return IsReadState(current) && IsReadState(required)
+			&& (static_cast<uint32_t>(current) & static_cast<uint32_t>(required)) == static_cast<uint32_t>(required);
+	}
+
+	RHI::ResourceState Combine(RHI::ResourceState a, RHI::ResourceState b)
+	{
+		return static_cast<RHI::ResourceState>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
+	}
+}
+
+RenderGraph::ResourceHandle RenderGraph::Import(const std::string& name, RHI::ResourceState initial_state, RHI::ResourceState final_state)
+{
+	Resource resource;
+	resource.name = name;
+	resource.imported = true;
+	resource.desc = {};
+	resource.initial_state = initial_state;
+	resource.final_state = final_state;
+	resources.push_back(std::move(resource));
+	compiled = false;
+	return static_cast<ResourceHandle>(resources.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::CreateTexture(const std::string& name, const TextureDesc& desc)
+{
+	if (desc.width == 0 || desc.height == 0 || RHI::GetFormatSize(desc.format) == 0)
+		throw std::invalid_argument("Transient texture " + name + " has no size or an unknown format");
+	Resource resource;
+	resource.name = name;
+	resource.imported = false;
+	resource.desc = desc;
+	resource.initial_state = RHI::ResourceState::Common;
+	resource.final_state = RHI::ResourceState::Common;
+	resources.push_back(std::move(resource));
+	compiled = false;
+	return static_cast<ResourceHandle>(resources.size() - 1);
+}
+
+RenderGraph::PassHandle RenderGraph::AddPass(const std::string& name, ExecuteFunction execute, Queue queue)
+{
+	Pass pass;
+	pass.name = name;
+	pass.execute = std::move(execute);
+	pass.queue = queue;
+	passes.push_back(std::move(pass));
+	compiled = false;
+	return static_cast<PassHandle>(passes.size() - 1);
+}
+
+void RenderGraph::Read(PassHandle pass, ResourceHandle resource, RHI::ResourceState state)
+{
+	if (!IsReadState(state))
+		throw std::invalid_argument("Reading " + resources.at(resource).name + " in a state that writes");
+	AddAccess(pass, resource, state, false);
+}
+
+void RenderGraph::Write(PassHandle pass, ResourceHandle resource, RHI::ResourceState state)
+{
+	AddAccess(pass, resource, state, true);
+}
+
+void RenderGraph::AddAccess(PassHandle pass, ResourceHandle resource, RHI::ResourceState state, bool write)
+{
+	if (resource >= resources.size())
+		throw std::out_of_range("Unknown render graph resource");
+	Pass& target = passes.at(pass);
+	if (target.queue == Queue::AsyncCompute && !IsComputeState(state))
+		throw std::invalid_argument("Async pass " + target.name + " uses " + resources[resource].name + " in a state compute queues don't support");
+	for (Access& access : target.accesses) {
+		if (access.resource != resource)
+			continue;
+		// Reads combine, anything involving a write needs a single state
+		if (access.state != state && (access.write || write))
+			throw std::logic_error("Pass " + target.name + " needs " + resources[resource].name + " in two incompatible states");
+		access.state = Combine(access.state, state);
+		access.write = access.write || write;
+		compiled = false;
+		return;
+	}
+	target.accesses.push_back({ resource, state, write });
+	compiled = false;
+}
+
+void RenderGraph::Reset()
+{
+	resources.clear();
+	passes.clear();
+	order.clear();
+	segments.clear();
+	barriers.clear();
+	heap.reset();
+	stats = {};
+	compiled = false;
+}
+
+void RenderGraph::Compile(RHI::Device& device)
+{
+	// The previous compilation's textures go away, the GPU must be done with them
+	for (Resource& resource : resources) {
+		resource.texture.reset();
+		resource.size = 0;
+		resource.heap_offset = ~0ull;
+		resource.first_use = ~0u;
+		resource.last_use = 0;
+		resource.aliased = false;
+		if (!resource.imported)
+			resource.physical = nullptr;
+	}
+	heap.reset();
+	stats = {};
+
+	Cull();
+	BuildSegments();
+	PlaceTransients(device);
+	PlaceBarriers();
+	SynchronizeQueues();
+
+	if (stats.heap_bytes > 0)
+		heap = device.CreateTextureHeap(stats.heap_bytes);
+	for (Resource& resource : resources) {
+		if (resource.imported || resource.heap_offset == ~0ull)
+			continue;
+		// Created in the state the frame leaves it in, so every frame starts the same way
+		resource.texture = device.CreatePlacedTexture2D(heap.get(), resource.heap_offset, resource.desc.width, resource.desc.height,
+			resource.desc.format, resource.initial_state);
+		resource.physical = resource.texture.get();
+	}
+	compiled = true;
+}
+
+void RenderGraph::Cull()
+{
+	// Walk backwards keeping passes that produce something a kept pass uses
+	std::vector<bool> needed(resources.size(), false);
+	for (size_t i = passes.size(); i-- > 0;) {
+		Pass& pass = passes[i];
+		bool writes = false;
+		bool live = false;
+		for (const Access& access : pass.accesses) {
+			if (!access.write)
+				continue;
+			writes = true;
+			live = live || resources[access.resource].imported || needed[access.resource];
+		}
+		pass.culled = writes && !live;
+		if (pass.culled)
+			continue;
+		// Writes count too, a pass may blend into what earlier passes wrote
+		for (const Access& access : pass.accesses)
+			needed[access.resource] = true;
+	}
+
+	order.clear();
+	for (PassHandle i = 0; i < passes.size(); i++) {
+		if (passes[i].culled) {
+			stats.culled_passes++;
+			continue;
+		}
+		for (const Access& access : passes[i].accesses) {
+			Resource& resource = resources[access.resource];
+			if (resource.first_use == ~0u) {
+				if (!resource.imported && !access.write)
+					throw std::logic_error("Pass " + passes[i].name + " reads " + resource.name + " before any pass writes it");
+				resource.first_use = static_cast<uint32_t>(order.size());
+			}
+			resource.last_use = static_cast<uint32_t>(order.size());
+		}
+		order.push_back(i);
+	}
+	stats.passes = static_cast<uint32_t>(order.size());
+}
+
+void RenderGraph::BuildSegments()
+{
+	segments.clear();
+	auto add_segment = [this](Queue queue, uint32_t first_pass) {
+		segments.push_back({ queue, first_pass, 0, ~0u, false, 0, 0 });
+	};
+
+	// Graphics segments bracket the async ones, transitions async passes can't make go into the
+	// graphics segment before them and the last one waits for all async work
+	if (!order.empty() && passes[order.front()].queue == Queue::AsyncCompute)
+		add_segment(Queue::Graphics, 0);
+	for (uint32_t i = 0; i < order.size(); i++) {
+		Pass& pass = passes[order[i]];
+		if (segments.empty() || segments.back().queue != pass.queue)
+			add_segment(pass.queue, i);
+		segments.back().pass_count++;
+		pass.segment = static_cast<uint32_t>(segments.size() - 1);
+		if (pass.queue == Queue::AsyncCompute)
+			stats.async_passes++;
+	}
+	if (segments.empty() || segments.back().queue == Queue::AsyncCompute)
+		add_segment(Queue::Graphics, static_cast<uint32_t>(order.size()));
+	stats.segments = static_cast<uint32_t>(segments.size());
+}
+
+void RenderGraph::PlaceTransients(RHI::Device& device)
+{
+	// The queues overlap async passes with passes anywhere around them, so what they use lives all frame
+	for (PassHandle pass : order) {
+		if (passes[pass].queue != Queue::AsyncCompute)
+			continue;
+		for (const Access& access : passes[pass].accesses) {
+			resources[access.resource].first_use = 0;
+			resources[access.resource].last_use = static_cast<uint32_t>(order.size() - 1);
+		}
+	}
+
+	std::vector<ResourceHandle> transients;
+	for (ResourceHandle i = 0; i < resources.size(); i++) {
+		Resource& resource = resources[i];
+		if (resource.imported || resource.first_use == ~0u)
+			continue;
+		resource.size = device.GetTexture2DAllocationSize(resource.desc.width, resource.desc.height, resource.desc.format);
+		stats.transient_textures++;
+		stats.transient_bytes += resource.size;
+		transients.push_back(i);
+	}
+
+	// Largest first packs tighter, each goes to the lowest offset free for its whole lifetime
+	std::stable_sort(transients.begin(), transients.end(), [&](ResourceHandle a, ResourceHandle b) { return resources[a].size > resources[b].size; });
+	std::vector<ResourceHandle> placed;
+	std::vector<std::pair<uint64_t, uint64_t>> occupied;
+	for (ResourceHandle handle : transients) {
+		Resource& resource = resources[handle];
+		occupied.clear();
+		for (ResourceHandle other_handle : placed) {
+			const Resource& other = resources[other_handle];
+			if (other.first_use <= resource.last_use && resource.first_use <= other.last_use)
+				occupied.push_back({ other.heap_offset, other.heap_offset + other.size });
+		}
+		std::sort(occupied.begin(), occupied.end());
+
+		uint64_t offset = 0;
+		for (const std::pair<uint64_t, uint64_t>& range : occupied) {
+			if (offset + resource.size <= range.first)
+				break;
+			if (range.second > offset)
+				offset = (range.second + RHI::default_placement_alignment - 1) / RHI::default_placement_alignment * RHI::default_placement_alignment;
+		}
+		resource.heap_offset = offset;
+		if (offset + resource.size > stats.heap_bytes)
+			stats.heap_bytes = offset + resource.size;
+
+		for (ResourceHandle other_handle : placed) {
+			Resource& other = resources[other_handle];
+			if (other.heap_offset < offset + resource.size && offset < other.heap_offset + other.size) {
+				other.aliased = true;
+				resource.aliased = true;
+			}
+		}
+		placed.push_back(handle);
+	}
+}
+
+void RenderGraph::PlaceBarriers()
+{
+	struct Use
+	{
+		uint32_t pass;
+		RHI::ResourceState state;
+		bool write;
+		// Reads transition straight to every read state used until the next write, the ones
+		// compute queues support when the transition is on the compute queue
+		RHI::ResourceState merged;
+	};
+
+	std::vector<std::vector<Use>> uses(resources.size());
+	for (uint32_t i = 0; i < order.size(); i++) {
+		for (const Access& access : passes[order[i]].accesses)
+			uses[access.resource].push_back({ i, access.state, access.write, access.state });
+	}
+	for (std::vector<Use>& resource_uses : uses) {
+		RHI::ResourceState reads = RHI::ResourceState::Common;
+		for (size_t i = resource_uses.size(); i-- > 0;) {
+			Use& use = resource_uses[i];
+			if (use.write) {
+				reads = RHI::ResourceState::Common;
+				continue;
+			}
+			reads = Combine(reads, use.state);
+			use.merged = reads;
+			if (passes[order[use.pass]].queue == Queue::AsyncCompute)
+				use.merged = static_cast<RHI::ResourceState>(static_cast<uint32_t>(reads) & compute_states);
+		}
+	}
+
+	// Transients start each frame in the state the previous frame left them in
+	std::vector<RHI::ResourceState> current(resources.size());
+	for (ResourceHandle i = 0; i < resources.size(); i++) {
+		Resource& resource = resources[i];
+		if (resource.imported || uses[i].empty()) {
+			current[i] = resource.initial_state;
+			continue;
+		}
+		RHI::ResourceState state = uses[i].front().merged;
+		for (const Use& use : uses[i]) {
+			if (!Satisfies(state, use.state))
+				state = use.merged;
+		}
+		// Except those an async pass uses first, which start in its state. Transitioning them out of
+		// graphics-only states would hold the async pass back until graphics work before it is done.
+		if (passes[order[uses[i].front().pass]].queue == Queue::AsyncCompute)
+			state = uses[i].front().merged;
+		resource.initial_state = state;
+		resource.final_state = state;
+		current[i] = state;
+	}
+
+	barriers.clear();
+	// Transitions out of graphics-only states, by the segment that issues them
+	std::vector<std::vector<Barrier>> hoisted(segments.size());
+	std::vector<size_t> next_use(resources.size(), 0);
+	for (uint32_t i = 0; i < order.size(); i++) {
+		Pass& pass = passes[order[i]];
+		pass.first_barrier = static_cast<uint32_t>(barriers.size());
+		// Aliasing barriers go first in the batch, ahead of the transitions of the same textures
+		for (const Access& access : pass.accesses) {
+			const Resource& resource = resources[access.resource];
+			if (resource.aliased && resource.first_use == i) {
+				barriers.push_back({ access.resource, RHI::ResourceState::Common, RHI::ResourceState::Common, RHI::ResourceBarrierType::Aliasing });
+				stats.aliasing_barriers++;
+			}
+		}
+		for (const Access& access : pass.accesses) {
+			const Use& use = uses[access.resource][next_use[access.resource]++];
+			RHI::ResourceState& state = current[access.resource];
+			if (Satisfies(state, use.state))
+				continue;
+			// The graphics segment before this async one ends with no other use of the resource in between
+			if (pass.queue == Queue::AsyncCompute && !IsComputeState(state))
+				hoisted[pass.segment - 1].push_back({ access.resource, state, use.merged, RHI::ResourceBarrierType::Transition });
+			else
+				barriers.push_back({ access.resource, state, use.merged, RHI::ResourceBarrierType::Transition });
+			state = use.merged;
+		}
+		pass.barrier_count = static_cast<uint32_t>(barriers.size()) - pass.first_barrier;
+		if (pass.barrier_count > 0)
+			stats.barrier_batches++;
+	}
+
+	for (uint32_t i = 0; i < segments.size(); i++) {
+		segments[i].first_barrier = static_cast<uint32_t>(barriers.size());
+		segments[i].barrier_count = static_cast<uint32_t>(hoisted[i].size());
+		barriers.insert(barriers.end(), hoisted[i].begin(), hoisted[i].end());
+		if (!hoisted[i].empty())
+			stats.barrier_batches++;
+	}
+
+	final_barrier = static_cast<uint32_t>(barriers.size());
+	for (ResourceHandle i = 0; i < resources.size(); i++) {
+		if (current[i] != resources[i].final_state)
+			barriers.push_back({ i, current[i], resources[i].final_state, RHI::ResourceBarrierType::Transition });
+	}
+	if (barriers.size() > final_barrier)
+		stats.barrier_batches++;
+	stats.barriers = static_cast<uint32_t>(barriers.size());
+}
+
+void RenderGraph::SynchronizeQueues()
+{
+	// Each pass waits for the last pass on the other queue that used its resources, earlier ones
+	// finished before that one
+	std::vector<uint32_t> awaited(order.size(), ~0u);
+	std::vector<uint32_t> last_use(resources.size(), ~0u);
+	for (uint32_t i = 0; i < order.size(); i++) {
+		const Pass& pass = passes[order[i]];
+		for (const Access& access : pass.accesses) {
+			const uint32_t previous = last_use[access.resource];
+			if (previous != ~0u && passes[order[previous]].queue != pass.queue && (awaited[i] == ~0u || previous > awaited[i]))
+				awaited[i] = previous;
+			last_use[access.resource] = i;
+		}
+	}
+
+	// Segments split before a pass that waits for more than the passes before it, so those overlap
+	// the work it waits for
+	std::vector<Segment> split;
+	std::vector<uint32_t> pass_segment(order.size());
+	for (const Segment& segment : segments) {
+		uint32_t wait = ~0u;
+		// Async segments wait for the transitions the graphics segment before them makes on their behalf
+		if (!split.empty() && split.back().barrier_count > 0)
+			wait = static_cast<uint32_t>(split.size() - 1);
+		split.push_back({ segment.queue, segment.first_pass, 0, wait, false, 0, 0 });
+		for (uint32_t i = segment.first_pass; i < segment.first_pass + segment.pass_count; i++) {
+			if (awaited[i] != ~0u) {
+				wait = pass_segment[awaited[i]];
+				if (split.back().wait == ~0u || wait > split.back().wait) {
+					if (split.back().pass_count > 0)
+						split.push_back({ segment.queue, i, 0, ~0u, false, 0, 0 });
+					split.back().wait = wait;
+				}
+			}
+			split.back().pass_count++;
+			pass_segment[i] = static_cast<uint32_t>(split.size() - 1);
+			passes[order[i]].segment = pass_segment[i];
+		}
+		split.back().first_barrier = segment.first_barrier;
+		split.back().barrier_count = segment.barrier_count;
+	}
+	segments = std::move(split);
+
+	// The last segment is graphics and waits for all async work
+	for (uint32_t i = static_cast<uint32_t>(segments.size() - 1); i-- > 0;) {
+		if (segments[i].queue == Queue::AsyncCompute) {
+			Segment& last = segments.back();
+			if (last.wait == ~0u || i > last.wait)
+				last.wait = i;
+			break;
+		}
+	}
+
+	// A queue that already waited for a later segment of the other queue needs no wait
+	uint32_t waited[2] = { ~0u, ~0u };
+	for (Segment& segment : segments) {
+		if (segment.wait == ~0u)
+			continue;
+		uint32_t& last = waited[static_cast<size_t>(segment.queue)];
+		if (last != ~0u && segment.wait <= last) {
+			segment.wait = ~0u;
+			continue;
+		}
+		last = segment.wait;
+		segments[segment.wait].signal = true;
+		stats.queue_waits++;
+	}
+	stats.segments = static_cast<uint32_t>(segments.size());
+}
+
+void RenderGraph::SetImportedResource(ResourceHandle resource, RHI::Resource* physical)
+{
+	Resource& target = resources.at(resource);
+	if (!target.imported)
+		throw std::logic_error(target.name + " is not an imported resource");
+	target.physical = physical;
+}
+
+RHI::Resource* RenderGraph::GetResource(ResourceHandle resource) const
+{
+	const Resource& target = resources.at(resource);
+	if (!target.physical)
+		throw std::logic_error(target.name + " has no resource, imported ones must be set and transients compiled");
+	return target.physical;
+}
+
+void RenderGraph::Execute(RHI::CommandList& command_list)
+{
+	if (!compiled)
+		throw std::logic_error("Render graph executed without compiling");
+	if (stats.async_passes > 0)
+		throw std::logic_error("Render graphs with async passes execute on queues");
+
+	Context context(*this, command_list);
+	for (uint32_t i = 0; i < segments.size(); i++)
+		RecordSegment(i, context);
+}
+
+void RenderGraph::Execute(QueueSubmission& graphics, QueueSubmission& compute)
+{
+	if (!compiled)
+		throw std::logic_error("Render graph executed without compiling");
+
+	signalled_values.assign(segments.size(), 0);
+	for (uint32_t i = 0; i < segments.size(); i++) {
+		const Segment& segment = segments[i];
+		QueueSubmission& target = segment.queue == Queue::Graphics ? graphics : compute;
+		QueueSubmission& other = segment.queue == Queue::Graphics ? compute : graphics;
+		if (segment.wait != ~0u)
+			target.queue->Wait(other.fence, signalled_values[segment.wait]);
+
+		if (HasWork(i)) {
+			RHI::CommandList* command_list = target.acquire_list();
+			Context context(*this, *command_list);
+			RecordSegment(i, context);
+			if (&context.GetCommandList() != command_list)
+				throw std::logic_error("Passes executing on queues must record into the list they are given");
+			command_list->Close();
+			target.queue->ExecuteCommandLists(1, &command_list);
+		}
+
+		if (segment.signal) {
+			target.queue->Signal(target.fence, ++target.fence_value);
+			signalled_values[i] = target.fence_value;
+		}
+	}
+}
+
+bool RenderGraph::HasWork(uint32_t segment) const
+{
+	return segments[segment].pass_count > 0 || segments[segment].barrier_count > 0
+		|| (segment == segments.size() - 1 && barriers.size() > final_barrier);
+}
+
+void RenderGraph::RecordSegment(uint32_t segment, Context& context)
+{
+	const Segment& target = segments[segment];
+	for (uint32_t i = target.first_pass; i < target.first_pass + target.pass_count; i++) {
+		Pass& pass = passes[order[i]];
+		IssueBarriers(context.GetCommandList(), pass.first_barrier, pass.barrier_count);
+		if (pass.execute)
+			pass.execute(context);
+	}
+	IssueBarriers(context.GetCommandList(), target.first_barrier, target.barrier_count);
+	// Imported resources are returned on the graphics queue after all async work
+	if (segment == segments.size() - 1)
+		IssueBarriers(context.GetCommandList(), final_barrier, static_cast<uint32_t>(barriers.size()) - final_barrier);
+}
+
+RenderGraph::Timeline RenderGraph::SimulateTimeline(const std::function<double(PassHandle)>& pass_cost) const
+{
+	if (!compiled)
+		throw std::logic_error("Render graph simulated without compiling");
+
+	Timeline timeline = {};
+	double queue_free[2] = { 0.0, 0.0 };
+	for (const Segment& segment : segments) {
+		double cost = 0.0;
+		for (uint32_t i = segment.first_pass; i < segment.first_pass + segment.pass_count; i++)
+			cost += pass_cost(order[i]);
+		double& free = queue_free[static_cast<size_t>(segment.queue)];
+		double start = free;
+		if (segment.wait != ~0u && timeline.segments[segment.wait].end > start)
+			start = timeline.segments[segment.wait].end;
+		timeline.segments.push_back({ start, start + cost });
+		free = start + cost;
+		timeline.serial_time += cost;
+	}
+	timeline.frame_time = queue_free[0] > queue_free[1] ? queue_free[0] : queue_free[1];
+	return timeline;
+}
+
+void RenderGraph::IssueBarriers(RHI::CommandList& command_list, uint32_t first, uint32_t count)
+{
+	if (count == 0)
+		return;
+	scratch.clear();
+	for (uint32_t i = first; i < first + count; i++) {
+		const Barrier& barrier = barriers[i];
+		scratch.push_back({ GetResource(barrier.resource), barrier.before, barrier.after, barrier.type });
+	}
+	command_list.ResourceBarrier(count, scratch.data());
+}
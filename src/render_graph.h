@@ -0,0 +1,224 @@
+#pragma once
+
+#include "rhi.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// A frame described as passes that declare the resources they read and write.
+// Compile culls passes whose results nothing uses, places every transition in one batch per
+// pass and aliases transient textures whose lifetimes don't overlap in a single heap. The graph
+// is compiled once per topology and executed every frame, only imported resources change
+// between frames.
+// Async passes run on a compute queue. Consecutive passes of one queue form segments that wait
+// on a fence for the other queue's segment that last used their resources, split where a pass
+// waits for more than the passes before it.
+class RenderGraph
+{
+public:
+	using ResourceHandle = uint32_t;
+	using PassHandle = uint32_t;
+
+	enum class Queue
+	{
+		Graphics,
+		// Runs beside graphics, may only use states compute queues support
+		AsyncCompute
+	};
+
+	struct TextureDesc
+	{
+		uint32_t width;
+		uint32_t height;
+		RHI::Format format;
+	};
+
+	struct Stats
+	{
+		uint32_t passes;
+		uint32_t culled_passes;
+		uint32_t transient_textures;
+		// What the transients would take as separate textures
+		uint64_t transient_bytes;
+		// What they take aliased in the graph's heap
+		uint64_t heap_bytes;
+		// Per executed frame
+		uint32_t barriers;
+		uint32_t aliasing_barriers;
+		uint32_t barrier_batches;
+		uint32_t async_passes;
+		uint32_t segments;
+		// Fence waits between the queues per executed frame
+		uint32_t queue_waits;
+	};
+
+	struct Segment
+	{
+		Queue queue;
+		// Range of the live passes in execution order
+		uint32_t first_pass;
+		uint32_t pass_count;
+		// Segment of the other queue that must finish first, ~0 when there is none
+		uint32_t wait;
+		// Whether the other queue waits for this segment
+		bool signal;
+		// Transitions out of graphics-only states for the async passes that follow, issued after the passes
+		uint32_t first_barrier;
+		uint32_t barrier_count;
+	};
+
+	// Where Execute records and submits the work of one queue
+	struct QueueSubmission
+	{
+		RHI::CommandQueue* queue;
+		// Signalled after segments the other queue waits for, fence_value is the last value signalled
+		RHI::Fence* fence;
+		uint64_t fence_value;
+		// Returns a reset list of the queue's type, Execute closes and submits it
+		std::function<RHI::CommandList*()> acquire_list;
+	};
+
+	// Times of a compiled graph on simulated queues, in the units of the pass costs
+	struct Timeline
+	{
+		struct Span { double start; double end; };
+		std::vector<Span> segments;
+		double frame_time;
+		// The same passes one after another on a single queue
+		double serial_time;
+	};
+
+	// Handed to passes while the graph executes
+	class Context
+	{
+	public:
+		RHI::CommandList& GetCommandList() const { return *command_list; }
+		// Later barriers and passes record into command_list, for passes spread over several
+		// lists that execute in order
+		void SetCommandList(RHI::CommandList& command_list) { this->command_list = &command_list; }
+		RHI::Resource* GetResource(ResourceHandle resource) const { return graph.GetResource(resource); }
+
+	private:
+		friend class RenderGraph;
+
+		Context(const RenderGraph& graph, RHI::CommandList& command_list) : graph(graph), command_list(&command_list) {}
+
+		const RenderGraph& graph;
+		RHI::CommandList* command_list;
+	};
+
+	using ExecuteFunction = std::function<void(Context& context)>;
+
+	// Resources living outside the graph, such as the back buffer. They are in initial_state
+	// when the graph executes and are left in final_state.
+	ResourceHandle Import(const std::string& name, RHI::ResourceState initial_state, RHI::ResourceState final_state);
+	// Placed in the graph's heap by Compile. Contents don't survive the frame, the first pass
+	// writing a transient must clear it since the memory may have held another texture.
+	ResourceHandle CreateTexture(const std::string& name, const TextureDesc& desc);
+
+	// Passes execute in the order they are added. Passes whose writes nothing reads are culled,
+	// writing an imported resource or nothing in the graph at all keeps a pass.
+	PassHandle AddPass(const std::string& name, ExecuteFunction execute, Queue queue = Queue::Graphics);
+	void Read(PassHandle pass, ResourceHandle resource, RHI::ResourceState state);
+	void Write(PassHandle pass, ResourceHandle resource, RHI::ResourceState state);
+
+	// Throws std::logic_error for transients read before any pass writes them and for
+	// resources a pass needs in two incompatible states
+	void Compile(RHI::Device& device);
+	bool IsCompiled() const { return compiled; }
+	// Drops every pass and resource, topology changes declare the graph again
+	void Reset();
+
+	// Must be set before every Execute that uses the resource
+	void SetImportedResource(ResourceHandle resource, RHI::Resource* physical);
+	// Records every pass into command_list, for graphs without async passes
+	void Execute(RHI::CommandList& command_list);
+	// Records each segment into a list of its own and submits it with the fence waits between
+	// the queues. The last segment is always graphics and waits for all async work, so a fence
+	// signalled on the graphics queue afterwards covers the whole frame. Passes must record
+	// into the list they are given.
+	void Execute(QueueSubmission& graphics, QueueSubmission& compute);
+
+	// Schedules the segments on two queues that each run in order, passes taking pass_cost
+	Timeline SimulateTimeline(const std::function<double(PassHandle)>& pass_cost) const;
+	const std::vector<Segment>& GetSegments() const { return segments; }
+	// Live passes in execution order
+	const std::vector<PassHandle>& GetOrder() const { return order; }
+
+	RHI::Resource* GetResource(ResourceHandle resource) const;
+	bool IsCulled(PassHandle pass) const { return passes.at(pass).culled; }
+	// Where Compile placed a transient, ~0 for imported and unused resources
+	uint64_t GetHeapOffset(ResourceHandle resource) const { return resources.at(resource).heap_offset; }
+	const Stats& GetStats() const { return stats; }
+
+private:
+	struct Access
+	{
+		ResourceHandle resource;
+		RHI::ResourceState state;
+		bool write;
+	};
+
+	struct Resource
+	{
+		std::string name;
+		bool imported;
+		TextureDesc desc;
+		RHI::ResourceState initial_state;
+		RHI::ResourceState final_state;
+		uint64_t size = 0;
+		uint64_t heap_offset = ~0ull;
+		// Live pass order of the first and last use
+		uint32_t first_use = ~0u;
+		uint32_t last_use = 0;
+		bool aliased = false;
+		std::unique_ptr<RHI::Resource> texture;
+		RHI::Resource* physical = nullptr;
+	};
+
+	struct Barrier
+	{
+		ResourceHandle resource;
+		RHI::ResourceState before;
+		RHI::ResourceState after;
+		RHI::ResourceBarrierType type;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		ExecuteFunction execute;
+		std::vector<Access> accesses;
+		Queue queue = Queue::Graphics;
+		bool culled = false;
+		uint32_t segment = 0;
+		// Issued in one batch before the pass
+		uint32_t first_barrier = 0;
+		uint32_t barrier_count = 0;
+	};
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	// Live passes in execution order
+	std::vector<PassHandle> order;
+	std::vector<Segment> segments;
+	std::vector<Barrier> barriers;
+	// Returns resources to the state the next frame expects after the last pass
+	uint32_t final_barrier = 0;
+	std::unique_ptr<RHI::Heap> heap;
+	std::vector<RHI::ResourceBarrier> scratch;
+	std::vector<uint64_t> signalled_values;
+	Stats stats = {};
+	bool compiled = false;
+
+	void AddAccess(PassHandle pass, ResourceHandle resource, RHI::ResourceState state, bool write);
+	void Cull();
+	void BuildSegments();
+	void PlaceTransients(RHI::Device& device);
+	void PlaceBarriers();
+	void SynchronizeQueues();
+	bool HasWork(uint32_t segment) const;
+	void RecordSegment(uint32_t segment, Context& context);
+	void IssueBarriers(RHI::CommandList& command_list, uint32_t first, uint32_t count);
+};
@@ -1,8 +1,20 @@
 #include "renderer.h"
 
+#include "parallel_for.h"
+
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+
+static_assert(VertexFormats::Standard::stride == sizeof(ColorVertex)
+	&& VertexFormats::Standard::OffsetOf<VertexFormats::Color>() == offsetof(ColorVertex, color)
+	&& VertexFormats::Standard::OffsetOf<VertexFormats::Normal>() == offsetof(ColorVertex, norm), "Standard vertex format must match ColorVertex");
+
 void Renderer::OnInit()
 {
 	LoadPipeline();
@@ -32,32 +44,55 @@ void Renderer::OnUpdate()
 	y += dy;
 	z += fz.m128_f32[2];
 
-	XMMATRIX world = XMMatrixScaling(.5f, .5f, .5f);
+	XMMATRIX world = XMMatrixScaling(model_scale, model_scale, model_scale);
 
 	XMMATRIX view = XMMatrixLookAtLH(XMVECTOR{ x, y, z }, XMVECTOR{ x, y, z } + fwd, XMVECTOR{ 0.f, 1.f, 0.f });
-	XMMATRIX projection = XMMatrixPerspectiveFovLH(60.f*XM_PI/180.f, aspect_ratio, 0.001, 100.f);
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(60.f*XM_PI/180.f, aspect_ratio, 0.001, far_plane);
 		
 
 	mvp = world * view * projection;
 
-	memcpy(const_data_begin, &mvp, sizeof(mvp));
+	if (capture_requested) {
+		capture_requested = false;
+		BeginCapture();
+	}
+
+	// Only a changed matrix reaches upload memory, frames where the camera stands still write nothing
+	constant_buffers->Update(object_constants, mvp);
+	constant_buffers->Flush();
+	if (frame_capture)
+		frame_capture->AddResourceData(constant_buffers->GetResource(), constant_buffers->GetOffset(object_constants),
+			constant_buffers->GetData(object_constants), sizeof(mvp));
 }
 
 void Renderer::OnRender()
 {
 	PopulateCommandList();
-	ID3D12CommandList* command_lists[] = { command_list.Get() };
-
-	command_queue->ExecuteCommandLists(_countof(command_lists), command_lists);
+	// Lists recorded in parallel still go to the GPU in one submission
+	command_queue->ExecuteCommandLists(static_cast<uint32_t>(submit_lists.size()), submit_lists.data());
 	ThrowIfFailed(swap_chain->Present(0, 0));
 
-	WaitForPreviousFrame();
+	MoveToNextFrame();
+
+	if (frame_capture)
+		EndCapture();
 }
 
 void Renderer::OnDestroy()
 {
-	WaitForPreviousFrame();
-	CloseHandle(fence_event);
+	ReleaseBuffer(vertex_buffer);
+
+	uploader->WaitForIdle();
+	frame_ring->WaitForIdle(*command_queue);
+	readbacks->Poll(frame_ring->GetCompletedFenceValue());
+	SaveScreenshots();
+	deferred_releases.Flush();
+
+	pipeline_library->Store();
+	if (pipeline_cache.IsDirty())
+		pipeline_cache.Save(GetPipelineCachePath());
+	if (shader_cache.IsDirty())
+		shader_cache.Save(GetShaderCachePath());
 }
 
 void Renderer::OnKeyDown(UINT8 key)
@@ -94,6 +129,39 @@ void Renderer::OnKeyDown(UINT8 key)
 	case VK_RIGHT:
 		dlr = 0.001;
 		break;
+	case 0x41 - 'a' + 'c':
+		capture_requested = true;
+		break;
+	case 0x41 - 'a' + 'p':
+		screenshot_requested = true;
+		break;
+	case 0x41 - 'a' + 'b':
+		SetDrawFeatures(draw_features ^ pixel_features.GetMask("BUMP_MAPPING"));
+		break;
+	case 0x41 - 'a' + 'l':
+		SetDrawFeatures(draw_features ^ pixel_features.GetMask("POINT_LIGHT"));
+		break;
+	case 0x41 - 'a' + 'r':
+		use_bundles = !use_bundles;
+		break;
+	case 0x41 - 'a' + 'z':
+		SetDepthPrepass(!depth_prepass);
+		break;
+	case 0x41 - 'a' + 'o':
+		MeasureOverdraw();
+		break;
+	case 0x41 - 'a' + 'f':
+		frustum_culling = !frustum_culling;
+		break;
+	case 0x41 - 'a' + 'h':
+		occlusion_culling = !occlusion_culling;
+		break;
+	case 0x41 - 'a' + 'v':
+		pvs_culling = !pvs_culling;
+		break;
+	case 0x41 - 'a' + 'k':
+		sort_draws = !sort_draws;
+		break;
 	default:
 		break;
 	}
@@ -157,13 +225,12 @@ void Renderer::LoadPipeline()
 
 	ComPtr<IDXGIAdapter1> hardware_adapter;
 	ThrowIfFailed(dxgifactory->EnumAdapters1(0, &hardware_adapter));
-	ThrowIfFailed(D3D12CreateDevice(hardware_adapter.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&device)));
+	ComPtr<ID3D12Device> native_device;
+	ThrowIfFailed(D3D12CreateDevice(hardware_adapter.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&native_device)));
+	device = std::make_unique<RHI::D3D12Device>(native_device);
 
 	// Create a direct command queue
-	D3D12_COMMAND_QUEUE_DESC queue_desc = {};
-	queue_desc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
-	queue_desc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
-	ThrowIfFailed(device->CreateCommandQueue(&queue_desc, IID_PPV_ARGS(&command_queue)));
+	command_queue = device->CreateCommandQueue(RHI::CommandListType::Direct);
 
 	// Create swap chain
 	DXGI_SWAP_CHAIN_DESC1 swap_chain_desc = {};
@@ -177,7 +244,7 @@ void Renderer::LoadPipeline()
 
 	ComPtr<IDXGISwapChain1> temp_swap_chain;
 	ThrowIfFailed(dxgifactory->CreateSwapChainForHwnd(
-		command_queue.Get(),
+		RHI::GetNative(command_queue.get()),
 		Win32Window::GetHwnd(),
 		&swap_chain_desc,
 		nullptr,
@@ -189,120 +256,165 @@ void Renderer::LoadPipeline()
 
 	frame_index = swap_chain->GetCurrentBackBufferIndex();
 
-	// Create descriptor heap for render target view
-	D3D12_DESCRIPTOR_HEAP_DESC rtv_heap_desc = {};
-	rtv_heap_desc.NumDescriptors = frame_number;
-	rtv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-	rtv_heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-	ThrowIfFailed(device->CreateDescriptorHeap(&rtv_heap_desc, IID_PPV_ARGS(&rtv_heap)));
-	rtv_descriptor_size = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-
-	// Create constant buffer
-	D3D12_DESCRIPTOR_HEAP_DESC cbv_heap_desc = {};
-	cbv_heap_desc.NumDescriptors = 1;
-	cbv_heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	cbv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	ThrowIfFailed(device->CreateDescriptorHeap(&cbv_heap_desc, IID_PPV_ARGS(&cbv_heap)));
-
+	// Create descriptor heaps, render targets only need persistent descriptors
+	rtv_descriptors = std::make_unique<DescriptorAllocator>(*device, RHI::DescriptorHeapType::Rtv, false, rtv_capacity);
+	dsv_descriptors = std::make_unique<DescriptorAllocator>(*device, RHI::DescriptorHeapType::Dsv, false, dsv_capacity);
+	dsv_index = dsv_descriptors->AllocatePersistent();
+	read_only_dsv_index = dsv_descriptors->AllocatePersistent();
+	descriptors = std::make_unique<DescriptorAllocator>(*device, RHI::DescriptorHeapType::CbvSrvUav, true,
+		persistent_descriptor_capacity, transient_descriptor_capacity, frames_in_flight);
 
 	// Create render target view for each frame
-	CD3DX12_CPU_DESCRIPTOR_HANDLE rtv_handle(rtv_heap->GetCPUDescriptorHandleForHeapStart());
-	for (INT i = 0; i < frame_number; i++) {
-		ThrowIfFailed(swap_chain->GetBuffer(i, IID_PPV_ARGS(&render_targets[i])));
-		device->CreateRenderTargetView(render_targets[i].Get(), nullptr, rtv_handle);
-		rtv_handle.Offset(1, rtv_descriptor_size);
+	for (UINT i = 0; i < frame_number; i++) {
+		ComPtr<ID3D12Resource> back_buffer;
+		ThrowIfFailed(swap_chain->GetBuffer(i, IID_PPV_ARGS(&back_buffer)));
+		render_targets[i] = device->WrapResource(back_buffer, RHI::HeapType::Default);
+		rtv_indices[i] = rtv_descriptors->AllocatePersistent();
+		device->CreateRenderTargetView(render_targets[i].get(), rtv_descriptors->GetCpuHandle(rtv_indices[i]));
 	}
 
-	// Create command allocator
-	ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&command_allocator)));
+	// Create a command allocator per recording list and frame in flight
+	UINT recording_lists = thread_pool.GetThreadCount();
+	if (recording_lists > max_recording_lists)
+		recording_lists = max_recording_lists;
+	frame_resources.resize(frames_in_flight);
+	for (FrameResources& frame : frame_resources) {
+		for (UINT i = 0; i < recording_lists; i++)
+			frame.command_allocators.push_back(device->CreateCommandAllocator(RHI::CommandListType::Direct));
+		frame.bundle_allocator = device->CreateCommandAllocator(RHI::CommandListType::Bundle);
+	}
 }
 
 void Renderer::LoadAssets()
 {
 	// Create a root signature
 
+	ID3D12Device* native_device = device->GetNative();
+
 	D3D12_FEATURE_DATA_ROOT_SIGNATURE rs_feature_data = {};
 	rs_feature_data.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
-	if (FAILED(device->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &rs_feature_data, sizeof(rs_feature_data)))) {
+	if (FAILED(native_device->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &rs_feature_data, sizeof(rs_feature_data)))) {
 		rs_feature_data.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
 	}
 	
-	CD3DX12_DESCRIPTOR_RANGE1 ranges[1];
-	CD3DX12_ROOT_PARAMETER1 root_parameters[1];
-
-	ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC);
-	root_parameters[0].InitAsDescriptorTable(1, &ranges[0], D3D12_SHADER_VISIBILITY_VERTEX );
-
-	D3D12_ROOT_SIGNATURE_FLAGS rs_flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT
-		| D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS
-		| D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS
-		| D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS
-		| D3D12_ROOT_SIGNATURE_FLAG_DENY_PIXEL_SHADER_ROOT_ACCESS;
+	// Bindless needs every descriptor of an unbounded CBV range to be addressable
+	D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+	ThrowIfFailed(native_device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options)));
+	bindless = options.ResourceBindingTier >= D3D12_RESOURCE_BINDING_TIER_2;
 
-	CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC root_signatre_desc;
-	root_signatre_desc.Init_1_1(_countof(root_parameters), root_parameters, 0, nullptr, rs_flags);
+	// Parameters and their binding come from the constexpr layouts RecordFrame binds against
+	const RHI::RootSignatureDesc root_signature_desc = bindless ? SceneRootSignature::Bindless::GetDesc() : SceneRootSignature::Bound::GetDesc();
 
+	// Serialized root signatures and compiled pipelines come from the previous run when nothing changed
+	pipeline_cache.Load(GetPipelineCachePath());
+	pipeline_library = std::make_unique<RHI::D3D12PipelineLibrary>(*device, pipeline_cache);
 
-	/*
-	CD3DX12_ROOT_SIGNATURE_DESC root_signatre_desc;
-	root_signatre_desc.Init(0, nullptr, 0, nullptr,
-		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
-	*/
-
-	ComPtr<ID3DBlob> signature;
-	ComPtr<ID3DBlob> error;
-	ThrowIfFailed(D3DX12SerializeVersionedRootSignature(&root_signatre_desc, rs_feature_data.HighestVersion, &signature, &error));
-	ThrowIfFailed(device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(),
-		IID_PPV_ARGS(&root_signature)));
-
-	// Create full PSO
-	ComPtr<ID3DBlob> ver_shader;
-	ComPtr<ID3DBlob> frag_shader;
-
-	UINT compile_flags = 0;
-
-#ifdef _DEBUG
-	compile_flags |= D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif // _DEBUG
-
+	auto pipeline_start = std::chrono::high_resolution_clock::now();
+	uint64_t root_signature_key;
+	root_signature = pipeline_library->CreateRootSignature(root_signature_desc, rs_feature_data.HighestVersion, root_signature_key);
+	auto pipeline_time = std::chrono::high_resolution_clock::now() - pipeline_start;
 
+	// Create full PSO, shaders come precompiled from the build unless shaders.hlsl changed since
+	const auto shader_start = std::chrono::high_resolution_clock::now();
 	std::wstring shader_path = GetBinPath(std::wstring(L"shaders.hlsl"));
-	ThrowIfFailed(D3DCompileFromFile(shader_path.c_str(), nullptr, nullptr,
-		"VSMain", "vs_5_0", compile_flags, 0, &ver_shader, &error));
-	ThrowIfFailed(D3DCompileFromFile(shader_path.c_str(), nullptr, nullptr,
-		"PSMain", "ps_5_0", compile_flags, 0, &frag_shader, &error));
-
-	D3D12_INPUT_ELEMENT_DESC input_element_desc[] = {
-		{"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-		{"COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 3 * 4, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-		{"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 3*4 + 4*4, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
-	};
+	std::string shader_source;
+	if (!ReadShaderSource(std::string(shader_path.begin(), shader_path.end()), shader_source))
+		throw std::runtime_error("Can't read shaders.hlsl");
+	shader_cache.Load(GetShaderCachePath());
+
+	std::vector<ShaderDefine> defines;
+	if (bindless)
+		defines.push_back({ "BINDLESS", "1" });
+	// Every distinct pixel shader permutation gets its own pipeline, draws pick one by feature mask
+	const std::vector<uint32_t> distinct_permutations = pixel_features.GetDistinctPermutations();
+	std::vector<std::vector<ShaderDefine>> pixel_permutations;
+	for (uint32_t permutation : distinct_permutations)
+		pixel_permutations.push_back(pixel_features.GetDefines(permutation, defines));
+	// The vertex shader's inputs follow the vertex format
+	std::vector<ShaderDefine> vertex_defines = defines;
+	vertex_defines.push_back({ "VERTEX_INPUT", SceneVertexFormat::GetHlslInputSignature() });
+	ShaderLoadStats shader_stats = {};
+	const std::vector<uint8_t> ver_shader = LoadShaders(shader_source, "VSMain", "vs", { vertex_defines }, shader_stats)[0];
+	const std::vector<uint8_t> depth_shader = LoadShaders(shader_source, "VSDepth", "vs", { vertex_defines }, shader_stats)[0];
+	const std::vector<std::vector<uint8_t>> frag_shaders = LoadShaders(shader_source, "PSMain", "ps", pixel_permutations, shader_stats);
+
+	const double shader_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - shader_start).count();
+	OutputDebugString((L"Shaders loaded in " + std::to_wstring(shader_ms) + L" ms, " + std::to_wstring(pixel_features.GetFeatureCount())
+		+ L" pixel features in " + std::to_wstring(distinct_permutations.size()) + L" permutations, " + std::to_wstring(shader_stats.offline)
+		+ L" precompiled, " + std::to_wstring(shader_stats.cached) + L" cached, " + std::to_wstring(shader_stats.compiled)
+		+ L" compiled\n").c_str());
+
+	// Offsets and formats come from the vertex format, RHI input elements match D3D12's
+	constexpr auto input_elements = SceneVertexFormat::GetInputElements();
 
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC pso_desc = {};
-	pso_desc.InputLayout = { input_element_desc, _countof(input_element_desc) };
-	pso_desc.pRootSignature = root_signature.Get();
-	pso_desc.VS = CD3DX12_SHADER_BYTECODE(ver_shader.Get());
-	pso_desc.PS = CD3DX12_SHADER_BYTECODE(frag_shader.Get());
+	pso_desc.InputLayout = { reinterpret_cast<const D3D12_INPUT_ELEMENT_DESC*>(input_elements.data()), static_cast<UINT>(input_elements.size()) };
+	pso_desc.pRootSignature = RHI::GetNative(root_signature.get());
+	pso_desc.VS = CD3DX12_SHADER_BYTECODE(ver_shader.data(), ver_shader.size());
 	pso_desc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
 	pso_desc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
 	//pso_desc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME; //todo remove
 	//pso_desc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE; //todo remove
-	pso_desc.RasterizerState.DepthClipEnable = false; //todo remove
-	pso_desc.DepthStencilState.DepthEnable = FALSE;
+	pso_desc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
 	pso_desc.DepthStencilState.StencilEnable = FALSE;
+	pso_desc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
 	pso_desc.SampleMask = UINT_MAX;
 	pso_desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
 	pso_desc.NumRenderTargets = 1;
 	pso_desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
 	pso_desc.SampleDesc.Count = 1;
 
-	ThrowIfFailed(device->CreateGraphicsPipelineState(&pso_desc, IID_PPV_ARGS(&pipeline_state)));
-
+	// Without the pre-pass the scene tests LESS and writes depth, after it the scene only shades
+	// what the pre-pass left visible
+	pipeline_start = std::chrono::high_resolution_clock::now();
+	for (D3D12_COMPARISON_FUNC depth_func : { D3D12_COMPARISON_FUNC_LESS, D3D12_COMPARISON_FUNC_EQUAL }) {
+		pso_desc.DepthStencilState.DepthFunc = depth_func;
+		pso_desc.DepthStencilState.DepthWriteMask = depth_func == D3D12_COMPARISON_FUNC_LESS ? D3D12_DEPTH_WRITE_MASK_ALL : D3D12_DEPTH_WRITE_MASK_ZERO;
+		const size_t first_pipeline = pipeline_states.size();
+		for (const std::vector<uint8_t>& frag_shader : frag_shaders) {
+			pso_desc.PS = CD3DX12_SHADER_BYTECODE(frag_shader.data(), frag_shader.size());
+			pipeline_states.push_back(pipeline_library->CreateGraphicsPipelineState(pso_desc, root_signature_key));
+		}
+		// Masks that aren't distinct share the pipeline of the permutation they resolve to
+		for (uint32_t mask = 0; mask < pixel_features.GetPermutationCount(); mask++) {
+			const auto distinct = std::find(distinct_permutations.begin(), distinct_permutations.end(), pixel_features.Resolve(mask));
+			pipeline_state_table.push_back(pipeline_states[first_pipeline + (distinct - distinct_permutations.begin())].get());
+		}
+	}
 
-	// Create command list
-	ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, command_allocator.Get(), 
-		pipeline_state.Get(), IID_PPV_ARGS(&command_list)));
-	ThrowIfFailed(command_list->Close());
+	// The pre-pass has no pixel shader or render target
+	pso_desc.VS = CD3DX12_SHADER_BYTECODE(depth_shader.data(), depth_shader.size());
+	pso_desc.PS = {};
+	pso_desc.NumRenderTargets = 0;
+	pso_desc.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
+	pso_desc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS;
+	pso_desc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
+	pipeline_states.push_back(pipeline_library->CreateGraphicsPipelineState(pso_desc, root_signature_key));
+	depth_pipeline_table.assign(pixel_features.GetPermutationCount(), pipeline_states.back().get());
+	pipeline_time += std::chrono::high_resolution_clock::now() - pipeline_start;
+
+	// Compare runs with a cold and a warm cache to see what it saves
+	const PipelineCache::Stats cache_stats = pipeline_cache.GetStats();
+	const double pipeline_ms = std::chrono::duration<double, std::milli>(pipeline_time).count();
+	OutputDebugString((L"Pipeline creation " + std::to_wstring(pipeline_ms) + L" ms, pipelines "
+		+ std::to_wstring(pipeline_library->GetPipelineHits()) + L" hits " + std::to_wstring(pipeline_library->GetPipelineMisses())
+		+ L" misses, cache " + std::to_wstring(cache_stats.hits) + L" hits " + std::to_wstring(cache_stats.misses)
+		+ L" misses\n").c_str());
+
+
+	// Create command lists, each with its own state filter since lists record concurrently
+	for (const std::unique_ptr<RHI::CommandAllocator>& command_allocator : frame_resources[0].command_allocators) {
+		command_lists.push_back(device->CreateCommandList(RHI::CommandListType::Direct, command_allocator.get(), nullptr));
+		command_lists.back()->Close();
+		state_filters.push_back(std::make_unique<StateFilterCommandList>());
+	}
+	for (FrameResources& frame : frame_resources) {
+		frame.bundle = device->CreateCommandList(RHI::CommandListType::Bundle, frame.bundle_allocator.get(), nullptr);
+		frame.bundle->Close();
+		frame.depth_bundle = device->CreateCommandList(RHI::CommandListType::Bundle, frame.bundle_allocator.get(), nullptr);
+		frame.depth_bundle->Close();
+	}
+	bundle_filter = std::make_unique<StateFilterCommandList>();
 
 	// Create and upload vertex buffer
 	std::wstring obj_directory = GetBinPath(L"");
@@ -333,8 +445,11 @@ void Renderer::LoadAssets()
 		ThrowIfFailed(-1);
 	}
 
-	// Loop over shapes
+	// Loop over shapes, each is a draw of its own with a box the frustum culler tests
+	draw_features = pixel_features.GetAllFeatures();
 	for (size_t s = 0; s < shapes.size(); s++) {
+		const uint32_t start_vertex = static_cast<uint32_t>(vertices.size());
+		Aabb bounds = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
 		// Loop over faces(polygon)
 		size_t index_offset = 0;
 		for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
@@ -343,30 +458,93 @@ void Renderer::LoadAssets()
 			// Loop over vertices in the face.
 			// per-face material
 			int material_ids = shapes[s].mesh.material_ids[f];
+			auto color = materials[material_ids].diffuse;
+			std::vector<XMFLOAT3> positions;
 			for (size_t v = 0; v < fv; v++) {
 				// access to vertex
 				tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
 				tinyobj::real_t vx = attrib.vertices[3 * idx.vertex_index + 0];
 				tinyobj::real_t vy = attrib.vertices[3 * idx.vertex_index + 1];
 				tinyobj::real_t vz = attrib.vertices[3 * idx.vertex_index + 2];
-				auto color = materials[material_ids].diffuse;
-
-				XMFLOAT3 norm = { 0, 0, 0 };
-				vertices.push_back(ColorVertex{ { vx, vy, vz }, {color[0], color[1], color[2], 1.f}, norm });
+				positions.push_back({ vx, vy, vz });
 			}
 
-			auto v1 = XMLoadFloat3(&vertices[vertices.size() - 1].position);
-			auto v2 = XMLoadFloat3(&vertices[vertices.size() - 2].position);
-			auto v3 = XMLoadFloat3(&vertices[vertices.size() - 3].position);
+			auto v1 = XMLoadFloat3(&positions[fv - 1]);
+			auto v2 = XMLoadFloat3(&positions[fv - 2]);
+			auto v3 = XMLoadFloat3(&positions[fv - 3]);
 
 			auto mnorm = XMVector3Cross(v1 - v2, v3 - v2);
+			// Normalized encodings can't hold the raw cross product
+			if (SceneVertexFormat::IsNormalized<VertexFormats::Normal>())
+				mnorm = XMVector3Normalize(mnorm);
 			XMFLOAT3 norm = XMFLOAT3{ XMVectorGetX(mnorm), XMVectorGetY(mnorm), XMVectorGetZ(mnorm) };
-			
-			for (size_t v = 0; v < fv; v++)
-				vertices[vertices.size() - 1 - v].norm = norm;
+
+			for (const XMFLOAT3& position : positions) {
+				vertex_positions.push_back(position);
+				const float coordinates[3] = { position.x, position.y, position.z };
+				for (int axis = 0; axis < 3; axis++) {
+					if (coordinates[axis] < bounds.min[axis])
+						bounds.min[axis] = coordinates[axis];
+					if (coordinates[axis] > bounds.max[axis])
+						bounds.max[axis] = coordinates[axis];
+				}
+				SceneVertexFormat::Vertex vertex;
+				vertex.Set<VertexFormats::Position>({ position.x, position.y, position.z });
+				vertex.Set<VertexFormats::Color>({ color[0], color[1], color[2], 1.f });
+				vertex.Set<VertexFormats::Normal>({ norm.x, norm.y, norm.z });
+				vertices.push_back(vertex);
+			}
 
 			index_offset += fv;			
 		}
+
+		const uint32_t vertex_count = static_cast<uint32_t>(vertices.size()) - start_vertex;
+		if (vertex_count == 0)
+			continue;
+		draws.push_back(DrawItem{ start_vertex, vertex_count, 0, 0, draw_features });
+		// Shapes of the model have a single material, faces without one get the first
+		const int material = shapes[s].mesh.material_ids.empty() ? 0 : shapes[s].mesh.material_ids[0];
+		draw_materials.push_back(material < 0 ? 0 : static_cast<uint32_t>(material));
+		frustum_culler.Add(bounds);
+		draw_bounds.push_back(bounds);
+	}
+	scene_version++;
+
+	// Shapes whose box has a face of at least a sixteenth of the model's largest face hide others, such as
+	// the walls of a room. Small shapes are rarely worth their triangles.
+	Aabb scene_bounds = draw_bounds.empty() ? Aabb{} : draw_bounds[0];
+	for (const Aabb& bounds : draw_bounds) {
+		for (int axis = 0; axis < 3; axis++) {
+			if (bounds.min[axis] < scene_bounds.min[axis])
+				scene_bounds.min[axis] = bounds.min[axis];
+			if (bounds.max[axis] > scene_bounds.max[axis])
+				scene_bounds.max[axis] = bounds.max[axis];
+		}
+	}
+	auto largest_face = [](const Aabb& bounds) {
+		const float x = bounds.max[0] - bounds.min[0];
+		const float y = bounds.max[1] - bounds.min[1];
+		const float z = bounds.max[2] - bounds.min[2];
+		const float xy = x * y;
+		const float yz = y * z;
+		const float zx = z * x;
+		return xy > yz ? (xy > zx ? xy : zx) : (yz > zx ? yz : zx);
+	};
+	const float occluder_area = largest_face(scene_bounds) / 16.f;
+	for (const Aabb& bounds : draw_bounds)
+		draw_occluders.push_back(largest_face(bounds) >= occluder_area);
+	occlusion_culler = std::make_unique<OcclusionCuller>(thread_pool, occlusion_width, occlusion_height, occlusion_threads);
+
+	// Shapes are numbered like the draws, a set baked for another version of the model is ignored
+	std::wstring pvs_path = GetBinPath(L"pvs.bin");
+	if (!pvs.Load(std::string(pvs_path.begin(), pvs_path.end()))) {
+		OutputDebugString(L"No potentially visible set loaded\n");
+	} else if (pvs.GetShapeCount() != draws.size()) {
+		OutputDebugString((L"Potentially visible set has " + std::to_wstring(pvs.GetShapeCount()) + L" shapes, the model "
+			+ std::to_wstring(draws.size()) + L", ignored\n").c_str());
+		pvs = PotentiallyVisibleSet();
+	} else {
+		OutputDebugString((L"Potentially visible set of " + std::to_wstring(pvs.GetCellCount()) + L" cells loaded\n").c_str());
 	}
 
 	/*ColorVertex triangle_verteces[] = {
@@ -375,111 +553,503 @@ void Renderer::LoadAssets()
 		{{-0.25f * std::sqrt(2.f), -0.25f * aspect_ratio, 0.f}, {0.f, 0.f, 1.f, 1.f}}
 	};*/
 
-	const UINT ver_buff_size = vertices.size() * sizeof(ColorVertex);
-	ThrowIfFailed(device->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(ver_buff_size),
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(&vertex_buffer)
-	));
-
-	UINT8* vertex_data_begin;
-	CD3DX12_RANGE read_range(0, 0);
-	ThrowIfFailed(vertex_buffer->Map(0, &read_range, reinterpret_cast<void**>(&vertex_data_begin)));
-	memcpy(vertex_data_begin, vertices.data(), sizeof(ColorVertex) * vertices.size());
-	vertex_buffer->Unmap(0, nullptr);
-
-	vertex_buffer_view.BufferLocation = vertex_buffer->GetGPUVirtualAddress();
-	vertex_buffer_view.StrideInBytes = sizeof(ColorVertex);
-	vertex_buffer_view.SizeInBytes = ver_buff_size;
-
-	// Constant buffer
-	ThrowIfFailed(device->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(16 * 4 * 1024),
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(&constant_buffer)
-	));
+	const UINT ver_buff_size = static_cast<UINT>(vertices.size() * SceneVertexFormat::stride);
+	OutputDebugString((L"Vertex buffer " + std::to_wstring(ver_buff_size) + L" bytes, " + std::to_wstring(SceneVertexFormat::stride)
+		+ L" bytes per vertex\n").c_str());
+	// Static geometry lives in video memory, the copy queue fills it while the direct queue starts up
+	uploader = std::make_unique<CopyUploader>(*device, staging_size);
+	heap_allocator = std::make_unique<GpuHeapAllocator>(*device);
+	vertex_buffer = heap_allocator->CreateBuffer(RHI::HeapType::Default, ver_buff_size, RHI::ResourceState::Common);
+	uploader->Upload(vertex_buffer.resource.get(), 0, vertices.data(), ver_buff_size);
+	uploader->Submit();
+	uploader->QueueWait(*command_queue);
+
+	vertex_buffer_view.buffer_location = vertex_buffer.resource->GetGpuAddress();
+	vertex_buffer_view.stride_in_bytes = SceneVertexFormat::stride;
+	vertex_buffer_view.size_in_bytes = ver_buff_size;
 
-	D3D12_CONSTANT_BUFFER_VIEW_DESC cbv_desc = {};
-	cbv_desc.BufferLocation = constant_buffer->GetGPUVirtualAddress();
-	cbv_desc.SizeInBytes = (sizeof(mvp) + 255) & ~255; // Black Magic
-	device->CreateConstantBufferView(&cbv_desc, cbv_heap->GetCPUDescriptorHandleForHeapStart());
+	// Create synchronization objects
+	frame_ring = std::make_unique<FrameRing>(*device, frames_in_flight);
+
+	// Constants keep a copy per frame in flight, bindless draws get a persistent view of each
+	constant_buffers = std::make_unique<ConstantBufferManager>(*device, constant_buffer_capacity, frames_in_flight);
+	object_constants = constant_buffers->Allocate(sizeof(mvp));
+	if (bindless) {
+		for (uint32_t frame = 0; frame < frames_in_flight; frame++) {
+			const uint32_t view = descriptors->AllocatePersistent();
+			device->CreateConstantBufferView(constant_buffers->GetResource()->GetGpuAddress() + constant_buffers->GetOffset(object_constants, frame),
+				constant_buffers->GetSize(object_constants), descriptors->GetCpuHandle(view));
+			object_constant_views.push_back(view);
+		}
+	}
+	readbacks = std::make_unique<ReadbackRing>(*device, frames_in_flight);
 
-	ThrowIfFailed(constant_buffer->Map(0, &read_range, reinterpret_cast<void**>(&const_data_begin)));
-	memcpy(const_data_begin, &mvp, sizeof(mvp));
+	BuildRenderGraph();
+}
 
-	// Create synchronization objects
-	ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence)));
-	fence_value = 1;
-	fence_event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-	if (fence_event == nullptr) {
-		ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+void Renderer::BuildRenderGraph()
+{
+	render_graph.Reset();
+	back_buffer = render_graph.Import("Back buffer", RHI::ResourceState::Present, RHI::ResourceState::Present);
+	depth_buffer = render_graph.CreateTexture("Depth", { width, height, RHI::Format::D32Float });
+	if (depth_prepass) {
+		const RenderGraph::PassHandle prepass = render_graph.AddPass("Depth pre-pass", [this](RenderGraph::Context& context) { RecordDepthPass(context); });
+		render_graph.Write(prepass, depth_buffer, RHI::ResourceState::DepthWrite);
 	}
+	const RenderGraph::PassHandle scene = render_graph.AddPass("Scene", [this](RenderGraph::Context& context) { RecordScenePass(context); });
+	render_graph.Write(scene, back_buffer, RHI::ResourceState::RenderTarget);
+	if (depth_prepass)
+		render_graph.Read(scene, depth_buffer, RHI::ResourceState::DepthRead);
+	else
+		render_graph.Write(scene, depth_buffer, RHI::ResourceState::DepthWrite);
+	render_graph.Compile(*device);
+
+	// Compile placed a new depth texture
+	RHI::Resource* depth_texture = render_graph.GetResource(depth_buffer);
+	device->CreateDepthStencilView(depth_texture, dsv_descriptors->GetCpuHandle(dsv_index), false);
+	device->CreateDepthStencilView(depth_texture, dsv_descriptors->GetCpuHandle(read_only_dsv_index), true);
+
+	const RenderGraph::Stats& stats = render_graph.GetStats();
+	OutputDebugString((L"Render graph " + std::to_wstring(stats.passes) + L" passes, " + std::to_wstring(stats.culled_passes) + L" culled, "
+		+ std::to_wstring(stats.barriers) + L" barriers in " + std::to_wstring(stats.barrier_batches) + L" batches, "
+		+ std::to_wstring(stats.transient_textures) + L" transients in " + std::to_wstring(stats.heap_bytes / 1024) + L" KiB instead of "
+		+ std::to_wstring(stats.transient_bytes / 1024) + L" KiB\n").c_str());
 }
 
 void Renderer::PopulateCommandList()
 {
-	// Reset allocators and lists
-	ThrowIfFailed(command_allocator->Reset());
-	ThrowIfFailed(command_list->Reset(command_allocator.Get(), pipeline_state.Get()));
-
-	// Set initial state
-	command_list->SetGraphicsRootSignature(root_signature.Get());
-	ID3D12DescriptorHeap* heaps[] = {cbv_heap.Get()};
-	command_list->SetDescriptorHeaps(_countof(heaps), heaps);
-	command_list->SetGraphicsRootDescriptorTable(0, cbv_heap->GetGPUDescriptorHandleForHeapStart());
-	command_list->RSSetViewports(1, &view_port);
-	command_list->RSSetScissorRects(1, &scissor_rect);
-
-	// Resource barrier from present to RT
-	command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(
-		render_targets[frame_index].Get(), 
-		D3D12_RESOURCE_STATE_PRESENT,
-		D3D12_RESOURCE_STATE_RENDER_TARGET
-		));
+	FrameContext& frame = scene_frame;
+	frame = {};
+	frame.root_signature = root_signature.get();
+	frame.bindless_heap = bindless ? descriptors->GetHeap() : nullptr;
+	frame.rtv = rtv_descriptors->GetCpuHandle(rtv_indices[frame_index]);
+	frame.view_port = view_port;
+	frame.scissor_rect = scissor_rect;
+	frame.vertex_buffer_view = vertex_buffer_view;
+
+	// The pre-pass writes depth on its own, the scene then tests against it without writing
+	depth_frame = frame;
+	depth_frame.rtv = {};
+	depth_frame.dsv = dsv_descriptors->GetCpuHandle(dsv_index);
+	depth_frame.clear_depth = true;
+	depth_frame.pipeline_states = depth_pipeline_table.data();
+	frame.dsv = dsv_descriptors->GetCpuHandle(depth_prepass ? read_only_dsv_index : dsv_index);
+	frame.clear_depth = !depth_prepass;
+	frame.pipeline_states = pipeline_state_table.data() + (depth_prepass ? pixel_features.GetPermutationCount() : 0);
+
+	CullDraws();
+
+	// Draws read this frame's copy of the constants, through its own view when bindless
+	const uint64_t constants = constant_buffers->GetGpuAddress(object_constants);
+	const uint32_t descriptor_index = bindless ? object_constant_views[frame_ring->GetFrameIndex()] : 0;
+	for (DrawItem& draw : visible_draws) {
+		draw.constants = constants;
+		draw.descriptor_index = descriptor_index;
+	}
 
-	// Record commands
-	CD3DX12_CPU_DESCRIPTOR_HANDLE rtv_handle(rtv_heap->GetCPUDescriptorHandleForHeapStart(),
-		frame_index, rtv_descriptor_size);
-	command_list->OMSetRenderTargets(1, &rtv_handle, FALSE, nullptr);
-	const float clear_color[3] = { 0.f, 0.f, 0.f };
-	command_list->ClearRenderTargetView(rtv_handle, clear_color, 0, nullptr);
-	command_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	command_list->IASetVertexBuffers(0, 1, &vertex_buffer_view);
-	command_list->DrawInstanced(vertices.size(), 1, 0, 0);
-
-	// Resource barrier from RT to present
-	command_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(
-		render_targets[frame_index].Get(),
-		D3D12_RESOURCE_STATE_RENDER_TARGET,
-		D3D12_RESOURCE_STATE_PRESENT
-		));
+	// With bundles the direct list only records the pass around them, a single list is enough.
+	// A capture re-records the bundle so it is part of the capture.
+	FrameResources& frame_resource = frame_resources[frame_ring->GetFrameIndex()];
+	if (use_bundles && (frame_resource.bundle_version != scene_version || frame_capture))
+		RecordBundles(frame_resource);
+
+	// Small frames aren't worth the threads, large ones get one list per worker
+	size_t list_count = use_bundles ? 1 : visible_draws.size() / min_draws_per_list;
+	if (list_count > command_lists.size())
+		list_count = command_lists.size();
+	if (list_count == 0)
+		list_count = 1;
+
+	// Record through the capture wrapper while a capture is running, and drop redundant state
+	// before it reaches the command list
+	std::vector<std::unique_ptr<CaptureCommandList>> capture_lists;
+	recording_lists.clear();
+	submit_lists.clear();
+	const UINT ring_index = frame_ring->GetFrameIndex();
+	for (size_t i = 0; i < list_count; i++) {
+		RHI::CommandList* target = command_lists[i].get();
+		if (frame_capture) {
+			capture_lists.push_back(std::make_unique<CaptureCommandList>(command_lists[i].get()));
+			target = capture_lists.back().get();
+		}
+		state_filters[i]->SetInner(target);
+		target = state_filters[i].get();
+
+		// Reset allocators and lists, the frame ring guarantees the GPU is done with these allocators
+		RHI::CommandAllocator* command_allocator = frame_resources[ring_index].command_allocators[i].get();
+		command_allocator->Reset();
+		target->Reset(command_allocator, nullptr);
+		recording_lists.push_back(target);
+		submit_lists.push_back(command_lists[i].get());
+	}
+
+	// The graph places the back buffer transitions around the scene pass
+	RHI::Resource* render_target = render_targets[frame_index].get();
+	render_graph.SetImportedResource(back_buffer, render_target);
+	render_graph.Execute(*recording_lists[0]);
+
+	// Requests wait for a free slot rather than stalling on older screenshots,
+	// and for the capture to end since readback buffers are not part of it
+	RHI::CommandList* last = recording_lists.back();
+	if (screenshot_requested && readbacks->HasFreeSlot() && !frame_capture) {
+		screenshot_requested = false;
+		RHI::ResourceBarrier to_copy_source = { render_target, RHI::ResourceState::Present, RHI::ResourceState::CopySource };
+		last->ResourceBarrier(1, &to_copy_source);
+		screenshots.push_back(readbacks->ReadTexture(*last, render_target, frame_ring->GetCurrentFenceValue()));
+		RHI::ResourceBarrier to_present = { render_target, RHI::ResourceState::CopySource, RHI::ResourceState::Present };
+		last->ResourceBarrier(1, &to_present);
+	}
 
-	// Close command list
-	ThrowIfFailed(command_list->Close());
+	// Close command lists
+	for (RHI::CommandList* target : recording_lists)
+		target->Close();
+
+	if (frame_capture) {
+		for (const std::unique_ptr<CaptureCommandList>& capture_list : capture_lists)
+			frame_capture->AddCommandList(RHI::CommandListType::Direct, capture_list->GetStream());
+	}
 }
 
-void Renderer::WaitForPreviousFrame()
+void Renderer::CullDraws()
 {
-	// WAITING FOR THE FRAME TO COMPLETE BEFORE CONTINUING IS NOT BEST PRACTICE.
-	// Signal and increment the fence value.
-	const UINT64 prev_fence_vale = fence_value;
-	ThrowIfFailed(command_queue->Signal(fence.Get(), prev_fence_vale));
-	fence_value++;
+	// Boxes are in object space, so they are tested against the whole world-view-projection
+	XMFLOAT4X4 transform;
+	XMStoreFloat4x4(&transform, mvp);
+	if (frustum_culling) {
+		frustum_culler.Cull(&transform.m[0][0], culled_indices);
+	} else {
+		culled_indices.resize(draws.size());
+		for (uint32_t i = 0; i < draws.size(); i++)
+			culled_indices[i] = i;
+	}
+
+	if (pvs_culling && !pvs.IsEmpty())
+		CullHiddenDraws();
+
+	if (occlusion_culling)
+		CullOccludedDraws(&transform.m[0][0]);
 
-	if (fence->GetCompletedValue() < prev_fence_vale) {
-		ThrowIfFailed(fence->SetEventOnCompletion(prev_fence_vale, fence_event));
-		WaitForSingleObject(fence_event, INFINITE);
+	if (sort_draws)
+		SortDraws();
+
+	// Bundles hold the visible draws, they are re-recorded only when the set or its order changes
+	if (culled_indices != visible_indices) {
+		visible_indices.swap(culled_indices);
+		scene_version++;
 	}
+	visible_draws.clear();
+	for (uint32_t index : visible_indices)
+		visible_draws.push_back(draws[index]);
+}
+
+void Renderer::CullHiddenDraws()
+{
+	// Outside the baked cells nothing is known and every draw stays
+	const uint32_t cell = pvs.FindCell(x / model_scale, y / model_scale, z / model_scale);
+	if (cell == PotentiallyVisibleSet::no_cell)
+		return;
+	size_t count = 0;
+	for (uint32_t index : culled_indices) {
+		if (pvs.IsVisible(cell, index))
+			culled_indices[count++] = index;
+	}
+	culled_indices.resize(count);
+}
+
+void Renderer::SortDraws()
+{
+	// Every draw is in the scene pass, the depth pre-pass records the same order
+	draw_packets.clear();
+	for (uint32_t index : culled_indices) {
+		const Aabb& bounds = draw_bounds[index];
+		const float dx = (bounds.min[0] + bounds.max[0]) * .5f * model_scale - x;
+		const float dy = (bounds.min[1] + bounds.max[1]) * .5f * model_scale - y;
+		const float dz = (bounds.min[2] + bounds.max[2]) * .5f * model_scale - z;
+		const uint32_t depth = DrawKey::QuantizeDepth(sqrtf(dx * dx + dy * dy + dz * dz), far_plane);
+		draw_packets.push_back({ DrawKey::Make(0, draws[index].features, draw_materials[index], depth), index });
+	}
+	draw_sorter.Sort(draw_packets);
+	for (size_t i = 0; i < draw_packets.size(); i++)
+		culled_indices[i] = draw_packets[i].draw;
+}
+
+void Renderer::CullOccludedDraws(const float* transform)
+{
+	// Occluders outside the view can't hide anything in it
+	occlusion_culler->Begin(transform);
+	for (uint32_t index : culled_indices) {
+		if (draw_occluders[index])
+			occlusion_culler->AddOccluder(&vertex_positions[draws[index].start_vertex].x, draws[index].vertex_count);
+	}
+	occlusion_culler->Rasterize();
+	occlusion_culler->Test(draw_bounds.data(), culled_indices.data(), culled_indices.size(), unoccluded_indices);
+	culled_indices.swap(unoccluded_indices);
+
+	const OcclusionCuller::Stats& stats = occlusion_culler->GetStats();
+	occlusion_totals.occluder_triangles += stats.occluder_triangles;
+	occlusion_totals.tested_boxes += stats.tested_boxes;
+	occlusion_totals.occluded_boxes += stats.occluded_boxes;
+	occlusion_totals.rasterize_ms += stats.rasterize_ms;
+	occlusion_totals.test_ms += stats.test_ms;
+	if (++occlusion_frames < occlusion_report_frames)
+		return;
+	const double culled_percent = occlusion_totals.tested_boxes ? 100.0 * occlusion_totals.occluded_boxes / occlusion_totals.tested_boxes : 0.0;
+	OutputDebugString((L"Occlusion culling " + std::to_wstring(culled_percent) + L"% of draws in the view culled, per frame "
+		+ std::to_wstring(occlusion_totals.occluder_triangles / occlusion_frames) + L" occluder triangles rasterized in "
+		+ std::to_wstring(occlusion_totals.rasterize_ms / occlusion_frames) + L" ms, "
+		+ std::to_wstring(occlusion_totals.tested_boxes / occlusion_frames) + L" boxes tested in "
+		+ std::to_wstring(occlusion_totals.test_ms / occlusion_frames) + L" ms\n").c_str());
+	occlusion_totals = {};
+	occlusion_frames = 0;
+}
+
+void Renderer::RecordDepthPass(RenderGraph::Context& context)
+{
+	// One list is enough, the scene pass recording in parallel after it appends to the same first list
+	FrameResources& frame_resource = frame_resources[frame_ring->GetFrameIndex()];
+	if (use_bundles)
+		RecordFrameWithBundle(context.GetCommandList(), depth_frame, frame_resource.depth_bundle.get());
+	else
+		RecordFrame(context.GetCommandList(), depth_frame, visible_draws);
+}
+
+void Renderer::RecordScenePass(RenderGraph::Context& context)
+{
+	FrameResources& frame_resource = frame_resources[frame_ring->GetFrameIndex()];
+	if (use_bundles)
+		RecordFrameWithBundle(context.GetCommandList(), scene_frame, frame_resource.bundle.get());
+	else if (recording_lists.size() == 1)
+		RecordFrame(context.GetCommandList(), scene_frame, visible_draws);
+	else
+		RecordFrameParallel(thread_pool, recording_lists.data(), static_cast<uint32_t>(recording_lists.size()), scene_frame, visible_draws);
+	// The lists execute in order, what follows the pass goes after the last one's draws
+	context.SetCommandList(*recording_lists.back());
+}
+
+void Renderer::RecordBundles(FrameResources& frame_resource)
+{
+	// The frame ring guarantees the GPU is done with the frames that executed these bundles
+	frame_resource.bundle_allocator->Reset();
+	RecordBundle(frame_resource.bundle_allocator.get(), frame_resource.bundle.get(), scene_frame);
+	if (depth_prepass)
+		RecordBundle(frame_resource.bundle_allocator.get(), frame_resource.depth_bundle.get(), depth_frame);
+	frame_resource.bundle_version = scene_version;
+}
+
+void Renderer::RecordBundle(RHI::CommandAllocator* allocator, RHI::CommandList* bundle, const FrameContext& frame)
+{
+	RHI::CommandList* target = bundle;
+	std::unique_ptr<CaptureCommandList> capture_bundle;
+	if (frame_capture) {
+		capture_bundle = std::make_unique<CaptureCommandList>(target);
+		target = capture_bundle.get();
+	}
+	bundle_filter->SetInner(target);
+
+	bundle_filter->Reset(allocator, nullptr);
+	RecordDraws(*bundle_filter, frame, visible_draws.data(), visible_draws.size());
+	bundle_filter->Close();
+
+	if (frame_capture)
+		frame_capture->AddBundle(bundle, capture_bundle->GetStream());
+}
+
+void Renderer::SetDrawFeatures(uint32_t features)
+{
+	draw_features = features;
+	for (DrawItem& draw : draws)
+		draw.features = features;
+	scene_version++;
+}
+
+void Renderer::SetDepthPrepass(bool enabled)
+{
+	// The graph places a new depth texture, the GPU must be done with the old one
+	frame_ring->WaitForIdle(*command_queue);
+	depth_prepass = enabled;
+	BuildRenderGraph();
+	scene_version++;
+}
+
+void Renderer::MeasureOverdraw()
+{
+	// Pixel shader invocations of the current view in software, the GPU doesn't count them
+	std::vector<OverdrawCounter::ClipVertex> clip_vertices;
+	clip_vertices.reserve(vertex_positions.size());
+	for (const XMFLOAT3& position : vertex_positions) {
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&position), mvp));
+		clip_vertices.push_back({ clip.x, clip.y, clip.z, clip.w });
+	}
+
+	OverdrawCounter counter(width, height);
+	auto measure = [&](const std::vector<OverdrawCounter::Pass>& passes) {
+		counter.ClearDepth();
+		counter.ResetStats();
+		for (const OverdrawCounter::Pass& pass : passes)
+			counter.Draw(clip_vertices.data(), clip_vertices.size(), pass);
+		return counter.GetStats().shaded_pixels;
+	};
+	const uint64_t no_depth = measure({ { OverdrawCounter::DepthTest::None, false, true } });
+	const uint64_t depth_test = measure({ { OverdrawCounter::DepthTest::Less, true, true } });
+	const uint64_t prepass = measure({ { OverdrawCounter::DepthTest::Less, true, false }, { OverdrawCounter::DepthTest::Equal, false, true } });
+
+	const double pixels = static_cast<double>(width) * height;
+	OutputDebugString((L"Pixel shader invocations without depth " + std::to_wstring(no_depth) + L" (" + std::to_wstring(no_depth / pixels)
+		+ L" per pixel), depth test " + std::to_wstring(depth_test) + L" (" + std::to_wstring(depth_test / pixels) + L"), depth pre-pass "
+		+ std::to_wstring(prepass) + L" (" + std::to_wstring(prepass / pixels) + L")\n").c_str());
+}
+
+void Renderer::MoveToNextFrame()
+{
+	// Blocks only when all frames in flight are still queued on the GPU
+	frame_ring->MoveToNextFrame(*command_queue);
+	constant_buffers->BeginFrame(frame_ring->GetFrameIndex());
+	descriptors->BeginFrame(frame_ring->GetFrameIndex());
+	deferred_releases.Collect(frame_ring->GetCompletedFenceValue());
+	uploader->Retire();
+	readbacks->Poll(frame_ring->GetCompletedFenceValue());
+	SaveScreenshots();
 
 	frame_index = swap_chain->GetCurrentBackBufferIndex();
 }
 
+void Renderer::ReleaseBuffer(GpuAllocation& allocation)
+{
+	// Frames recorded so far may still read the buffer
+	deferred_releases.Defer([this, buffer = std::move(allocation)]() mutable { heap_allocator->Release(buffer); },
+		frame_ring->GetCurrentFenceValue());
+}
+
+void Renderer::BeginCapture()
+{
+	frame_capture = std::make_unique<FrameCapture>();
+
+	// Declare everything the frame references, with its current contents
+	frame_capture->AddRootSignature(root_signature.get());
+	for (const std::unique_ptr<RHI::PipelineState>& pipeline_state : pipeline_states)
+		frame_capture->AddPipelineState(pipeline_state.get());
+	frame_capture->AddDescriptorHeap(rtv_descriptors->GetHeap());
+	frame_capture->AddDescriptorHeap(dsv_descriptors->GetHeap());
+	frame_capture->AddDescriptorHeap(descriptors->GetHeap());
+	for (UINT i = 0; i < frame_number; i++) {
+		frame_capture->AddResource(render_targets[i].get(), RHI::HeapType::Default);
+		frame_capture->AddRenderTargetView(rtv_descriptors->GetHeap(), rtv_indices[i], render_targets[i].get());
+	}
+	RHI::Resource* depth_texture = render_graph.GetResource(depth_buffer);
+	frame_capture->AddResource(depth_texture, RHI::HeapType::Default);
+	frame_capture->AddDepthStencilView(dsv_descriptors->GetHeap(), dsv_index, depth_texture, false);
+	frame_capture->AddDepthStencilView(dsv_descriptors->GetHeap(), read_only_dsv_index, depth_texture, true);
+	frame_capture->AddResource(vertex_buffer.resource.get(), RHI::HeapType::Default);
+	frame_capture->AddResourceData(vertex_buffer.resource.get(), 0, vertices.data(), SceneVertexFormat::stride * vertices.size());
+	frame_capture->AddResource(constant_buffers->GetResource(), RHI::HeapType::Upload);
+	for (uint32_t frame = 0; frame < object_constant_views.size(); frame++)
+		frame_capture->AddConstantBufferView(descriptors->GetHeap(), object_constant_views[frame], constant_buffers->GetResource(),
+			constant_buffers->GetOffset(object_constants, frame), constant_buffers->GetSize(object_constants));
+}
+
+void Renderer::EndCapture()
+{
+	frame_capture->EndFrame();
+
+	std::wstring capture_path = GetBinPath(L"frame_capture.bin");
+	frame_capture->Save(std::string(capture_path.begin(), capture_path.end()));
+	OutputDebugString((L"Frame captured to " + capture_path + L"\n").c_str());
+
+	frame_capture.reset();
+}
+
+void Renderer::SaveScreenshots()
+{
+	// Futures resolve in submission order, so only the front needs checking
+	while (!screenshots.empty() && screenshots.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+		ReadbackImage image = screenshots.front().get();
+		screenshots.pop_front();
+
+		std::wstring path = GetBinPath(L"screenshot_" + std::to_wstring(screenshot_count++) + L".ppm");
+		SaveImagePpm(image, std::string(path.begin(), path.end()));
+		OutputDebugString((L"Screenshot saved to " + path + L"\n").c_str());
+	}
+}
+
+// D3DCompile is reentrant, so misses can compile on several threads
+static std::vector<uint8_t> CompileShader(const std::string& source, const ShaderVariant& variant)
+{
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (const ShaderDefine& define : variant.defines)
+		macros.push_back({ define.name.c_str(), define.value.c_str() });
+	macros.push_back({ nullptr, nullptr });
+
+	ComPtr<ID3DBlob> bytecode;
+	ComPtr<ID3DBlob> error;
+	HRESULT result = D3DCompile(source.data(), source.size(), "shaders.hlsl", macros.data(), nullptr,
+		variant.entry_point.c_str(), variant.target.c_str(), variant.flags, 0, &bytecode, &error);
+	if (error)
+		OutputDebugStringA(static_cast<const char*>(error->GetBufferPointer()));
+	ThrowIfFailed(result);
+
+	const uint8_t* data = static_cast<const uint8_t*>(bytecode->GetBufferPointer());
+	return std::vector<uint8_t>(data, data + bytecode->GetBufferSize());
+}
+
+std::vector<std::vector<uint8_t>> Renderer::LoadShaders(const std::string& source, const char* entry_point, const char* stage,
+	const std::vector<std::vector<ShaderDefine>>& permutations, ShaderLoadStats& stats)
+{
+#ifndef _DEBUG
+	// The build compiles optimized shader model 6.0 bytecode with DXC, which older runtimes can't load
+	D3D12_FEATURE_DATA_SHADER_MODEL shader_model = { D3D_SHADER_MODEL_6_0 };
+	const bool dxil_supported = SUCCEEDED(device->GetNative()->CheckFeatureSupport(D3D12_FEATURE_SHADER_MODEL, &shader_model, sizeof(shader_model)))
+		&& shader_model.HighestShaderModel >= D3D_SHADER_MODEL_6_0;
+#endif // _DEBUG
+
+	std::vector<std::vector<uint8_t>> bytecode(permutations.size());
+	std::vector<ShaderVariant> variants(permutations.size());
+	std::vector<size_t> misses;
+	for (size_t i = 0; i < permutations.size(); i++) {
+		ShaderVariant& variant = variants[i];
+		variant = { entry_point, std::string(stage) + "_6_0", permutations[i], 0 };
+#ifndef _DEBUG
+		if (dxil_supported) {
+			if (const std::vector<uint8_t>* cached = shader_cache.Find(GetShaderKey(source, variant))) {
+				bytecode[i] = *cached;
+				stats.offline++;
+				continue;
+			}
+		}
+#endif // _DEBUG
+
+		// Resource arrays need shader model 5.1
+		variant.target = std::string(stage) + (bindless ? "_5_1" : "_5_0");
+#ifdef _DEBUG
+		variant.flags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#endif // _DEBUG
+		if (const std::vector<uint8_t>* cached = shader_cache.Find(GetShaderKey(source, variant))) {
+			bytecode[i] = *cached;
+			stats.cached++;
+			continue;
+		}
+		misses.push_back(i);
+	}
+
+	thread_pool.ParallelFor(misses.size(), [&](size_t i) { bytecode[misses[i]] = CompileShader(source, variants[misses[i]]); });
+	for (size_t i : misses)
+		shader_cache.Store(GetShaderKey(source, variants[i]), bytecode[i].data(), bytecode[i].size());
+	stats.compiled += static_cast<uint32_t>(misses.size());
+	return bytecode;
+}
+
+std::string Renderer::GetShaderCachePath() const
+{
+	std::wstring path = GetBinPath(L"shader_cache.bin");
+	return std::string(path.begin(), path.end());
+}
+
+std::string Renderer::GetPipelineCachePath() const
+{
+	std::wstring path = GetBinPath(L"pipeline_cache.bin");
+	return std::string(path.begin(), path.end());
+}
+
 std::wstring Renderer::GetBinPath(std::wstring shader_file) const
 {
 	WCHAR buffer[MAX_PATH];
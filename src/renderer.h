@@ -2,18 +2,38 @@
 
 #include "dx12_labs.h"
 
+#include "constant_buffer_manager.h"
+#include "copy_uploader.h"
+#include "deferred_release.h"
+#include "descriptor_allocator.h"
+#include "draw_sorter.h"
+#include "frame_capture.h"
+#include "frame_recorder.h"
+#include "frame_ring.h"
+#include "frustum_culler.h"
+#include "gpu_heap_allocator.h"
+#include "occlusion_culler.h"
+#include "overdraw_counter.h"
+#include "parallel_for.h"
+#include "pipeline_cache.h"
+#include "pvs.h"
+#include "readback_ring.h"
+#include "render_graph.h"
+#include "shader_permutations.h"
+#include "rhi_d3d12.h"
+#include "state_filter.h"
+#include "vertex_formats.h"
 #include "win32_window.h"
 
 class Renderer
 {
 public:
-	Renderer(UINT width, UINT height) : width(width), height(height), title(L"DX12 renderer"), frame_index(0), rtv_descriptor_size(0)
+	Renderer(UINT width, UINT height, UINT frames_in_flight = 2)
+		: width(width), height(height), title(L"DX12 renderer"), frames_in_flight(frames_in_flight), frame_index(0)
 	{
-		view_port = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height));
-		scissor_rect = CD3DX12_RECT(0, 0, static_cast<LONG>(width), static_cast<LONG>(height));
+		view_port = { 0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f, 1.0f };
+		scissor_rect = { 0, 0, static_cast<int32_t>(width), static_cast<int32_t>(height) };
 		vertex_buffer_view = {};
-		fence_value = 0;
-		fence_event = nullptr;
 
 		mvp = XMMatrixIdentity();
 
@@ -44,43 +64,199 @@ protected:
 	std::wstring title;
 
 	static const UINT frame_number = 2;
+	// Frames the CPU may record ahead of the GPU, independent of the swap chain length
+	UINT frames_in_flight;
+	// Persistent constants, one copy of this size per frame in flight
+	static const UINT constant_buffer_capacity = 64 * 1024;
+	static const UINT rtv_capacity = 64;
+	static const UINT dsv_capacity = 4;
+	static const UINT persistent_descriptor_capacity = 4096;
+	static const UINT transient_descriptor_capacity = 4096;
+	// Draws are recorded on up to this many command lists in parallel, each list gets at least min_draws_per_list
+	static const UINT max_recording_lists = 8;
+	static const size_t min_draws_per_list = 512;
+	// Depth buffer the occlusion culler rasterizes occluders into, stretched over the whole view
+	static const UINT occlusion_width = 256;
+	static const UINT occlusion_height = 144;
+	// Threads of thread_pool the occlusion culler rasterizes and tests boxes on
+	static const UINT occlusion_threads = 4;
+	// Occlusion culling statistics are averaged over this many frames
+	static const UINT occlusion_report_frames = 256;
+	// The model is drawn at this scale, the camera moves in world units
+	static constexpr float model_scale = .5f;
+	// Far plane of the projection, draws farther away share the last depth bucket of their sort key
+	static constexpr float far_plane = 100.f;
+	// Staging memory for static data, larger uploads are split
+	static const UINT64 staging_size = 16 * 1024 * 1024;
+
+	// Everything the GPU may still read while the CPU records the next frame
+	struct FrameResources
+	{
+		// One per recording command list, lists record concurrently
+		std::vector<std::unique_ptr<RHI::CommandAllocator>> command_allocators;
+		// Static draws of the scene, per frame since draws read this frame's constants
+		std::unique_ptr<RHI::CommandAllocator> bundle_allocator;
+		std::unique_ptr<RHI::CommandList> bundle;
+		// The same draws for the depth pre-pass, from the same allocator
+		std::unique_ptr<RHI::CommandList> depth_bundle;
+		// scene_version the bundles were recorded at
+		uint64_t bundle_version = 0;
+	};
+
+	// Where LoadShader found each shader
+	struct ShaderLoadStats
+	{
+		uint32_t offline;
+		uint32_t cached;
+		uint32_t compiled;
+	};
 
 	// Pipeline objects.
-	ComPtr<ID3D12Device> device;
-	ComPtr<ID3D12CommandQueue> command_queue;
+	std::unique_ptr<RHI::D3D12Device> device;
+	// Root signatures and pipelines persisted across runs in pipeline_cache.bin
+	PipelineCache pipeline_cache;
+	std::unique_ptr<RHI::D3D12PipelineLibrary> pipeline_library;
+	// Bytecode compiled by the build into shader_cache.bin, runtime compilations are added to it
+	PipelineCache shader_cache;
+	std::unique_ptr<RHI::CommandQueue> command_queue;
 	ComPtr<IDXGISwapChain3> swap_chain;
-	ComPtr<ID3D12DescriptorHeap> rtv_heap;
-	ComPtr<ID3D12DescriptorHeap> cbv_heap;
-	UINT rtv_descriptor_size;
-	ComPtr<ID3D12Resource> render_targets[frame_number];
-	ComPtr<ID3D12CommandAllocator> command_allocator;
-	ComPtr<ID3D12PipelineState> pipeline_state;
-	ComPtr<ID3D12GraphicsCommandList> command_list;
-
-	ComPtr<ID3D12RootSignature> root_signature;
-	CD3DX12_VIEWPORT view_port;
-	CD3DX12_RECT scissor_rect;
+	std::unique_ptr<DescriptorAllocator> rtv_descriptors;
+	UINT rtv_indices[frame_number];
+	// Writable and read only views of the depth buffer
+	std::unique_ptr<DescriptorAllocator> dsv_descriptors;
+	UINT dsv_index;
+	UINT read_only_dsv_index;
+	// Shader visible CBV/SRV/UAV heap, draws index it directly when bindless is supported
+	std::unique_ptr<DescriptorAllocator> descriptors;
+	bool bindless = false;
+	std::unique_ptr<RHI::Resource> render_targets[frame_number];
+	std::vector<FrameResources> frame_resources;
+	// One pipeline per pixel feature mask, masks resolving to the same permutation share it. The first
+	// half tests LESS and writes depth, the second tests EQUAL against the pre-pass depth without
+	// writing it. Bump mapping only changes the point light, so it requires it.
+	ShaderPermutationSet pixel_features = ShaderPermutationSet({ "BUMP_MAPPING", "POINT_LIGHT" }, { { "BUMP_MAPPING", "POINT_LIGHT" } });
+	std::vector<std::unique_ptr<RHI::PipelineState>> pipeline_states;
+	std::vector<RHI::PipelineState*> pipeline_state_table;
+	// The depth pre-pass pipeline for every feature mask
+	std::vector<RHI::PipelineState*> depth_pipeline_table;
+	// Features of every draw, toggled with the B and L keys
+	uint32_t draw_features = 0;
+	// Bumped whenever draws change, bundles recorded at an older version are re-recorded
+	uint64_t scene_version = 1;
+	// Static draws replay from bundles, toggled with the R key to compare against recording them every frame
+	bool use_bundles = true;
+	// Lays down depth before the scene so each pixel shades once, toggled with the Z key
+	bool depth_prepass = true;
+	// Skips shapes outside the view, toggled with the F key
+	bool frustum_culling = true;
+	// Skips shapes hidden behind the large ones, toggled with the H key
+	bool occlusion_culling = true;
+	// Skips shapes the baked potentially visible set hides from the camera's cell, toggled with the V key
+	bool pvs_culling = true;
+	// Records draws sorted by pipeline, material and depth instead of in model order, toggled with the K key
+	bool sort_draws = true;
+	// Workers for everything parallel in a frame, started once instead of on every loop.
+	// Declared before the members that use it so it outlives them.
+	ThreadPool thread_pool;
+	std::unique_ptr<StateFilterCommandList> bundle_filter;
+	std::vector<std::unique_ptr<RHI::CommandList>> command_lists;
+	std::vector<std::unique_ptr<StateFilterCommandList>> state_filters;
+	// Lists recorded this frame, in submission order
+	std::vector<RHI::CommandList*> submit_lists;
+	// Wrappers of submit_lists that recording goes through
+	std::vector<RHI::CommandList*> recording_lists;
+
+	// Passes of a frame and the barriers between them, declared and compiled once
+	RenderGraph render_graph;
+	RenderGraph::ResourceHandle back_buffer;
+	RenderGraph::ResourceHandle depth_buffer;
+	// What the passes record, set before the graph executes
+	FrameContext scene_frame = {};
+	FrameContext depth_frame = {};
+
+	std::unique_ptr<RHI::RootSignature> root_signature;
+	RHI::Viewport view_port;
+	RHI::Rect scissor_rect;
 
 	// Resources
-	ComPtr<ID3D12Resource> vertex_buffer;
-	D3D12_VERTEX_BUFFER_VIEW vertex_buffer_view;
-	std::vector<ColorVertex> vertices;
+	std::unique_ptr<CopyUploader> uploader;
+	// Static buffers are placed in shared heaps, declared first so it outlives them
+	std::unique_ptr<GpuHeapAllocator> heap_allocator;
+	GpuAllocation vertex_buffer;
+	RHI::VertexBufferView vertex_buffer_view;
+	// Switch to VertexFormats::Compact or Half to compare vertex formats
+	using SceneVertexFormat = VertexFormats::Standard;
+	std::vector<SceneVertexFormat::Vertex> vertices;
+	// Positions of vertices, the overdraw counter transforms them on the CPU
+	std::vector<XMFLOAT3> vertex_positions;
+	// One draw per shape of the model, with its bounding box in frustum_culler under the same index
+	std::vector<DrawItem> draws;
+	FrustumCuller frustum_culler;
+	std::vector<Aabb> draw_bounds;
+	// Draws large enough to hide others, rasterized by the occlusion culler when in the view
+	std::vector<bool> draw_occluders;
+	std::unique_ptr<OcclusionCuller> occlusion_culler;
+	OcclusionCuller::Stats occlusion_totals = {};
+	UINT occlusion_frames = 0;
+	// Baked offline in model space by the PVS baker, empty when missing or baked for another model
+	PotentiallyVisibleSet pvs;
+	// Material of every draw, the third field of its sort key
+	std::vector<uint32_t> draw_materials;
+	DrawSorter draw_sorter{ thread_pool };
+	std::vector<DrawPacket> draw_packets;
+	// Indices of the draws in the view and the draws the frame records, in recording order
+	std::vector<uint32_t> visible_indices;
+	std::vector<DrawItem> visible_draws;
+	std::vector<uint32_t> culled_indices;
+	std::vector<uint32_t> unoccluded_indices;
 
 	// Synchronization objects.
 	UINT frame_index;
-	HANDLE fence_event;
-	ComPtr<ID3D12Fence> fence;
-	UINT64 fence_value;
+	std::unique_ptr<FrameRing> frame_ring;
+	// Objects replaced while frames are in flight, declared after what its releases refer to
+	DeferredReleaseQueue deferred_releases;
 
 	XMMATRIX mvp;
-	ComPtr<ID3D12Resource> constant_buffer;
-	UINT8* const_data_begin;
+	std::unique_ptr<ConstantBufferManager> constant_buffers;
+	uint32_t object_constants;
+	// Bindless view of object_constants per frame copy
+	std::vector<uint32_t> object_constant_views;
 
 	float aspect_ratio;
 
+	// Frame capture, requested with the C key
+	bool capture_requested = false;
+	std::unique_ptr<FrameCapture> frame_capture;
+
+	// Screenshots, requested with the P key and saved once the GPU has finished the frame
+	bool screenshot_requested = false;
+	std::unique_ptr<ReadbackRing> readbacks;
+	std::deque<std::future<ReadbackImage>> screenshots;
+	uint32_t screenshot_count = 0;
+
 	void LoadPipeline();
 	void LoadAssets();
 	void PopulateCommandList();
-	void WaitForPreviousFrame();
+	void BuildRenderGraph();
+	void CullDraws();
+	void CullHiddenDraws();
+	void SortDraws();
+	void CullOccludedDraws(const float* transform);
+	void RecordDepthPass(RenderGraph::Context& context);
+	void RecordScenePass(RenderGraph::Context& context);
+	void RecordBundles(FrameResources& frame_resource);
+	void RecordBundle(RHI::CommandAllocator* allocator, RHI::CommandList* bundle, const FrameContext& frame);
+	void SetDrawFeatures(uint32_t features);
+	void SetDepthPrepass(bool enabled);
+	void MeasureOverdraw();
+	void MoveToNextFrame();
+	void ReleaseBuffer(GpuAllocation& allocation);
+	void BeginCapture();
+	void EndCapture();
+	void SaveScreenshots();
+	std::vector<std::vector<uint8_t>> LoadShaders(const std::string& source, const char* entry_point, const char* stage,
+		const std::vector<std::vector<ShaderDefine>>& permutations, ShaderLoadStats& stats);
+	std::string GetShaderCachePath() const;
+	std::string GetPipelineCachePath() const;
 	std::wstring GetBinPath(std::wstring shader_file) const;
 };
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include "frame_replay.h"
+#include "rhi_null.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Replays a frame capture on the null backend and reports CPU timings
+int main(int argc, char** argv)
+{
+	const char* capture_path = nullptr;
+	int iterations = 100;
+	bool filter_state = false;
+	uint32_t frames_in_flight = 2;
+	double gpu_latency_ms = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--filter-state") == 0)
+			filter_state = true;
+		else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+			frames_in_flight = static_cast<uint32_t>(std::max(1, atoi(argv[++i])));
+		else if (strcmp(argv[i], "--gpu-latency-ms") == 0 && i + 1 < argc)
+			gpu_latency_ms = std::max(0.0, atof(argv[++i]));
+		else if (!capture_path)
+			capture_path = argv[i];
+		else
+			iterations = std::max(1, atoi(argv[i]));
+	}
+
+	if (!capture_path) {
+		printf("Usage: %s [--filter-state] [--frames-in-flight N] [--gpu-latency-ms X] <capture file> [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	try
+	{
+		RHI::NullDevice device;
+		FrameReplay replay(capture_path);
+		replay.SetFramesInFlight(frames_in_flight);
+		replay.Prepare(device,
+			[&](uint32_t) { return device.CreateRootSignature(); },
+			[&](uint32_t) { return device.CreatePipelineState(); });
+		if (filter_state)
+			replay.EnableStateFilter();
+		// Every submission keeps the simulated GPU busy, so frames in flight can hide its latency
+		static_cast<RHI::NullCommandQueue*>(replay.GetQueue())->SetSimulatedGpuTime(
+			std::chrono::microseconds(static_cast<int64_t>(gpu_latency_ms * 1000.0)));
+
+		std::vector<double> frame_ms;
+		size_t commands = 0;
+		double record_ms = 0, upload_ms = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; i++) {
+			for (const ReplayFrameTiming& timing : replay.Run()) {
+				frame_ms.push_back(timing.record_ms + timing.execute_ms + timing.upload_ms);
+				record_ms += timing.record_ms;
+				upload_ms += timing.upload_ms;
+				commands += timing.commands;
+			}
+		}
+		const double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		if (frame_ms.empty()) {
+			printf("%s contains no complete frames\n", capture_path);
+			return 1;
+		}
+
+		std::sort(frame_ms.begin(), frame_ms.end());
+		const double frames = static_cast<double>(frame_ms.size());
+		double total_ms = 0;
+		for (double ms : frame_ms)
+			total_ms += ms;
+
+		printf("Frames per iteration: %u, iterations: %d\n", replay.GetFrameCount(), iterations);
+		printf("Commands per frame:   %.0f\n", commands / frames);
+		printf("Frame ms  avg %.4f  min %.4f  median %.4f  max %.4f\n",
+			total_ms / frames, frame_ms.front(), frame_ms[frame_ms.size() / 2], frame_ms.back());
+		printf("Record ms avg %.4f  upload ms avg %.4f\n", record_ms / frames, upload_ms / frames);
+		printf("Frames in flight: %u, GPU ms per submission: %.3f\n", frames_in_flight, gpu_latency_ms);
+		printf("Throughput: %.1f frames/s, stalls: %llu\n", frames * 1000.0 / wall_ms,
+			static_cast<unsigned long long>(replay.GetFrameRing()->GetStallCount()));
+
+		if (const StateFilterStats* stats = replay.GetStateFilterStats()) {
+			printf("\n%-36s %12s %12s\n", "Command", "issued", "elided");
+			for (size_t id = 0; id < static_cast<size_t>(RHI::CommandId::Count); id++) {
+				if (stats->issued[id] + stats->elided[id] == 0)
+					continue;
+				printf("%-36s %12.1f %12.1f\n", RHI::GetCommandName(static_cast<RHI::CommandId>(id)),
+					stats->issued[id] / frames, stats->elided[id] / frames);
+			}
+			printf("%-36s %12.1f %12.1f\n", "Barrier transitions", stats->barriers_issued / frames,
+				(stats->barriers_requested - stats->barriers_issued) / frames);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		printf("Replay failed: %s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,441 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Thin render hardware interface.
+// Mirrors the subset of D3D12 the renderer uses. Enum values match their D3D12
+// counterparts so the D3D12 backend can pass them straight through.
+namespace RHI
+{
+	enum class CommandListType : uint32_t
+	{
+		Direct = 0,
+		Bundle = 1,
+		Compute = 2,
+		Copy = 3
+	};
+
+	enum class HeapType : uint32_t
+	{
+		Default = 1,
+		Upload = 2,
+		Readback = 3
+	};
+
+	enum class DescriptorHeapType : uint32_t
+	{
+		CbvSrvUav = 0,
+		Sampler = 1,
+		Rtv = 2,
+		Dsv = 3
+	};
+
+	enum class ResourceState : uint32_t
+	{
+		Common = 0,
+		VertexAndConstantBuffer = 0x1,
+		IndexBuffer = 0x2,
+		RenderTarget = 0x4,
+		UnorderedAccess = 0x8,
+		DepthWrite = 0x10,
+		DepthRead = 0x20,
+		NonPixelShaderResource = 0x40,
+		PixelShaderResource = 0x80,
+		CopyDest = 0x400,
+		CopySource = 0x800,
+		GenericRead = 0x1 | 0x2 | 0x40 | 0x80 | 0x200 | 0x800,
+		Present = 0
+	};
+
+	enum class PrimitiveTopology : uint32_t
+	{
+		Undefined = 0,
+		PointList = 1,
+		LineList = 2,
+		LineStrip = 3,
+		TriangleList = 4,
+		TriangleStrip = 5
+	};
+
+	enum class Format : uint32_t
+	{
+		Unknown = 0,
+		R32G32B32A32Float = 2,
+		R32G32B32Float = 6,
+		R16G16B16A16Float = 10,
+		R32G32Float = 16,
+		R8G8B8A8Unorm = 28,
+		R8G8B8A8Snorm = 31,
+		R16G16Float = 34,
+		D32Float = 40
+	};
+
+	constexpr uint32_t GetFormatSize(Format format)
+	{
+		switch (format)
+		{
+		case Format::R32G32B32A32Float:
+			return 16;
+		case Format::R32G32B32Float:
+			return 12;
+		case Format::R16G16B16A16Float:
+		case Format::R32G32Float:
+			return 8;
+		case Format::R8G8B8A8Unorm:
+		case Format::R8G8B8A8Snorm:
+		case Format::R16G16Float:
+		case Format::D32Float:
+			return 4;
+		default:
+			return 0;
+		}
+	}
+
+	enum class ResourceDimension : uint32_t
+	{
+		Buffer = 1,
+		Texture2D = 3
+	};
+
+	struct CpuDescriptorHandle
+	{
+		size_t ptr;
+	};
+
+	struct GpuDescriptorHandle
+	{
+		uint64_t ptr;
+	};
+
+	struct Viewport
+	{
+		float top_left_x;
+		float top_left_y;
+		float width;
+		float height;
+		float min_depth;
+		float max_depth;
+	};
+
+	struct Rect
+	{
+		int32_t left;
+		int32_t top;
+		int32_t right;
+		int32_t bottom;
+	};
+
+	enum class InputClassification : uint32_t
+	{
+		PerVertex = 0,
+		PerInstance = 1
+	};
+
+	struct InputElementDesc
+	{
+		const char* semantic_name;
+		uint32_t semantic_index;
+		Format format;
+		uint32_t input_slot;
+		uint32_t aligned_byte_offset;
+		InputClassification input_slot_class;
+		uint32_t instance_data_step_rate;
+	};
+
+	enum class ShaderVisibility : uint32_t
+	{
+		All = 0,
+		Vertex = 1,
+		Hull = 2,
+		Domain = 3,
+		Geometry = 4,
+		Pixel = 5
+	};
+
+	enum class RootParameterType : uint32_t
+	{
+		DescriptorTable = 0,
+		Constants = 1,
+		ConstantBufferView = 2,
+		ShaderResourceView = 3,
+		UnorderedAccessView = 4
+	};
+
+	enum class DescriptorRangeType : uint32_t
+	{
+		ShaderResourceView = 0,
+		UnorderedAccessView = 1,
+		ConstantBufferView = 2,
+		Sampler = 3
+	};
+
+	enum class DescriptorRangeFlags : uint32_t
+	{
+		None = 0,
+		DescriptorsVolatile = 0x1,
+		DataVolatile = 0x2,
+		DataStaticWhileSetAtExecute = 0x4,
+		DataStatic = 0x8
+	};
+
+	enum class RootDescriptorFlags : uint32_t
+	{
+		None = 0,
+		DataVolatile = 0x2,
+		DataStaticWhileSetAtExecute = 0x4,
+		DataStatic = 0x8
+	};
+
+	enum class RootSignatureFlags : uint32_t
+	{
+		None = 0,
+		AllowInputAssemblerInputLayout = 0x1,
+		DenyVertexShaderRootAccess = 0x2,
+		DenyHullShaderRootAccess = 0x4,
+		DenyDomainShaderRootAccess = 0x8,
+		DenyGeometryShaderRootAccess = 0x10,
+		DenyPixelShaderRootAccess = 0x20
+	};
+
+	constexpr DescriptorRangeFlags operator|(DescriptorRangeFlags a, DescriptorRangeFlags b)
+	{
+		return static_cast<DescriptorRangeFlags>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
+	}
+
+	constexpr RootDescriptorFlags operator|(RootDescriptorFlags a, RootDescriptorFlags b)
+	{
+		return static_cast<RootDescriptorFlags>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
+	}
+
+	constexpr RootSignatureFlags operator|(RootSignatureFlags a, RootSignatureFlags b)
+	{
+		return static_cast<RootSignatureFlags>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
+	}
+
+	// Root signatures hold at most 64 DWORDs: one per table, two per root descriptor and one per constant
+	static const uint32_t max_root_signature_dwords = 64;
+	static const uint32_t descriptor_range_unbounded = 0xffffffff;
+	static const uint32_t descriptor_range_offset_append = 0xffffffff;
+
+	// Matches D3D12_DESCRIPTOR_RANGE1
+	struct DescriptorRange
+	{
+		DescriptorRangeType type;
+		uint32_t descriptor_count;
+		uint32_t base_shader_register;
+		uint32_t register_space;
+		DescriptorRangeFlags flags;
+		uint32_t offset_in_descriptors_from_table_start;
+	};
+
+	// Tables refer to range_count ranges starting at first_range of RootSignatureDesc::ranges,
+	// constants use value_count, root descriptors use flags
+	struct RootParameter
+	{
+		RootParameterType type;
+		ShaderVisibility visibility;
+		uint32_t shader_register;
+		uint32_t register_space;
+		uint32_t value_count;
+		RootDescriptorFlags flags;
+		uint32_t first_range;
+		uint32_t range_count;
+	};
+
+	struct RootSignatureDesc
+	{
+		const RootParameter* parameters;
+		uint32_t parameter_count;
+		const DescriptorRange* ranges;
+		uint32_t range_count;
+		RootSignatureFlags flags;
+	};
+
+	struct VertexBufferView
+	{
+		uint64_t buffer_location;
+		uint32_t size_in_bytes;
+		uint32_t stride_in_bytes;
+	};
+
+	struct ResourceDesc
+	{
+		ResourceDimension dimension;
+		Format format;
+		uint64_t width;
+		uint32_t height;
+	};
+
+	// Every RHI object gets a process-unique id, used by recording backends
+	// to refer to objects without holding pointers.
+	class Object
+	{
+	public:
+		Object() : id(next_id.fetch_add(1) + 1) {}
+		virtual ~Object() = default;
+
+		Object(const Object&) = delete;
+		Object& operator=(const Object&) = delete;
+
+		uint32_t GetId() const { return id; }
+
+	private:
+		const uint32_t id;
+		static inline std::atomic<uint32_t> next_id{ 0 };
+	};
+
+	class Resource : public Object
+	{
+	public:
+		virtual const ResourceDesc& GetDesc() const = 0;
+		virtual uint64_t GetGpuAddress() const = 0;
+		// Upload and readback heaps only
+		virtual void* Map() = 0;
+		virtual void Unmap() = 0;
+	};
+
+	// Placed buffers must start on this alignment within their heap
+	static const uint64_t default_placement_alignment = 64 * 1024;
+	// Row pitch and offset alignment of texture data copied into buffers
+	static const uint32_t texture_data_pitch_alignment = 256;
+	static const uint64_t texture_data_placement_alignment = 512;
+
+	// Memory that buffers are placed into with Device::CreatePlacedBuffer
+	class Heap : public Object
+	{
+	public:
+		virtual HeapType GetType() const = 0;
+		virtual uint64_t GetSize() const = 0;
+	};
+
+	enum class ResourceBarrierType : uint32_t
+	{
+		Transition = 0,
+		Aliasing = 1
+	};
+
+	struct ResourceBarrier
+	{
+		Resource* resource;
+		ResourceState before;
+		ResourceState after;
+		// Aliasing barriers ignore the states, resource is the placed resource that starts using
+		// memory other placed resources used before
+		ResourceBarrierType type = ResourceBarrierType::Transition;
+	};
+
+	class RootSignature : public Object {};
+	class PipelineState : public Object {};
+
+	class CommandAllocator : public Object
+	{
+	public:
+		virtual void Reset() = 0;
+	};
+
+	class DescriptorHeap : public Object
+	{
+	public:
+		virtual DescriptorHeapType GetType() const = 0;
+		virtual uint32_t GetCapacity() const = 0;
+		virtual uint32_t GetIncrementSize() const = 0;
+		virtual CpuDescriptorHandle GetCpuStart() const = 0;
+		virtual GpuDescriptorHandle GetGpuStart() const = 0;
+
+		CpuDescriptorHandle GetCpuHandle(uint32_t index) const
+		{
+			return { GetCpuStart().ptr + static_cast<size_t>(index) * GetIncrementSize() };
+		}
+		GpuDescriptorHandle GetGpuHandle(uint32_t index) const
+		{
+			return { GetGpuStart().ptr + static_cast<uint64_t>(index) * GetIncrementSize() };
+		}
+	};
+
+	class Fence : public Object
+	{
+	public:
+		virtual uint64_t GetCompletedValue() const = 0;
+		// Blocks the calling thread until the fence reaches value
+		virtual void Wait(uint64_t value) = 0;
+	};
+
+	class CommandList : public Object
+	{
+	public:
+		virtual void Reset(CommandAllocator* allocator, PipelineState* initial_state) = 0;
+		virtual void Close() = 0;
+
+		virtual void SetPipelineState(PipelineState* pipeline_state) = 0;
+		virtual void SetGraphicsRootSignature(RootSignature* root_signature) = 0;
+		virtual void SetDescriptorHeaps(uint32_t count, DescriptorHeap* const* heaps) = 0;
+		virtual void SetGraphicsRootDescriptorTable(uint32_t index, GpuDescriptorHandle base) = 0;
+		virtual void SetGraphicsRootConstantBufferView(uint32_t index, uint64_t address) = 0;
+		virtual void SetGraphicsRoot32BitConstants(uint32_t index, uint32_t count, const void* data, uint32_t dest_offset) = 0;
+
+		virtual void RSSetViewports(uint32_t count, const Viewport* viewports) = 0;
+		virtual void RSSetScissorRects(uint32_t count, const Rect* rects) = 0;
+		virtual void ResourceBarrier(uint32_t count, const RHI::ResourceBarrier* barriers) = 0;
+
+		virtual void OMSetRenderTargets(uint32_t count, const CpuDescriptorHandle* rtvs, const CpuDescriptorHandle* dsv) = 0;
+		virtual void ClearRenderTargetView(CpuDescriptorHandle rtv, const float color[4]) = 0;
+		// Clears depth only, the depth formats have no stencil
+		virtual void ClearDepthStencilView(CpuDescriptorHandle dsv, float depth) = 0;
+
+		virtual void IASetPrimitiveTopology(PrimitiveTopology topology) = 0;
+		virtual void IASetVertexBuffers(uint32_t start_slot, uint32_t count, const VertexBufferView* views) = 0;
+		virtual void DrawInstanced(uint32_t vertex_count, uint32_t instance_count, uint32_t start_vertex, uint32_t start_instance) = 0;
+
+		virtual void CopyBufferRegion(Resource* dst, uint64_t dst_offset, Resource* src, uint64_t src_offset, uint64_t size) = 0;
+		// Copies the whole 2D texture src into buffer dst with rows dst_row_pitch bytes apart
+		virtual void CopyTextureToBuffer(Resource* dst, uint64_t dst_offset, uint32_t dst_row_pitch, Resource* src) = 0;
+
+		// Runs a closed command list of type Bundle. Pipeline state, root signature, root arguments
+		// and geometry it sets stay set afterwards, it inherits the descriptor heaps.
+		virtual void ExecuteBundle(CommandList* bundle) = 0;
+	};
+
+	class CommandQueue : public Object
+	{
+	public:
+		virtual CommandListType GetType() const = 0;
+		virtual void ExecuteCommandLists(uint32_t count, CommandList* const* lists) = 0;
+		virtual void Signal(Fence* fence, uint64_t value) = 0;
+		// GPU side wait, the calling thread does not block
+		virtual void Wait(Fence* fence, uint64_t value) = 0;
+	};
+
+	class Device
+	{
+	public:
+		virtual ~Device() = default;
+
+		virtual std::unique_ptr<CommandQueue> CreateCommandQueue(CommandListType type) = 0;
+		virtual std::unique_ptr<CommandAllocator> CreateCommandAllocator(CommandListType type) = 0;
+		virtual std::unique_ptr<CommandList> CreateCommandList(CommandListType type, CommandAllocator* allocator, PipelineState* initial_state) = 0;
+		virtual std::unique_ptr<Fence> CreateFence(uint64_t initial_value) = 0;
+		virtual std::unique_ptr<DescriptorHeap> CreateDescriptorHeap(DescriptorHeapType type, uint32_t capacity, bool shader_visible) = 0;
+		virtual std::unique_ptr<Resource> CreateBuffer(HeapType heap_type, uint64_t size, ResourceState initial_state) = 0;
+		virtual std::unique_ptr<Heap> CreateHeap(HeapType type, uint64_t size) = 0;
+		// The heap must outlive the buffer, offset must be a multiple of default_placement_alignment
+		virtual std::unique_ptr<Resource> CreatePlacedBuffer(Heap* heap, uint64_t offset, uint64_t size, ResourceState initial_state) = 0;
+		// Depth formats are created as depth stencil targets, everything else as render targets
+		virtual std::unique_ptr<Resource> CreateTexture2D(uint32_t width, uint32_t height, Format format, ResourceState initial_state) = 0;
+		// Heap for render target and depth textures, which keeps it usable on resource heap tier 1 hardware
+		virtual std::unique_ptr<Heap> CreateTextureHeap(uint64_t size) = 0;
+		// Bytes a placed texture takes in a texture heap, a multiple of default_placement_alignment
+		virtual uint64_t GetTexture2DAllocationSize(uint32_t width, uint32_t height, Format format) = 0;
+		// The heap must outlive the texture, textures placed over each other need an aliasing barrier
+		// and a clear before their first use
+		virtual std::unique_ptr<Resource> CreatePlacedTexture2D(Heap* heap, uint64_t offset, uint32_t width, uint32_t height, Format format,
+			ResourceState initial_state) = 0;
+
+		virtual void CreateConstantBufferView(uint64_t address, uint32_t size, CpuDescriptorHandle dest) = 0;
+		virtual void CreateRenderTargetView(Resource* resource, CpuDescriptorHandle dest) = 0;
+		// Read only views can be bound while the texture is in the DepthRead state
+		virtual void CreateDepthStencilView(Resource* resource, CpuDescriptorHandle dest, bool read_only) = 0;
+	};
+}
@@ -0,0 +1,148 @@
+#include "rhi_commands.h"
+
+#include <stdexcept>
+
+namespace RHI
+{
+	const char* GetCommandName(CommandId id)
+	{
+		static const char* names[] = {
+			"SetPipelineState",
+			"SetGraphicsRootSignature",
+			"SetDescriptorHeaps",
+			"SetGraphicsRootDescriptorTable",
+			"SetGraphicsRootConstantBufferView",
+			"SetGraphicsRoot32BitConstants",
+			"RSSetViewports",
+			"RSSetScissorRects",
+			"ResourceBarrier",
+			"OMSetRenderTargets",
+			"ClearRenderTargetView",
+			"ClearDepthStencilView",
+			"IASetPrimitiveTopology",
+			"IASetVertexBuffers",
+			"DrawInstanced",
+			"CopyBufferRegion",
+			"CopyTextureToBuffer",
+			"ExecuteBundle"
+		};
+		static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(CommandId::Count), "Command name table is out of date");
+
+		if (id >= CommandId::Count)
+			return "Unknown";
+		return names[static_cast<size_t>(id)];
+	}
+
+	void RecordingCommandList::Reset(CommandAllocator*, PipelineState* initial_state)
+	{
+		stream.Clear();
+		closed = false;
+		if (initial_state)
+			SetPipelineState(initial_state);
+	}
+
+	void RecordingCommandList::SetPipelineState(PipelineState* pipeline_state)
+	{
+		stream.Push(CommandId::SetPipelineState, Commands::SetPipelineState{ pipeline_state->GetId() });
+	}
+
+	void RecordingCommandList::SetGraphicsRootSignature(RootSignature* root_signature)
+	{
+		stream.Push(CommandId::SetGraphicsRootSignature, Commands::SetGraphicsRootSignature{ root_signature->GetId() });
+	}
+
+	void RecordingCommandList::SetDescriptorHeaps(uint32_t count, DescriptorHeap* const* heaps)
+	{
+		uint32_t ids[2] = {};
+		if (count > 2)
+			throw std::invalid_argument("At most one CBV/SRV/UAV and one sampler heap can be bound");
+		for (uint32_t i = 0; i < count; i++)
+			ids[i] = heaps[i]->GetId();
+		stream.Push(CommandId::SetDescriptorHeaps, Commands::SetDescriptorHeaps{ count }, ids, sizeof(uint32_t) * count);
+	}
+
+	void RecordingCommandList::SetGraphicsRootDescriptorTable(uint32_t index, GpuDescriptorHandle base)
+	{
+		stream.Push(CommandId::SetGraphicsRootDescriptorTable, Commands::SetGraphicsRootDescriptorTable{ index, 0, base.ptr });
+	}
+
+	void RecordingCommandList::SetGraphicsRootConstantBufferView(uint32_t index, uint64_t address)
+	{
+		stream.Push(CommandId::SetGraphicsRootConstantBufferView, Commands::SetGraphicsRootConstantBufferView{ index, 0, address });
+	}
+
+	void RecordingCommandList::SetGraphicsRoot32BitConstants(uint32_t index, uint32_t count, const void* data, uint32_t dest_offset)
+	{
+		stream.Push(CommandId::SetGraphicsRoot32BitConstants, Commands::SetGraphicsRoot32BitConstants{ index, count, dest_offset },
+			data, sizeof(uint32_t) * count);
+	}
+
+	void RecordingCommandList::RSSetViewports(uint32_t count, const Viewport* viewports)
+	{
+		stream.Push(CommandId::RSSetViewports, Commands::RSSetViewports{ count }, viewports, sizeof(Viewport) * count);
+	}
+
+	void RecordingCommandList::RSSetScissorRects(uint32_t count, const Rect* rects)
+	{
+		stream.Push(CommandId::RSSetScissorRects, Commands::RSSetScissorRects{ count }, rects, sizeof(Rect) * count);
+	}
+
+	void RecordingCommandList::ResourceBarrier(uint32_t count, const RHI::ResourceBarrier* barriers)
+	{
+		std::vector<Commands::Barrier> records(count);
+		for (uint32_t i = 0; i < count; i++)
+			records[i] = { barriers[i].resource->GetId(), barriers[i].before, barriers[i].after, barriers[i].type };
+		stream.Push(CommandId::ResourceBarrier, Commands::ResourceBarrier{ count }, records.data(), sizeof(Commands::Barrier) * count);
+	}
+
+	void RecordingCommandList::OMSetRenderTargets(uint32_t count, const CpuDescriptorHandle* rtvs, const CpuDescriptorHandle* dsv)
+	{
+		uint64_t handles[8] = {};
+		if (count > 8)
+			throw std::invalid_argument("At most 8 render targets can be bound");
+		for (uint32_t i = 0; i < count; i++)
+			handles[i] = rtvs[i].ptr;
+		Commands::OMSetRenderTargets command = { count, dsv != nullptr, dsv ? dsv->ptr : 0 };
+		stream.Push(CommandId::OMSetRenderTargets, command, handles, sizeof(uint64_t) * count);
+	}
+
+	void RecordingCommandList::ClearRenderTargetView(CpuDescriptorHandle rtv, const float color[4])
+	{
+		stream.Push(CommandId::ClearRenderTargetView, Commands::ClearRenderTargetView{ rtv.ptr, { color[0], color[1], color[2], color[3] } });
+	}
+
+	void RecordingCommandList::ClearDepthStencilView(CpuDescriptorHandle dsv, float depth)
+	{
+		stream.Push(CommandId::ClearDepthStencilView, Commands::ClearDepthStencilView{ dsv.ptr, depth, 0 });
+	}
+
+	void RecordingCommandList::IASetPrimitiveTopology(PrimitiveTopology topology)
+	{
+		stream.Push(CommandId::IASetPrimitiveTopology, Commands::IASetPrimitiveTopology{ topology });
+	}
+
+	void RecordingCommandList::IASetVertexBuffers(uint32_t start_slot, uint32_t count, const VertexBufferView* views)
+	{
+		stream.Push(CommandId::IASetVertexBuffers, Commands::IASetVertexBuffers{ start_slot, count }, views, sizeof(VertexBufferView) * count);
+	}
+
+	void RecordingCommandList::DrawInstanced(uint32_t vertex_count, uint32_t instance_count, uint32_t start_vertex, uint32_t start_instance)
+	{
+		stream.Push(CommandId::DrawInstanced, Commands::DrawInstanced{ vertex_count, instance_count, start_vertex, start_instance });
+	}
+
+	void RecordingCommandList::CopyBufferRegion(Resource* dst, uint64_t dst_offset, Resource* src, uint64_t src_offset, uint64_t size)
+	{
+		stream.Push(CommandId::CopyBufferRegion, Commands::CopyBufferRegion{ dst->GetId(), src->GetId(), dst_offset, src_offset, size });
+	}
+
+	void RecordingCommandList::CopyTextureToBuffer(Resource* dst, uint64_t dst_offset, uint32_t dst_row_pitch, Resource* src)
+	{
+		stream.Push(CommandId::CopyTextureToBuffer, Commands::CopyTextureToBuffer{ dst->GetId(), src->GetId(), dst_offset, dst_row_pitch, 0 });
+	}
+
+	void RecordingCommandList::ExecuteBundle(CommandList* bundle)
+	{
+		stream.Push(CommandId::ExecuteBundle, Commands::ExecuteBundle{ bundle->GetId() });
+	}
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "rhi.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+// Packed binary encoding of command list calls.
+// Objects are referenced by RHI id and descriptors/addresses by raw value, so a
+// stream stays meaningful after the recording command list is gone.
+namespace RHI
+{
+	enum class CommandId : uint16_t
+	{
+		SetPipelineState,
+		SetGraphicsRootSignature,
+		SetDescriptorHeaps,
+		SetGraphicsRootDescriptorTable,
+		SetGraphicsRootConstantBufferView,
+		SetGraphicsRoot32BitConstants,
+		RSSetViewports,
+		RSSetScissorRects,
+		ResourceBarrier,
+		OMSetRenderTargets,
+		ClearRenderTargetView,
+		ClearDepthStencilView,
+		IASetPrimitiveTopology,
+		IASetVertexBuffers,
+		DrawInstanced,
+		CopyBufferRegion,
+		CopyTextureToBuffer,
+		ExecuteBundle,
+		Count
+	};
+
+	const char* GetCommandName(CommandId id);
+
+	struct CommandHeader
+	{
+		CommandId id;
+		uint16_t reserved;
+		// Payload size in bytes, including trailing arrays and padding
+		uint32_t size;
+	};
+
+	namespace Commands
+	{
+		struct SetPipelineState { uint32_t pipeline_state; };
+		struct SetGraphicsRootSignature { uint32_t root_signature; };
+		// Followed by count heap ids
+		struct SetDescriptorHeaps { uint32_t count; };
+		struct SetGraphicsRootDescriptorTable { uint32_t index; uint32_t padding; uint64_t base; };
+		struct SetGraphicsRootConstantBufferView { uint32_t index; uint32_t padding; uint64_t address; };
+		// Followed by count 32 bit values
+		struct SetGraphicsRoot32BitConstants { uint32_t index; uint32_t count; uint32_t dest_offset; };
+		// Followed by count Viewport
+		struct RSSetViewports { uint32_t count; };
+		// Followed by count Rect
+		struct RSSetScissorRects { uint32_t count; };
+		struct Barrier { uint32_t resource; ResourceState before; ResourceState after; ResourceBarrierType type; };
+		// Followed by count Barrier
+		struct ResourceBarrier { uint32_t count; };
+		// Followed by count rtv handles as uint64_t
+		struct OMSetRenderTargets { uint32_t count; uint32_t has_dsv; uint64_t dsv; };
+		struct ClearRenderTargetView { uint64_t rtv; float color[4]; };
+		struct ClearDepthStencilView { uint64_t dsv; float depth; uint32_t padding; };
+		struct IASetPrimitiveTopology { PrimitiveTopology topology; };
+		// Followed by count VertexBufferView
+		struct IASetVertexBuffers { uint32_t start_slot; uint32_t count; };
+		struct DrawInstanced { uint32_t vertex_count; uint32_t instance_count; uint32_t start_vertex; uint32_t start_instance; };
+		struct CopyBufferRegion { uint32_t dst; uint32_t src; uint64_t dst_offset; uint64_t src_offset; uint64_t size; };
+		struct CopyTextureToBuffer { uint32_t dst; uint32_t src; uint64_t dst_offset; uint32_t dst_row_pitch; uint32_t padding; };
+		struct ExecuteBundle { uint32_t bundle; };
+	}
+
+	// Calls visitor(const CommandHeader&, const uint8_t* payload) for every record in data
+	template <class Visitor>
+	void ForEachCommand(const uint8_t* data, size_t size, Visitor&& visitor)
+	{
+		size_t offset = 0;
+		while (offset < size) {
+			if (size - offset < sizeof(CommandHeader))
+				throw std::runtime_error("Truncated command header");
+			const CommandHeader* header = reinterpret_cast<const CommandHeader*>(data + offset);
+			if (size - offset - sizeof(CommandHeader) < header->size)
+				throw std::runtime_error("Truncated command payload");
+			visitor(*header, data + offset + sizeof(CommandHeader));
+			offset += sizeof(CommandHeader) + header->size;
+		}
+	}
+
+	class CommandStream
+	{
+	public:
+		// Records are padded so every header and payload stays 8 byte aligned
+		static const size_t record_alignment = 8;
+
+		void Clear()
+		{
+			data.clear();
+			command_count = 0;
+			for (auto& count : per_command_count)
+				count = 0;
+		}
+
+		template <class T>
+		void Push(CommandId id, const T& command, const void* extra = nullptr, size_t extra_size = 0)
+		{
+			const size_t payload = Align(sizeof(T) + extra_size);
+			const size_t offset = data.size();
+			data.resize(offset + sizeof(CommandHeader) + payload);
+
+			CommandHeader header = { id, 0, static_cast<uint32_t>(payload) };
+			memcpy(data.data() + offset, &header, sizeof(header));
+			memcpy(data.data() + offset + sizeof(header), &command, sizeof(T));
+			if (extra_size)
+				memcpy(data.data() + offset + sizeof(header) + sizeof(T), extra, extra_size);
+
+			command_count++;
+			per_command_count[static_cast<size_t>(id)]++;
+		}
+
+		template <class Visitor>
+		void ForEach(Visitor&& visitor) const
+		{
+			ForEachCommand(data.data(), data.size(), visitor);
+		}
+
+		const std::vector<uint8_t>& GetData() const { return data; }
+		size_t GetCommandCount() const { return command_count; }
+		size_t GetCommandCount(CommandId id) const { return per_command_count[static_cast<size_t>(id)]; }
+
+	private:
+		std::vector<uint8_t> data;
+		size_t command_count = 0;
+		size_t per_command_count[static_cast<size_t>(CommandId::Count)] = {};
+
+		static size_t Align(size_t size)
+		{
+			return (size + record_alignment - 1) & ~(record_alignment - 1);
+		}
+	};
+
+	static_assert(sizeof(CommandHeader) % CommandStream::record_alignment == 0, "Command header breaks payload alignment");
+
+	// Command list that encodes every call into a CommandStream
+	class RecordingCommandList : public CommandList
+	{
+	public:
+		void Reset(CommandAllocator* allocator, PipelineState* initial_state) override;
+		void Close() override { closed = true; }
+
+		void SetPipelineState(PipelineState* pipeline_state) override;
+		void SetGraphicsRootSignature(RootSignature* root_signature) override;
+		void SetDescriptorHeaps(uint32_t count, DescriptorHeap* const* heaps) override;
+		void SetGraphicsRootDescriptorTable(uint32_t index, GpuDescriptorHandle base) override;
+		void SetGraphicsRootConstantBufferView(uint32_t index, uint64_t address) override;
+		void SetGraphicsRoot32BitConstants(uint32_t index, uint32_t count, const void* data, uint32_t dest_offset) override;
+
+		void RSSetViewports(uint32_t count, const Viewport* viewports) override;
+		void RSSetScissorRects(uint32_t count, const Rect* rects) override;
+		void ResourceBarrier(uint32_t count, const RHI::ResourceBarrier* barriers) override;
+
+		void OMSetRenderTargets(uint32_t count, const CpuDescriptorHandle* rtvs, const CpuDescriptorHandle* dsv) override;
+		void ClearRenderTargetView(CpuDescriptorHandle rtv, const float color[4]) override;
+		void ClearDepthStencilView(CpuDescriptorHandle dsv, float depth) override;
+
+		void IASetPrimitiveTopology(PrimitiveTopology topology) override;
+		void IASetVertexBuffers(uint32_t start_slot, uint32_t count, const VertexBufferView* views) override;
+		void DrawInstanced(uint32_t vertex_count, uint32_t instance_count, uint32_t start_vertex, uint32_t start_instance) override;
+
+		void CopyBufferRegion(Resource* dst, uint64_t dst_offset, Resource* src, uint64_t src_offset, uint64_t size) override;
+		void CopyTextureToBuffer(Resource* dst, uint64_t dst_offset, uint32_t dst_row_pitch, Resource* src) override;
+
+		void ExecuteBundle(CommandList* bundle) override;
+
+		bool IsClosed() const { return closed; }
+		const CommandStream& GetStream() const { return stream; }
+
+	private:
+		bool closed = false;
+		CommandStream stream;
+	};
+}
@@ -0,0 +1,661 @@
+#include "rhi_d3d12.h"
+
+#include <stdexcept>
+
+namespace RHI
+{
+	static_assert(sizeof(Viewport) == sizeof(D3D12_VIEWPORT), "Viewport must match D3D12_VIEWPORT");
+	static_assert(sizeof(Rect) == sizeof(D3D12_RECT), "Rect must match D3D12_RECT");
+	static_assert(sizeof(VertexBufferView) == sizeof(D3D12_VERTEX_BUFFER_VIEW), "VertexBufferView must match D3D12_VERTEX_BUFFER_VIEW");
+	static_assert(sizeof(InputElementDesc) == sizeof(D3D12_INPUT_ELEMENT_DESC), "InputElementDesc must match D3D12_INPUT_ELEMENT_DESC");
+	static_assert(offsetof(InputElementDesc, aligned_byte_offset) == offsetof(D3D12_INPUT_ELEMENT_DESC, AlignedByteOffset), "InputElementDesc must match D3D12_INPUT_ELEMENT_DESC");
+	static_assert(static_cast<UINT>(ResourceState::GenericRead) == D3D12_RESOURCE_STATE_GENERIC_READ, "ResourceState values must match D3D12");
+	static_assert(static_cast<UINT>(Format::R8G8B8A8Unorm) == DXGI_FORMAT_R8G8B8A8_UNORM, "Format values must match DXGI");
+	static_assert(static_cast<UINT>(Format::D32Float) == DXGI_FORMAT_D32_FLOAT, "Format values must match DXGI");
+	static_assert(static_cast<UINT>(Format::R16G16B16A16Float) == DXGI_FORMAT_R16G16B16A16_FLOAT, "Format values must match DXGI");
+	static_assert(static_cast<UINT>(Format::R8G8B8A8Snorm) == DXGI_FORMAT_R8G8B8A8_SNORM, "Format values must match DXGI");
+	static_assert(static_cast<UINT>(Format::R16G16Float) == DXGI_FORMAT_R16G16_FLOAT, "Format values must match DXGI");
+	static_assert(default_placement_alignment == D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT, "Placement alignment must match D3D12");
+	static_assert(sizeof(DescriptorRange) == sizeof(D3D12_DESCRIPTOR_RANGE1), "DescriptorRange must match D3D12_DESCRIPTOR_RANGE1");
+	static_assert(offsetof(DescriptorRange, offset_in_descriptors_from_table_start) == offsetof(D3D12_DESCRIPTOR_RANGE1, OffsetInDescriptorsFromTableStart), "DescriptorRange must match D3D12_DESCRIPTOR_RANGE1");
+	static_assert(static_cast<UINT>(ShaderVisibility::Pixel) == D3D12_SHADER_VISIBILITY_PIXEL, "ShaderVisibility values must match D3D12");
+	static_assert(static_cast<UINT>(RootParameterType::UnorderedAccessView) == D3D12_ROOT_PARAMETER_TYPE_UAV, "RootParameterType values must match D3D12");
+	static_assert(static_cast<UINT>(DescriptorRangeType::Sampler) == D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, "DescriptorRangeType values must match D3D12");
+	static_assert(static_cast<UINT>(DescriptorRangeFlags::DataStatic) == D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC, "DescriptorRangeFlags values must match D3D12");
+	static_assert(static_cast<UINT>(RootDescriptorFlags::DataStatic) == D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC, "RootDescriptorFlags values must match D3D12");
+	static_assert(static_cast<UINT>(RootSignatureFlags::DenyPixelShaderRootAccess) == D3D12_ROOT_SIGNATURE_FLAG_DENY_PIXEL_SHADER_ROOT_ACCESS, "RootSignatureFlags values must match D3D12");
+	static_assert(max_root_signature_dwords == D3D12_MAX_ROOT_COST, "Root signature budget must match D3D12");
+	static_assert(descriptor_range_unbounded == UINT_MAX && descriptor_range_offset_append == D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND, "Range sentinels must match D3D12");
+	static_assert(static_cast<UINT>(ResourceBarrierType::Aliasing) == D3D12_RESOURCE_BARRIER_TYPE_ALIASING, "ResourceBarrierType values must match D3D12");
+
+	D3D12Resource::D3D12Resource(ComPtr<ID3D12Resource> resource, HeapType heap_type) : resource(resource), heap_type(heap_type)
+	{
+		D3D12_RESOURCE_DESC native_desc = resource->GetDesc();
+		desc.dimension = native_desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER ? ResourceDimension::Buffer : ResourceDimension::Texture2D;
+		desc.format = static_cast<Format>(native_desc.Format);
+		desc.width = native_desc.Width;
+		desc.height = native_desc.Height;
+	}
+
+	void* D3D12Resource::Map()
+	{
+		void* data = nullptr;
+		// The CPU only reads back from readback heaps
+		CD3DX12_RANGE read_range(0, 0);
+		ThrowIfFailed(resource->Map(0, heap_type == HeapType::Readback ? nullptr : &read_range, &data));
+		return data;
+	}
+
+	void D3D12Resource::Unmap()
+	{
+		CD3DX12_RANGE written_range(0, 0);
+		resource->Unmap(0, heap_type == HeapType::Readback ? &written_range : nullptr);
+	}
+
+	D3D12Heap::D3D12Heap(ComPtr<ID3D12Heap> heap) : heap(heap)
+	{
+		D3D12_HEAP_DESC desc = heap->GetDesc();
+		type = static_cast<HeapType>(desc.Properties.Type);
+		size = desc.SizeInBytes;
+	}
+
+	D3D12DescriptorHeap::D3D12DescriptorHeap(ComPtr<ID3D12DescriptorHeap> heap, UINT increment_size) : heap(heap), increment_size(increment_size)
+	{
+		D3D12_DESCRIPTOR_HEAP_DESC desc = heap->GetDesc();
+		type = static_cast<DescriptorHeapType>(desc.Type);
+		capacity = desc.NumDescriptors;
+		cpu_start = { heap->GetCPUDescriptorHandleForHeapStart().ptr };
+		gpu_start = { 0 };
+		if (desc.Flags & D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE)
+			gpu_start = { heap->GetGPUDescriptorHandleForHeapStart().ptr };
+	}
+
+	D3D12Fence::D3D12Fence(ComPtr<ID3D12Fence> fence) : fence(fence)
+	{
+		fence_event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		if (fence_event == nullptr) {
+			ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+		}
+	}
+
+	D3D12Fence::~D3D12Fence()
+	{
+		CloseHandle(fence_event);
+	}
+
+	void D3D12Fence::Wait(uint64_t value)
+	{
+		if (fence->GetCompletedValue() < value) {
+			ThrowIfFailed(fence->SetEventOnCompletion(value, fence_event));
+			WaitForSingleObject(fence_event, INFINITE);
+		}
+	}
+
+	void D3D12CommandList::Reset(CommandAllocator* allocator, PipelineState* initial_state)
+	{
+		ThrowIfFailed(command_list->Reset(RHI::GetNative(allocator), initial_state ? RHI::GetNative(initial_state) : nullptr));
+	}
+
+	void D3D12CommandList::SetPipelineState(PipelineState* pipeline_state)
+	{
+		command_list->SetPipelineState(RHI::GetNative(pipeline_state));
+	}
+
+	void D3D12CommandList::SetGraphicsRootSignature(RootSignature* root_signature)
+	{
+		command_list->SetGraphicsRootSignature(RHI::GetNative(root_signature));
+	}
+
+	void D3D12CommandList::SetDescriptorHeaps(uint32_t count, DescriptorHeap* const* heaps)
+	{
+		ID3D12DescriptorHeap* native_heaps[2] = {};
+		for (uint32_t i = 0; i < count && i < _countof(native_heaps); i++)
+			native_heaps[i] = RHI::GetNative(heaps[i]);
+		command_list->SetDescriptorHeaps(count, native_heaps);
+	}
+
+	void D3D12CommandList::SetGraphicsRootDescriptorTable(uint32_t index, GpuDescriptorHandle base)
+	{
+		command_list->SetGraphicsRootDescriptorTable(index, D3D12_GPU_DESCRIPTOR_HANDLE{ base.ptr });
+	}
+
+	void D3D12CommandList::SetGraphicsRootConstantBufferView(uint32_t index, uint64_t address)
+	{
+		command_list->SetGraphicsRootConstantBufferView(index, address);
+	}
+
+	void D3D12CommandList::SetGraphicsRoot32BitConstants(uint32_t index, uint32_t count, const void* data, uint32_t dest_offset)
+	{
+		command_list->SetGraphicsRoot32BitConstants(index, count, data, dest_offset);
+	}
+
+	void D3D12CommandList::RSSetViewports(uint32_t count, const Viewport* viewports)
+	{
+		command_list->RSSetViewports(count, reinterpret_cast<const D3D12_VIEWPORT*>(viewports));
+	}
+
+	void D3D12CommandList::RSSetScissorRects(uint32_t count, const Rect* rects)
+	{
+		command_list->RSSetScissorRects(count, reinterpret_cast<const D3D12_RECT*>(rects));
+	}
+
+	void D3D12CommandList::ResourceBarrier(uint32_t count, const RHI::ResourceBarrier* barriers)
+	{
+		// Translate in fixed size batches to avoid allocating on the recording path
+		D3D12_RESOURCE_BARRIER native_barriers[16];
+		while (count > 0) {
+			UINT batch = count < _countof(native_barriers) ? count : _countof(native_barriers);
+			for (UINT i = 0; i < batch; i++) {
+				if (barriers[i].type == ResourceBarrierType::Aliasing) {
+					// Any placed resource that used the memory before, so callers don't need to track which
+					native_barriers[i] = CD3DX12_RESOURCE_BARRIER::Aliasing(nullptr, RHI::GetNative(barriers[i].resource));
+					continue;
+				}
+				native_barriers[i] = CD3DX12_RESOURCE_BARRIER::Transition(RHI::GetNative(barriers[i].resource),
+					static_cast<D3D12_RESOURCE_STATES>(barriers[i].before),
+					static_cast<D3D12_RESOURCE_STATES>(barriers[i].after));
+			}
+			command_list->ResourceBarrier(batch, native_barriers);
+			barriers += batch;
+			count -= batch;
+		}
+	}
+
+	void D3D12CommandList::OMSetRenderTargets(uint32_t count, const CpuDescriptorHandle* rtvs, const CpuDescriptorHandle* dsv)
+	{
+		D3D12_CPU_DESCRIPTOR_HANDLE native_rtvs[D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT] = {};
+		for (uint32_t i = 0; i < count && i < _countof(native_rtvs); i++)
+			native_rtvs[i].ptr = rtvs[i].ptr;
+		D3D12_CPU_DESCRIPTOR_HANDLE native_dsv = { dsv ? dsv->ptr : 0 };
+		command_list->OMSetRenderTargets(count, native_rtvs, FALSE, dsv ? &native_dsv : nullptr);
+	}
+
+	void D3D12CommandList::ClearRenderTargetView(CpuDescriptorHandle rtv, const float color[4])
+	{
+		command_list->ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE{ rtv.ptr }, color, 0, nullptr);
+	}
+
+	void D3D12CommandList::ClearDepthStencilView(CpuDescriptorHandle dsv, float depth)
+	{
+		command_list->ClearDepthStencilView(D3D12_CPU_DESCRIPTOR_HANDLE{ dsv.ptr }, D3D12_CLEAR_FLAG_DEPTH, depth, 0, 0, nullptr);
+	}
+
+	void D3D12CommandList::IASetPrimitiveTopology(PrimitiveTopology topology)
+	{
+		command_list->IASetPrimitiveTopology(static_cast<D3D12_PRIMITIVE_TOPOLOGY>(topology));
+	}
+
+	void D3D12CommandList::IASetVertexBuffers(uint32_t start_slot, uint32_t count, const VertexBufferView* views)
+	{
+		command_list->IASetVertexBuffers(start_slot, count, reinterpret_cast<const D3D12_VERTEX_BUFFER_VIEW*>(views));
+	}
+
+	void D3D12CommandList::DrawInstanced(uint32_t vertex_count, uint32_t instance_count, uint32_t start_vertex, uint32_t start_instance)
+	{
+		command_list->DrawInstanced(vertex_count, instance_count, start_vertex, start_instance);
+	}
+
+	void D3D12CommandList::CopyBufferRegion(Resource* dst, uint64_t dst_offset, Resource* src, uint64_t src_offset, uint64_t size)
+	{
+		command_list->CopyBufferRegion(RHI::GetNative(dst), dst_offset, RHI::GetNative(src), src_offset, size);
+	}
+
+	void D3D12CommandList::CopyTextureToBuffer(Resource* dst, uint64_t dst_offset, uint32_t dst_row_pitch, Resource* src)
+	{
+		const ResourceDesc& desc = src->GetDesc();
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+		footprint.Offset = dst_offset;
+		footprint.Footprint = CD3DX12_SUBRESOURCE_FOOTPRINT(static_cast<DXGI_FORMAT>(desc.format), static_cast<UINT>(desc.width), desc.height, 1, dst_row_pitch);
+		CD3DX12_TEXTURE_COPY_LOCATION dst_location(RHI::GetNative(dst), footprint);
+		CD3DX12_TEXTURE_COPY_LOCATION src_location(RHI::GetNative(src), 0);
+		command_list->CopyTextureRegion(&dst_location, 0, 0, 0, &src_location, nullptr);
+	}
+
+	void D3D12CommandList::ExecuteBundle(CommandList* bundle)
+	{
+		command_list->ExecuteBundle(RHI::GetNative(bundle));
+	}
+
+	void D3D12CommandQueue::ExecuteCommandLists(uint32_t count, CommandList* const* lists)
+	{
+		ID3D12CommandList* native_lists[16];
+		while (count > 0) {
+			UINT batch = count < _countof(native_lists) ? count : _countof(native_lists);
+			for (UINT i = 0; i < batch; i++)
+				native_lists[i] = RHI::GetNative(lists[i]);
+			queue->ExecuteCommandLists(batch, native_lists);
+			lists += batch;
+			count -= batch;
+		}
+	}
+
+	void D3D12CommandQueue::Signal(Fence* fence, uint64_t value)
+	{
+		ThrowIfFailed(queue->Signal(RHI::GetNative(fence), value));
+	}
+
+	void D3D12CommandQueue::Wait(Fence* fence, uint64_t value)
+	{
+		ThrowIfFailed(queue->Wait(RHI::GetNative(fence), value));
+	}
+
+	std::unique_ptr<CommandQueue> D3D12Device::CreateCommandQueue(CommandListType type)
+	{
+		D3D12_COMMAND_QUEUE_DESC queue_desc = {};
+		queue_desc.Type = static_cast<D3D12_COMMAND_LIST_TYPE>(type);
+		queue_desc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+		ComPtr<ID3D12CommandQueue> queue;
+		ThrowIfFailed(device->CreateCommandQueue(&queue_desc, IID_PPV_ARGS(&queue)));
+		return std::make_unique<D3D12CommandQueue>(queue, type);
+	}
+
+	std::unique_ptr<CommandAllocator> D3D12Device::CreateCommandAllocator(CommandListType type)
+	{
+		ComPtr<ID3D12CommandAllocator> allocator;
+		ThrowIfFailed(device->CreateCommandAllocator(static_cast<D3D12_COMMAND_LIST_TYPE>(type), IID_PPV_ARGS(&allocator)));
+		return std::make_unique<D3D12CommandAllocator>(allocator);
+	}
+
+	std::unique_ptr<CommandList> D3D12Device::CreateCommandList(CommandListType type, CommandAllocator* allocator, PipelineState* initial_state)
+	{
+		ComPtr<ID3D12GraphicsCommandList> command_list;
+		ThrowIfFailed(device->CreateCommandList(0, static_cast<D3D12_COMMAND_LIST_TYPE>(type), RHI::GetNative(allocator),
+			initial_state ? RHI::GetNative(initial_state) : nullptr, IID_PPV_ARGS(&command_list)));
+		return std::make_unique<D3D12CommandList>(command_list);
+	}
+
+	std::unique_ptr<Fence> D3D12Device::CreateFence(uint64_t initial_value)
+	{
+		ComPtr<ID3D12Fence> fence;
+		ThrowIfFailed(device->CreateFence(initial_value, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence)));
+		return std::make_unique<D3D12Fence>(fence);
+	}
+
+	std::unique_ptr<DescriptorHeap> D3D12Device::CreateDescriptorHeap(DescriptorHeapType type, uint32_t capacity, bool shader_visible)
+	{
+		D3D12_DESCRIPTOR_HEAP_DESC heap_desc = {};
+		heap_desc.NumDescriptors = capacity;
+		heap_desc.Type = static_cast<D3D12_DESCRIPTOR_HEAP_TYPE>(type);
+		heap_desc.Flags = shader_visible ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE : D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+		ComPtr<ID3D12DescriptorHeap> heap;
+		ThrowIfFailed(device->CreateDescriptorHeap(&heap_desc, IID_PPV_ARGS(&heap)));
+		return std::make_unique<D3D12DescriptorHeap>(heap, device->GetDescriptorHandleIncrementSize(heap_desc.Type));
+	}
+
+	std::unique_ptr<Resource> D3D12Device::CreateBuffer(HeapType heap_type, uint64_t size, ResourceState initial_state)
+	{
+		CD3DX12_HEAP_PROPERTIES heap_properties(static_cast<D3D12_HEAP_TYPE>(heap_type));
+		CD3DX12_RESOURCE_DESC buffer_desc = CD3DX12_RESOURCE_DESC::Buffer(size);
+		ComPtr<ID3D12Resource> buffer;
+		ThrowIfFailed(device->CreateCommittedResource(
+			&heap_properties,
+			D3D12_HEAP_FLAG_NONE,
+			&buffer_desc,
+			static_cast<D3D12_RESOURCE_STATES>(initial_state),
+			nullptr,
+			IID_PPV_ARGS(&buffer)
+		));
+		return std::make_unique<D3D12Resource>(buffer, heap_type);
+	}
+
+	std::unique_ptr<Heap> D3D12Device::CreateHeap(HeapType type, uint64_t size)
+	{
+		// Buffers only, which keeps the heap usable on resource heap tier 1 hardware
+		CD3DX12_HEAP_DESC heap_desc(size, static_cast<D3D12_HEAP_TYPE>(type), D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT,
+			D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS);
+		ComPtr<ID3D12Heap> heap;
+		ThrowIfFailed(device->CreateHeap(&heap_desc, IID_PPV_ARGS(&heap)));
+		return std::make_unique<D3D12Heap>(heap);
+	}
+
+	std::unique_ptr<Resource> D3D12Device::CreatePlacedBuffer(Heap* heap, uint64_t offset, uint64_t size, ResourceState initial_state)
+	{
+		CD3DX12_RESOURCE_DESC buffer_desc = CD3DX12_RESOURCE_DESC::Buffer(size);
+		ComPtr<ID3D12Resource> buffer;
+		ThrowIfFailed(device->CreatePlacedResource(
+			RHI::GetNative(heap),
+			offset,
+			&buffer_desc,
+			static_cast<D3D12_RESOURCE_STATES>(initial_state),
+			nullptr,
+			IID_PPV_ARGS(&buffer)
+		));
+		return std::make_unique<D3D12Resource>(buffer, heap->GetType());
+	}
+
+	static CD3DX12_RESOURCE_DESC GetTexture2DDesc(uint32_t width, uint32_t height, Format format)
+	{
+		const bool is_depth = format == Format::D32Float;
+		return CD3DX12_RESOURCE_DESC::Tex2D(static_cast<DXGI_FORMAT>(format), width, height, 1, 1, 1, 0,
+			is_depth ? D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL : D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
+	}
+
+	static D3D12_CLEAR_VALUE GetTexture2DClearValue(Format format)
+	{
+		D3D12_CLEAR_VALUE clear_value = {};
+		clear_value.Format = static_cast<DXGI_FORMAT>(format);
+		if (format == Format::D32Float)
+			clear_value.DepthStencil.Depth = 1.f;
+		return clear_value;
+	}
+
+	std::unique_ptr<Resource> D3D12Device::CreateTexture2D(uint32_t width, uint32_t height, Format format, ResourceState initial_state)
+	{
+		CD3DX12_HEAP_PROPERTIES heap_properties(D3D12_HEAP_TYPE_DEFAULT);
+		CD3DX12_RESOURCE_DESC texture_desc = GetTexture2DDesc(width, height, format);
+		D3D12_CLEAR_VALUE clear_value = GetTexture2DClearValue(format);
+
+		ComPtr<ID3D12Resource> texture;
+		ThrowIfFailed(device->CreateCommittedResource(
+			&heap_properties,
+			D3D12_HEAP_FLAG_NONE,
+			&texture_desc,
+			static_cast<D3D12_RESOURCE_STATES>(initial_state),
+			&clear_value,
+			IID_PPV_ARGS(&texture)
+		));
+		return std::make_unique<D3D12Resource>(texture, HeapType::Default);
+	}
+
+	std::unique_ptr<Heap> D3D12Device::CreateTextureHeap(uint64_t size)
+	{
+		CD3DX12_HEAP_DESC heap_desc(size, D3D12_HEAP_TYPE_DEFAULT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT,
+			D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES);
+		ComPtr<ID3D12Heap> heap;
+		ThrowIfFailed(device->CreateHeap(&heap_desc, IID_PPV_ARGS(&heap)));
+		return std::make_unique<D3D12Heap>(heap);
+	}
+
+	uint64_t D3D12Device::GetTexture2DAllocationSize(uint32_t width, uint32_t height, Format format)
+	{
+		CD3DX12_RESOURCE_DESC texture_desc = GetTexture2DDesc(width, height, format);
+		const D3D12_RESOURCE_ALLOCATION_INFO info = device->GetResourceAllocationInfo(0, 1, &texture_desc);
+		return (info.SizeInBytes + D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT - 1) / D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT
+			* D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	}
+
+	std::unique_ptr<Resource> D3D12Device::CreatePlacedTexture2D(Heap* heap, uint64_t offset, uint32_t width, uint32_t height, Format format,
+		ResourceState initial_state)
+	{
+		CD3DX12_RESOURCE_DESC texture_desc = GetTexture2DDesc(width, height, format);
+		D3D12_CLEAR_VALUE clear_value = GetTexture2DClearValue(format);
+		ComPtr<ID3D12Resource> texture;
+		ThrowIfFailed(device->CreatePlacedResource(
+			RHI::GetNative(heap),
+			offset,
+			&texture_desc,
+			static_cast<D3D12_RESOURCE_STATES>(initial_state),
+			&clear_value,
+			IID_PPV_ARGS(&texture)
+		));
+		return std::make_unique<D3D12Resource>(texture, HeapType::Default);
+	}
+
+	void D3D12Device::CreateConstantBufferView(uint64_t address, uint32_t size, CpuDescriptorHandle dest)
+	{
+		D3D12_CONSTANT_BUFFER_VIEW_DESC cbv_desc = {};
+		cbv_desc.BufferLocation = address;
+		cbv_desc.SizeInBytes = size;
+		device->CreateConstantBufferView(&cbv_desc, D3D12_CPU_DESCRIPTOR_HANDLE{ dest.ptr });
+	}
+
+	void D3D12Device::CreateRenderTargetView(Resource* resource, CpuDescriptorHandle dest)
+	{
+		device->CreateRenderTargetView(RHI::GetNative(resource), nullptr, D3D12_CPU_DESCRIPTOR_HANDLE{ dest.ptr });
+	}
+
+	void D3D12Device::CreateDepthStencilView(Resource* resource, CpuDescriptorHandle dest, bool read_only)
+	{
+		D3D12_DEPTH_STENCIL_VIEW_DESC dsv_desc = {};
+		dsv_desc.Format = static_cast<DXGI_FORMAT>(resource->GetDesc().format);
+		dsv_desc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+		dsv_desc.Flags = read_only ? D3D12_DSV_FLAG_READ_ONLY_DEPTH : D3D12_DSV_FLAG_NONE;
+		device->CreateDepthStencilView(RHI::GetNative(resource), &dsv_desc, D3D12_CPU_DESCRIPTOR_HANDLE{ dest.ptr });
+	}
+
+	std::unique_ptr<RootSignature> D3D12Device::WrapRootSignature(ComPtr<ID3D12RootSignature> root_signature)
+	{
+		return std::make_unique<D3D12RootSignature>(root_signature);
+	}
+
+	std::unique_ptr<PipelineState> D3D12Device::WrapPipelineState(ComPtr<ID3D12PipelineState> pipeline_state)
+	{
+		return std::make_unique<D3D12PipelineState>(pipeline_state);
+	}
+
+	std::unique_ptr<Resource> D3D12Device::WrapResource(ComPtr<ID3D12Resource> resource, HeapType heap_type)
+	{
+		return std::make_unique<D3D12Resource>(resource, heap_type);
+	}
+
+	namespace
+	{
+		const uint64_t library_key = Hasher().AddString("PipelineLibrary").Get();
+
+		void HashShader(Hasher& hasher, const D3D12_SHADER_BYTECODE& shader)
+		{
+			hasher.Add(shader.BytecodeLength);
+			hasher.Add(shader.pShaderBytecode, shader.BytecodeLength);
+		}
+
+		template <class Parameter, class Range>
+		void HashRootParameter(Hasher& hasher, const Parameter& parameter)
+		{
+			hasher.Add(parameter.ParameterType).Add(parameter.ShaderVisibility);
+			switch (parameter.ParameterType)
+			{
+			case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+				hasher.Add(parameter.DescriptorTable.NumDescriptorRanges);
+				hasher.Add(parameter.DescriptorTable.pDescriptorRanges, sizeof(Range) * parameter.DescriptorTable.NumDescriptorRanges);
+				break;
+			case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+				hasher.Add(parameter.Constants);
+				break;
+			default:
+				hasher.Add(parameter.Descriptor);
+				break;
+			}
+		}
+
+		template <class Desc, class Parameter, class Range>
+		void HashRootSignature(Hasher& hasher, const Desc& desc)
+		{
+			hasher.Add(desc.NumParameters);
+			for (UINT i = 0; i < desc.NumParameters; i++)
+				HashRootParameter<Parameter, Range>(hasher, desc.pParameters[i]);
+			hasher.Add(desc.NumStaticSamplers);
+			hasher.Add(desc.pStaticSamplers, sizeof(D3D12_STATIC_SAMPLER_DESC) * desc.NumStaticSamplers);
+			hasher.Add(desc.Flags);
+		}
+
+		// Structs with small members are hashed member by member to skip their padding
+		void HashBlendState(Hasher& hasher, const D3D12_BLEND_DESC& blend)
+		{
+			hasher.Add(blend.AlphaToCoverageEnable).Add(blend.IndependentBlendEnable);
+			for (const D3D12_RENDER_TARGET_BLEND_DESC& target : blend.RenderTarget) {
+				hasher.Add(target.BlendEnable).Add(target.LogicOpEnable);
+				hasher.Add(target.SrcBlend).Add(target.DestBlend).Add(target.BlendOp);
+				hasher.Add(target.SrcBlendAlpha).Add(target.DestBlendAlpha).Add(target.BlendOpAlpha);
+				hasher.Add(target.LogicOp).Add(target.RenderTargetWriteMask);
+			}
+		}
+
+		void HashDepthStencilState(Hasher& hasher, const D3D12_DEPTH_STENCIL_DESC& depth_stencil)
+		{
+			hasher.Add(depth_stencil.DepthEnable).Add(depth_stencil.DepthWriteMask).Add(depth_stencil.DepthFunc);
+			hasher.Add(depth_stencil.StencilEnable).Add(depth_stencil.StencilReadMask).Add(depth_stencil.StencilWriteMask);
+			hasher.Add(depth_stencil.FrontFace).Add(depth_stencil.BackFace);
+		}
+
+		std::wstring GetPipelineName(uint64_t key)
+		{
+			wchar_t name[17];
+			swprintf_s(name, L"%016llx", static_cast<unsigned long long>(key));
+			return name;
+		}
+	}
+
+	uint64_t HashRootSignatureDesc(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc, D3D_ROOT_SIGNATURE_VERSION version)
+	{
+		Hasher hasher;
+		hasher.AddString("RootSignature").Add(version).Add(desc.Version);
+		if (desc.Version == D3D_ROOT_SIGNATURE_VERSION_1_1)
+			HashRootSignature<D3D12_ROOT_SIGNATURE_DESC1, D3D12_ROOT_PARAMETER1, D3D12_DESCRIPTOR_RANGE1>(hasher, desc.Desc_1_1);
+		else
+			HashRootSignature<D3D12_ROOT_SIGNATURE_DESC, D3D12_ROOT_PARAMETER, D3D12_DESCRIPTOR_RANGE>(hasher, desc.Desc_1_0);
+		return hasher.Get();
+	}
+
+	uint64_t HashGraphicsPipelineDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t root_signature_key)
+	{
+		Hasher hasher;
+		hasher.AddString("GraphicsPipeline").Add(root_signature_key);
+		HashShader(hasher, desc.VS);
+		HashShader(hasher, desc.PS);
+		HashShader(hasher, desc.DS);
+		HashShader(hasher, desc.HS);
+		HashShader(hasher, desc.GS);
+
+		hasher.Add(desc.StreamOutput.NumEntries);
+		for (UINT i = 0; i < desc.StreamOutput.NumEntries; i++) {
+			const D3D12_SO_DECLARATION_ENTRY& entry = desc.StreamOutput.pSODeclaration[i];
+			hasher.Add(entry.Stream).AddString(entry.SemanticName).Add(entry.SemanticIndex);
+			hasher.Add(entry.StartComponent).Add(entry.ComponentCount).Add(entry.OutputSlot);
+		}
+		hasher.Add(desc.StreamOutput.NumStrides);
+		hasher.Add(desc.StreamOutput.pBufferStrides, sizeof(UINT) * desc.StreamOutput.NumStrides);
+		hasher.Add(desc.StreamOutput.RasterizedStream);
+
+		HashBlendState(hasher, desc.BlendState);
+		hasher.Add(desc.SampleMask);
+		hasher.Add(desc.RasterizerState);
+		HashDepthStencilState(hasher, desc.DepthStencilState);
+
+		hasher.Add(desc.InputLayout.NumElements);
+		for (UINT i = 0; i < desc.InputLayout.NumElements; i++) {
+			const D3D12_INPUT_ELEMENT_DESC& element = desc.InputLayout.pInputElementDescs[i];
+			hasher.AddString(element.SemanticName).Add(element.SemanticIndex).Add(element.Format).Add(element.InputSlot);
+			hasher.Add(element.AlignedByteOffset).Add(element.InputSlotClass).Add(element.InstanceDataStepRate);
+		}
+
+		hasher.Add(desc.IBStripCutValue).Add(desc.PrimitiveTopologyType).Add(desc.NumRenderTargets);
+		hasher.Add(desc.RTVFormats).Add(desc.DSVFormat).Add(desc.SampleDesc).Add(desc.NodeMask).Add(desc.Flags);
+		return hasher.Get();
+	}
+
+	D3D12PipelineLibrary::D3D12PipelineLibrary(D3D12Device& device, PipelineCache& cache) : device(device), cache(cache)
+	{
+		ComPtr<ID3D12Device1> device1;
+		if (FAILED(device.GetNative()->QueryInterface(IID_PPV_ARGS(&device1))))
+			return;
+
+		if (const std::vector<uint8_t>* blob = cache.Find(library_key)) {
+			library_blob = *blob;
+			// Libraries from another driver or adapter are rejected and rebuilt from scratch
+			if (FAILED(device1->CreatePipelineLibrary(library_blob.data(), library_blob.size(), IID_PPV_ARGS(&library))))
+				library_blob.clear();
+		}
+		if (!library && FAILED(device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&library))))
+			library = nullptr;
+	}
+
+	std::unique_ptr<RootSignature> D3D12PipelineLibrary::CreateRootSignature(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc,
+		D3D_ROOT_SIGNATURE_VERSION version, uint64_t& key)
+	{
+		key = HashRootSignatureDesc(desc, version);
+		ComPtr<ID3D12RootSignature> root_signature;
+		if (const std::vector<uint8_t>* blob = cache.Find(key)) {
+			if (SUCCEEDED(device.GetNative()->CreateRootSignature(0, blob->data(), blob->size(), IID_PPV_ARGS(&root_signature))))
+				return device.WrapRootSignature(root_signature);
+		}
+
+		ComPtr<ID3DBlob> signature;
+		ComPtr<ID3DBlob> error;
+		ThrowIfFailed(D3DX12SerializeVersionedRootSignature(&desc, version, &signature, &error));
+		ThrowIfFailed(device.GetNative()->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(),
+			IID_PPV_ARGS(&root_signature)));
+		cache.Store(key, signature->GetBufferPointer(), signature->GetBufferSize());
+		return device.WrapRootSignature(root_signature);
+	}
+
+	std::unique_ptr<RootSignature> D3D12PipelineLibrary::CreateRootSignature(const RootSignatureDesc& desc,
+		D3D_ROOT_SIGNATURE_VERSION version, uint64_t& key)
+	{
+		std::vector<CD3DX12_ROOT_PARAMETER1> parameters(desc.parameter_count);
+		for (uint32_t i = 0; i < desc.parameter_count; i++) {
+			const RootParameter& parameter = desc.parameters[i];
+			const D3D12_SHADER_VISIBILITY visibility = static_cast<D3D12_SHADER_VISIBILITY>(parameter.visibility);
+			const D3D12_ROOT_DESCRIPTOR_FLAGS flags = static_cast<D3D12_ROOT_DESCRIPTOR_FLAGS>(parameter.flags);
+			switch (parameter.type) {
+			case RootParameterType::DescriptorTable:
+				if (parameter.first_range + parameter.range_count > desc.range_count)
+					throw std::out_of_range("Descriptor table refers to ranges past the end of the desc");
+				parameters[i].InitAsDescriptorTable(parameter.range_count,
+					reinterpret_cast<const D3D12_DESCRIPTOR_RANGE1*>(desc.ranges + parameter.first_range), visibility);
+				break;
+			case RootParameterType::Constants:
+				parameters[i].InitAsConstants(parameter.value_count, parameter.shader_register, parameter.register_space, visibility);
+				break;
+			case RootParameterType::ConstantBufferView:
+				parameters[i].InitAsConstantBufferView(parameter.shader_register, parameter.register_space, flags, visibility);
+				break;
+			case RootParameterType::ShaderResourceView:
+				parameters[i].InitAsShaderResourceView(parameter.shader_register, parameter.register_space, flags, visibility);
+				break;
+			case RootParameterType::UnorderedAccessView:
+				parameters[i].InitAsUnorderedAccessView(parameter.shader_register, parameter.register_space, flags, visibility);
+				break;
+			}
+		}
+
+		// Serializing with a 1.0 target drops the 1.1 flags, so one desc serves both
+		CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC native_desc;
+		native_desc.Init_1_1(desc.parameter_count, parameters.data(), 0, nullptr, static_cast<D3D12_ROOT_SIGNATURE_FLAGS>(desc.flags));
+		return CreateRootSignature(native_desc, version, key);
+	}
+
+	std::unique_ptr<PipelineState> D3D12PipelineLibrary::CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t root_signature_key)
+	{
+		const uint64_t key = HashGraphicsPipelineDesc(desc, root_signature_key);
+		ComPtr<ID3D12PipelineState> pipeline_state;
+
+		if (library) {
+			const std::wstring name = GetPipelineName(key);
+			if (SUCCEEDED(library->LoadGraphicsPipeline(name.c_str(), &desc, IID_PPV_ARGS(&pipeline_state)))) {
+				pipeline_hits++;
+				return device.WrapPipelineState(pipeline_state);
+			}
+			pipeline_misses++;
+			ThrowIfFailed(device.GetNative()->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipeline_state)));
+			ThrowIfFailed(library->StorePipeline(name.c_str(), pipeline_state.Get()));
+			library_dirty = true;
+			return device.WrapPipelineState(pipeline_state);
+		}
+
+		// Without a library each pipeline keeps the driver's blob, stale blobs fail creation and get replaced
+		if (const std::vector<uint8_t>* blob = cache.Find(key)) {
+			D3D12_GRAPHICS_PIPELINE_STATE_DESC cached_desc = desc;
+			cached_desc.CachedPSO = { blob->data(), blob->size() };
+			if (SUCCEEDED(device.GetNative()->CreateGraphicsPipelineState(&cached_desc, IID_PPV_ARGS(&pipeline_state)))) {
+				pipeline_hits++;
+				return device.WrapPipelineState(pipeline_state);
+			}
+		}
+		pipeline_misses++;
+		ThrowIfFailed(device.GetNative()->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipeline_state)));
+		ComPtr<ID3DBlob> blob;
+		if (SUCCEEDED(pipeline_state->GetCachedBlob(&blob)))
+			cache.Store(key, blob->GetBufferPointer(), blob->GetBufferSize());
+		return device.WrapPipelineState(pipeline_state);
+	}
+
+	void D3D12PipelineLibrary::Store()
+	{
+		if (!library || !library_dirty)
+			return;
+		std::vector<uint8_t> data(library->GetSerializedSize());
+		ThrowIfFailed(library->Serialize(data.data(), data.size()));
+		cache.Store(library_key, data.data(), data.size());
+		library_dirty = false;
+	}
+}
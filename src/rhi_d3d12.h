@@ -0,0 +1,257 @@
+#pragma once
+
+#include "dx12_labs.h"
+
+#include "pipeline_cache.h"
+#include "rhi.h"
+
+// D3D12 implementation of the RHI.
+// Root signatures, pipeline states and swap chain buffers are created natively and wrapped.
+namespace RHI
+{
+	class D3D12Resource : public Resource
+	{
+	public:
+		D3D12Resource(ComPtr<ID3D12Resource> resource, HeapType heap_type);
+
+		const ResourceDesc& GetDesc() const override { return desc; }
+		uint64_t GetGpuAddress() const override { return resource->GetGPUVirtualAddress(); }
+		void* Map() override;
+		void Unmap() override;
+
+		ID3D12Resource* GetNative() const { return resource.Get(); }
+
+	private:
+		ComPtr<ID3D12Resource> resource;
+		HeapType heap_type;
+		ResourceDesc desc;
+	};
+
+	class D3D12Heap : public Heap
+	{
+	public:
+		explicit D3D12Heap(ComPtr<ID3D12Heap> heap);
+
+		HeapType GetType() const override { return type; }
+		uint64_t GetSize() const override { return size; }
+
+		ID3D12Heap* GetNative() const { return heap.Get(); }
+
+	private:
+		ComPtr<ID3D12Heap> heap;
+		HeapType type;
+		uint64_t size;
+	};
+
+	class D3D12RootSignature : public RootSignature
+	{
+	public:
+		explicit D3D12RootSignature(ComPtr<ID3D12RootSignature> root_signature) : root_signature(root_signature) {}
+
+		ID3D12RootSignature* GetNative() const { return root_signature.Get(); }
+
+	private:
+		ComPtr<ID3D12RootSignature> root_signature;
+	};
+
+	class D3D12PipelineState : public PipelineState
+	{
+	public:
+		explicit D3D12PipelineState(ComPtr<ID3D12PipelineState> pipeline_state) : pipeline_state(pipeline_state) {}
+
+		ID3D12PipelineState* GetNative() const { return pipeline_state.Get(); }
+
+	private:
+		ComPtr<ID3D12PipelineState> pipeline_state;
+	};
+
+	class D3D12CommandAllocator : public CommandAllocator
+	{
+	public:
+		explicit D3D12CommandAllocator(ComPtr<ID3D12CommandAllocator> allocator) : allocator(allocator) {}
+
+		void Reset() override { ThrowIfFailed(allocator->Reset()); }
+
+		ID3D12CommandAllocator* GetNative() const { return allocator.Get(); }
+
+	private:
+		ComPtr<ID3D12CommandAllocator> allocator;
+	};
+
+	class D3D12DescriptorHeap : public DescriptorHeap
+	{
+	public:
+		D3D12DescriptorHeap(ComPtr<ID3D12DescriptorHeap> heap, UINT increment_size);
+
+		DescriptorHeapType GetType() const override { return type; }
+		uint32_t GetCapacity() const override { return capacity; }
+		uint32_t GetIncrementSize() const override { return increment_size; }
+		CpuDescriptorHandle GetCpuStart() const override { return cpu_start; }
+		GpuDescriptorHandle GetGpuStart() const override { return gpu_start; }
+
+		ID3D12DescriptorHeap* GetNative() const { return heap.Get(); }
+
+	private:
+		ComPtr<ID3D12DescriptorHeap> heap;
+		DescriptorHeapType type;
+		uint32_t capacity;
+		uint32_t increment_size;
+		CpuDescriptorHandle cpu_start;
+		GpuDescriptorHandle gpu_start;
+	};
+
+	class D3D12Fence : public Fence
+	{
+	public:
+		explicit D3D12Fence(ComPtr<ID3D12Fence> fence);
+		~D3D12Fence() override;
+
+		uint64_t GetCompletedValue() const override { return fence->GetCompletedValue(); }
+		void Wait(uint64_t value) override;
+
+		ID3D12Fence* GetNative() const { return fence.Get(); }
+
+	private:
+		ComPtr<ID3D12Fence> fence;
+		HANDLE fence_event;
+	};
+
+	class D3D12CommandList : public CommandList
+	{
+	public:
+		explicit D3D12CommandList(ComPtr<ID3D12GraphicsCommandList> command_list) : command_list(command_list) {}
+
+		void Reset(CommandAllocator* allocator, PipelineState* initial_state) override;
+		void Close() override { ThrowIfFailed(command_list->Close()); }
+
+		void SetPipelineState(PipelineState* pipeline_state) override;
+		void SetGraphicsRootSignature(RootSignature* root_signature) override;
+		void SetDescriptorHeaps(uint32_t count, DescriptorHeap* const* heaps) override;
+		void SetGraphicsRootDescriptorTable(uint32_t index, GpuDescriptorHandle base) override;
+		void SetGraphicsRootConstantBufferView(uint32_t index, uint64_t address) override;
+		void SetGraphicsRoot32BitConstants(uint32_t index, uint32_t count, const void* data, uint32_t dest_offset) override;
+
+		void RSSetViewports(uint32_t count, const Viewport* viewports) override;
+		void RSSetScissorRects(uint32_t count, const Rect* rects) override;
+		void ResourceBarrier(uint32_t count, const RHI::ResourceBarrier* barriers) override;
+
+		void OMSetRenderTargets(uint32_t count, const CpuDescriptorHandle* rtvs, const CpuDescriptorHandle* dsv) override;
+		void ClearRenderTargetView(CpuDescriptorHandle rtv, const float color[4]) override;
+		void ClearDepthStencilView(CpuDescriptorHandle dsv, float depth) override;
+
+		void IASetPrimitiveTopology(PrimitiveTopology topology) override;
+		void IASetVertexBuffers(uint32_t start_slot, uint32_t count, const VertexBufferView* views) override;
+		void DrawInstanced(uint32_t vertex_count, uint32_t instance_count, uint32_t start_vertex, uint32_t start_instance) override;
+
+		void CopyBufferRegion(Resource* dst, uint64_t dst_offset, Resource* src, uint64_t src_offset, uint64_t size) override;
+		void CopyTextureToBuffer(Resource* dst, uint64_t dst_offset, uint32_t dst_row_pitch, Resource* src) override;
+
+		void ExecuteBundle(CommandList* bundle) override;
+
+		ID3D12GraphicsCommandList* GetNative() const { return command_list.Get(); }
+
+	private:
+		ComPtr<ID3D12GraphicsCommandList> command_list;
+	};
+
+	class D3D12CommandQueue : public CommandQueue
+	{
+	public:
+		D3D12CommandQueue(ComPtr<ID3D12CommandQueue> queue, CommandListType type) : queue(queue), type(type) {}
+
+		CommandListType GetType() const override { return type; }
+		void ExecuteCommandLists(uint32_t count, CommandList* const* lists) override;
+		void Signal(Fence* fence, uint64_t value) override;
+		void Wait(Fence* fence, uint64_t value) override;
+
+		ID3D12CommandQueue* GetNative() const { return queue.Get(); }
+
+	private:
+		ComPtr<ID3D12CommandQueue> queue;
+		CommandListType type;
+	};
+
+	class D3D12Device : public Device
+	{
+	public:
+		explicit D3D12Device(ComPtr<ID3D12Device> device) : device(device) {}
+
+		std::unique_ptr<CommandQueue> CreateCommandQueue(CommandListType type) override;
+		std::unique_ptr<CommandAllocator> CreateCommandAllocator(CommandListType type) override;
+		std::unique_ptr<CommandList> CreateCommandList(CommandListType type, CommandAllocator* allocator, PipelineState* initial_state) override;
+		std::unique_ptr<Fence> CreateFence(uint64_t initial_value) override;
+		std::unique_ptr<DescriptorHeap> CreateDescriptorHeap(DescriptorHeapType type, uint32_t capacity, bool shader_visible) override;
+		std::unique_ptr<Resource> CreateBuffer(HeapType heap_type, uint64_t size, ResourceState initial_state) override;
+		std::unique_ptr<Heap> CreateHeap(HeapType type, uint64_t size) override;
+		std::unique_ptr<Resource> CreatePlacedBuffer(Heap* heap, uint64_t offset, uint64_t size, ResourceState initial_state) override;
+		std::unique_ptr<Resource> CreateTexture2D(uint32_t width, uint32_t height, Format format, ResourceState initial_state) override;
+		std::unique_ptr<Heap> CreateTextureHeap(uint64_t size) override;
+		uint64_t GetTexture2DAllocationSize(uint32_t width, uint32_t height, Format format) override;
+		std::unique_ptr<Resource> CreatePlacedTexture2D(Heap* heap, uint64_t offset, uint32_t width, uint32_t height, Format format,
+			ResourceState initial_state) override;
+
+		void CreateConstantBufferView(uint64_t address, uint32_t size, CpuDescriptorHandle dest) override;
+		void CreateRenderTargetView(Resource* resource, CpuDescriptorHandle dest) override;
+		void CreateDepthStencilView(Resource* resource, CpuDescriptorHandle dest, bool read_only) override;
+
+		std::unique_ptr<RootSignature> WrapRootSignature(ComPtr<ID3D12RootSignature> root_signature);
+		std::unique_ptr<PipelineState> WrapPipelineState(ComPtr<ID3D12PipelineState> pipeline_state);
+		std::unique_ptr<Resource> WrapResource(ComPtr<ID3D12Resource> resource, HeapType heap_type);
+
+		ID3D12Device* GetNative() const { return device.Get(); }
+
+	private:
+		ComPtr<ID3D12Device> device;
+	};
+
+	// Cache keys of native descriptions, pointers are replaced by what they point to
+	uint64_t HashRootSignatureDesc(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc, D3D_ROOT_SIGNATURE_VERSION version);
+	uint64_t HashGraphicsPipelineDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t root_signature_key);
+
+	// Creates root signatures and pipeline states through a PipelineCache.
+	// Serialized root signatures are cached directly. Pipelines are stored in an ID3D12PipelineLibrary
+	// that is itself one cache entry, runtimes without it fall back to per-pipeline cached blobs.
+	// Store must be called before the cache is saved.
+	class D3D12PipelineLibrary
+	{
+	public:
+		D3D12PipelineLibrary(D3D12Device& device, PipelineCache& cache);
+
+		// Returns the key to pass along with pipelines using this root signature
+		std::unique_ptr<RootSignature> CreateRootSignature(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc,
+			D3D_ROOT_SIGNATURE_VERSION version, uint64_t& key);
+		// Same for portable descs, e.g. those generated by RootSignatureLayout
+		std::unique_ptr<RootSignature> CreateRootSignature(const RootSignatureDesc& desc,
+			D3D_ROOT_SIGNATURE_VERSION version, uint64_t& key);
+		// desc.pRootSignature must be the root signature created for root_signature_key
+		std::unique_ptr<PipelineState> CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t root_signature_key);
+
+		// Writes the pipeline library back into the cache if pipelines were added
+		void Store();
+
+		bool HasNativeLibrary() const { return library != nullptr; }
+		uint64_t GetPipelineHits() const { return pipeline_hits; }
+		uint64_t GetPipelineMisses() const { return pipeline_misses; }
+
+	private:
+		D3D12Device& device;
+		PipelineCache& cache;
+		ComPtr<ID3D12PipelineLibrary> library;
+		// The library reads from its initial blob for its whole lifetime
+		std::vector<uint8_t> library_blob;
+		bool library_dirty = false;
+		uint64_t pipeline_hits = 0;
+		uint64_t pipeline_misses = 0;
+	};
+
+	// Access to the native objects behind RHI interfaces created by D3D12Device
+	inline ID3D12Resource* GetNative(Resource* resource) { return static_cast<D3D12Resource*>(resource)->GetNative(); }
+	inline ID3D12Heap* GetNative(Heap* heap) { return static_cast<D3D12Heap*>(heap)->GetNative(); }
+	inline ID3D12RootSignature* GetNative(RootSignature* root_signature) { return static_cast<D3D12RootSignature*>(root_signature)->GetNative(); }
+	inline ID3D12PipelineState* GetNative(PipelineState* pipeline_state) { return static_cast<D3D12PipelineState*>(pipeline_state)->GetNative(); }
+	inline ID3D12CommandAllocator* GetNative(CommandAllocator* allocator) { return static_cast<D3D12CommandAllocator*>(allocator)->GetNative(); }
+	inline ID3D12DescriptorHeap* GetNative(DescriptorHeap* heap) { return static_cast<D3D12DescriptorHeap*>(heap)->GetNative(); }
+	inline ID3D12Fence* GetNative(Fence* fence) { return static_cast<D3D12Fence*>(fence)->GetNative(); }
+	inline ID3D12GraphicsCommandList* GetNative(CommandList* command_list) { return static_cast<D3D12CommandList*>(command_list)->GetNative(); }
+	inline ID3D12CommandQueue* GetNative(CommandQueue* queue) { return static_cast<D3D12CommandQueue*>(queue)->GetNative(); }
+}
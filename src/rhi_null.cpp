@@ -0,0 +1,299 @@
+#include "rhi_null.h"
+
+#include <stdexcept>
+#include <thread>
+
+namespace RHI
+{
+	static size_t ComputeStorageSize(const ResourceDesc& desc)
+	{
+		size_t size = static_cast<size_t>(desc.width);
+		if (desc.dimension == ResourceDimension::Texture2D)
+			size *= static_cast<size_t>(desc.height) * GetFormatSize(desc.format);
+		return size;
+	}
+
+	NullResource::NullResource(NullDevice* device, const ResourceDesc& desc, HeapType heap_type)
+		: device(device), desc(desc), heap_type(heap_type), storage(ComputeStorageSize(desc)), data(storage.data()), size(storage.size())
+	{
+		device->Register(this);
+	}
+
+	NullResource::NullResource(NullDevice* device, const ResourceDesc& desc, HeapType heap_type, uint8_t* placed_memory)
+		: device(device), desc(desc), heap_type(heap_type), data(placed_memory), size(ComputeStorageSize(desc))
+	{
+		device->Register(this);
+	}
+
+	NullResource::~NullResource()
+	{
+		device->Unregister(this);
+	}
+
+	NullBundle::NullBundle(NullDevice* device) : device(device)
+	{
+		device->Register(this);
+	}
+
+	NullBundle::~NullBundle()
+	{
+		device->Unregister(this);
+	}
+
+	void NullBundle::RSSetViewports(uint32_t, const Viewport*) { throw std::logic_error("Bundles can't set viewports"); }
+	void NullBundle::RSSetScissorRects(uint32_t, const Rect*) { throw std::logic_error("Bundles can't set scissor rects"); }
+	void NullBundle::ResourceBarrier(uint32_t, const RHI::ResourceBarrier*) { throw std::logic_error("Bundles can't transition resources"); }
+	void NullBundle::OMSetRenderTargets(uint32_t, const CpuDescriptorHandle*, const CpuDescriptorHandle*) { throw std::logic_error("Bundles can't set render targets"); }
+	void NullBundle::ClearRenderTargetView(CpuDescriptorHandle, const float[4]) { throw std::logic_error("Bundles can't clear"); }
+	void NullBundle::ClearDepthStencilView(CpuDescriptorHandle, float) { throw std::logic_error("Bundles can't clear"); }
+	void NullBundle::CopyBufferRegion(Resource*, uint64_t, Resource*, uint64_t, uint64_t) { throw std::logic_error("Bundles can't copy"); }
+	void NullBundle::CopyTextureToBuffer(Resource*, uint64_t, uint32_t, Resource*) { throw std::logic_error("Bundles can't copy"); }
+	void NullBundle::ExecuteBundle(CommandList*) { throw std::logic_error("Bundles can't execute bundles"); }
+
+	void NullFence::Retire(Clock::time_point now) const
+	{
+		while (!pending.empty() && pending.front().second <= now) {
+			if (pending.front().first > completed_value)
+				completed_value = pending.front().first;
+			pending.pop_front();
+		}
+	}
+
+	uint64_t NullFence::GetCompletedValue() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Retire(Clock::now());
+		return completed_value;
+	}
+
+	void NullFence::Wait(uint64_t value)
+	{
+		Clock::time_point when = GetCompletionTime(value);
+		// Every signal is scheduled on submission, so an unscheduled value can never be reached
+		if (when == Clock::time_point::max())
+			throw std::logic_error("Waiting for a fence value that was never signalled");
+		std::this_thread::sleep_until(when);
+		std::lock_guard<std::mutex> lock(mutex);
+		Retire(when);
+	}
+
+	void NullFence::SignalAt(uint64_t value, Clock::time_point when)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// A queue signals in GPU timeline order
+		if (!pending.empty() && pending.back().second > when)
+			when = pending.back().second;
+		pending.emplace_back(value, when);
+		Retire(Clock::now());
+	}
+
+	NullFence::Clock::time_point NullFence::GetCompletionTime(uint64_t value) const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (completed_value >= value)
+			return Clock::time_point::min();
+		for (const auto& signal : pending) {
+			if (signal.first >= value)
+				return signal.second;
+		}
+		return Clock::time_point::max();
+	}
+
+	void NullCommandQueue::ExecuteCommandLists(uint32_t count, CommandList* const* lists)
+	{
+		for (uint32_t i = 0; i < count; i++) {
+			const RecordingCommandList* list = static_cast<const RecordingCommandList*>(lists[i]);
+			if (!list->IsClosed())
+				throw std::logic_error("Executing a command list that is still recording");
+			Execute(*list);
+			stats.executed_lists++;
+		}
+
+		if (simulated_gpu_time.count() > 0) {
+			auto now = NullFence::Clock::now();
+			gpu_busy_until = (gpu_busy_until > now ? gpu_busy_until : now) + simulated_gpu_time;
+		}
+	}
+
+	void NullCommandQueue::Execute(const RecordingCommandList& list)
+	{
+		list.GetStream().ForEach([&](const CommandHeader& header, const uint8_t* payload) {
+			if (header.id == CommandId::DrawInstanced) {
+				stats.draw_calls++;
+			}
+			else if (header.id == CommandId::CopyBufferRegion) {
+				const Commands::CopyBufferRegion* copy = reinterpret_cast<const Commands::CopyBufferRegion*>(payload);
+				NullResource* dst = device->LookupResource(copy->dst);
+				NullResource* src = device->LookupResource(copy->src);
+				if (!dst || !src || copy->dst_offset + copy->size > dst->GetStorageSize() || copy->src_offset + copy->size > src->GetStorageSize())
+					throw std::out_of_range("CopyBufferRegion outside of resource bounds");
+				memcpy(dst->GetStorage() + copy->dst_offset, src->GetStorage() + copy->src_offset, static_cast<size_t>(copy->size));
+				stats.copied_bytes += copy->size;
+			}
+			else if (header.id == CommandId::CopyTextureToBuffer) {
+				const Commands::CopyTextureToBuffer* copy = reinterpret_cast<const Commands::CopyTextureToBuffer*>(payload);
+				NullResource* dst = device->LookupResource(copy->dst);
+				NullResource* src = device->LookupResource(copy->src);
+				if (!dst || !src || src->GetDesc().dimension != ResourceDimension::Texture2D)
+					throw std::invalid_argument("CopyTextureToBuffer needs a texture source and a buffer destination");
+				// Textures are stored tightly packed, the destination uses the requested pitch
+				const ResourceDesc& desc = src->GetDesc();
+				const size_t row_size = static_cast<size_t>(desc.width) * GetFormatSize(desc.format);
+				if (copy->dst_row_pitch < row_size || copy->dst_offset + static_cast<uint64_t>(copy->dst_row_pitch) * (desc.height - 1) + row_size > dst->GetStorageSize())
+					throw std::out_of_range("CopyTextureToBuffer outside of resource bounds");
+				for (uint32_t row = 0; row < desc.height; row++)
+					memcpy(dst->GetStorage() + copy->dst_offset + static_cast<size_t>(copy->dst_row_pitch) * row, src->GetStorage() + row_size * row, row_size);
+				stats.copied_bytes += row_size * desc.height;
+			}
+			else if (header.id == CommandId::ExecuteBundle) {
+				// Bundles run in place, with the calling list's state
+				const NullBundle* bundle = device->LookupBundle(reinterpret_cast<const Commands::ExecuteBundle*>(payload)->bundle);
+				if (!bundle || !bundle->IsClosed())
+					throw std::logic_error("Executing a bundle that doesn't exist or is still recording");
+				Execute(*bundle);
+				stats.executed_bundles++;
+			}
+		});
+		stats.executed_commands += list.GetStream().GetCommandCount();
+	}
+
+	void NullCommandQueue::Signal(Fence* fence, uint64_t value)
+	{
+		// Without simulated GPU time the timeline never runs ahead of the CPU
+		static_cast<NullFence*>(fence)->SignalAt(value, gpu_busy_until);
+	}
+
+	void NullCommandQueue::Wait(Fence* fence, uint64_t value)
+	{
+		// Later work on this queue starts once the other timeline reaches value
+		NullFence::Clock::time_point when = static_cast<NullFence*>(fence)->GetCompletionTime(value);
+		if (when == NullFence::Clock::time_point::max())
+			throw std::logic_error("Queue waits for a fence value that was never signalled");
+		if (when > gpu_busy_until)
+			gpu_busy_until = when;
+	}
+
+	std::unique_ptr<CommandQueue> NullDevice::CreateCommandQueue(CommandListType type)
+	{
+		return std::make_unique<NullCommandQueue>(this, type);
+	}
+
+	std::unique_ptr<CommandAllocator> NullDevice::CreateCommandAllocator(CommandListType)
+	{
+		return std::make_unique<NullCommandAllocator>();
+	}
+
+	std::unique_ptr<CommandList> NullDevice::CreateCommandList(CommandListType type, CommandAllocator* allocator, PipelineState* initial_state)
+	{
+		std::unique_ptr<RecordingCommandList> list;
+		if (type == CommandListType::Bundle)
+			list = std::make_unique<NullBundle>(this);
+		else
+			list = std::make_unique<RecordingCommandList>();
+		list->Reset(allocator, initial_state);
+		return list;
+	}
+
+	std::unique_ptr<Fence> NullDevice::CreateFence(uint64_t initial_value)
+	{
+		return std::make_unique<NullFence>(initial_value);
+	}
+
+	std::unique_ptr<DescriptorHeap> NullDevice::CreateDescriptorHeap(DescriptorHeapType type, uint32_t capacity, bool shader_visible)
+	{
+		return std::make_unique<NullDescriptorHeap>(type, capacity, shader_visible);
+	}
+
+	std::unique_ptr<Resource> NullDevice::CreateBuffer(HeapType heap_type, uint64_t size, ResourceState)
+	{
+		return std::make_unique<NullResource>(this, ResourceDesc{ ResourceDimension::Buffer, Format::Unknown, size, 1 }, heap_type);
+	}
+
+	std::unique_ptr<Heap> NullDevice::CreateHeap(HeapType type, uint64_t size)
+	{
+		return std::make_unique<NullHeap>(type, size);
+	}
+
+	std::unique_ptr<Resource> NullDevice::CreatePlacedBuffer(Heap* heap, uint64_t offset, uint64_t size, ResourceState)
+	{
+		if (offset % default_placement_alignment != 0 || offset + size > heap->GetSize())
+			throw std::out_of_range("Placed buffer outside of its heap or misaligned");
+		NullHeap* null_heap = static_cast<NullHeap*>(heap);
+		return std::make_unique<NullResource>(this, ResourceDesc{ ResourceDimension::Buffer, Format::Unknown, size, 1 }, heap->GetType(),
+			null_heap->GetMemory() + offset);
+	}
+
+	std::unique_ptr<RootSignature> NullDevice::CreateRootSignature()
+	{
+		return std::make_unique<RootSignature>();
+	}
+
+	std::unique_ptr<PipelineState> NullDevice::CreatePipelineState()
+	{
+		return std::make_unique<PipelineState>();
+	}
+
+	std::unique_ptr<Resource> NullDevice::CreateTexture2D(uint32_t width, uint32_t height, Format format, ResourceState)
+	{
+		return std::make_unique<NullResource>(this, ResourceDesc{ ResourceDimension::Texture2D, format, width, height }, HeapType::Default);
+	}
+
+	std::unique_ptr<Heap> NullDevice::CreateTextureHeap(uint64_t size)
+	{
+		return std::make_unique<NullHeap>(HeapType::Default, size);
+	}
+
+	uint64_t NullDevice::GetTexture2DAllocationSize(uint32_t width, uint32_t height, Format format)
+	{
+		const uint64_t size = static_cast<uint64_t>(width) * height * GetFormatSize(format);
+		return (size + default_placement_alignment - 1) / default_placement_alignment * default_placement_alignment;
+	}
+
+	std::unique_ptr<Resource> NullDevice::CreatePlacedTexture2D(Heap* heap, uint64_t offset, uint32_t width, uint32_t height, Format format,
+		ResourceState)
+	{
+		if (offset % default_placement_alignment != 0 || offset + GetTexture2DAllocationSize(width, height, format) > heap->GetSize())
+			throw std::out_of_range("Placed texture outside of its heap or misaligned");
+		NullHeap* null_heap = static_cast<NullHeap*>(heap);
+		return std::make_unique<NullResource>(this, ResourceDesc{ ResourceDimension::Texture2D, format, width, height }, HeapType::Default,
+			null_heap->GetMemory() + offset);
+	}
+
+	NullResource* NullDevice::LookupResource(uint32_t id)
+	{
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		auto it = resources.find(id);
+		return it == resources.end() ? nullptr : it->second;
+	}
+
+	void NullDevice::Register(NullResource* resource)
+	{
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		resources[resource->GetId()] = resource;
+	}
+
+	void NullDevice::Unregister(NullResource* resource)
+	{
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		resources.erase(resource->GetId());
+	}
+
+	NullBundle* NullDevice::LookupBundle(uint32_t id)
+	{
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		auto it = bundles.find(id);
+		return it == bundles.end() ? nullptr : it->second;
+	}
+
+	void NullDevice::Register(NullBundle* bundle)
+	{
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		bundles[bundle->GetId()] = bundle;
+	}
+
+	void NullDevice::Unregister(NullBundle* bundle)
+	{
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		bundles.erase(bundle->GetId());
+	}
+}
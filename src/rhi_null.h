@@ -0,0 +1,211 @@
+#pragma once
+
+#include "rhi.h"
+#include "rhi_commands.h"
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Null backend: command lists are RecordingCommandLists, queues execute on submission.
+// Only copies touch memory, everything else is counted and discarded.
+// Queues can simulate GPU time, which delays fence completion but not the work itself.
+// Handles and GPU addresses encode the owning object id in the upper 32 bits.
+namespace RHI
+{
+	class NullDevice;
+
+	class NullResource : public Resource
+	{
+	public:
+		NullResource(NullDevice* device, const ResourceDesc& desc, HeapType heap_type);
+		// Placed resources alias heap memory instead of owning storage
+		NullResource(NullDevice* device, const ResourceDesc& desc, HeapType heap_type, uint8_t* placed_memory);
+		~NullResource() override;
+
+		const ResourceDesc& GetDesc() const override { return desc; }
+		uint64_t GetGpuAddress() const override { return static_cast<uint64_t>(GetId()) << 32; }
+		void* Map() override { return data; }
+		void Unmap() override {}
+
+		HeapType GetHeapType() const { return heap_type; }
+		uint8_t* GetStorage() { return data; }
+		size_t GetStorageSize() const { return size; }
+
+	private:
+		NullDevice* device;
+		ResourceDesc desc;
+		HeapType heap_type;
+		std::vector<uint8_t> storage;
+		uint8_t* data;
+		size_t size;
+	};
+
+	class NullHeap : public Heap
+	{
+	public:
+		NullHeap(HeapType type, uint64_t size) : type(type), memory(static_cast<size_t>(size)) {}
+
+		HeapType GetType() const override { return type; }
+		uint64_t GetSize() const override { return memory.size(); }
+
+		uint8_t* GetMemory() { return memory.data(); }
+
+	private:
+		HeapType type;
+		std::vector<uint8_t> memory;
+	};
+
+	// Registered with its device so queues can run it wherever a list executes it.
+	// Commands D3D12 doesn't allow in bundles throw std::logic_error.
+	class NullBundle : public RecordingCommandList
+	{
+	public:
+		explicit NullBundle(NullDevice* device);
+		~NullBundle() override;
+
+		void RSSetViewports(uint32_t count, const Viewport* viewports) override;
+		void RSSetScissorRects(uint32_t count, const Rect* rects) override;
+		void ResourceBarrier(uint32_t count, const RHI::ResourceBarrier* barriers) override;
+		void OMSetRenderTargets(uint32_t count, const CpuDescriptorHandle* rtvs, const CpuDescriptorHandle* dsv) override;
+		void ClearRenderTargetView(CpuDescriptorHandle rtv, const float color[4]) override;
+		void ClearDepthStencilView(CpuDescriptorHandle dsv, float depth) override;
+		void CopyBufferRegion(Resource* dst, uint64_t dst_offset, Resource* src, uint64_t src_offset, uint64_t size) override;
+		void CopyTextureToBuffer(Resource* dst, uint64_t dst_offset, uint32_t dst_row_pitch, Resource* src) override;
+		void ExecuteBundle(CommandList* bundle) override;
+
+	private:
+		NullDevice* device;
+	};
+
+	class NullCommandAllocator : public CommandAllocator
+	{
+	public:
+		void Reset() override { reset_count++; }
+
+		uint64_t GetResetCount() const { return reset_count; }
+
+	private:
+		uint64_t reset_count = 0;
+	};
+
+	class NullDescriptorHeap : public DescriptorHeap
+	{
+	public:
+		NullDescriptorHeap(DescriptorHeapType type, uint32_t capacity, bool shader_visible)
+			: type(type), capacity(capacity), shader_visible(shader_visible) {}
+
+		DescriptorHeapType GetType() const override { return type; }
+		uint32_t GetCapacity() const override { return capacity; }
+		uint32_t GetIncrementSize() const override { return 1; }
+		CpuDescriptorHandle GetCpuStart() const override { return { static_cast<size_t>(GetId()) << 32 }; }
+		GpuDescriptorHandle GetGpuStart() const override { return { shader_visible ? static_cast<uint64_t>(GetId()) << 32 : 0 }; }
+
+	private:
+		DescriptorHeapType type;
+		uint32_t capacity;
+		bool shader_visible;
+	};
+
+	class NullFence : public Fence
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		explicit NullFence(uint64_t initial_value) : completed_value(initial_value) {}
+
+		uint64_t GetCompletedValue() const override;
+		void Wait(uint64_t value) override;
+
+		// Completes value once the simulated GPU timeline reaches when
+		void SignalAt(uint64_t value, Clock::time_point when);
+		// Time the value completes or has completed, time_point::max() if it was never signalled
+		Clock::time_point GetCompletionTime(uint64_t value) const;
+
+	private:
+		mutable std::mutex mutex;
+		mutable uint64_t completed_value;
+		mutable std::deque<std::pair<uint64_t, Clock::time_point>> pending;
+
+		void Retire(Clock::time_point now) const;
+	};
+
+	struct NullQueueStats
+	{
+		uint64_t executed_lists = 0;
+		uint64_t executed_bundles = 0;
+		uint64_t executed_commands = 0;
+		uint64_t draw_calls = 0;
+		uint64_t copied_bytes = 0;
+	};
+
+	class NullCommandQueue : public CommandQueue
+	{
+	public:
+		NullCommandQueue(NullDevice* device, CommandListType type) : device(device), type(type) {}
+
+		CommandListType GetType() const override { return type; }
+		void ExecuteCommandLists(uint32_t count, CommandList* const* lists) override;
+		void Signal(Fence* fence, uint64_t value) override;
+		void Wait(Fence* fence, uint64_t value) override;
+
+		const NullQueueStats& GetStats() const { return stats; }
+
+		// Makes every ExecuteCommandLists occupy the simulated GPU for gpu_time.
+		// Fences signalled afterwards complete when the GPU timeline catches up.
+		void SetSimulatedGpuTime(std::chrono::microseconds gpu_time) { simulated_gpu_time = gpu_time; }
+
+	private:
+		NullDevice* device;
+		CommandListType type;
+		NullQueueStats stats;
+		std::chrono::microseconds simulated_gpu_time{ 0 };
+		NullFence::Clock::time_point gpu_busy_until;
+
+		void Execute(const RecordingCommandList& list);
+	};
+
+	class NullDevice : public Device
+	{
+	public:
+		std::unique_ptr<CommandQueue> CreateCommandQueue(CommandListType type) override;
+		std::unique_ptr<CommandAllocator> CreateCommandAllocator(CommandListType type) override;
+		std::unique_ptr<CommandList> CreateCommandList(CommandListType type, CommandAllocator* allocator, PipelineState* initial_state) override;
+		std::unique_ptr<Fence> CreateFence(uint64_t initial_value) override;
+		std::unique_ptr<DescriptorHeap> CreateDescriptorHeap(DescriptorHeapType type, uint32_t capacity, bool shader_visible) override;
+		std::unique_ptr<Resource> CreateBuffer(HeapType heap_type, uint64_t size, ResourceState initial_state) override;
+		std::unique_ptr<Heap> CreateHeap(HeapType type, uint64_t size) override;
+		std::unique_ptr<Resource> CreatePlacedBuffer(Heap* heap, uint64_t offset, uint64_t size, ResourceState initial_state) override;
+		std::unique_ptr<Resource> CreateTexture2D(uint32_t width, uint32_t height, Format format, ResourceState initial_state) override;
+		std::unique_ptr<Heap> CreateTextureHeap(uint64_t size) override;
+		uint64_t GetTexture2DAllocationSize(uint32_t width, uint32_t height, Format format) override;
+		std::unique_ptr<Resource> CreatePlacedTexture2D(Heap* heap, uint64_t offset, uint32_t width, uint32_t height, Format format,
+			ResourceState initial_state) override;
+
+		void CreateConstantBufferView(uint64_t, uint32_t, CpuDescriptorHandle) override {}
+		void CreateRenderTargetView(Resource*, CpuDescriptorHandle) override {}
+		void CreateDepthStencilView(Resource*, CpuDescriptorHandle, bool) override {}
+
+		// Null only factories for objects other backends build from native descriptions
+		std::unique_ptr<RootSignature> CreateRootSignature();
+		std::unique_ptr<PipelineState> CreatePipelineState();
+
+		NullResource* LookupResource(uint32_t id);
+		NullBundle* LookupBundle(uint32_t id);
+
+	private:
+		friend class NullResource;
+		friend class NullBundle;
+
+		std::mutex registry_mutex;
+		std::unordered_map<uint32_t, NullResource*> resources;
+		std::unordered_map<uint32_t, NullBundle*> bundles;
+
+		void Register(NullResource* resource);
+		void Unregister(NullResource* resource);
+		void Register(NullBundle* bundle);
+		void Unregister(NullBundle* bundle);
+	};
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "rhi.h"
+
+#include <array>
+#include <type_traits>
+#include <utility>
+
+// Compile-time description of a root signature.
+// Root parameters are types listed in a Layout, which derives the desc, the parameter indices
+// and the DWORD cost from that list. Binding goes through the parameter type instead of an index,
+// so reordering parameters or moving data into root constants can't leave a stale index behind
+// and binding a parameter as the wrong kind fails to compile.
+namespace RootSignatureLayout
+{
+	template <RHI::DescriptorRangeType Type, uint32_t Register, uint32_t Count, uint32_t Space, RHI::DescriptorRangeFlags Flags,
+		uint32_t Offset = RHI::descriptor_range_offset_append>
+	struct Range
+	{
+		static_assert(Count > 0, "Descriptor ranges need at least one descriptor");
+		static constexpr RHI::DescriptorRange desc = { Type, Count, Register, Space, Flags, Offset };
+	};
+
+	template <uint32_t Register, uint32_t Count = 1, uint32_t Space = 0, RHI::DescriptorRangeFlags Flags = RHI::DescriptorRangeFlags::None>
+	using CbvRange = Range<RHI::DescriptorRangeType::ConstantBufferView, Register, Count, Space, Flags>;
+	template <uint32_t Register, uint32_t Count = 1, uint32_t Space = 0, RHI::DescriptorRangeFlags Flags = RHI::DescriptorRangeFlags::None>
+	using SrvRange = Range<RHI::DescriptorRangeType::ShaderResourceView, Register, Count, Space, Flags>;
+	template <uint32_t Register, uint32_t Count = 1, uint32_t Space = 0, RHI::DescriptorRangeFlags Flags = RHI::DescriptorRangeFlags::None>
+	using UavRange = Range<RHI::DescriptorRangeType::UnorderedAccessView, Register, Count, Space, Flags>;
+	template <uint32_t Register, uint32_t Count = 1, uint32_t Space = 0, RHI::DescriptorRangeFlags Flags = RHI::DescriptorRangeFlags::None>
+	using SamplerRange = Range<RHI::DescriptorRangeType::Sampler, Register, Count, Space, Flags>;
+
+	// Values stored in the root signature itself, shaders read them as a cbuffer at Register
+	template <uint32_t Register, uint32_t Count, uint32_t Space = 0, RHI::ShaderVisibility Visibility = RHI::ShaderVisibility::All>
+	struct Constants
+	{
+		static_assert(Count > 0, "Root constants need at least one value");
+		static constexpr RHI::RootParameterType type = RHI::RootParameterType::Constants;
+		static constexpr uint32_t value_count = Count;
+		static constexpr uint32_t dword_cost = Count;
+		static constexpr std::array<RHI::DescriptorRange, 0> ranges = {};
+
+		static constexpr RHI::RootParameter Describe(uint32_t)
+		{
+			return { type, Visibility, Register, Space, Count, RHI::RootDescriptorFlags::None, 0, 0 };
+		}
+	};
+
+	// Constant buffer bound by GPU address, no descriptor needed
+	template <uint32_t Register, uint32_t Space = 0, RHI::RootDescriptorFlags Flags = RHI::RootDescriptorFlags::None,
+		RHI::ShaderVisibility Visibility = RHI::ShaderVisibility::All>
+	struct ConstantBufferView
+	{
+		static constexpr RHI::RootParameterType type = RHI::RootParameterType::ConstantBufferView;
+		static constexpr uint32_t dword_cost = 2;
+		static constexpr std::array<RHI::DescriptorRange, 0> ranges = {};
+
+		static constexpr RHI::RootParameter Describe(uint32_t)
+		{
+			return { type, Visibility, Register, Space, 0, Flags, 0, 0 };
+		}
+	};
+
+	namespace Detail
+	{
+		template <size_t Count>
+		constexpr bool MixesSamplers(const std::array<RHI::DescriptorRange, Count>& ranges)
+		{
+			size_t samplers = 0;
+			for (size_t i = 0; i < Count; i++)
+				samplers += ranges[i].type == RHI::DescriptorRangeType::Sampler;
+			return samplers != 0 && samplers != Count;
+		}
+
+		// An appended range has no offset to go to after an unbounded one
+		template <size_t Count>
+		constexpr bool AppendsAfterUnbounded(const std::array<RHI::DescriptorRange, Count>& ranges)
+		{
+			for (size_t i = 1; i < Count; i++) {
+				if (ranges[i - 1].descriptor_count == RHI::descriptor_range_unbounded
+					&& ranges[i].offset_in_descriptors_from_table_start == RHI::descriptor_range_offset_append)
+					return true;
+			}
+			return false;
+		}
+
+		template <size_t Count, size_t RangeCount>
+		constexpr void Copy(std::array<RHI::DescriptorRange, Count>& out, size_t first, const std::array<RHI::DescriptorRange, RangeCount>& ranges)
+		{
+			for (size_t i = 0; i < RangeCount; i++)
+				out[first + i] = ranges[i];
+		}
+
+		// Tables take their ranges from the layout's ranges in parameter order
+		template <class... Parameters>
+		constexpr uint32_t GetFirstRange(size_t index)
+		{
+			constexpr uint32_t counts[] = { static_cast<uint32_t>(Parameters::ranges.size())..., 0 };
+			uint32_t first = 0;
+			for (size_t i = 0; i < index; i++)
+				first += counts[i];
+			return first;
+		}
+
+		template <class... Parameters, size_t... Indices>
+		constexpr std::array<RHI::RootParameter, sizeof...(Parameters)> GetParameters(std::index_sequence<Indices...>)
+		{
+			return { { Parameters::Describe(GetFirstRange<Parameters...>(Indices))... } };
+		}
+
+		template <class... Parameters, size_t... Indices>
+		constexpr auto GetRanges(std::index_sequence<Indices...>)
+		{
+			std::array<RHI::DescriptorRange, (0 + ... + Parameters::ranges.size())> result = {};
+			(Copy(result, GetFirstRange<Parameters...>(Indices), Parameters::ranges), ...);
+			return result;
+		}
+
+		template <class... Types>
+		struct AreUnique : std::true_type {};
+
+		template <class First, class... Rest>
+		struct AreUnique<First, Rest...>
+			: std::integral_constant<bool, !(std::is_same<First, Rest>::value || ...) && AreUnique<Rest...>::value> {};
+	}
+
+	// Descriptors in the bound heap, only the table start lives in the root signature
+	template <RHI::ShaderVisibility Visibility, class... Ranges>
+	struct Table
+	{
+		static_assert(sizeof...(Ranges) > 0, "Descriptor tables need at least one range");
+		static constexpr RHI::RootParameterType type = RHI::RootParameterType::DescriptorTable;
+		static constexpr uint32_t dword_cost = 1;
+		static constexpr std::array<RHI::DescriptorRange, sizeof...(Ranges)> ranges = { Ranges::desc... };
+		static_assert(!Detail::MixesSamplers(ranges), "Samplers need a table of their own");
+		static_assert(!Detail::AppendsAfterUnbounded(ranges), "Ranges after an unbounded range need an explicit offset");
+
+		static constexpr RHI::RootParameter Describe(uint32_t first_range)
+		{
+			return { type, Visibility, 0, 0, 0, RHI::RootDescriptorFlags::None, first_range, static_cast<uint32_t>(ranges.size()) };
+		}
+	};
+
+	template <RHI::RootSignatureFlags Flags, class... Parameters>
+	class Layout
+	{
+	public:
+		static constexpr uint32_t parameter_count = sizeof...(Parameters);
+		static constexpr uint32_t range_count = (0 + ... + static_cast<uint32_t>(Parameters::ranges.size()));
+		static constexpr uint32_t dword_count = (0 + ... + Parameters::dword_cost);
+		static constexpr RHI::RootSignatureFlags flags = Flags;
+
+		static_assert(dword_count <= RHI::max_root_signature_dwords, "Root signature is over the 64 DWORD budget");
+		static_assert(Detail::AreUnique<Parameters...>::value, "Root signature repeats a parameter");
+
+		static constexpr std::array<RHI::RootParameter, parameter_count> parameters = Detail::GetParameters<Parameters...>(std::index_sequence_for<Parameters...>());
+		static constexpr std::array<RHI::DescriptorRange, range_count> ranges = Detail::GetRanges<Parameters...>(std::index_sequence_for<Parameters...>());
+
+		static constexpr RHI::RootSignatureDesc GetDesc()
+		{
+			return { parameters.data(), parameter_count, ranges.data(), range_count, Flags };
+		}
+
+		template <class Parameter>
+		static constexpr uint32_t IndexOf()
+		{
+			constexpr bool matches[] = { std::is_same<Parameter, Parameters>::value..., false };
+			for (uint32_t i = 0; i < parameter_count; i++) {
+				if (matches[i])
+					return i;
+			}
+			return parameter_count;
+		}
+
+		template <class Parameter>
+		static constexpr bool Has() { return IndexOf<Parameter>() < parameter_count; }
+
+		// Writes values at DestOffset, values must be whole DWORDs and fit the constants
+		template <class Parameter, uint32_t DestOffset = 0, class T>
+		static void SetGraphicsConstants(RHI::CommandList& command_list, const T& values)
+		{
+			static_assert(Has<Parameter>(), "Parameter is not part of the root signature");
+			static_assert(Parameter::type == RHI::RootParameterType::Constants, "Parameter is not root constants");
+			static_assert(std::is_trivially_copyable<T>::value && sizeof(T) % 4 == 0, "Root constants are set in whole DWORDs");
+			static_assert(DestOffset + sizeof(T) / 4 <= Parameter::value_count, "Values don't fit the root constants");
+			command_list.SetGraphicsRoot32BitConstants(IndexOf<Parameter>(), sizeof(T) / 4, &values, DestOffset);
+		}
+
+		template <class Parameter>
+		static void SetGraphicsConstantBufferView(RHI::CommandList& command_list, uint64_t address)
+		{
+			static_assert(Has<Parameter>(), "Parameter is not part of the root signature");
+			static_assert(Parameter::type == RHI::RootParameterType::ConstantBufferView, "Parameter is not a root constant buffer view");
+			command_list.SetGraphicsRootConstantBufferView(IndexOf<Parameter>(), address);
+		}
+
+		template <class Parameter>
+		static void SetGraphicsDescriptorTable(RHI::CommandList& command_list, RHI::GpuDescriptorHandle base)
+		{
+			static_assert(Has<Parameter>(), "Parameter is not part of the root signature");
+			static_assert(Parameter::type == RHI::RootParameterType::DescriptorTable, "Parameter is not a descriptor table");
+			command_list.SetGraphicsRootDescriptorTable(IndexOf<Parameter>(), base);
+		}
+	};
+}
@@ -0,0 +1,79 @@
+#include "shader_cache.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#ifdef _WIN32
+static const char* null_device = "NUL";
+#else
+static const char* null_device = "/dev/null";
+#endif
+
+uint64_t GetShaderKey(const std::string& source, const ShaderVariant& variant)
+{
+	Hasher hasher;
+	hasher.AddString("Shader").Add(source.size()).Add(source.data(), source.size());
+	hasher.AddString(variant.entry_point.c_str()).AddString(variant.target.c_str()).Add(variant.flags);
+	hasher.Add(variant.defines.size());
+	for (const ShaderDefine& define : variant.defines)
+		hasher.AddString(define.name.c_str()).AddString(define.value.c_str());
+	return hasher.Get();
+}
+
+bool ReadShaderSource(const std::string& path, std::string& source)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	source.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return true;
+}
+
+ShaderVariant ParseShaderVariant(const std::string& spec)
+{
+	const size_t target_begin = spec.find(':');
+	if (target_begin == std::string::npos || target_begin == 0)
+		throw std::invalid_argument("Shader variant " + spec + " needs ENTRY:TARGET");
+	const size_t defines_begin = spec.find(':', target_begin + 1);
+
+	ShaderVariant variant;
+	variant.entry_point = spec.substr(0, target_begin);
+	variant.target = spec.substr(target_begin + 1, defines_begin == std::string::npos ? std::string::npos : defines_begin - target_begin - 1);
+	if (variant.target.empty())
+		throw std::invalid_argument("Shader variant " + spec + " needs ENTRY:TARGET");
+
+	size_t begin = defines_begin;
+	while (begin != std::string::npos) {
+		const size_t end = spec.find(',', begin + 1);
+		const std::string define = spec.substr(begin + 1, end == std::string::npos ? std::string::npos : end - begin - 1);
+		const size_t equals = define.find('=');
+		if (define.empty() || equals == 0)
+			throw std::invalid_argument("Shader variant " + spec + " has an empty define");
+		if (equals == std::string::npos)
+			variant.defines.push_back({ define, "1" });
+		else
+			variant.defines.push_back({ define.substr(0, equals), define.substr(equals + 1) });
+		begin = end;
+	}
+	return variant;
+}
+
+bool IsDxcAvailable(const std::string& dxc)
+{
+	return std::system(("\"" + dxc + "\" -help > " + null_device + " 2>&1").c_str()) == 0;
+}
+
+std::string GetDxcCommandLine(const std::string& dxc, const ShaderVariant& variant, const std::string& source_path, const std::string& output_path)
+{
+	std::string command = "\"" + dxc + "\" -nologo -T " + variant.target + " -E " + variant.entry_point;
+	for (const ShaderDefine& define : variant.defines)
+		command += " -D \"" + define.name + "=" + define.value + "\"";
+	command += " -Fo \"" + output_path + "\" \"" + source_path + "\"";
+#ifdef _WIN32
+	// cmd.exe strips the outer quotes of a command line starting with one
+	command = "\"" + command + "\"";
+#endif
+	return command;
+}
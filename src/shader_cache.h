@@ -0,0 +1,39 @@
+#pragma once
+
+#include "pipeline_cache.h"
+
+#include <string>
+#include <vector>
+
+struct ShaderDefine
+{
+	std::string name;
+	std::string value;
+};
+
+// One entry point of a source compiled for one target
+struct ShaderVariant
+{
+	std::string entry_point;
+	std::string target;
+	std::vector<ShaderDefine> defines;
+	// Compiler specific flags, 0 for the optimized build the offline compiler produces
+	uint32_t flags = 0;
+};
+
+// Key of the bytecode in a shader cache, any change to the source text or the variant misses.
+// Shader caches are PipelineCache files filled by the shader compiler tool at build time.
+uint64_t GetShaderKey(const std::string& source, const ShaderVariant& variant);
+
+// Returns false if the file can't be read
+bool ReadShaderSource(const std::string& path, std::string& source);
+
+// Parses ENTRY:TARGET[:NAME=VALUE,...], a define without a value is set to 1.
+// Throws std::invalid_argument on malformed specs.
+ShaderVariant ParseShaderVariant(const std::string& spec);
+
+// True if running dxc -help succeeds, dxc is a path or a name looked up on the PATH
+bool IsDxcAvailable(const std::string& dxc);
+
+// Command line for std::system that compiles variant of source_path with dxc into output_path
+std::string GetDxcCommandLine(const std::string& dxc, const ShaderVariant& variant, const std::string& source_path, const std::string& output_path);
@@ -0,0 +1,141 @@
+#include "parallel_for.h"
+#include "pipeline_cache.h"
+#include "shader_cache.h"
+#include "shader_permutations.h"
+#include "vertex_formats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+// Splits ENTRY:TARGET[:DEFINES[:FEATURES]] into one variant per permutation of FEATURES
+static void AddVariants(const std::string& spec, std::vector<ShaderVariant>& variants)
+{
+	size_t features_begin = 0;
+	for (int i = 0; i < 3 && features_begin != std::string::npos; i++)
+		features_begin = spec.find(':', features_begin + (i ? 1 : 0));
+
+	ShaderPermutationSet permutations;
+	if (features_begin != std::string::npos)
+		permutations = ShaderPermutationSet::Parse(spec.substr(features_begin + 1));
+	// Variants with features but no defines leave the defines field empty
+	std::string variant_spec = spec.substr(0, features_begin);
+	if (!variant_spec.empty() && variant_spec.back() == ':')
+		variant_spec.pop_back();
+	const ShaderVariant base = ParseShaderVariant(variant_spec);
+
+	// Permutations enabling a feature without its requirement would duplicate another one
+	const std::vector<uint32_t> distinct = permutations.GetDistinctPermutations();
+	for (uint32_t permutation : distinct) {
+		ShaderVariant variant = base;
+		variant.defines = permutations.GetDefines(permutation, base.defines);
+		variants.push_back(variant);
+	}
+	printf("%s: %u features, %zu of %u permutations distinct\n", base.entry_point.c_str(), permutations.GetFeatureCount(), distinct.size(), permutations.GetPermutationCount());
+}
+
+// Compiles shader variants with DXC at build time into a cache the renderer loads at startup.
+// Without DXC nothing is written and the renderer compiles at runtime instead.
+int main(int argc, char** argv)
+{
+	std::string dxc = "dxc";
+	std::string output;
+	std::string source_path;
+	uint32_t thread_count = 0;
+	std::string vertex_format;
+	std::vector<ShaderVariant> variants;
+	try
+	{
+		for (int i = 1; i < argc; i++) {
+			if (strcmp(argv[i], "--dxc") == 0 && i + 1 < argc)
+				dxc = argv[++i];
+			else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+				output = argv[++i];
+			else if (strcmp(argv[i], "--vertex-format") == 0 && i + 1 < argc)
+				vertex_format = argv[++i];
+			else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+				thread_count = static_cast<uint32_t>(std::max(1, atoi(argv[++i])));
+			else if (source_path.empty())
+				source_path = argv[i];
+			else
+				AddVariants(argv[i], variants);
+		}
+
+		// Vertex shaders read the format's attributes, defined last like the renderer does
+		if (!vertex_format.empty()) {
+			const std::string signature = VertexFormats::GetHlslInputSignature(vertex_format);
+			for (ShaderVariant& variant : variants) {
+				if (variant.target.compare(0, 3, "vs_") == 0)
+					variant.defines.push_back({ "VERTEX_INPUT", signature });
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		printf("%s\n", e.what());
+		return 1;
+	}
+
+	if (output.empty() || source_path.empty() || variants.empty()) {
+		printf("Usage: %s [--dxc path] [--threads N] [--vertex-format name] --output <cache file> <source.hlsl> ENTRY:TARGET[:NAME=VALUE,...[:FEATURE,...]]...\n", argv[0]);
+		return 1;
+	}
+
+	std::string source;
+	if (!ReadShaderSource(source_path, source)) {
+		printf("Can't read %s\n", source_path.c_str());
+		return 1;
+	}
+
+	if (!IsDxcAvailable(dxc)) {
+		printf("warning: %s not found, shaders will be compiled at runtime\n", dxc.c_str());
+		return 0;
+	}
+
+	// Every variant is a separate DXC process writing its own file, stored once all are done
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<std::vector<char>> bytecode(variants.size());
+	try
+	{
+		ParallelFor(variants.size(), thread_count, [&](size_t i) {
+			const ShaderVariant& variant = variants[i];
+			const std::string bytecode_path = output + ".tmp" + std::to_string(i);
+			const int result = std::system(GetDxcCommandLine(dxc, variant, source_path, bytecode_path).c_str());
+			{
+				std::ifstream file(bytecode_path, std::ios::binary);
+				bytecode[i].assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			}
+			std::remove(bytecode_path.c_str());
+			if (result != 0 || bytecode[i].empty())
+				throw std::runtime_error(source_path + ": " + variant.entry_point + " for " + variant.target + " failed");
+		});
+	}
+	catch (const std::exception& e)
+	{
+		printf("%s\n", e.what());
+		return 1;
+	}
+	const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	PipelineCache cache;
+	for (size_t i = 0; i < variants.size(); i++)
+		cache.Store(GetShaderKey(source, variants[i]), bytecode[i].data(), bytecode[i].size());
+	try
+	{
+		cache.Save(output);
+	}
+	catch (const std::exception& e)
+	{
+		printf("%s\n", e.what());
+		return 1;
+	}
+
+	const PipelineCache::Stats stats = cache.GetStats();
+	printf("%s: %zu variants, %llu bytes of bytecode in %.0f ms, %.1f variants/s\n", output.c_str(), stats.entries,
+		static_cast<unsigned long long>(stats.bytes), ms, variants.size() * 1000.0 / std::max(ms, 1.0));
+	return 0;
+}
@@ -0,0 +1,104 @@
+#include "shader_permutations.h"
+
+#include <stdexcept>
+
+ShaderPermutationSet::ShaderPermutationSet(std::vector<std::string> features, const std::vector<Requirement>& requirements)
+	: features(std::move(features)), required_masks(this->features.size(), 0)
+{
+	if (this->features.size() > max_features)
+		throw std::invalid_argument("Too many shader features, permutations grow as 2^features");
+	for (size_t i = 0; i < this->features.size(); i++) {
+		if (this->features[i].empty())
+			throw std::invalid_argument("Empty shader feature name");
+		for (size_t j = 0; j < i; j++) {
+			if (this->features[i] == this->features[j])
+				throw std::invalid_argument("Shader feature " + this->features[i] + " declared twice");
+		}
+	}
+	for (const Requirement& requirement : requirements) {
+		const uint32_t required = GetMask(requirement.required);
+		if (requirement.feature == requirement.required)
+			throw std::invalid_argument("Shader feature " + requirement.feature + " requires itself");
+		required_masks[GetIndex(requirement.feature)] |= required;
+	}
+}
+
+uint32_t ShaderPermutationSet::GetMask(const std::string& feature) const
+{
+	return 1u << GetIndex(feature);
+}
+
+uint32_t ShaderPermutationSet::Resolve(uint32_t permutation) const
+{
+	permutation &= GetAllFeatures();
+	// Clearing a feature can break the requirement of another, repeat until nothing changes
+	for (bool changed = true; changed;) {
+		changed = false;
+		for (size_t i = 0; i < features.size(); i++) {
+			if ((permutation >> i) & 1 && (permutation & required_masks[i]) != required_masks[i]) {
+				permutation &= ~(1u << i);
+				changed = true;
+			}
+		}
+	}
+	return permutation;
+}
+
+std::vector<uint32_t> ShaderPermutationSet::GetDistinctPermutations() const
+{
+	std::vector<uint32_t> permutations;
+	for (uint32_t permutation = 0; permutation < GetPermutationCount(); permutation++) {
+		if (IsDistinct(permutation))
+			permutations.push_back(permutation);
+	}
+	return permutations;
+}
+
+std::vector<ShaderDefine> ShaderPermutationSet::GetDefines(uint32_t permutation, const std::vector<ShaderDefine>& base) const
+{
+	std::vector<ShaderDefine> defines = base;
+	for (size_t i = 0; i < features.size(); i++)
+		defines.push_back({ features[i], (permutation >> i) & 1 ? "1" : "0" });
+	return defines;
+}
+
+std::string ShaderPermutationSet::Describe(uint32_t permutation) const
+{
+	std::string description;
+	for (size_t i = 0; i < features.size(); i++) {
+		if ((permutation >> i) & 1)
+			description += (description.empty() ? "" : "|") + features[i];
+	}
+	return description.empty() ? "none" : description;
+}
+
+ShaderPermutationSet ShaderPermutationSet::Parse(const std::string& list)
+{
+	std::vector<std::string> features;
+	std::vector<Requirement> requirements;
+	size_t begin = 0;
+	while (!list.empty()) {
+		const size_t end = list.find(',', begin);
+		std::string feature = list.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+		// Requirements may name features declared later, they are checked once all are known
+		const size_t required = feature.find('+');
+		if (required != std::string::npos) {
+			requirements.push_back({ feature.substr(0, required), feature.substr(required + 1) });
+			feature.resize(required);
+		}
+		features.push_back(std::move(feature));
+		if (end == std::string::npos)
+			break;
+		begin = end + 1;
+	}
+	return ShaderPermutationSet(std::move(features), requirements);
+}
+
+size_t ShaderPermutationSet::GetIndex(const std::string& feature) const
+{
+	for (size_t i = 0; i < features.size(); i++) {
+		if (features[i] == feature)
+			return i;
+	}
+	throw std::invalid_argument("Unknown shader feature " + feature);
+}
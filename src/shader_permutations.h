@@ -0,0 +1,57 @@
+#pragma once
+
+#include "shader_cache.h"
+
+#include <string>
+#include <vector>
+
+// Compile-time features of a shader, each one a define the shader tests with #if.
+// A permutation is a bitmask where bit i enables features[i]; every feature is defined
+// to 0 or 1, so disabled features compile out and cost nothing at runtime.
+// A feature that only has an effect together with another one requires it: masks enabling it
+// alone compile to the same code as without it, so only distinct permutations are built.
+class ShaderPermutationSet
+{
+public:
+	static const uint32_t max_features = 16;
+
+	struct Requirement
+	{
+		std::string feature;
+		std::string required;
+	};
+
+	ShaderPermutationSet() = default;
+	// Throws std::invalid_argument for more than max_features, duplicated features or
+	// requirements naming unknown features
+	explicit ShaderPermutationSet(std::vector<std::string> features, const std::vector<Requirement>& requirements = {});
+
+	uint32_t GetFeatureCount() const { return static_cast<uint32_t>(features.size()); }
+	// Every feature mask, including those that resolve to another permutation
+	uint32_t GetPermutationCount() const { return 1u << features.size(); }
+	uint32_t GetAllFeatures() const { return GetPermutationCount() - 1; }
+	const std::vector<std::string>& GetFeatures() const { return features; }
+
+	// Throws std::invalid_argument for unknown features
+	uint32_t GetMask(const std::string& feature) const;
+	// Clears features whose requirements are disabled, the result is a distinct permutation
+	uint32_t Resolve(uint32_t permutation) const;
+	bool IsDistinct(uint32_t permutation) const { return Resolve(permutation) == permutation; }
+	// The permutations worth compiling, in ascending mask order
+	std::vector<uint32_t> GetDistinctPermutations() const;
+	// Base defines followed by every feature, in declaration order
+	std::vector<ShaderDefine> GetDefines(uint32_t permutation, const std::vector<ShaderDefine>& base = {}) const;
+	// Enabled feature names joined with '|', for reports
+	std::string Describe(uint32_t permutation) const;
+
+	// Parses a comma separated feature list as used by the shader compiler tool.
+	// FEATURE+REQUIRED declares that FEATURE only has an effect together with REQUIRED.
+	static ShaderPermutationSet Parse(const std::string& list);
+
+private:
+	std::vector<std::string> features;
+	// Per feature, the mask of the features it requires
+	std::vector<uint32_t> required_masks;
+
+	size_t GetIndex(const std::string& feature) const;
+};
@@ -0,0 +1,290 @@
+#include "state_filter.h"
+
+#include <cstring>
+
+using RHI::CommandId;
+
+void StateFilterCommandList::InvalidateState()
+{
+	pipeline_state = nullptr;
+	root_signature = nullptr;
+	heap_count = 0;
+	InvalidateRootBindings();
+	viewport_count = 0;
+	scissor_count = 0;
+	topology = RHI::PrimitiveTopology::Undefined;
+	vertex_buffer_valid = 0;
+	render_targets_valid = false;
+	// Barriers still pending are dropped with the recording they belonged to
+	stats.elided[static_cast<size_t>(CommandId::ResourceBarrier)] += pending_barrier_calls;
+	pending_barrier_calls = 0;
+	pending_barriers.clear();
+}
+
+void StateFilterCommandList::InvalidateRootBindings()
+{
+	for (uint32_t i = 0; i < max_root_parameters; i++) {
+		root_bindings[i] = RootBinding::None;
+		root_constant_valid[i] = 0;
+	}
+}
+
+bool StateFilterCommandList::Filter(CommandId id, bool redundant)
+{
+	if (redundant) {
+		stats.elided[static_cast<size_t>(id)]++;
+		return false;
+	}
+	stats.issued[static_cast<size_t>(id)]++;
+	return true;
+}
+
+void StateFilterCommandList::FlushBarriers()
+{
+	if (pending_barrier_calls == 0)
+		return;
+
+	// The batch is issued as one of the calls merged into it, the others are dropped. Calls whose
+	// transitions cancelled out are dropped entirely.
+	const size_t calls = pending_barrier_calls;
+	pending_barrier_calls = 0;
+	if (pending_barriers.empty()) {
+		stats.elided[static_cast<size_t>(CommandId::ResourceBarrier)] += calls;
+		return;
+	}
+	stats.issued[static_cast<size_t>(CommandId::ResourceBarrier)]++;
+	stats.elided[static_cast<size_t>(CommandId::ResourceBarrier)] += calls - 1;
+	stats.barriers_issued += pending_barriers.size();
+	inner->ResourceBarrier(static_cast<uint32_t>(pending_barriers.size()), pending_barriers.data());
+	pending_barriers.clear();
+}
+
+void StateFilterCommandList::Reset(RHI::CommandAllocator* allocator, RHI::PipelineState* initial_state)
+{
+	InvalidateState();
+	inner->Reset(allocator, initial_state);
+	pipeline_state = initial_state;
+}
+
+void StateFilterCommandList::Close()
+{
+	FlushBarriers();
+	inner->Close();
+}
+
+void StateFilterCommandList::SetPipelineState(RHI::PipelineState* state)
+{
+	if (Filter(CommandId::SetPipelineState, state == pipeline_state)) {
+		pipeline_state = state;
+		inner->SetPipelineState(state);
+	}
+}
+
+void StateFilterCommandList::SetGraphicsRootSignature(RHI::RootSignature* signature)
+{
+	if (Filter(CommandId::SetGraphicsRootSignature, signature == root_signature)) {
+		// Changing the root signature drops every root binding
+		root_signature = signature;
+		InvalidateRootBindings();
+		inner->SetGraphicsRootSignature(signature);
+	}
+}
+
+void StateFilterCommandList::SetDescriptorHeaps(uint32_t count, RHI::DescriptorHeap* const* new_heaps)
+{
+	bool redundant = count == heap_count;
+	for (uint32_t i = 0; redundant && i < count; i++)
+		redundant = new_heaps[i] == heaps[i];
+
+	if (Filter(CommandId::SetDescriptorHeaps, redundant)) {
+		heap_count = count < 2 ? count : 2;
+		for (uint32_t i = 0; i < heap_count; i++)
+			heaps[i] = new_heaps[i];
+		// Tables point into the previous heaps
+		for (uint32_t i = 0; i < max_root_parameters; i++) {
+			if (root_bindings[i] == RootBinding::Table)
+				root_bindings[i] = RootBinding::None;
+		}
+		inner->SetDescriptorHeaps(count, new_heaps);
+	}
+}
+
+void StateFilterCommandList::SetGraphicsRootDescriptorTable(uint32_t index, RHI::GpuDescriptorHandle base)
+{
+	bool redundant = index < max_root_parameters && root_bindings[index] == RootBinding::Table && root_values[index] == base.ptr;
+	if (Filter(CommandId::SetGraphicsRootDescriptorTable, redundant)) {
+		if (index < max_root_parameters) {
+			root_bindings[index] = RootBinding::Table;
+			root_values[index] = base.ptr;
+		}
+		inner->SetGraphicsRootDescriptorTable(index, base);
+	}
+}
+
+void StateFilterCommandList::SetGraphicsRootConstantBufferView(uint32_t index, uint64_t address)
+{
+	bool redundant = index < max_root_parameters && root_bindings[index] == RootBinding::ConstantBufferView && root_values[index] == address;
+	if (Filter(CommandId::SetGraphicsRootConstantBufferView, redundant)) {
+		if (index < max_root_parameters) {
+			root_bindings[index] = RootBinding::ConstantBufferView;
+			root_values[index] = address;
+		}
+		inner->SetGraphicsRootConstantBufferView(index, address);
+	}
+}
+
+void StateFilterCommandList::SetGraphicsRoot32BitConstants(uint32_t index, uint32_t count, const void* data, uint32_t dest_offset)
+{
+	const bool trackable = index < max_root_parameters && count > 0 && dest_offset + count <= max_root_constants;
+	uint64_t mask = 0;
+	if (trackable)
+		mask = (count == 64 ? ~0ull : ((1ull << count) - 1)) << dest_offset;
+
+	bool redundant = trackable && (root_constant_valid[index] & mask) == mask
+		&& memcmp(&root_constants[index][dest_offset], data, sizeof(uint32_t) * count) == 0;
+	if (Filter(CommandId::SetGraphicsRoot32BitConstants, redundant)) {
+		if (trackable) {
+			memcpy(&root_constants[index][dest_offset], data, sizeof(uint32_t) * count);
+			root_constant_valid[index] |= mask;
+		}
+		inner->SetGraphicsRoot32BitConstants(index, count, data, dest_offset);
+	}
+}
+
+void StateFilterCommandList::RSSetViewports(uint32_t count, const RHI::Viewport* new_viewports)
+{
+	bool redundant = count == viewport_count && memcmp(viewports, new_viewports, sizeof(RHI::Viewport) * count) == 0;
+	if (Filter(CommandId::RSSetViewports, redundant)) {
+		viewport_count = count <= max_viewports ? count : 0;
+		memcpy(viewports, new_viewports, sizeof(RHI::Viewport) * viewport_count);
+		inner->RSSetViewports(count, new_viewports);
+	}
+}
+
+void StateFilterCommandList::RSSetScissorRects(uint32_t count, const RHI::Rect* rects)
+{
+	bool redundant = count == scissor_count && memcmp(scissor_rects, rects, sizeof(RHI::Rect) * count) == 0;
+	if (Filter(CommandId::RSSetScissorRects, redundant)) {
+		scissor_count = count <= max_viewports ? count : 0;
+		memcpy(scissor_rects, rects, sizeof(RHI::Rect) * scissor_count);
+		inner->RSSetScissorRects(count, rects);
+	}
+}
+
+void StateFilterCommandList::ResourceBarrier(uint32_t count, const RHI::ResourceBarrier* barriers)
+{
+	// Counted once FlushBarriers knows whether the batch is issued
+	pending_barrier_calls++;
+	stats.barriers_requested += count;
+
+	for (uint32_t i = 0; i < count; i++) {
+		const RHI::ResourceBarrier& barrier = barriers[i];
+		// Only the resource's latest pending barrier can absorb a transition, merging into an older
+		// one would move the transition ahead of an aliasing barrier pending between them
+		auto latest = pending_barriers.end();
+		for (auto it = pending_barriers.begin(); it != pending_barriers.end(); ++it) {
+			if (it->resource == barrier.resource)
+				latest = it;
+		}
+		if (barrier.type == RHI::ResourceBarrierType::Transition && latest != pending_barriers.end()
+			&& latest->type == RHI::ResourceBarrierType::Transition && latest->after == barrier.before) {
+			latest->after = barrier.after;
+			if (latest->before == latest->after)
+				pending_barriers.erase(latest);
+			continue;
+		}
+		pending_barriers.push_back(barrier);
+	}
+}
+
+void StateFilterCommandList::OMSetRenderTargets(uint32_t count, const RHI::CpuDescriptorHandle* rtvs, const RHI::CpuDescriptorHandle* dsv)
+{
+	bool redundant = render_targets_valid && count == render_target_count && (dsv != nullptr) == has_depth_stencil
+		&& (!dsv || dsv->ptr == depth_stencil.ptr);
+	for (uint32_t i = 0; redundant && i < count; i++)
+		redundant = rtvs[i].ptr == render_targets[i].ptr;
+
+	if (Filter(CommandId::OMSetRenderTargets, redundant)) {
+		render_targets_valid = count <= 8;
+		render_target_count = count;
+		for (uint32_t i = 0; i < count && i < 8; i++)
+			render_targets[i] = rtvs[i];
+		has_depth_stencil = dsv != nullptr;
+		depth_stencil = dsv ? *dsv : RHI::CpuDescriptorHandle{ 0 };
+		inner->OMSetRenderTargets(count, rtvs, dsv);
+	}
+}
+
+void StateFilterCommandList::ClearRenderTargetView(RHI::CpuDescriptorHandle rtv, const float color[4])
+{
+	FlushBarriers();
+	Filter(CommandId::ClearRenderTargetView, false);
+	inner->ClearRenderTargetView(rtv, color);
+}
+
+void StateFilterCommandList::ClearDepthStencilView(RHI::CpuDescriptorHandle dsv, float depth)
+{
+	FlushBarriers();
+	Filter(CommandId::ClearDepthStencilView, false);
+	inner->ClearDepthStencilView(dsv, depth);
+}
+
+void StateFilterCommandList::IASetPrimitiveTopology(RHI::PrimitiveTopology new_topology)
+{
+	if (Filter(CommandId::IASetPrimitiveTopology, new_topology == topology)) {
+		topology = new_topology;
+		inner->IASetPrimitiveTopology(new_topology);
+	}
+}
+
+void StateFilterCommandList::IASetVertexBuffers(uint32_t start_slot, uint32_t count, const RHI::VertexBufferView* views)
+{
+	const bool trackable = start_slot + count <= max_vertex_buffers;
+	bool redundant = trackable;
+	for (uint32_t i = 0; redundant && i < count; i++) {
+		redundant = (vertex_buffer_valid & (1u << (start_slot + i)))
+			&& memcmp(&vertex_buffers[start_slot + i], &views[i], sizeof(RHI::VertexBufferView)) == 0;
+	}
+
+	if (Filter(CommandId::IASetVertexBuffers, redundant)) {
+		for (uint32_t i = 0; trackable && i < count; i++) {
+			vertex_buffers[start_slot + i] = views[i];
+			vertex_buffer_valid |= 1u << (start_slot + i);
+		}
+		inner->IASetVertexBuffers(start_slot, count, views);
+	}
+}
+
+void StateFilterCommandList::DrawInstanced(uint32_t vertex_count, uint32_t instance_count, uint32_t start_vertex, uint32_t start_instance)
+{
+	FlushBarriers();
+	Filter(CommandId::DrawInstanced, false);
+	inner->DrawInstanced(vertex_count, instance_count, start_vertex, start_instance);
+}
+
+void StateFilterCommandList::CopyBufferRegion(RHI::Resource* dst, uint64_t dst_offset, RHI::Resource* src, uint64_t src_offset, uint64_t size)
+{
+	FlushBarriers();
+	Filter(CommandId::CopyBufferRegion, false);
+	inner->CopyBufferRegion(dst, dst_offset, src, src_offset, size);
+}
+
+void StateFilterCommandList::CopyTextureToBuffer(RHI::Resource* dst, uint64_t dst_offset, uint32_t dst_row_pitch, RHI::Resource* src)
+{
+	FlushBarriers();
+	Filter(CommandId::CopyTextureToBuffer, false);
+	inner->CopyTextureToBuffer(dst, dst_offset, dst_row_pitch, src);
+}
+
+void StateFilterCommandList::ExecuteBundle(RHI::CommandList* bundle)
+{
+	FlushBarriers();
+	Filter(CommandId::ExecuteBundle, false);
+	inner->ExecuteBundle(bundle);
+	// Whatever the bundle bound is current now, only heaps and output state can't change in bundles
+	pipeline_state = nullptr;
+	root_signature = nullptr;
+	InvalidateRootBindings();
+	topology = RHI::PrimitiveTopology::Undefined;
+	vertex_buffer_valid = 0;
+}
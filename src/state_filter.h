@@ -0,0 +1,101 @@
+#pragma once
+
+#include "rhi.h"
+#include "rhi_commands.h"
+
+#include <vector>
+
+struct StateFilterStats
+{
+	uint64_t issued[static_cast<size_t>(RHI::CommandId::Count)] = {};
+	uint64_t elided[static_cast<size_t>(RHI::CommandId::Count)] = {};
+	// Individual transitions, ResourceBarrier counters above count batches
+	uint64_t barriers_requested = 0;
+	uint64_t barriers_issued = 0;
+};
+
+// Forwards to the wrapped command list, dropping state that is already bound and
+// merging resource barriers into one batch issued right before the next command that needs them.
+// Transitions of the same resource that cancel out are dropped entirely.
+class StateFilterCommandList : public RHI::CommandList
+{
+public:
+	explicit StateFilterCommandList(RHI::CommandList* inner = nullptr) : inner(inner) {}
+
+	void SetInner(RHI::CommandList* command_list) { inner = command_list; }
+
+	void Reset(RHI::CommandAllocator* allocator, RHI::PipelineState* initial_state) override;
+	void Close() override;
+
+	void SetPipelineState(RHI::PipelineState* pipeline_state) override;
+	void SetGraphicsRootSignature(RHI::RootSignature* root_signature) override;
+	void SetDescriptorHeaps(uint32_t count, RHI::DescriptorHeap* const* heaps) override;
+	void SetGraphicsRootDescriptorTable(uint32_t index, RHI::GpuDescriptorHandle base) override;
+	void SetGraphicsRootConstantBufferView(uint32_t index, uint64_t address) override;
+	void SetGraphicsRoot32BitConstants(uint32_t index, uint32_t count, const void* data, uint32_t dest_offset) override;
+
+	void RSSetViewports(uint32_t count, const RHI::Viewport* viewports) override;
+	void RSSetScissorRects(uint32_t count, const RHI::Rect* rects) override;
+	void ResourceBarrier(uint32_t count, const RHI::ResourceBarrier* barriers) override;
+
+	void OMSetRenderTargets(uint32_t count, const RHI::CpuDescriptorHandle* rtvs, const RHI::CpuDescriptorHandle* dsv) override;
+	void ClearRenderTargetView(RHI::CpuDescriptorHandle rtv, const float color[4]) override;
+	void ClearDepthStencilView(RHI::CpuDescriptorHandle dsv, float depth) override;
+
+	void IASetPrimitiveTopology(RHI::PrimitiveTopology topology) override;
+	void IASetVertexBuffers(uint32_t start_slot, uint32_t count, const RHI::VertexBufferView* views) override;
+	void DrawInstanced(uint32_t vertex_count, uint32_t instance_count, uint32_t start_vertex, uint32_t start_instance) override;
+
+	void CopyBufferRegion(RHI::Resource* dst, uint64_t dst_offset, RHI::Resource* src, uint64_t src_offset, uint64_t size) override;
+	void CopyTextureToBuffer(RHI::Resource* dst, uint64_t dst_offset, uint32_t dst_row_pitch, RHI::Resource* src) override;
+
+	void ExecuteBundle(RHI::CommandList* bundle) override;
+
+	const StateFilterStats& GetStats() const { return stats; }
+	void ResetStats() { stats = {}; }
+
+private:
+	static const uint32_t max_root_parameters = 64;
+	static const uint32_t max_root_constants = 64;
+	static const uint32_t max_vertex_buffers = 32;
+	static const uint32_t max_viewports = 16;
+
+	enum class RootBinding : uint8_t { None, Table, ConstantBufferView };
+
+	RHI::CommandList* inner;
+	StateFilterStats stats;
+
+	RHI::PipelineState* pipeline_state = nullptr;
+	RHI::RootSignature* root_signature = nullptr;
+	uint32_t heap_count = 0;
+	RHI::DescriptorHeap* heaps[2] = {};
+
+	RootBinding root_bindings[max_root_parameters] = {};
+	uint64_t root_values[max_root_parameters] = {};
+	uint64_t root_constant_valid[max_root_parameters] = {};
+	uint32_t root_constants[max_root_parameters][max_root_constants] = {};
+
+	uint32_t viewport_count = 0;
+	RHI::Viewport viewports[max_viewports] = {};
+	uint32_t scissor_count = 0;
+	RHI::Rect scissor_rects[max_viewports] = {};
+
+	RHI::PrimitiveTopology topology = RHI::PrimitiveTopology::Undefined;
+	uint32_t vertex_buffer_valid = 0;
+	RHI::VertexBufferView vertex_buffers[max_vertex_buffers] = {};
+
+	bool render_targets_valid = false;
+	uint32_t render_target_count = 0;
+	RHI::CpuDescriptorHandle render_targets[8] = {};
+	bool has_depth_stencil = false;
+	RHI::CpuDescriptorHandle depth_stencil = {};
+
+	std::vector<RHI::ResourceBarrier> pending_barriers;
+	// ResourceBarrier calls merged into pending_barriers
+	size_t pending_barrier_calls = 0;
+
+	void InvalidateState();
+	void InvalidateRootBindings();
+	bool Filter(RHI::CommandId id, bool redundant);
+	void FlushBarriers();
+};
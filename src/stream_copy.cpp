@@ -0,0 +1,142 @@
+#include "stream_copy.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define STREAM_COPY_X64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX in functions that ask for it, MSVC always can
+#if defined(__GNUC__)
+#define STREAM_COPY_TARGET_AVX __attribute__((target("avx")))
+#else
+#define STREAM_COPY_TARGET_AVX
+#endif
+
+namespace
+{
+#ifdef STREAM_COPY_X64
+	bool HasAvx()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		// The OS must also save the upper register halves
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#else
+		return __builtin_cpu_supports("avx");
+#endif
+	}
+
+	// Four stores fill one write-combining buffer
+	void CopySse2(uint8_t* dst, const uint8_t* src, size_t size)
+	{
+		size_t i = 0;
+		for (; i + 64 <= size; i += 64) {
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 16));
+			const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 32));
+			const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 48));
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst + i), a);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst + i + 16), b);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst + i + 32), c);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst + i + 48), d);
+		}
+		for (; i < size; i += 16)
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst + i), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+	}
+
+	STREAM_COPY_TARGET_AVX void CopyAvx(uint8_t* dst, const uint8_t* src, size_t size)
+	{
+		size_t i = 0;
+		for (; i + 64 <= size; i += 64) {
+			const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+			const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 32));
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(dst + i), a);
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(dst + i + 32), b);
+		}
+		for (; i < size; i += 16)
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst + i), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+	}
+#endif
+}
+
+const char* GetStreamKernelName(StreamKernel kernel)
+{
+	switch (kernel) {
+	case StreamKernel::Memcpy: return "memcpy";
+	case StreamKernel::Sse2: return "sse2";
+	case StreamKernel::Avx: return "avx";
+	}
+	return "unknown";
+}
+
+bool IsStreamKernelSupported(StreamKernel kernel)
+{
+	switch (kernel) {
+	case StreamKernel::Memcpy:
+		return true;
+#ifdef STREAM_COPY_X64
+	case StreamKernel::Sse2:
+		return true;
+	case StreamKernel::Avx: {
+		static const bool avx = HasAvx();
+		return avx;
+	}
+#endif
+	default:
+		return false;
+	}
+}
+
+StreamKernel GetBestStreamKernel()
+{
+	if (IsStreamKernelSupported(StreamKernel::Avx))
+		return StreamKernel::Avx;
+	if (IsStreamKernelSupported(StreamKernel::Sse2))
+		return StreamKernel::Sse2;
+	return StreamKernel::Memcpy;
+}
+
+void StreamCopy(StreamKernel kernel, void* dst, const void* src, size_t size)
+{
+	if (reinterpret_cast<uintptr_t>(dst) % 16 != 0 || size % 16 != 0)
+		throw std::invalid_argument("Streaming copies need a 16 byte aligned destination and size");
+	if (!IsStreamKernelSupported(kernel))
+		throw std::invalid_argument(std::string("Streaming kernel not supported: ") + GetStreamKernelName(kernel));
+
+	uint8_t* out = static_cast<uint8_t*>(dst);
+	const uint8_t* in = static_cast<const uint8_t*>(src);
+	switch (kernel) {
+#ifdef STREAM_COPY_X64
+	case StreamKernel::Avx:
+		if (reinterpret_cast<uintptr_t>(dst) % 32 == 0) {
+			CopyAvx(out, in, size);
+			break;
+		}
+		CopySse2(out, in, size);
+		break;
+	case StreamKernel::Sse2:
+		CopySse2(out, in, size);
+		break;
+#endif
+	default:
+		memcpy(out, in, size);
+		break;
+	}
+}
+
+void StreamFence()
+{
+#ifdef STREAM_COPY_X64
+	_mm_sfence();
+#endif
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Copies into write-combined memory such as mapped upload heaps.
+// The destination is only ever written, with non-temporal stores of whole 64 byte lines where
+// possible, so the CPU never reads it back and the combining buffers leave full.
+enum class StreamKernel
+{
+	// Plain memcpy, what writing constants did before
+	Memcpy,
+	Sse2,
+	Avx
+};
+
+const char* GetStreamKernelName(StreamKernel kernel);
+bool IsStreamKernelSupported(StreamKernel kernel);
+// Widest kernel the CPU supports
+StreamKernel GetBestStreamKernel();
+
+// dst must be 16 byte aligned and size a multiple of 16, the AVX kernel falls back to SSE2
+// for destinations that are not 32 byte aligned
+void StreamCopy(StreamKernel kernel, void* dst, const void* src, size_t size);
+inline void StreamCopy(void* dst, const void* src, size_t size) { StreamCopy(GetBestStreamKernel(), dst, src, size); }
+// Orders the non-temporal stores of previous copies, call once per batch before the GPU or
+// another thread may read the memory
+void StreamFence();
@@ -0,0 +1,244 @@
+#include "tlsf_allocator.h"
+
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+	uint32_t HighestBit(uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return index;
+#else
+		return 63 - __builtin_clzll(value);
+#endif
+	}
+
+	uint32_t LowestBit(uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return index;
+#else
+		return __builtin_ctzll(value);
+#endif
+	}
+}
+
+TlsfAllocator::TlsfAllocator(uint64_t capacity, uint64_t granularity) : granularity(granularity)
+{
+	if (granularity == 0 || (granularity & (granularity - 1)) != 0)
+		throw std::invalid_argument("TLSF granularity must be a power of two");
+	granularity_shift = HighestBit(granularity);
+	this->capacity = (capacity >> granularity_shift) << granularity_shift;
+	if (this->capacity == 0)
+		throw std::invalid_argument("TLSF capacity is smaller than its granularity");
+
+	for (auto& heads : free_heads) {
+		for (uint32_t& head : heads)
+			head = invalid_block;
+	}
+	// Block 0 always starts at offset 0, coalescing keeps the lower block
+	InsertFree(NewBlock(0, this->capacity >> granularity_shift));
+}
+
+bool TlsfAllocator::Allocate(uint64_t size, uint64_t alignment, Allocation& allocation)
+{
+	if (size == 0 || size > capacity)
+		return false;
+
+	const uint64_t units = (size + granularity - 1) >> granularity_shift;
+	const uint64_t alignment_units = alignment > granularity ? alignment >> granularity_shift : 1;
+
+	// Worst case padding is reserved up front so the block found always fits
+	uint32_t index = FindFreeBlock(units + alignment_units - 1);
+	if (index == invalid_block)
+		return false;
+	RemoveFree(index);
+
+	const uint64_t aligned = (blocks[index].offset + alignment_units - 1) & ~(alignment_units - 1);
+	if (aligned != blocks[index].offset) {
+		// The padding in front stays free, its previous neighbour is in use
+		uint32_t rest = Split(index, aligned - blocks[index].offset);
+		InsertFree(index);
+		index = rest;
+	}
+	if (blocks[index].size > units)
+		InsertFree(Split(index, units));
+
+	used += units << granularity_shift;
+	allocation_count++;
+	allocation = { aligned << granularity_shift, units << granularity_shift, index };
+	return true;
+}
+
+void TlsfAllocator::Free(const Allocation& allocation)
+{
+	uint32_t index = allocation.block;
+	if (index >= blocks.size() || blocks[index].free)
+		throw std::logic_error("Freeing a TLSF block that is not allocated");
+
+	used -= blocks[index].size << granularity_shift;
+	allocation_count--;
+
+	// Coalesce with free neighbours so no two free blocks are ever adjacent
+	const uint32_t prev = blocks[index].prev_physical;
+	if (prev != invalid_block && blocks[prev].free) {
+		RemoveFree(prev);
+		blocks[prev].size += blocks[index].size;
+		blocks[prev].next_physical = blocks[index].next_physical;
+		if (blocks[index].next_physical != invalid_block)
+			blocks[blocks[index].next_physical].prev_physical = prev;
+		// Merged away blocks count as free, so freeing their allocation again is caught
+		blocks[index].free = true;
+		unused_blocks.push_back(index);
+		index = prev;
+	}
+
+	const uint32_t next = blocks[index].next_physical;
+	if (next != invalid_block && blocks[next].free) {
+		RemoveFree(next);
+		blocks[index].size += blocks[next].size;
+		blocks[index].next_physical = blocks[next].next_physical;
+		if (blocks[next].next_physical != invalid_block)
+			blocks[blocks[next].next_physical].prev_physical = index;
+		blocks[next].free = true;
+		unused_blocks.push_back(next);
+	}
+
+	InsertFree(index);
+}
+
+TlsfAllocator::Stats TlsfAllocator::GetStats() const
+{
+	Stats stats = {};
+	stats.capacity = capacity;
+	stats.used = used;
+	stats.allocations = allocation_count;
+
+	uint64_t free_size = 0;
+	bool hole_seen = false;
+	for (uint32_t index = 0; index != invalid_block; index = blocks[index].next_physical) {
+		const uint64_t size = blocks[index].size << granularity_shift;
+		if (blocks[index].free) {
+			free_size += size;
+			stats.free_blocks++;
+			if (size > stats.largest_free_block)
+				stats.largest_free_block = size;
+			hole_seen = true;
+		}
+		else if (hole_seen) {
+			stats.compaction_bytes += size;
+		}
+	}
+	stats.fragmentation = free_size ? 1.0 - static_cast<double>(stats.largest_free_block) / free_size : 0.0;
+	return stats;
+}
+
+void TlsfAllocator::Mapping(uint64_t size, uint32_t& fl, uint32_t& sl)
+{
+	if (size < sl_count) {
+		// Small sizes get exact bins in the first level
+		fl = 0;
+		sl = static_cast<uint32_t>(size);
+	}
+	else {
+		const uint32_t log = HighestBit(size);
+		fl = log - sl_bits + 1;
+		sl = static_cast<uint32_t>(size >> (log - sl_bits)) - sl_count;
+	}
+}
+
+uint32_t TlsfAllocator::FindFreeBlock(uint64_t size) const
+{
+	// Round up to the next bin boundary, every block in the bin found is large enough
+	if (size >= sl_count)
+		size += (1ull << (HighestBit(size) - sl_bits)) - 1;
+
+	uint32_t fl, sl;
+	Mapping(size, fl, sl);
+	if (fl >= fl_count)
+		return invalid_block;
+
+	uint32_t sl_map = sl_bitmap[fl] & (~0u << sl);
+	if (sl_map == 0) {
+		if (fl + 1 >= fl_count)
+			return invalid_block;
+		const uint64_t fl_map = fl_bitmap & (~0ull << (fl + 1));
+		if (fl_map == 0)
+			return invalid_block;
+		fl = LowestBit(fl_map);
+		sl_map = sl_bitmap[fl];
+	}
+	return free_heads[fl][LowestBit(sl_map)];
+}
+
+uint32_t TlsfAllocator::NewBlock(uint64_t offset, uint64_t size)
+{
+	Block block = { offset, size, invalid_block, invalid_block, invalid_block, invalid_block, false };
+	if (!unused_blocks.empty()) {
+		const uint32_t index = unused_blocks.back();
+		unused_blocks.pop_back();
+		blocks[index] = block;
+		return index;
+	}
+	blocks.push_back(block);
+	return static_cast<uint32_t>(blocks.size() - 1);
+}
+
+void TlsfAllocator::InsertFree(uint32_t index)
+{
+	uint32_t fl, sl;
+	Mapping(blocks[index].size, fl, sl);
+
+	Block& block = blocks[index];
+	block.free = true;
+	block.prev_free = invalid_block;
+	block.next_free = free_heads[fl][sl];
+	if (block.next_free != invalid_block)
+		blocks[block.next_free].prev_free = index;
+	free_heads[fl][sl] = index;
+
+	fl_bitmap |= 1ull << fl;
+	sl_bitmap[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::RemoveFree(uint32_t index)
+{
+	uint32_t fl, sl;
+	Mapping(blocks[index].size, fl, sl);
+
+	Block& block = blocks[index];
+	if (block.prev_free != invalid_block)
+		blocks[block.prev_free].next_free = block.next_free;
+	else
+		free_heads[fl][sl] = block.next_free;
+	if (block.next_free != invalid_block)
+		blocks[block.next_free].prev_free = block.prev_free;
+	block.free = false;
+
+	if (free_heads[fl][sl] == invalid_block) {
+		sl_bitmap[fl] &= ~(1u << sl);
+		if (sl_bitmap[fl] == 0)
+			fl_bitmap &= ~(1ull << fl);
+	}
+}
+
+uint32_t TlsfAllocator::Split(uint32_t index, uint64_t size)
+{
+	// NewBlock may grow the vector, so no references are held across it
+	const uint32_t rest = NewBlock(blocks[index].offset + size, blocks[index].size - size);
+	blocks[rest].prev_physical = index;
+	blocks[rest].next_physical = blocks[index].next_physical;
+	if (blocks[index].next_physical != invalid_block)
+		blocks[blocks[index].next_physical].prev_physical = rest;
+	blocks[index].next_physical = rest;
+	blocks[index].size = size;
+	return rest;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Two-level segregated fit allocator over an abstract range of offsets.
+// Allocation and free are O(1): free blocks are binned by size class with a bitmap
+// per level, neighbours are coalesced on free. Holds no memory itself, so it can
+// manage GPU heaps, descriptor ranges or anything else addressed by offset.
+class TlsfAllocator
+{
+public:
+	static const uint32_t invalid_block = ~0u;
+
+	struct Allocation
+	{
+		uint64_t offset;
+		uint64_t size;
+		uint32_t block;
+	};
+
+	struct Stats
+	{
+		uint64_t capacity;
+		uint64_t used;
+		uint64_t largest_free_block;
+		uint32_t allocations;
+		uint32_t free_blocks;
+		// Bytes of allocations placed after the first hole, what compaction would have to move
+		uint64_t compaction_bytes;
+		// 0 when all free space is one block, approaching 1 as it splinters
+		double fragmentation;
+	};
+
+	// Offsets and sizes are rounded to granularity, which must be a power of two
+	explicit TlsfAllocator(uint64_t capacity, uint64_t granularity = 256);
+
+	// Alignment must be a power of two, returns false if no free block fits
+	bool Allocate(uint64_t size, uint64_t alignment, Allocation& allocation);
+	void Free(const Allocation& allocation);
+
+	uint64_t GetCapacity() const { return capacity; }
+	uint64_t GetUsedSize() const { return used; }
+	uint32_t GetAllocationCount() const { return allocation_count; }
+	bool IsEmpty() const { return allocation_count == 0; }
+	// Walks every block, meant for reporting rather than per-frame use
+	Stats GetStats() const;
+
+private:
+	static const uint32_t sl_bits = 5;
+	static const uint32_t sl_count = 1u << sl_bits;
+	static const uint32_t fl_count = 64 - sl_bits + 1;
+
+	struct Block
+	{
+		// In units of granularity
+		uint64_t offset;
+		uint64_t size;
+		uint32_t prev_physical;
+		uint32_t next_physical;
+		uint32_t prev_free;
+		uint32_t next_free;
+		bool free;
+	};
+
+	uint64_t capacity;
+	uint64_t granularity;
+	uint32_t granularity_shift;
+	uint64_t used = 0;
+	uint32_t allocation_count = 0;
+
+	std::vector<Block> blocks;
+	std::vector<uint32_t> unused_blocks;
+	uint64_t fl_bitmap = 0;
+	uint32_t sl_bitmap[fl_count] = {};
+	uint32_t free_heads[fl_count][sl_count];
+
+	static void Mapping(uint64_t size, uint32_t& fl, uint32_t& sl);
+	uint32_t FindFreeBlock(uint64_t size) const;
+	uint32_t NewBlock(uint64_t offset, uint64_t size);
+	void InsertFree(uint32_t index);
+	void RemoveFree(uint32_t index);
+	// Splits size units off the front of block index, returns the block holding the rest
+	uint32_t Split(uint32_t index, uint64_t size);
+};
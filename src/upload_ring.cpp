@@ -0,0 +1,80 @@
+#include "upload_ring.h"
+
+#include <stdexcept>
+
+uint64_t RingAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	if (size == 0 || size > capacity)
+		return invalid_offset;
+
+	// Nothing in flight, start over from the beginning to avoid needless wrapping
+	if (used == 0)
+		head = tail = 0;
+
+	uint64_t offset = (head + alignment - 1) & ~(alignment - 1);
+	if (used == 0 || head > tail) {
+		// Free space runs from head to the end and from the start to tail
+		if (offset + size > capacity) {
+			if (size > tail && used != 0)
+				return invalid_offset;
+			// The tail of the buffer is skipped and counted as used until the frame retires
+			offset = 0;
+		}
+	}
+	else if (offset + size > tail) {
+		// Head has wrapped behind tail, only the gap between them is free
+		return invalid_offset;
+	}
+
+	const uint64_t consumed = offset >= head ? offset + size - head : capacity - head + offset + size;
+	head = offset + size;
+	used += consumed;
+	frame_used += consumed;
+	return offset;
+}
+
+void RingAllocator::EndFrame(uint64_t fence_value)
+{
+	if (frame_used == 0)
+		return;
+	frames.push_back({ fence_value, head, frame_used });
+	frame_used = 0;
+}
+
+void RingAllocator::Retire(uint64_t completed_fence_value)
+{
+	while (!frames.empty() && frames.front().fence_value <= completed_fence_value) {
+		tail = frames.front().end;
+		used -= frames.front().size;
+		frames.pop_front();
+	}
+}
+
+UploadRing::UploadRing(RHI::Device& device, uint64_t capacity) : ring(capacity)
+{
+	buffer = device.CreateBuffer(RHI::HeapType::Upload, capacity, RHI::ResourceState::GenericRead);
+	// Upload heaps stay mapped for the lifetime of the ring
+	mapped = static_cast<uint8_t*>(buffer->Map());
+}
+
+UploadRing::~UploadRing()
+{
+	buffer->Unmap();
+}
+
+UploadAllocation UploadRing::Allocate(uint64_t size, uint64_t alignment)
+{
+	UploadAllocation allocation;
+	if (!TryAllocate(size, alignment, allocation))
+		throw std::runtime_error("Upload ring is out of memory");
+	return allocation;
+}
+
+bool UploadRing::TryAllocate(uint64_t size, uint64_t alignment, UploadAllocation& allocation)
+{
+	const uint64_t offset = ring.Allocate(size, alignment);
+	if (offset == RingAllocator::invalid_offset)
+		return false;
+	allocation = { buffer.get(), offset, buffer->GetGpuAddress() + offset, mapped + offset };
+	return true;
+}
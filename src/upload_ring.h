@@ -0,0 +1,88 @@
+#pragma once
+
+#include "rhi.h"
+
+#include <cstring>
+#include <deque>
+
+// Offset bookkeeping for a ring of transient memory, independent of any GPU resource.
+// Allocations made before EndFrame(fence_value) are reused once Retire sees that fence value.
+class RingAllocator
+{
+public:
+	static const uint64_t invalid_offset = ~0ull;
+
+	explicit RingAllocator(uint64_t capacity) : capacity(capacity) {}
+
+	// Returns invalid_offset if the ring has no room left, alignment must be a power of two
+	uint64_t Allocate(uint64_t size, uint64_t alignment);
+	// Closes the current frame, its allocations retire once fence_value completes
+	void EndFrame(uint64_t fence_value);
+	// Releases every closed frame with a fence value up to completed_fence_value
+	void Retire(uint64_t completed_fence_value);
+
+	uint64_t GetCapacity() const { return capacity; }
+	// Bytes still owned by frames in flight and the current frame, including alignment padding
+	uint64_t GetUsedSize() const { return used; }
+	uint64_t GetFrameUsedSize() const { return frame_used; }
+	uint32_t GetFramesInFlight() const { return static_cast<uint32_t>(frames.size()); }
+
+private:
+	struct FrameMark
+	{
+		uint64_t fence_value;
+		uint64_t end;
+		uint64_t size;
+	};
+
+	uint64_t capacity;
+	uint64_t head = 0;
+	uint64_t tail = 0;
+	uint64_t used = 0;
+	uint64_t frame_used = 0;
+	std::deque<FrameMark> frames;
+};
+
+struct UploadAllocation
+{
+	RHI::Resource* resource;
+	uint64_t offset;
+	uint64_t gpu_address;
+	uint8_t* cpu_address;
+};
+
+// Per-frame upload memory for constants and other transient data, carved from one
+// persistently mapped upload buffer. Suballocations are 256 byte aligned by default
+// so they can be bound directly as constant buffer views.
+class UploadRing
+{
+public:
+	static const uint64_t constant_alignment = 256;
+
+	UploadRing(RHI::Device& device, uint64_t capacity);
+	~UploadRing();
+
+	// Throws std::runtime_error when the frames in flight use the whole ring
+	UploadAllocation Allocate(uint64_t size, uint64_t alignment = constant_alignment);
+	// Returns false instead of throwing when the ring is full
+	bool TryAllocate(uint64_t size, uint64_t alignment, UploadAllocation& allocation);
+
+	template <class T>
+	UploadAllocation Push(const T& data)
+	{
+		UploadAllocation allocation = Allocate(sizeof(T));
+		memcpy(allocation.cpu_address, &data, sizeof(T));
+		return allocation;
+	}
+
+	void EndFrame(uint64_t fence_value) { ring.EndFrame(fence_value); }
+	void Retire(uint64_t completed_fence_value) { ring.Retire(completed_fence_value); }
+
+	RHI::Resource* GetResource() const { return buffer.get(); }
+	const RingAllocator& GetRing() const { return ring; }
+
+private:
+	std::unique_ptr<RHI::Resource> buffer;
+	uint8_t* mapped;
+	RingAllocator ring;
+};
@@ -0,0 +1,17 @@
+#include "vertex_formats.h"
+
+#include <stdexcept>
+
+namespace VertexFormats
+{
+	std::string GetHlslInputSignature(const std::string& format)
+	{
+		if (format == "Standard")
+			return Standard::GetHlslInputSignature();
+		if (format == "Compact")
+			return Compact::GetHlslInputSignature();
+		if (format == "Half")
+			return Half::GetHlslInputSignature();
+		throw std::invalid_argument("Unknown vertex format " + format);
+	}
+}
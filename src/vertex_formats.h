@@ -0,0 +1,25 @@
+#pragma once
+
+#include "vertex_layout.h"
+
+#include <string>
+
+// Vertex formats of the scene, from the original 40 byte vertex down to 16 bytes.
+// The renderer draws SceneVertex; switching the alias and rebuilding compares their cost.
+namespace VertexFormats
+{
+	using namespace VertexLayout;
+
+	// Same layout as ColorVertex
+	using Standard = Layout<Attribute<Position, Float3>, Attribute<Color, Float4>, Attribute<Normal, Float3>>;
+	// 8 bit color and normal
+	using Compact = Layout<Attribute<Position, Float3>, Attribute<Color, Unorm4x8>, Attribute<Normal, Snorm4x8>>;
+	// Half precision position on top of Compact
+	using Half = Layout<Attribute<Position, Half4>, Attribute<Color, Unorm4x8>, Attribute<Normal, Snorm4x8>>;
+
+	static_assert(Standard::stride == 40 && Compact::stride == 20 && Half::stride == 16, "Unexpected vertex format size");
+
+	// HLSL input signature of a format by name, for the shader compiler tool.
+	// Throws std::invalid_argument for unknown names.
+	std::string GetHlslInputSignature(const std::string& format);
+}
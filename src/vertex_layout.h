@@ -0,0 +1,295 @@
+#pragma once
+
+#include "rhi.h"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+// Compile-time description of an interleaved vertex.
+// A layout lists attributes, each a semantic (what the shader reads) stored with an element
+// encoding (how many bytes the vertex buffer spends on it). Offsets, stride, input elements
+// and the HLSL input signature are all derived from that list, so trying a more compact
+// format is a one line change that can't get out of sync with the shader or the PSO.
+namespace VertexLayout
+{
+	inline uint16_t FloatToHalf(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+		const uint32_t magnitude = bits & 0x7fffffff;
+		// Too large, infinity or NaN
+		if (magnitude >= 0x47800000)
+			return sign | (magnitude > 0x7f800000 ? 0x7e00 : 0x7c00);
+		// Subnormal halves are multiples of 2^-24
+		if (magnitude < 0x38800000)
+			return sign | static_cast<uint16_t>(std::lrint(std::fabs(value) * 16777216.0f));
+		// Rebias the exponent and round the mantissa to nearest even, a carry moves into the exponent
+		uint32_t half = (magnitude - 0x38000000) >> 13;
+		const uint32_t rest = magnitude & 0x1fff;
+		if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+			half++;
+		return sign | static_cast<uint16_t>(half);
+	}
+
+	// Element encodings, Encode writes count floats and zero fills missing components
+	template <RHI::Format Format, uint32_t Components, bool Normalized>
+	struct Element
+	{
+		static constexpr RHI::Format format = Format;
+		static constexpr uint32_t components = Components;
+		static constexpr uint32_t size = RHI::GetFormatSize(Format);
+		// Normalized encodings only hold values in [0, 1] or [-1, 1]
+		static constexpr bool normalized = Normalized;
+		static_assert(size > 0, "Vertex elements need a format with a known size");
+	};
+
+	struct Float2 : Element<RHI::Format::R32G32Float, 2, false>
+	{
+		static void Encode(const float* values, uint32_t count, uint8_t* out);
+	};
+
+	struct Float3 : Element<RHI::Format::R32G32B32Float, 3, false>
+	{
+		static void Encode(const float* values, uint32_t count, uint8_t* out);
+	};
+
+	struct Float4 : Element<RHI::Format::R32G32B32A32Float, 4, false>
+	{
+		static void Encode(const float* values, uint32_t count, uint8_t* out);
+	};
+
+	struct Half2 : Element<RHI::Format::R16G16Float, 2, false>
+	{
+		static void Encode(const float* values, uint32_t count, uint8_t* out);
+	};
+
+	struct Half4 : Element<RHI::Format::R16G16B16A16Float, 4, false>
+	{
+		static void Encode(const float* values, uint32_t count, uint8_t* out);
+	};
+
+	struct Unorm4x8 : Element<RHI::Format::R8G8B8A8Unorm, 4, true>
+	{
+		static void Encode(const float* values, uint32_t count, uint8_t* out);
+	};
+
+	struct Snorm4x8 : Element<RHI::Format::R8G8B8A8Snorm, 4, true>
+	{
+		static void Encode(const float* values, uint32_t count, uint8_t* out);
+	};
+
+	// Semantics, components is what the application provides and the shader declares
+	struct Position
+	{
+		static constexpr const char* semantic = "POSITION";
+		static constexpr const char* name = "position";
+		static constexpr uint32_t components = 3;
+	};
+
+	struct Color
+	{
+		static constexpr const char* semantic = "COLOR";
+		static constexpr const char* name = "color";
+		static constexpr uint32_t components = 4;
+	};
+
+	struct Normal
+	{
+		static constexpr const char* semantic = "NORMAL";
+		static constexpr const char* name = "norm";
+		static constexpr uint32_t components = 3;
+	};
+
+	struct TexCoord
+	{
+		static constexpr const char* semantic = "TEXCOORD";
+		static constexpr const char* name = "uv";
+		static constexpr uint32_t components = 2;
+	};
+
+	template <class SemanticType, class ElementType>
+	struct Attribute
+	{
+		using Semantic = SemanticType;
+		using Element = ElementType;
+		static_assert(Element::components >= Semantic::components, "Element has fewer components than the semantic needs");
+	};
+
+	namespace Detail
+	{
+		template <size_t Count>
+		constexpr std::array<uint32_t, Count> GetOffsets(const std::array<uint32_t, Count>& sizes)
+		{
+			std::array<uint32_t, Count> offsets = {};
+			uint32_t offset = 0;
+			for (size_t i = 0; i < Count; i++) {
+				offsets[i] = offset;
+				offset += sizes[i];
+			}
+			return offsets;
+		}
+
+		template <size_t Count>
+		constexpr bool AreAligned(const std::array<uint32_t, Count>& offsets, uint32_t alignment)
+		{
+			for (size_t i = 0; i < Count; i++) {
+				if (offsets[i] % alignment != 0)
+					return false;
+			}
+			return true;
+		}
+
+		template <class... Types>
+		struct AreUnique : std::true_type {};
+
+		template <class First, class... Rest>
+		struct AreUnique<First, Rest...>
+			: std::integral_constant<bool, !(std::is_same<First, Rest>::value || ...) && AreUnique<Rest...>::value> {};
+	}
+
+	template <class... Attributes>
+	class Layout
+	{
+	public:
+		static constexpr uint32_t attribute_count = sizeof...(Attributes);
+		static_assert(attribute_count > 0, "Vertex layout without attributes");
+
+		static constexpr std::array<uint32_t, attribute_count> sizes = { Attributes::Element::size... };
+		static constexpr std::array<uint32_t, attribute_count> offsets = Detail::GetOffsets(sizes);
+		static constexpr uint32_t stride = offsets[attribute_count - 1] + sizes[attribute_count - 1];
+
+		// The input assembler wants 4 byte aligned elements and at most 2048 byte strides
+		static_assert(Detail::AreAligned(offsets, 4), "Vertex attributes must be 4 byte aligned");
+		static_assert(stride <= 2048, "Vertex stride over the input assembler limit");
+		static_assert(Detail::AreUnique<typename Attributes::Semantic...>::value, "Vertex layout repeats a semantic");
+
+		// Vertices are plain bytes in buffer layout, filled attribute by attribute
+		struct Vertex
+		{
+			template <class Semantic>
+			void Set(const float (&values)[Semantic::components])
+			{
+				constexpr size_t index = IndexOf<Semantic>();
+				static_assert(index < attribute_count, "Semantic is not part of the vertex layout");
+				using Element = typename std::tuple_element<index, std::tuple<typename Attributes::Element...>>::type;
+				Element::Encode(values, Semantic::components, bytes + offsets[index]);
+			}
+
+			uint8_t bytes[stride];
+		};
+		static_assert(sizeof(Vertex) == stride, "Vertex must be tightly packed");
+
+		template <class Semantic>
+		static constexpr size_t IndexOf()
+		{
+			constexpr bool matches[] = { std::is_same<Semantic, typename Attributes::Semantic>::value... };
+			for (size_t i = 0; i < attribute_count; i++) {
+				if (matches[i])
+					return i;
+			}
+			return attribute_count;
+		}
+
+		template <class Semantic>
+		static constexpr bool Has() { return IndexOf<Semantic>() < attribute_count; }
+
+		template <class Semantic>
+		static constexpr uint32_t OffsetOf()
+		{
+			static_assert(Has<Semantic>(), "Semantic is not part of the vertex layout");
+			return offsets[IndexOf<Semantic>()];
+		}
+
+		// True when the encoding of the semantic only holds normalized values
+		template <class Semantic>
+		static constexpr bool IsNormalized()
+		{
+			static_assert(Has<Semantic>(), "Semantic is not part of the vertex layout");
+			constexpr bool normalized[] = { Attributes::Element::normalized... };
+			return normalized[IndexOf<Semantic>()];
+		}
+
+		static constexpr std::array<RHI::InputElementDesc, attribute_count> GetInputElements(uint32_t input_slot = 0)
+		{
+			std::array<RHI::InputElementDesc, attribute_count> elements = {};
+			const char* semantics[] = { Attributes::Semantic::semantic... };
+			const RHI::Format formats[] = { Attributes::Element::format... };
+			for (size_t i = 0; i < attribute_count; i++)
+				elements[i] = { semantics[i], 0, formats[i], input_slot, offsets[i], RHI::InputClassification::PerVertex, 0 };
+			return elements;
+		}
+
+		// Vertex shader parameters, e.g. "float3 position : POSITION, float4 color : COLOR"
+		static std::string GetHlslInputSignature()
+		{
+			const char* names[] = { Attributes::Semantic::name... };
+			const char* semantics[] = { Attributes::Semantic::semantic... };
+			const uint32_t components[] = { Attributes::Semantic::components... };
+			std::string signature;
+			for (size_t i = 0; i < attribute_count; i++) {
+				signature += i ? ", " : "";
+				signature += "float" + std::to_string(components[i]) + " " + names[i] + " : " + semantics[i];
+			}
+			return signature;
+		}
+
+	};
+
+	inline void Float2::Encode(const float* values, uint32_t count, uint8_t* out)
+	{
+		float result[2] = {};
+		memcpy(result, values, sizeof(float) * (count < 2 ? count : 2));
+		memcpy(out, result, sizeof(result));
+	}
+
+	inline void Float3::Encode(const float* values, uint32_t count, uint8_t* out)
+	{
+		float result[3] = {};
+		memcpy(result, values, sizeof(float) * (count < 3 ? count : 3));
+		memcpy(out, result, sizeof(result));
+	}
+
+	inline void Float4::Encode(const float* values, uint32_t count, uint8_t* out)
+	{
+		float result[4] = {};
+		memcpy(result, values, sizeof(float) * (count < 4 ? count : 4));
+		memcpy(out, result, sizeof(result));
+	}
+
+	inline void Half2::Encode(const float* values, uint32_t count, uint8_t* out)
+	{
+		uint16_t result[2] = {};
+		for (uint32_t i = 0; i < 2 && i < count; i++)
+			result[i] = FloatToHalf(values[i]);
+		memcpy(out, result, sizeof(result));
+	}
+
+	inline void Half4::Encode(const float* values, uint32_t count, uint8_t* out)
+	{
+		uint16_t result[4] = {};
+		for (uint32_t i = 0; i < 4 && i < count; i++)
+			result[i] = FloatToHalf(values[i]);
+		memcpy(out, result, sizeof(result));
+	}
+
+	inline void Unorm4x8::Encode(const float* values, uint32_t count, uint8_t* out)
+	{
+		for (uint32_t i = 0; i < 4; i++) {
+			const float value = i < count ? std::fmin(std::fmax(values[i], 0.f), 1.f) : 0.f;
+			out[i] = static_cast<uint8_t>(std::lrint(value * 255.f));
+		}
+	}
+
+	inline void Snorm4x8::Encode(const float* values, uint32_t count, uint8_t* out)
+	{
+		for (uint32_t i = 0; i < 4; i++) {
+			const float value = i < count ? std::fmin(std::fmax(values[i], -1.f), 1.f) : 0.f;
+			out[i] = static_cast<uint8_t>(static_cast<int8_t>(std::lrint(value * 127.f)));
+		}
+	}
+}
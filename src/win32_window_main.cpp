@@ -16,4 +16,10 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine, INT nC
 		OutputDebugString(e.get_wstring());
 		return 1;
 	}
+	catch (const std::exception& e)
+	{
+		OutputDebugString(L"Exception:\n");
+		OutputDebugStringA(e.what());
+		return 1;
+	}
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "test.h"
+
+#include "constant_buffer_manager.h"
+#include "rhi_null.h"
+#include "stream_copy.h"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	struct Constants
+	{
+		float matrix[16];
+	};
+
+	bool CopyHolds(const ConstantBufferManager& manager, uint32_t block, uint32_t frame, const Constants& constants)
+	{
+		const uint8_t* storage = static_cast<RHI::NullResource*>(manager.GetResource())->GetStorage();
+		return memcmp(storage + manager.GetOffset(block, frame), &constants, sizeof(constants)) == 0;
+	}
+}
+
+TEST(StreamCopyKernelsMatchMemcpy)
+{
+	std::vector<uint8_t> source(4096 + 64);
+	for (size_t i = 0; i < source.size(); i++)
+		source[i] = static_cast<uint8_t>(i * 13 + 5);
+	alignas(32) uint8_t destination[4096 + 64];
+
+	// Every destination alignment the kernels accept, with sizes around the 64 byte loop
+	for (StreamKernel kernel : { StreamKernel::Memcpy, StreamKernel::Sse2, StreamKernel::Avx }) {
+		if (!IsStreamKernelSupported(kernel))
+			continue;
+		for (size_t offset : { 0, 16, 32, 48 }) {
+			for (size_t size : { 16, 48, 64, 80, 240, 4096 }) {
+				memset(destination, 0, sizeof(destination));
+				StreamCopy(kernel, destination + offset, source.data() + 3, size);
+				StreamFence();
+				CHECK(memcmp(destination + offset, source.data() + 3, size) == 0);
+				CHECK_EQUAL(0, destination[offset + size]);
+			}
+		}
+	}
+	CHECK_THROWS(StreamCopy(StreamKernel::Memcpy, destination + 8, source.data(), 16), std::invalid_argument);
+	CHECK_THROWS(StreamCopy(StreamKernel::Memcpy, destination, source.data(), 24), std::invalid_argument);
+}
+
+TEST(ConstantBufferManagerWritesOnlyChangedBlocks)
+{
+	RHI::NullDevice device;
+	ConstantBufferManager manager(device, 4096, 3);
+	const uint32_t camera = manager.Allocate(sizeof(Constants));
+	const uint32_t object = manager.Allocate(sizeof(Constants));
+	CHECK_EQUAL(256u, manager.GetOffset(object, 0));
+
+	Constants constants = {};
+	constants.matrix[0] = 1.f;
+	CHECK(manager.Update(camera, constants));
+
+	// A change reaches each frame copy once, as that frame comes around
+	for (uint32_t frame = 0; frame < 3; frame++) {
+		manager.BeginFrame(frame);
+		CHECK_EQUAL(256u, manager.Flush());
+		CHECK(CopyHolds(manager, camera, frame, constants));
+	}
+	CHECK_EQUAL(0u, manager.GetDirtyCount());
+
+	// Updating with the same contents writes nothing at all
+	for (uint32_t frame = 3; frame < 6; frame++) {
+		manager.BeginFrame(frame);
+		CHECK(!manager.Update(camera, constants));
+		CHECK_EQUAL(0u, manager.Flush());
+	}
+	CHECK_EQUAL(4u, manager.GetStats().updates);
+	CHECK_EQUAL(3u, manager.GetStats().unchanged_updates);
+	CHECK_EQUAL(768u, manager.GetStats().written_bytes);
+
+	// A later change leaves other frames' copies alone until they are current
+	constants.matrix[5] = 2.f;
+	manager.Update(camera, constants);
+	manager.BeginFrame(7);
+	manager.Flush();
+	CHECK(CopyHolds(manager, camera, 1, constants));
+	CHECK(!CopyHolds(manager, camera, 0, constants));
+	CHECK_EQUAL(manager.GetResource()->GetGpuAddress() + 4096 + 256, manager.GetGpuAddress(object));
+
+	CHECK_THROWS(manager.Update(object, &constants, sizeof(constants), 200), std::out_of_range);
+	CHECK_THROWS(manager.Allocate(4096), std::runtime_error);
+}
@@ -0,0 +1,91 @@
+#include "test.h"
+
+#include "copy_uploader.h"
+#include "rhi_null.h"
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	std::vector<uint8_t> MakeBytes(size_t size, uint8_t seed)
+	{
+		std::vector<uint8_t> bytes(size);
+		for (size_t i = 0; i < size; i++)
+			bytes[i] = static_cast<uint8_t>(i * 31 + seed);
+		return bytes;
+	}
+
+	bool Contains(RHI::Resource* resource, uint64_t offset, const std::vector<uint8_t>& bytes)
+	{
+		const uint8_t* storage = static_cast<RHI::NullResource*>(resource)->GetStorage();
+		return memcmp(storage + offset, bytes.data(), bytes.size()) == 0;
+	}
+}
+
+TEST(CopyUploaderCopiesThroughStaging)
+{
+	RHI::NullDevice device;
+	CopyUploader uploader(device, 4096);
+	const std::vector<uint8_t> vertices = MakeBytes(1000, 1);
+	std::unique_ptr<RHI::Resource> buffer = uploader.CreateBuffer(vertices.data(), vertices.size());
+	CHECK(static_cast<RHI::NullResource*>(buffer.get())->GetHeapType() == RHI::HeapType::Default);
+
+	// Nothing reaches the queue before Submit
+	CHECK_EQUAL(0u, static_cast<RHI::NullCommandQueue*>(uploader.GetQueue())->GetStats().executed_lists);
+	CHECK_EQUAL(1u, uploader.Submit());
+	CHECK(Contains(buffer.get(), 0, vertices));
+	CHECK_EQUAL(1000u, uploader.GetUploadedBytes());
+	// Submitting without new copies doesn't signal again
+	CHECK_EQUAL(1u, uploader.Submit());
+	uploader.Retire();
+	CHECK_EQUAL(0u, uploader.GetStaging().GetUsedSize());
+}
+
+TEST(CopyUploaderSplitsUploadsLargerThanStaging)
+{
+	RHI::NullDevice device;
+	CopyUploader uploader(device, 1024);
+	auto buffer = device.CreateBuffer(RHI::HeapType::Default, 10000, RHI::ResourceState::Common);
+	const std::vector<uint8_t> bytes = MakeBytes(5000, 7);
+	uploader.Upload(buffer.get(), 4000, bytes.data(), bytes.size());
+	uploader.WaitForIdle();
+
+	CHECK(Contains(buffer.get(), 4000, bytes));
+	const RHI::NullQueueStats& stats = static_cast<RHI::NullCommandQueue*>(uploader.GetQueue())->GetStats();
+	CHECK_EQUAL(5000u, stats.copied_bytes);
+	// A full ring flushes the pending copies and waits, five chunks take five submissions
+	CHECK_EQUAL(5u, uploader.GetSubmittedFenceValue());
+	CHECK_EQUAL(0u, uploader.GetStaging().GetUsedSize());
+}
+
+TEST(CopyUploaderRetiresStagingByFence)
+{
+	RHI::NullDevice device;
+	CopyUploader uploader(device, 4096);
+	static_cast<RHI::NullCommandQueue*>(uploader.GetQueue())->SetSimulatedGpuTime(std::chrono::milliseconds(20));
+	auto buffer = device.CreateBuffer(RHI::HeapType::Default, 1024, RHI::ResourceState::Common);
+	const std::vector<uint8_t> bytes = MakeBytes(1024, 3);
+	uploader.Upload(buffer.get(), 0, bytes.data(), bytes.size());
+	const uint64_t fence_value = uploader.Submit();
+
+	// Staging memory stays owned by the copy until the copy queue's fence passes it
+	uploader.Retire();
+	CHECK(uploader.GetFence()->GetCompletedValue() < fence_value);
+	CHECK_EQUAL(1024u, uploader.GetStaging().GetUsedSize());
+
+	// A direct queue that waits on the copy completes its own work after it, without the CPU blocking
+	auto direct = device.CreateCommandQueue(RHI::CommandListType::Direct);
+	auto direct_fence = device.CreateFence(0);
+	uploader.QueueWait(*direct);
+	direct->Signal(direct_fence.get(), 1);
+	CHECK_EQUAL(0u, direct_fence->GetCompletedValue());
+	auto* copy_fence = static_cast<RHI::NullFence*>(uploader.GetFence());
+	CHECK(static_cast<RHI::NullFence*>(direct_fence.get())->GetCompletionTime(1) >= copy_fence->GetCompletionTime(fence_value));
+
+	uploader.WaitForIdle();
+	CHECK_EQUAL(fence_value, uploader.GetFence()->GetCompletedValue());
+	CHECK_EQUAL(0u, uploader.GetStaging().GetUsedSize());
+	direct_fence->Wait(1);
+}
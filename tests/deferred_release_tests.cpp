@@ -0,0 +1,62 @@
+#include "test.h"
+
+#include "deferred_release.h"
+#include "rhi_null.h"
+
+#include <vector>
+
+TEST(DeferredReleaseCollectsOnlyRetiredEntriesInOrder)
+{
+	DeferredReleaseQueue queue;
+	std::vector<int> released;
+	queue.Defer([&] { released.push_back(1); }, 1);
+	queue.Defer([&] { released.push_back(2); }, 2);
+	queue.Defer([&] { released.push_back(3); }, 2);
+	queue.Defer([&] { released.push_back(4); }, 4);
+
+	// A fake completed fence value stands in for the GPU's progress
+	CHECK_EQUAL(0u, queue.Collect(0));
+	CHECK(released.empty());
+	CHECK_EQUAL(1u, queue.Collect(1));
+	CHECK_EQUAL(2u, queue.Collect(3));
+	CHECK_EQUAL(3u, released.size());
+	CHECK_EQUAL(1, released[0]);
+	CHECK_EQUAL(2, released[1]);
+	CHECK_EQUAL(3, released[2]);
+	CHECK_EQUAL(1u, queue.GetPendingCount());
+	// Collecting again with the same value is a no-op
+	CHECK_EQUAL(0u, queue.Collect(3));
+
+	CHECK_EQUAL(1u, queue.Collect(10));
+	CHECK_EQUAL(4, released.back());
+	CHECK_EQUAL(4u, queue.GetReleasedCount());
+}
+
+TEST(DeferredReleaseKeepsObjectsAliveUntilTheirFence)
+{
+	RHI::NullDevice device;
+	auto command_queue = device.CreateCommandQueue(RHI::CommandListType::Direct);
+	auto fence = device.CreateFence(0);
+	bool destroyed = false;
+	{
+		DeferredReleaseQueue queue;
+		queue.Release(device.CreateBuffer(RHI::HeapType::Default, 256, RHI::ResourceState::Common), 1);
+		queue.Defer([&] { destroyed = true; }, 2);
+		queue.Release(std::unique_ptr<RHI::Resource>(), 2);
+		CHECK_EQUAL(2u, queue.GetPendingCount());
+
+		command_queue->Signal(fence.get(), 1);
+		CHECK_EQUAL(1u, queue.Collect(fence->GetCompletedValue()));
+		CHECK(!destroyed);
+
+		// A release that defers more work doesn't disturb the collect in progress
+		queue.Defer([&] { queue.Defer([&] { destroyed = true; }, 3); }, 2);
+		command_queue->Signal(fence.get(), 2);
+		CHECK_EQUAL(2u, queue.Collect(fence->GetCompletedValue()));
+		CHECK(destroyed);
+		destroyed = false;
+		CHECK_EQUAL(1u, queue.GetPendingCount());
+	}
+	// Destroying the queue flushes what is left
+	CHECK(destroyed);
+}
@@ -0,0 +1,69 @@
+#include "test.h"
+
+#include "descriptor_allocator.h"
+#include "rhi_null.h"
+
+#include <algorithm>
+#include <vector>
+
+TEST(DescriptorAllocatorReusesFreedPersistentSlots)
+{
+	RHI::NullDevice device;
+	DescriptorAllocator descriptors(device, RHI::DescriptorHeapType::CbvSrvUav, true, 4);
+	CHECK_EQUAL(4u, descriptors.GetHeap()->GetCapacity());
+	CHECK_EQUAL(0u, descriptors.AllocatePersistent());
+	CHECK_EQUAL(1u, descriptors.AllocatePersistent());
+	CHECK_EQUAL(2u, descriptors.AllocatePersistent());
+
+	// The most recently freed slot comes back first, before untouched ones
+	descriptors.FreePersistent(1);
+	descriptors.FreePersistent(0);
+	CHECK_EQUAL(1u, descriptors.GetPersistentUsed());
+	CHECK_EQUAL(0u, descriptors.AllocatePersistent());
+	CHECK_EQUAL(1u, descriptors.AllocatePersistent());
+	CHECK_EQUAL(3u, descriptors.AllocatePersistent());
+	CHECK_THROWS(descriptors.AllocatePersistent(), std::runtime_error);
+
+	CHECK_THROWS(descriptors.FreePersistent(4), std::logic_error);
+	descriptors.FreePersistent(3);
+	CHECK_THROWS(descriptors.FreePersistent(3), std::logic_error);
+	CHECK_EQUAL(3u, descriptors.GetPersistentUsed());
+
+	// Handles are offsets from the heap start, shaders index the heap with the same numbers
+	const RHI::DescriptorHeap* heap = descriptors.GetHeap();
+	CHECK_EQUAL(heap->GetGpuStart().ptr + 2 * heap->GetIncrementSize(), descriptors.GetGpuHandle(2).ptr);
+	CHECK_EQUAL(heap->GetCpuStart().ptr + 2 * heap->GetIncrementSize(), descriptors.GetCpuHandle(2).ptr);
+}
+
+TEST(DescriptorAllocatorResetsTransientRegionPerFrame)
+{
+	RHI::NullDevice device;
+	DescriptorAllocator descriptors(device, RHI::DescriptorHeapType::CbvSrvUav, true, 8, 16, 3);
+	CHECK_EQUAL(8u + 16u * 3u, descriptors.GetHeap()->GetCapacity());
+
+	// Each frame slot owns its own range behind the persistent region
+	for (uint32_t frame = 0; frame < 6; frame++) {
+		descriptors.BeginFrame(frame);
+		CHECK_EQUAL(0u, descriptors.GetTransientUsed());
+		const uint32_t first = descriptors.AllocateTransient(10);
+		CHECK_EQUAL(8u + (frame % 3) * 16u, first);
+		CHECK_EQUAL(first + 10, descriptors.AllocateTransient(6));
+		CHECK_THROWS(descriptors.AllocateTransient(1), std::runtime_error);
+	}
+
+	// Persistent allocations never land in a transient range
+	std::vector<uint32_t> persistent;
+	for (uint32_t i = 0; i < 8; i++)
+		persistent.push_back(descriptors.AllocatePersistent());
+	CHECK(*std::max_element(persistent.begin(), persistent.end()) < 8u);
+}
+
+TEST(DescriptorAllocatorRejectsEmptyHeaps)
+{
+	RHI::NullDevice device;
+	CHECK_THROWS(DescriptorAllocator(device, RHI::DescriptorHeapType::Rtv, false, 0), std::invalid_argument);
+	// Without frames in flight there is no transient region
+	DescriptorAllocator descriptors(device, RHI::DescriptorHeapType::Rtv, false, 2, 16, 0);
+	CHECK_EQUAL(0u, descriptors.GetTransientCapacity());
+	CHECK_THROWS(descriptors.AllocateTransient(), std::runtime_error);
+}
@@ -0,0 +1,59 @@
+#include "test.h"
+
+#include "draw_sorter.h"
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+TEST(DrawKeyPacksFields)
+{
+	const uint64_t key = DrawKey::Make(3, 0x1234, 0xabcde, 0x654321);
+	CHECK_EQUAL(3u, DrawKey::GetPass(key));
+	CHECK_EQUAL(0x1234u, DrawKey::GetPipeline(key));
+	CHECK_EQUAL(0xabcdeu, DrawKey::GetMaterial(key));
+	CHECK_EQUAL(0x654321u, DrawKey::GetDepth(key));
+	// Fields wider than their bits are masked instead of spilling into the next
+	CHECK_EQUAL(0u, DrawKey::GetPipeline(DrawKey::Make(0, 0, 1u << 20, 0)));
+	CHECK(DrawKey::Make(1, 0, 0, 0) > DrawKey::Make(0, 0xffff, 0xfffff, 0xffffff));
+
+	CHECK_EQUAL(0u, DrawKey::QuantizeDepth(-1.f, 100.f));
+	CHECK_EQUAL((1u << DrawKey::depth_bits) - 1, DrawKey::QuantizeDepth(1000.f, 100.f));
+	CHECK(DrawKey::QuantizeDepth(10.f, 100.f) < DrawKey::QuantizeDepth(20.f, 100.f));
+}
+
+TEST(DrawSorterMatchesStableSort)
+{
+	ThreadPool pool(4);
+	DrawSorter inline_sorter(pool, 1);
+	DrawSorter pool_sorter(pool);
+	std::mt19937_64 random(5);
+
+	std::vector<DrawPacket> packets;
+	inline_sorter.Sort(packets);
+	CHECK_EQUAL(0u, inline_sorter.GetStats().packets);
+
+	// Few distinct keys check stability, the larger lists split into blocks on the pool
+	for (size_t count : { 1u, 3u, 1000u, 100000u, 300000u }) {
+		packets.resize(count);
+		for (size_t i = 0; i < count; i++)
+			packets[i] = { DrawKey::Make(static_cast<uint32_t>(random() % 2), static_cast<uint32_t>(random() % 4), static_cast<uint32_t>(random() % 16), 0), static_cast<uint32_t>(i) };
+		std::vector<DrawPacket> reference = packets;
+		std::stable_sort(reference.begin(), reference.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+
+		for (DrawSorter* sorter : { &inline_sorter, &pool_sorter }) {
+			std::vector<DrawPacket> sorted = packets;
+			sorter->Sort(sorted);
+			bool same = sorted.size() == count;
+			for (size_t i = 0; same && i < count; i++)
+				same = sorted[i].key == reference[i].key && sorted[i].draw == reference[i].draw;
+			CHECK(same);
+		}
+		// Depth is always zero, only the pass, pipeline and material bytes move packets
+		if (count >= 1000)
+			CHECK_EQUAL(3u, pool_sorter.GetStats().digit_passes);
+	}
+	CHECK_EQUAL(1u, inline_sorter.GetStats().blocks);
+	CHECK_EQUAL(4u, pool_sorter.GetStats().blocks);
+}
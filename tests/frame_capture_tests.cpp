@@ -0,0 +1,263 @@
+#include "test.h"
+
+#include "frame_capture.h"
+#include "frame_replay.h"
+#include "rhi_null.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	using RHI::CommandId;
+
+	// A file in the temp directory, removed when the test ends
+	struct TempFile
+	{
+		std::string path;
+		explicit TempFile(const char* name) : path((std::filesystem::temp_directory_path() / name).string()) { std::remove(path.c_str()); }
+		~TempFile() { std::remove(path.c_str()); }
+	};
+
+	// Keeps the direct lists and bundles it creates, so the streams a replay records can be read back
+	class ListKeepingDevice : public RHI::NullDevice
+	{
+	public:
+		std::vector<RHI::RecordingCommandList*> direct_lists;
+		std::vector<RHI::RecordingCommandList*> bundles;
+
+		std::unique_ptr<RHI::CommandList> CreateCommandList(RHI::CommandListType type, RHI::CommandAllocator* allocator,
+			RHI::PipelineState* initial_state) override
+		{
+			std::unique_ptr<RHI::CommandList> list = NullDevice::CreateCommandList(type, allocator, initial_state);
+			if (type == RHI::CommandListType::Direct)
+				direct_lists.push_back(static_cast<RHI::RecordingCommandList*>(list.get()));
+			else if (type == RHI::CommandListType::Bundle)
+				bundles.push_back(static_cast<RHI::RecordingCommandList*>(list.get()));
+			return list;
+		}
+	};
+
+	// Flattens streams into words with every object id replaced by the order it first shows up in.
+	// Streams recorded against different objects compare equal when they use them the same way.
+	// On the null backend handles and addresses carry the object id in their upper 32 bits.
+	class StreamNormalizer
+	{
+	public:
+		std::vector<uint64_t> Normalize(const RHI::CommandStream& stream)
+		{
+			std::vector<uint64_t> words;
+			stream.ForEach([&](const RHI::CommandHeader& header, const uint8_t* payload) {
+				words.push_back(static_cast<uint64_t>(header.id));
+				words.push_back(header.size);
+				switch (header.id)
+				{
+				case CommandId::SetPipelineState:
+				case CommandId::SetGraphicsRootSignature:
+				case CommandId::ExecuteBundle:
+					words.push_back(Id(Read<uint32_t>(payload)));
+					break;
+				case CommandId::SetDescriptorHeaps:
+				{
+					const auto& command = Read<RHI::Commands::SetDescriptorHeaps>(payload);
+					for (uint32_t i = 0; i < command.count; i++)
+						words.push_back(Id(Read<uint32_t>(payload + sizeof(command) + i * sizeof(uint32_t))));
+					break;
+				}
+				case CommandId::SetGraphicsRootDescriptorTable:
+				case CommandId::SetGraphicsRootConstantBufferView:
+					words.push_back(Read<uint32_t>(payload));
+					words.push_back(Handle(Read<uint64_t>(payload + 8)));
+					break;
+				case CommandId::ResourceBarrier:
+				{
+					const auto& command = Read<RHI::Commands::ResourceBarrier>(payload);
+					for (uint32_t i = 0; i < command.count; i++) {
+						const auto& barrier = Read<RHI::Commands::Barrier>(payload + sizeof(command) + i * sizeof(RHI::Commands::Barrier));
+						words.insert(words.end(), { Id(barrier.resource), static_cast<uint64_t>(barrier.before),
+							static_cast<uint64_t>(barrier.after), static_cast<uint64_t>(barrier.type) });
+					}
+					break;
+				}
+				case CommandId::OMSetRenderTargets:
+				{
+					const auto& command = Read<RHI::Commands::OMSetRenderTargets>(payload);
+					words.insert(words.end(), { command.count, command.has_dsv, Handle(command.dsv) });
+					for (uint32_t i = 0; i < command.count; i++)
+						words.push_back(Handle(Read<uint64_t>(payload + sizeof(command) + i * sizeof(uint64_t))));
+					break;
+				}
+				case CommandId::ClearRenderTargetView:
+				case CommandId::ClearDepthStencilView:
+					words.push_back(Handle(Read<uint64_t>(payload)));
+					AddWords(payload + 8, header.size - 8, words);
+					break;
+				case CommandId::IASetVertexBuffers:
+				{
+					const auto& command = Read<RHI::Commands::IASetVertexBuffers>(payload);
+					words.insert(words.end(), { command.start_slot, command.count });
+					for (uint32_t i = 0; i < command.count; i++) {
+						const auto& view = Read<RHI::VertexBufferView>(payload + sizeof(command) + i * sizeof(RHI::VertexBufferView));
+						words.insert(words.end(), { Handle(view.buffer_location), view.size_in_bytes, view.stride_in_bytes });
+					}
+					break;
+				}
+				case CommandId::CopyBufferRegion:
+				case CommandId::CopyTextureToBuffer:
+					words.push_back(Id(Read<uint32_t>(payload)));
+					words.push_back(Id(Read<uint32_t>(payload + 4)));
+					AddWords(payload + 8, header.size - 8, words);
+					break;
+				default:
+					AddWords(payload, header.size, words);
+					break;
+				}
+			});
+			return words;
+		}
+
+	private:
+		std::unordered_map<uint32_t, uint64_t> ids;
+
+		template <class T>
+		static T Read(const uint8_t* bytes)
+		{
+			T value;
+			memcpy(&value, bytes, sizeof(T));
+			return value;
+		}
+
+		// Payloads are padded to 8 bytes
+		static void AddWords(const uint8_t* bytes, size_t size, std::vector<uint64_t>& words)
+		{
+			for (size_t offset = 0; offset < size; offset += sizeof(uint64_t))
+				words.push_back(Read<uint64_t>(bytes + offset));
+		}
+
+		uint64_t Id(uint32_t id)
+		{
+			return id ? ids.emplace(id, ids.size() + 1).first->second : 0;
+		}
+
+		uint64_t Handle(uint64_t handle)
+		{
+			return handle ? Id(static_cast<uint32_t>(handle >> 32)) << 32 | (handle & 0xffffffffull) : 0;
+		}
+	};
+}
+
+TEST(FrameCaptureReplaysBundlesAndDepthClears)
+{
+	RHI::NullDevice device;
+	auto root_signature = device.CreateRootSignature();
+	auto pipeline = device.CreatePipelineState();
+	auto rtv_heap = device.CreateDescriptorHeap(RHI::DescriptorHeapType::Rtv, 2, false);
+	auto dsv_heap = device.CreateDescriptorHeap(RHI::DescriptorHeapType::Dsv, 2, false);
+	auto render_target = device.CreateTexture2D(64, 64, RHI::Format::R8G8B8A8Unorm, RHI::ResourceState::Present);
+	auto depth = device.CreateTexture2D(64, 64, RHI::Format::D32Float, RHI::ResourceState::DepthWrite);
+	std::vector<float> vertices(3 * 8);
+	for (size_t i = 0; i < vertices.size(); i++)
+		vertices[i] = static_cast<float>(i);
+	const uint32_t vertices_size = static_cast<uint32_t>(vertices.size() * sizeof(float));
+	auto vertex_buffer = device.CreateBuffer(RHI::HeapType::Default, vertices_size, RHI::ResourceState::Common);
+
+	FrameCapture capture;
+	capture.AddRootSignature(root_signature.get());
+	capture.AddPipelineState(pipeline.get());
+	capture.AddDescriptorHeap(rtv_heap.get());
+	capture.AddDescriptorHeap(dsv_heap.get());
+	capture.AddResource(render_target.get(), RHI::HeapType::Default);
+	capture.AddRenderTargetView(rtv_heap.get(), 1, render_target.get());
+	capture.AddResource(depth.get(), RHI::HeapType::Default);
+	capture.AddDepthStencilView(dsv_heap.get(), 0, depth.get(), false);
+	capture.AddDepthStencilView(dsv_heap.get(), 1, depth.get(), true);
+	capture.AddResource(vertex_buffer.get(), RHI::HeapType::Default);
+	capture.AddResourceData(vertex_buffer.get(), 0, vertices.data(), vertices_size);
+
+	// The static draws live in a bundle, as the renderer records them
+	auto bundle_allocator = device.CreateCommandAllocator(RHI::CommandListType::Bundle);
+	auto bundle = device.CreateCommandList(RHI::CommandListType::Bundle, bundle_allocator.get(), nullptr);
+	CaptureCommandList capture_bundle(bundle.get());
+	const RHI::VertexBufferView vertex_view = { vertex_buffer->GetGpuAddress(), vertices_size, 32 };
+	capture_bundle.SetPipelineState(pipeline.get());
+	capture_bundle.IASetPrimitiveTopology(RHI::PrimitiveTopology::TriangleList);
+	capture_bundle.IASetVertexBuffers(0, 1, &vertex_view);
+	capture_bundle.DrawInstanced(3, 1, 0, 0);
+	capture_bundle.DrawInstanced(3, 2, 3, 1);
+	capture_bundle.Close();
+	capture.AddBundle(bundle.get(), capture_bundle.GetStream());
+
+	auto allocator = device.CreateCommandAllocator(RHI::CommandListType::Direct);
+	auto list = device.CreateCommandList(RHI::CommandListType::Direct, allocator.get(), nullptr);
+	CaptureCommandList capture_list(list.get());
+	const RHI::Viewport view_port = { 0.f, 0.f, 64.f, 64.f, 0.f, 1.f };
+	const RHI::Rect scissor_rect = { 0, 0, 64, 64 };
+	const RHI::CpuDescriptorHandle rtv = rtv_heap->GetCpuHandle(1);
+	const RHI::CpuDescriptorHandle dsv = dsv_heap->GetCpuHandle(0);
+	const RHI::CpuDescriptorHandle read_only_dsv = dsv_heap->GetCpuHandle(1);
+	const float clear_color[4] = { .1f, .2f, .3f, 1.f };
+	const RHI::ResourceBarrier to_target = { render_target.get(), RHI::ResourceState::Present, RHI::ResourceState::RenderTarget };
+	const RHI::ResourceBarrier to_present = { render_target.get(), RHI::ResourceState::RenderTarget, RHI::ResourceState::Present };
+	capture_list.SetGraphicsRootSignature(root_signature.get());
+	capture_list.RSSetViewports(1, &view_port);
+	capture_list.RSSetScissorRects(1, &scissor_rect);
+	capture_list.ResourceBarrier(1, &to_target);
+	capture_list.OMSetRenderTargets(1, &rtv, &dsv);
+	capture_list.ClearRenderTargetView(rtv, clear_color);
+	capture_list.ClearDepthStencilView(dsv, 1.f);
+	capture_list.ExecuteBundle(bundle.get());
+	// A colour pass against the read-only view of the depth the bundle laid down
+	capture_list.OMSetRenderTargets(1, &rtv, &read_only_dsv);
+	capture_list.ExecuteBundle(bundle.get());
+	capture_list.ResourceBarrier(1, &to_present);
+	capture_list.Close();
+	capture.AddCommandList(RHI::CommandListType::Direct, capture_list.GetStream());
+	capture.EndFrame();
+
+	TempFile file("frame_capture_tests.bin");
+	capture.Save(file.path);
+	auto queue = device.CreateCommandQueue(RHI::CommandListType::Direct);
+	RHI::CommandList* lists[] = { list.get() };
+	queue->ExecuteCommandLists(1, lists);
+
+	ListKeepingDevice target;
+	FrameReplay replay(file.path);
+	CHECK_EQUAL(1u, replay.GetFrameCount());
+	replay.Prepare(target,
+		[&](uint32_t) { return target.CreateRootSignature(); },
+		[&](uint32_t) { return target.CreatePipelineState(); });
+	const std::vector<ReplayFrameTiming> timings = replay.Run();
+	CHECK_EQUAL(1u, timings.size());
+	CHECK_EQUAL(capture_bundle.GetStream().GetCommandCount() + capture_list.GetStream().GetCommandCount(), timings[0].commands);
+
+	// The replay records the same commands against its own objects, bundle first
+	CHECK_EQUAL(1u, target.direct_lists.size());
+	CHECK_EQUAL(1u, target.bundles.size());
+	StreamNormalizer captured;
+	StreamNormalizer replayed;
+	CHECK(captured.Normalize(capture_bundle.GetStream()) == replayed.Normalize(target.bundles[0]->GetStream()));
+	CHECK(captured.Normalize(capture_list.GetStream()) == replayed.Normalize(target.direct_lists[0]->GetStream()));
+	CHECK_EQUAL(1u, target.direct_lists[0]->GetStream().GetCommandCount(CommandId::ClearDepthStencilView));
+
+	const RHI::NullQueueStats& original = static_cast<RHI::NullCommandQueue*>(queue.get())->GetStats();
+	const RHI::NullQueueStats& replayed_stats = static_cast<RHI::NullCommandQueue*>(replay.GetQueue())->GetStats();
+	CHECK_EQUAL(original.executed_lists, replayed_stats.executed_lists);
+	CHECK_EQUAL(2u, replayed_stats.executed_bundles);
+	CHECK_EQUAL(original.executed_bundles, replayed_stats.executed_bundles);
+	CHECK_EQUAL(original.executed_commands, replayed_stats.executed_commands);
+	CHECK_EQUAL(4u, replayed_stats.draw_calls);
+
+	// The vertex data reached the replayed buffer the bundle reads from
+	RHI::NullResource* replayed_buffer = nullptr;
+	target.bundles[0]->GetStream().ForEach([&](const RHI::CommandHeader& header, const uint8_t* payload) {
+		if (header.id == CommandId::IASetVertexBuffers) {
+			const auto* view = reinterpret_cast<const RHI::VertexBufferView*>(payload + sizeof(RHI::Commands::IASetVertexBuffers));
+			replayed_buffer = target.LookupResource(static_cast<uint32_t>(view->buffer_location >> 32));
+		}
+	});
+	CHECK(replayed_buffer != nullptr && replayed_buffer != vertex_buffer.get());
+	CHECK(replayed_buffer && memcmp(replayed_buffer->GetStorage(), vertices.data(), vertices_size) == 0);
+}
@@ -0,0 +1,111 @@
+#include "test.h"
+
+#include "frame_recorder.h"
+#include "rhi_null.h"
+
+#include <vector>
+
+namespace
+{
+	const RHI::NullQueueStats& GetStats(RHI::CommandQueue& queue)
+	{
+		return static_cast<RHI::NullCommandQueue&>(queue).GetStats();
+	}
+}
+
+TEST(RecordFrameWithBundleExecutesLikeRecordFrame)
+{
+	RHI::NullDevice device;
+	auto root_signature = device.CreateRootSignature();
+	auto pipeline = device.CreatePipelineState();
+	RHI::PipelineState* pipelines[1] = { pipeline.get() };
+	FrameContext frame = {};
+	frame.root_signature = root_signature.get();
+	frame.rtv = { 1 };
+	frame.dsv = { 2 };
+	frame.clear_depth = true;
+	frame.view_port = { 0.f, 0.f, 1280.f, 720.f, 0.f, 1.f };
+	frame.scissor_rect = { 0, 0, 1280, 720 };
+	frame.pipeline_states = pipelines;
+	std::vector<DrawItem> draws;
+	for (uint32_t i = 0; i < 1000; i++)
+		draws.push_back({ i * 3, 3, (1ull << 32) + i * 256, 0, 0 });
+
+	auto allocator = device.CreateCommandAllocator(RHI::CommandListType::Direct);
+	auto direct = device.CreateCommandList(RHI::CommandListType::Direct, allocator.get(), nullptr);
+	RecordFrame(*direct, frame, draws);
+	direct->Close();
+
+	auto bundle_allocator = device.CreateCommandAllocator(RHI::CommandListType::Bundle);
+	auto bundle = device.CreateCommandList(RHI::CommandListType::Bundle, bundle_allocator.get(), nullptr);
+	RecordDraws(*bundle, frame, draws.data(), draws.size());
+	bundle->Close();
+	auto bundled = device.CreateCommandList(RHI::CommandListType::Direct, allocator.get(), nullptr);
+	RecordFrameWithBundle(*bundled, frame, bundle.get());
+	bundled->Close();
+
+	auto direct_queue = device.CreateCommandQueue(RHI::CommandListType::Direct);
+	auto bundled_queue = device.CreateCommandQueue(RHI::CommandListType::Direct);
+	RHI::CommandList* direct_lists[] = { direct.get() };
+	RHI::CommandList* bundled_lists[] = { bundled.get() };
+	direct_queue->ExecuteCommandLists(1, direct_lists);
+	bundled_queue->ExecuteCommandLists(1, bundled_lists);
+
+	// The bundle runs the same commands in place, the ExecuteBundle itself is the only extra one
+	CHECK_EQUAL(1000u, GetStats(*direct_queue).draw_calls);
+	CHECK_EQUAL(GetStats(*direct_queue).draw_calls, GetStats(*bundled_queue).draw_calls);
+	CHECK_EQUAL(1u, GetStats(*bundled_queue).executed_bundles);
+	CHECK_EQUAL(GetStats(*direct_queue).executed_commands + 1, GetStats(*bundled_queue).executed_commands);
+	// The direct list only holds the pass state around the bundle
+	const RHI::CommandStream& stream = static_cast<RHI::RecordingCommandList*>(bundled.get())->GetStream();
+	CHECK_EQUAL(0u, stream.GetCommandCount(RHI::CommandId::DrawInstanced));
+	CHECK_EQUAL(1u, stream.GetCommandCount(RHI::CommandId::ClearDepthStencilView));
+
+	// A bundle recorded once is executed again by later frames
+	bundled_queue->ExecuteCommandLists(1, bundled_lists);
+	CHECK_EQUAL(2000u, GetStats(*bundled_queue).draw_calls);
+	CHECK_EQUAL(2u, GetStats(*bundled_queue).executed_bundles);
+}
+
+TEST(NullBundleRejectsCommandsBundlesCantRecord)
+{
+	RHI::NullDevice device;
+	auto allocator = device.CreateCommandAllocator(RHI::CommandListType::Bundle);
+	auto bundle = device.CreateCommandList(RHI::CommandListType::Bundle, allocator.get(), nullptr);
+	auto other = device.CreateCommandList(RHI::CommandListType::Bundle, allocator.get(), nullptr);
+	auto buffer = device.CreateBuffer(RHI::HeapType::Default, 256, RHI::ResourceState::Common);
+	auto texture = device.CreateTexture2D(4, 4, RHI::Format::R8G8B8A8Unorm, RHI::ResourceState::Common);
+	const RHI::Viewport view_port = { 0.f, 0.f, 4.f, 4.f, 0.f, 1.f };
+	const RHI::Rect scissor_rect = { 0, 0, 4, 4 };
+	const RHI::ResourceBarrier barrier = { buffer.get(), RHI::ResourceState::Common, RHI::ResourceState::CopyDest };
+	const RHI::CpuDescriptorHandle rtv = { 1 };
+	const float color[4] = {};
+
+	CHECK_THROWS(bundle->RSSetViewports(1, &view_port), std::logic_error);
+	CHECK_THROWS(bundle->RSSetScissorRects(1, &scissor_rect), std::logic_error);
+	CHECK_THROWS(bundle->ResourceBarrier(1, &barrier), std::logic_error);
+	CHECK_THROWS(bundle->OMSetRenderTargets(1, &rtv, nullptr), std::logic_error);
+	CHECK_THROWS(bundle->ClearRenderTargetView(rtv, color), std::logic_error);
+	CHECK_THROWS(bundle->ClearDepthStencilView(rtv, 1.f), std::logic_error);
+	CHECK_THROWS(bundle->CopyBufferRegion(buffer.get(), 0, buffer.get(), 128, 64), std::logic_error);
+	CHECK_THROWS(bundle->CopyTextureToBuffer(buffer.get(), 0, 16, texture.get()), std::logic_error);
+	CHECK_THROWS(bundle->ExecuteBundle(other.get()), std::logic_error);
+	// The pass state RecordFrame sets is not allowed either, only RecordDraws is
+	FrameContext frame = {};
+	frame.view_port = view_port;
+	frame.scissor_rect = scissor_rect;
+	CHECK_THROWS(RecordFrame(*bundle, frame, {}), std::logic_error);
+
+	// A bundle still recording can't be executed
+	bundle->DrawInstanced(3, 1, 0, 0);
+	auto direct_allocator = device.CreateCommandAllocator(RHI::CommandListType::Direct);
+	auto list = device.CreateCommandList(RHI::CommandListType::Direct, direct_allocator.get(), nullptr);
+	list->ExecuteBundle(bundle.get());
+	list->Close();
+	auto queue = device.CreateCommandQueue(RHI::CommandListType::Direct);
+	RHI::CommandList* lists[] = { list.get() };
+	CHECK_THROWS(queue->ExecuteCommandLists(1, lists), std::logic_error);
+	bundle->Close();
+	queue->ExecuteCommandLists(1, lists);
+	CHECK_EQUAL(1u, GetStats(*queue).draw_calls);
+}
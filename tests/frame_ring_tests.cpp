@@ -0,0 +1,85 @@
+#include "test.h"
+
+#include "frame_ring.h"
+#include "rhi_null.h"
+
+#include <chrono>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct RingRun
+	{
+		double ms_per_frame;
+		uint64_t stalls;
+	};
+
+	// Records frame_count frames that each keep the CPU busy for cpu_time and the simulated GPU for gpu_time
+	RingRun RunFrames(uint32_t frames_in_flight, std::chrono::microseconds cpu_time, std::chrono::microseconds gpu_time, uint32_t frame_count)
+	{
+		RHI::NullDevice device;
+		auto queue = device.CreateCommandQueue(RHI::CommandListType::Direct);
+		static_cast<RHI::NullCommandQueue*>(queue.get())->SetSimulatedGpuTime(gpu_time);
+		auto allocator = device.CreateCommandAllocator(RHI::CommandListType::Direct);
+		auto list = device.CreateCommandList(RHI::CommandListType::Direct, allocator.get(), nullptr);
+		list->Close();
+		FrameRing ring(device, frames_in_flight);
+
+		const auto start = Clock::now();
+		for (uint32_t frame = 0; frame < frame_count; frame++) {
+			// Spinning instead of sleeping, sleeps are too coarse on some platforms
+			const auto cpu_end = Clock::now() + cpu_time;
+			while (Clock::now() < cpu_end) {
+			}
+			RHI::CommandList* lists[] = { list.get() };
+			queue->ExecuteCommandLists(1, lists);
+			ring.MoveToNextFrame(*queue);
+		}
+		ring.WaitForIdle(*queue);
+		const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		return { ms / frame_count, ring.GetStallCount() };
+	}
+}
+
+TEST(FrameRingCyclesSlotsAndFenceValues)
+{
+	RHI::NullDevice device;
+	auto queue = device.CreateCommandQueue(RHI::CommandListType::Direct);
+	FrameRing ring(device, 3);
+	CHECK_EQUAL(3u, ring.GetFrameCount());
+	for (uint32_t frame = 0; frame < 7; frame++) {
+		CHECK_EQUAL(frame % 3, ring.GetFrameIndex());
+		CHECK_EQUAL(frame + 1u, ring.GetCurrentFenceValue());
+		ring.MoveToNextFrame(*queue);
+	}
+	// Without GPU time every signal completes right away and nothing waits
+	CHECK_EQUAL(7u, ring.GetCompletedFenceValue());
+	CHECK_EQUAL(0u, ring.GetStallCount());
+	CHECK_THROWS(FrameRing(device, 0), std::invalid_argument);
+}
+
+TEST(FrameRingOverlapsCpuAndGpu)
+{
+	const std::chrono::microseconds frame_time(4000);
+	const uint32_t frame_count = 24;
+	const double frame_ms = frame_time.count() / 1000.0;
+
+	// A single frame in flight waits for the GPU after every frame, frames cost CPU plus GPU time
+	const RingRun serial = RunFrames(1, frame_time, frame_time, frame_count);
+	CHECK(serial.ms_per_frame >= 2 * frame_ms * .95);
+	CHECK_EQUAL(static_cast<uint64_t>(frame_count), serial.stalls);
+
+	// With more frames in flight the GPU works on one frame while the CPU records the next,
+	// throughput approaches the slower of the two
+	for (uint32_t frames_in_flight : { 2u, 3u }) {
+		const RingRun overlapped = RunFrames(frames_in_flight, frame_time, frame_time, frame_count);
+		CHECK(overlapped.ms_per_frame < serial.ms_per_frame * .75);
+		CHECK(overlapped.ms_per_frame < frame_ms * 1.35);
+	}
+
+	// A GPU slower than the CPU sets the pace and the ring blocks to keep up with it
+	const RingRun gpu_bound = RunFrames(2, frame_time / 4, frame_time, frame_count);
+	CHECK(gpu_bound.ms_per_frame >= frame_ms * .95);
+	CHECK(gpu_bound.stalls > 0);
+}
@@ -0,0 +1,102 @@
+#include "test.h"
+
+#include "frustum_culler.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+	void Multiply(const float* a, const float* b, float* result)
+	{
+		for (int row = 0; row < 4; row++) {
+			for (int column = 0; column < 4; column++) {
+				float sum = 0.f;
+				for (int k = 0; k < 4; k++)
+					sum += a[row * 4 + k] * b[k * 4 + column];
+				result[row * 4 + column] = sum;
+			}
+		}
+	}
+
+	// Left handed look-to view and 60 degree perspective, row major for row vectors like DirectXMath
+	void MakeViewProjection(float x, float z, float yaw, float pitch, float* view_projection)
+	{
+		const float forward[3] = { std::sin(yaw) * std::cos(pitch), std::sin(pitch), std::cos(yaw) * std::cos(pitch) };
+		const float right_length = std::sqrt(forward[0] * forward[0] + forward[2] * forward[2]);
+		const float right[3] = { forward[2] / right_length, 0.f, -forward[0] / right_length };
+		const float up[3] = { forward[1] * right[2], forward[2] * right[0] - forward[0] * right[2], -forward[1] * right[0] };
+		const float eye[3] = { x, 0.f, z };
+		auto dot = [](const float* a, const float* b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; };
+		const float view[16] = {
+			right[0], up[0], forward[0], 0.f,
+			right[1], up[1], forward[1], 0.f,
+			right[2], up[2], forward[2], 0.f,
+			-dot(right, eye), -dot(up, eye), -dot(forward, eye), 1.f };
+		const float h = 1.f / std::tan(3.14159265f / 6.f);
+		const float aspect = 16.f / 9.f;
+		const float near_plane = .1f;
+		const float far_plane = 100.f;
+		const float projection[16] = {
+			h / aspect, 0.f, 0.f, 0.f,
+			0.f, h, 0.f, 0.f,
+			0.f, 0.f, far_plane / (far_plane - near_plane), 1.f,
+			0.f, 0.f, -near_plane * far_plane / (far_plane - near_plane), 0.f };
+		Multiply(view, projection, view_projection);
+	}
+
+	bool HasCornerInside(const Aabb& box, const float* view_projection)
+	{
+		for (int corner = 0; corner < 8; corner++) {
+			const float point[4] = { corner & 1 ? box.max[0] : box.min[0], corner & 2 ? box.max[1] : box.min[1], corner & 4 ? box.max[2] : box.min[2], 1.f };
+			float clip[4] = {};
+			for (int column = 0; column < 4; column++) {
+				for (int k = 0; k < 4; k++)
+					clip[column] += point[k] * view_projection[k * 4 + column];
+			}
+			if (clip[3] > 0.f && std::fabs(clip[0]) < clip[3] && std::fabs(clip[1]) < clip[3] && clip[2] > 0.f && clip[2] < clip[3])
+				return true;
+		}
+		return false;
+	}
+}
+
+TEST(FrustumCullerKernelsAgreeAndKeepVisibleBoxes)
+{
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> position(-200.f, 200.f);
+	std::uniform_real_distribution<float> size(.1f, 4.f);
+	// Counts around the eight box batches of the AVX2 kernel
+	for (size_t count : { 0, 1, 7, 8, 9, 1000 }) {
+		FrustumCuller culler;
+		std::vector<Aabb> boxes;
+		for (size_t i = 0; i < count; i++) {
+			const float x = position(random), y = position(random) * .1f, z = position(random), s = size(random);
+			boxes.push_back({ { x - s, y - s, z - s }, { x + s, y + 2 * s, z + s } });
+			CHECK_EQUAL(i, static_cast<size_t>(culler.Add(boxes.back())));
+		}
+
+		for (int camera = 0; camera < 20; camera++) {
+			float view_projection[16];
+			MakeViewProjection(position(random) * .2f, position(random) * .2f, camera * .3f, (camera % 5 - 2) * .2f, view_projection);
+			std::vector<uint32_t> scalar, avx2;
+			CHECK_EQUAL(culler.Cull(CullKernel::Scalar, view_projection, scalar), scalar.size());
+			if (IsCullKernelSupported(CullKernel::Avx2)) {
+				culler.Cull(CullKernel::Avx2, view_projection, avx2);
+				CHECK(scalar == avx2);
+			}
+
+			// The test is conservative, every box with a corner in the frustum must be reported
+			size_t next = 0;
+			for (size_t i = 0; i < count; i++) {
+				const bool visible = next < scalar.size() && scalar[next] == i;
+				if (visible)
+					next++;
+				if (HasCornerInside(boxes[i], view_projection))
+					CHECK(visible);
+			}
+			CHECK_EQUAL(scalar.size(), next);
+		}
+	}
+}
@@ -0,0 +1,115 @@
+#include "test.h"
+
+#include "occlusion_culler.h"
+#include "parallel_for.h"
+
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	const float identity[16] = { 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f };
+
+	// Two triangles covering [x0, x1] x [y0, y1] at depth z, clockwise on screen unless back facing
+	std::vector<float> MakeQuad(float x0, float y0, float x1, float y1, float z, bool front_facing = true)
+	{
+		std::vector<float> quad = { x0, y1, z, x1, y1, z, x0, y0, z, x1, y1, z, x1, y0, z, x0, y0, z };
+		if (!front_facing) {
+			for (size_t triangle = 0; triangle < quad.size(); triangle += 9) {
+				for (size_t k = 0; k < 3; k++)
+					std::swap(quad[triangle + 3 + k], quad[triangle + 6 + k]);
+			}
+		}
+		return quad;
+	}
+
+	bool IsVisible(OcclusionCuller& culler, const Aabb& box)
+	{
+		const uint32_t candidate = 0;
+		std::vector<uint32_t> visible;
+		return culler.Test(&box, &candidate, 1, visible) == 1;
+	}
+}
+
+TEST(OcclusionCullerHidesBoxesBehindOccluders)
+{
+	ThreadPool pool(4);
+	for (CullKernel kernel : { CullKernel::Scalar, CullKernel::Avx2 }) {
+		if (!IsCullKernelSupported(kernel))
+			continue;
+		OcclusionCuller culler(pool, 64, 32, 0, kernel);
+		culler.Begin(identity);
+		std::vector<float> quad = MakeQuad(-1.f, -1.f, 1.f, 1.f, .5f);
+		culler.AddOccluder(quad.data(), 6);
+		culler.Rasterize();
+		CHECK_EQUAL(2u, culler.GetStats().occluder_triangles);
+		CHECK_EQUAL(.5f, culler.GetDepth(0, 0));
+		CHECK_EQUAL(.5f, culler.GetDepth(63, 31));
+		CHECK(!IsVisible(culler, { { -.2f, -.2f, .6f }, { .2f, .2f, .7f } }));
+		CHECK(IsVisible(culler, { { -.2f, -.2f, .3f }, { .2f, .2f, .4f } }));
+		// Boxes reaching in front of the occluder or across the near plane stay visible
+		CHECK(IsVisible(culler, { { -.2f, -.2f, .4f }, { .2f, .2f, .6f } }));
+		CHECK(IsVisible(culler, { { -.2f, -.2f, -.1f }, { .2f, .2f, .6f } }));
+
+		// An occluder over the left half hides only what is entirely behind it
+		culler.Begin(identity);
+		quad = MakeQuad(-1.f, -1.f, 0.f, 1.f, .5f);
+		culler.AddOccluder(quad.data(), 6);
+		culler.Rasterize();
+		CHECK(!IsVisible(culler, { { -.8f, -.2f, .6f }, { -.4f, .2f, .7f } }));
+		CHECK(IsVisible(culler, { { .2f, -.2f, .6f }, { .4f, .2f, .7f } }));
+		CHECK(IsVisible(culler, { { -.1f, -.2f, .6f }, { -.01f, .2f, .7f } }));
+
+		// Back faces don't occlude
+		culler.Begin(identity);
+		quad = MakeQuad(-1.f, -1.f, 1.f, 1.f, .5f, false);
+		culler.AddOccluder(quad.data(), 6);
+		culler.Rasterize();
+		CHECK_EQUAL(0u, culler.GetStats().occluder_triangles);
+		CHECK(IsVisible(culler, { { -.2f, -.2f, .6f }, { .2f, .2f, .7f } }));
+	}
+	CHECK_THROWS(OcclusionCuller(pool, 60, 32), std::invalid_argument);
+}
+
+TEST(OcclusionCullerResultsDontDependOnThreads)
+{
+	// Random occluders and boxes, culled inline, on every thread of a pool and with a single band
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+	std::vector<float> occluders;
+	for (int i = 0; i < 40; i++) {
+		const float x = unit(random), y = unit(random), size = .1f + .2f * (unit(random) + 1.f);
+		const std::vector<float> quad = MakeQuad(x - size, y - size, x + size, y + size, .3f + .3f * (unit(random) + 1.f));
+		occluders.insert(occluders.end(), quad.begin(), quad.end());
+	}
+	std::vector<Aabb> boxes;
+	std::vector<uint32_t> candidates;
+	for (uint32_t i = 0; i < 5000; i++) {
+		const float x = unit(random), y = unit(random), z = .5f + .4f * unit(random), size = .01f + .05f * (unit(random) + 1.f);
+		boxes.push_back({ { x - size, y - size, z - size }, { x + size, y + size, z + size } });
+		candidates.push_back(i);
+	}
+
+	ThreadPool pool(4);
+	std::vector<uint32_t> reference;
+	for (uint32_t max_threads : { 1u, 0u }) {
+		for (uint32_t height : { 64u, 8u }) {
+			OcclusionCuller culler(pool, 128, height, max_threads);
+			culler.Begin(identity);
+			culler.AddOccluder(occluders.data(), occluders.size() / 3);
+			culler.Rasterize();
+			std::vector<uint32_t> visible;
+			culler.Test(boxes.data(), candidates.data(), candidates.size(), visible);
+			CHECK_EQUAL(candidates.size(), visible.size() + culler.GetStats().occluded_boxes);
+			if (height == 8u)
+				continue;
+			if (reference.empty()) {
+				reference = visible;
+				CHECK(!reference.empty() && reference.size() < candidates.size());
+			}
+			else
+				CHECK(visible == reference);
+		}
+	}
+}
@@ -0,0 +1,138 @@
+#include "test.h"
+
+#include "overdraw_counter.h"
+
+#include <utility>
+#include <vector>
+
+namespace
+{
+	using Vertex = OverdrawCounter::ClipVertex;
+	using DepthTest = OverdrawCounter::DepthTest;
+
+	const OverdrawCounter::Pass draw_unsorted = { DepthTest::None, false, true };
+	const OverdrawCounter::Pass draw_depth_tested = { DepthTest::Less, true, true };
+	const OverdrawCounter::Pass depth_pre_pass = { DepthTest::Less, true, false };
+	const OverdrawCounter::Pass draw_after_pre_pass = { DepthTest::Equal, false, true };
+
+	// Two triangles covering [x0, x1] x [y0, y1] in normalized device coordinates, clockwise on
+	// screen unless back facing. Depth goes from z_left at x0 to z_right at x1.
+	std::vector<Vertex> MakeQuad(float x0, float y0, float x1, float y1, float z_left, float z_right, bool front_facing = true)
+	{
+		std::vector<Vertex> quad = { { x0, y1, z_left, 1.f }, { x1, y1, z_right, 1.f }, { x0, y0, z_left, 1.f },
+			{ x1, y1, z_right, 1.f }, { x1, y0, z_right, 1.f }, { x0, y0, z_left, 1.f } };
+		if (!front_facing) {
+			std::swap(quad[1], quad[2]);
+			std::swap(quad[4], quad[5]);
+		}
+		return quad;
+	}
+
+	std::vector<Vertex> MakeQuad(float x0, float y0, float x1, float y1, float z)
+	{
+		return MakeQuad(x0, y0, x1, y1, z, z);
+	}
+}
+
+TEST(OverdrawCounterCountsShadedPixelsPerDepthTest)
+{
+	// On a 16x16 target both quads cover 12x12 pixels and overlap in 8x8, b is in front
+	const std::vector<Vertex> a = MakeQuad(-1.f, -1.f, .5f, .5f, .5f);
+	const std::vector<Vertex> b = MakeQuad(-.5f, -.5f, 1.f, 1.f, .25f);
+	const uint64_t quad_pixels = 144;
+	const uint64_t overlap_pixels = 64;
+	OverdrawCounter counter(16, 16);
+
+	// Without a depth test every covered pixel shades
+	counter.Draw(a.data(), a.size(), draw_unsorted);
+	counter.Draw(b.data(), b.size(), draw_unsorted);
+	CHECK_EQUAL(4u, counter.GetStats().triangles);
+	CHECK_EQUAL(2 * quad_pixels, counter.GetStats().covered_pixels);
+	CHECK_EQUAL(2 * quad_pixels, counter.GetStats().shaded_pixels);
+
+	// Back to front the depth test saves nothing, front to back it rejects the hidden overlap
+	counter.ResetStats();
+	counter.Draw(a.data(), a.size(), draw_depth_tested);
+	counter.Draw(b.data(), b.size(), draw_depth_tested);
+	CHECK_EQUAL(2 * quad_pixels, counter.GetStats().shaded_pixels);
+	counter.ClearDepth();
+	counter.ResetStats();
+	counter.Draw(b.data(), b.size(), draw_depth_tested);
+	counter.Draw(a.data(), a.size(), draw_depth_tested);
+	CHECK_EQUAL(2 * quad_pixels, counter.GetStats().covered_pixels);
+	CHECK_EQUAL(2 * quad_pixels - overlap_pixels, counter.GetStats().shaded_pixels);
+
+	// A depth pre-pass shades nothing, the EQUAL pass after it shades every visible pixel once
+	// whatever the order
+	counter.ClearDepth();
+	counter.ResetStats();
+	counter.Draw(a.data(), a.size(), depth_pre_pass);
+	counter.Draw(b.data(), b.size(), depth_pre_pass);
+	CHECK_EQUAL(2 * quad_pixels, counter.GetStats().covered_pixels);
+	CHECK_EQUAL(0u, counter.GetStats().shaded_pixels);
+	counter.Draw(a.data(), a.size(), draw_after_pre_pass);
+	counter.Draw(b.data(), b.size(), draw_after_pre_pass);
+	CHECK_EQUAL(4 * quad_pixels, counter.GetStats().covered_pixels);
+	CHECK_EQUAL(2 * quad_pixels - overlap_pixels, counter.GetStats().shaded_pixels);
+
+	// Nothing passes a depth test against a cleared near plane
+	counter.ClearDepth(0.f);
+	counter.ResetStats();
+	counter.Draw(b.data(), b.size(), draw_depth_tested);
+	CHECK_EQUAL(quad_pixels, counter.GetStats().covered_pixels);
+	CHECK_EQUAL(0u, counter.GetStats().shaded_pixels);
+	CHECK_THROWS(counter.Draw(a.data(), 4, draw_unsorted), std::invalid_argument);
+}
+
+TEST(OverdrawCounterCullsBackFacesAndSharesEdgesOnce)
+{
+	OverdrawCounter counter(16, 16);
+	const std::vector<Vertex> back = MakeQuad(-1.f, -1.f, 1.f, 1.f, .5f, .5f, false);
+	counter.Draw(back.data(), back.size(), draw_unsorted);
+	CHECK_EQUAL(2u, counter.GetStats().culled_triangles);
+	CHECK_EQUAL(0u, counter.GetStats().covered_pixels);
+
+	// The diagonal of a full screen quad runs through 16 pixel centers, each belongs to one triangle
+	counter.ResetStats();
+	const std::vector<Vertex> full = MakeQuad(-1.f, -1.f, 1.f, 1.f, .5f);
+	counter.Draw(full.data(), full.size(), draw_unsorted);
+	CHECK_EQUAL(256u, counter.GetStats().covered_pixels);
+	CHECK_EQUAL(1.0, counter.GetOverdraw());
+
+	// Quads meeting on the pixel centers at x = 8.5 and y = 8.5, column and row 8 go only to the
+	// right and bottom quads, whose left and top edges they are
+	const float edge = .0625f;
+	const std::vector<Vertex> left = MakeQuad(-1.f, -1.f, edge, 1.f, .5f);
+	const std::vector<Vertex> right = MakeQuad(edge, -1.f, 1.f, 1.f, .5f);
+	const std::vector<Vertex> top = MakeQuad(-1.f, -edge, 1.f, 1.f, .5f);
+	const std::vector<Vertex> bottom = MakeQuad(-1.f, -1.f, 1.f, -edge, .5f);
+	const std::pair<const std::vector<Vertex>*, uint64_t> halves[] = { { &left, 128 }, { &right, 128 }, { &top, 128 }, { &bottom, 128 } };
+	for (const auto& half : halves) {
+		counter.ResetStats();
+		counter.Draw(half.first->data(), half.first->size(), draw_unsorted);
+		CHECK_EQUAL(half.second, counter.GetStats().covered_pixels);
+	}
+}
+
+TEST(OverdrawCounterClipsToTheDepthRange)
+{
+	OverdrawCounter counter(16, 16);
+	const std::vector<Vertex> in_front = MakeQuad(-1.f, -1.f, 1.f, 1.f, -.1f);
+	const std::vector<Vertex> behind = MakeQuad(-1.f, -1.f, 1.f, 1.f, 1.5f);
+	counter.Draw(in_front.data(), in_front.size(), draw_unsorted);
+	counter.Draw(behind.data(), behind.size(), draw_unsorted);
+	CHECK_EQUAL(4u, counter.GetStats().culled_triangles);
+	CHECK_EQUAL(0u, counter.GetStats().covered_pixels);
+
+	// Depth crossing the near plane at the center keeps the right half, crossing the far plane the left
+	counter.ResetStats();
+	const std::vector<Vertex> near_crossing = MakeQuad(-1.f, -1.f, 1.f, 1.f, -1.f, 1.f);
+	counter.Draw(near_crossing.data(), near_crossing.size(), draw_unsorted);
+	CHECK_EQUAL(0u, counter.GetStats().culled_triangles);
+	CHECK_EQUAL(128u, counter.GetStats().covered_pixels);
+	counter.ResetStats();
+	const std::vector<Vertex> far_crossing = MakeQuad(-1.f, -1.f, 1.f, 1.f, 0.f, 2.f);
+	counter.Draw(far_crossing.data(), far_crossing.size(), draw_depth_tested);
+	CHECK_EQUAL(128u, counter.GetStats().covered_pixels);
+	CHECK_EQUAL(128u, counter.GetStats().shaded_pixels);
+}
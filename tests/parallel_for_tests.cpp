@@ -0,0 +1,126 @@
+#include "test.h"
+
+#include "frame_recorder.h"
+#include "parallel_for.h"
+#include "rhi_null.h"
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST(ThreadPoolRunsEveryIndexOnce)
+{
+	ThreadPool pool(4);
+	CHECK_EQUAL(4u, pool.GetThreadCount());
+	// The same workers serve many loops of different sizes
+	for (size_t count : { 0, 1, 3, 4, 1000, 7 }) {
+		std::vector<std::atomic<uint32_t>> runs(count);
+		for (uint32_t loop = 0; loop < 50; loop++)
+			pool.ParallelFor(count, [&](size_t i) { runs[i]++; });
+		for (const std::atomic<uint32_t>& run : runs)
+			CHECK_EQUAL(50u, run.load());
+	}
+}
+
+TEST(ThreadPoolLimitsThreadsPerLoop)
+{
+	ThreadPool pool(4);
+	std::mutex mutex;
+	std::set<std::thread::id> threads;
+	auto record = [&](size_t) {
+		std::lock_guard<std::mutex> lock(mutex);
+		threads.insert(std::this_thread::get_id());
+	};
+	pool.ParallelFor(64, record, 1);
+	CHECK_EQUAL(1u, threads.size());
+	CHECK(*threads.begin() == std::this_thread::get_id());
+
+	// Which threads take part is up to scheduling, but never more than asked for
+	threads.clear();
+	pool.ParallelFor(64, record, 2);
+	CHECK(threads.size() <= 2);
+}
+
+TEST(ThreadPoolRethrowsAndRecovers)
+{
+	ThreadPool pool(3);
+	std::atomic<uint32_t> runs(0);
+	auto fail_at_10 = [&](size_t i) {
+		runs++;
+		if (i == 10)
+			throw std::runtime_error("task failed");
+	};
+	CHECK_THROWS(pool.ParallelFor(100, fail_at_10), std::runtime_error);
+	// On one thread nothing after the failing index runs, other threads may finish theirs first
+	runs = 0;
+	CHECK_THROWS(pool.ParallelFor(100, fail_at_10, 1), std::runtime_error);
+	CHECK_EQUAL(11u, runs.load());
+
+	// A failed loop leaves the pool usable
+	runs = 0;
+	pool.ParallelFor(100, [&](size_t) { runs++; });
+	CHECK_EQUAL(100u, runs.load());
+}
+
+TEST(ThreadPoolRunsNestedAndConcurrentLoops)
+{
+	ThreadPool pool(4);
+	// A task looping on its own pool runs the inner loop inline instead of deadlocking
+	std::atomic<uint32_t> inner(0);
+	pool.ParallelFor(8, [&](size_t) { pool.ParallelFor(8, [&](size_t) { inner++; }); });
+	CHECK_EQUAL(64u, inner.load());
+
+	// Loops from several threads queue up behind each other
+	std::atomic<uint32_t> runs(0);
+	std::vector<std::thread> callers;
+	for (uint32_t caller = 0; caller < 4; caller++) {
+		callers.emplace_back([&] {
+			for (uint32_t loop = 0; loop < 100; loop++)
+				pool.ParallelFor(16, [&](size_t) { runs++; });
+		});
+	}
+	for (std::thread& caller : callers)
+		caller.join();
+	CHECK_EQUAL(4u * 100u * 16u, runs.load());
+}
+
+TEST(RecordFrameParallelMatchesRecordFrame)
+{
+	RHI::NullDevice device;
+	auto root_signature = device.CreateRootSignature();
+	auto pipeline = device.CreatePipelineState();
+	RHI::PipelineState* pipelines[1] = { pipeline.get() };
+	FrameContext frame = {};
+	frame.root_signature = root_signature.get();
+	frame.rtv = { 1 };
+	frame.view_port = { 0.f, 0.f, 1280.f, 720.f, 0.f, 1.f };
+	frame.scissor_rect = { 0, 0, 1280, 720 };
+	frame.pipeline_states = pipelines;
+	std::vector<DrawItem> draws;
+	for (uint32_t i = 0; i < 1000; i++)
+		draws.push_back({ i * 3, 3, (1ull << 32) + i * 256, 0, 0 });
+
+	RHI::RecordingCommandList serial;
+	RecordFrame(serial, frame, draws);
+
+	ThreadPool pool(4);
+	std::vector<RHI::RecordingCommandList> lists(4);
+	std::vector<RHI::CommandList*> list_pointers;
+	for (RHI::RecordingCommandList& list : lists)
+		list_pointers.push_back(&list);
+	RecordFrameParallel(pool, list_pointers.data(), 4, frame, draws);
+
+	// Chunks keep the draw order, every list sets its own state and only the first begins the pass
+	uint64_t draw_calls = 0;
+	for (const RHI::RecordingCommandList& list : lists) {
+		CHECK_EQUAL(250u, list.GetStream().GetCommandCount(RHI::CommandId::DrawInstanced));
+		CHECK(list.GetStream().GetCommandCount(RHI::CommandId::SetGraphicsRootSignature) > 0);
+		draw_calls += list.GetStream().GetCommandCount(RHI::CommandId::DrawInstanced);
+	}
+	CHECK_EQUAL(serial.GetStream().GetCommandCount(RHI::CommandId::DrawInstanced), draw_calls);
+	CHECK_EQUAL(serial.GetStream().GetCommandCount(RHI::CommandId::ClearRenderTargetView), lists[0].GetStream().GetCommandCount(RHI::CommandId::ClearRenderTargetView));
+	CHECK_EQUAL(0u, lists[3].GetStream().GetCommandCount(RHI::CommandId::ClearRenderTargetView));
+}
@@ -0,0 +1,122 @@
+#include "test.h"
+
+#include "pipeline_cache.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+	// A file in the temp directory, removed when the test ends
+	struct TempFile
+	{
+		std::string path;
+		explicit TempFile(const char* name) : path((std::filesystem::temp_directory_path() / name).string()) { std::remove(path.c_str()); }
+		~TempFile() { std::remove(path.c_str()); }
+	};
+
+	std::vector<uint8_t> ReadFile(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	}
+
+	void WriteFile(const std::string& path, const std::vector<uint8_t>& data)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	}
+}
+
+TEST(HasherMatchesFnv1a)
+{
+	// Reference values of 64-bit FNV-1a
+	CHECK_EQUAL(0xcbf29ce484222325ull, Hasher().Get());
+	CHECK_EQUAL(0xaf63dc4c8601ec8cull, Hasher().Add("a", 1).Get());
+	CHECK_EQUAL(0x85944171f73967e8ull, Hasher().Add("foobar", 6).Get());
+
+	// Incremental adds hash the same bytes as one add
+	const uint32_t values[2] = { 1, 2 };
+	CHECK_EQUAL(Hasher().Add(values).Get(), Hasher().Add(values[0]).Add(values[1]).Get());
+}
+
+TEST(HasherSeparatesStringBoundaries)
+{
+	CHECK(Hasher().AddString("ab").AddString("c").Get() != Hasher().AddString("a").AddString("bc").Get());
+	CHECK(Hasher().AddString("").Get() != Hasher().Get());
+	CHECK_EQUAL(Hasher().AddString(nullptr).Get(), Hasher().AddString("").Get());
+}
+
+TEST(PipelineCacheStoresAndCountsLookups)
+{
+	PipelineCache cache;
+	CHECK(cache.Find(1) == nullptr);
+	const uint8_t blob[4] = { 1, 2, 3, 4 };
+	cache.Store(1, blob, sizeof(blob));
+	CHECK(cache.IsDirty());
+	const std::vector<uint8_t>* found = cache.Find(1);
+	CHECK(found != nullptr);
+	CHECK_EQUAL(4u, found->size());
+	CHECK_EQUAL(3, (*found)[2]);
+
+	// Storing again replaces the blob
+	cache.Store(1, blob, 2);
+	CHECK_EQUAL(2u, cache.Find(1)->size());
+	const PipelineCache::Stats stats = cache.GetStats();
+	CHECK_EQUAL(2u, stats.hits);
+	CHECK_EQUAL(1u, stats.misses);
+	CHECK_EQUAL(1u, stats.entries);
+	CHECK_EQUAL(2u, stats.bytes);
+}
+
+TEST(PipelineCacheRoundTripsThroughAFile)
+{
+	TempFile file("pipeline_cache_tests.bin");
+	PipelineCache cache;
+	CHECK(!cache.Load(file.path));
+	const std::string a = "root signature";
+	const std::string b(10000, 'x');
+	cache.Store(Hasher().AddString("a").Get(), a.data(), a.size());
+	cache.Store(Hasher().AddString("b").Get(), b.data(), b.size());
+	cache.Store(3, nullptr, 0);
+	cache.Save(file.path);
+
+	PipelineCache loaded;
+	CHECK(loaded.Load(file.path));
+	CHECK(!loaded.IsDirty());
+	CHECK_EQUAL(3u, loaded.GetStats().entries);
+	const std::vector<uint8_t>* found = loaded.Find(Hasher().AddString("b").Get());
+	CHECK(found != nullptr);
+	CHECK(std::string(found->begin(), found->end()) == b);
+	CHECK(loaded.Find(3) != nullptr && loaded.Find(3)->empty());
+}
+
+TEST(PipelineCacheDiscardsDamagedFiles)
+{
+	TempFile file("pipeline_cache_tests.bin");
+	PipelineCache cache;
+	const uint8_t blob[64] = {};
+	cache.Store(1, blob, sizeof(blob));
+	cache.Store(2, blob, sizeof(blob));
+	cache.Save(file.path);
+	const std::vector<uint8_t> data = ReadFile(file.path);
+
+	// A truncated file is dropped as a whole, not trusted partially
+	WriteFile(file.path, std::vector<uint8_t>(data.begin(), data.end() - 1));
+	PipelineCache loaded;
+	loaded.Store(9, blob, 1);
+	CHECK(!loaded.Load(file.path));
+	CHECK_EQUAL(0u, loaded.GetStats().entries);
+
+	// So is a file of another version
+	std::vector<uint8_t> outdated = data;
+	outdated[4]++;
+	WriteFile(file.path, outdated);
+	CHECK(!loaded.Load(file.path));
+	CHECK_EQUAL(0u, loaded.GetStats().entries);
+
+	WriteFile(file.path, data);
+	CHECK(loaded.Load(file.path));
+	CHECK_EQUAL(2u, loaded.GetStats().entries);
+}
@@ -0,0 +1,260 @@
+#include "test.h"
+
+#include "pvs.h"
+#include "pvs_baker.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+	// A file in the temp directory, removed when the test ends
+	struct TempFile
+	{
+		std::string path;
+		explicit TempFile(const char* name) : path((std::filesystem::temp_directory_path() / name).string()) { std::remove(path.c_str()); }
+		~TempFile() { std::remove(path.c_str()); }
+	};
+
+	std::vector<uint8_t> ReadFile(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	}
+
+	void WriteFile(const std::string& path, const std::vector<uint8_t>& data)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	}
+
+	// Offsets into the file header
+	const size_t shape_count_offset = 8;
+	const size_t cells_offset = 12;
+	const size_t data_size_offset = 40;
+
+	template<typename T>
+	void Patch(std::vector<uint8_t>& file, size_t offset, const T& value)
+	{
+		memcpy(file.data() + offset, &value, sizeof(value));
+	}
+
+	// Four cells of 3000 shapes: the second cell sees what the first does, the last one sees nothing
+	PotentiallyVisibleSet MakeSparseSet()
+	{
+		PotentiallyVisibleSet pvs;
+		pvs.Reset({ { 0.f, 0.f, 0.f }, { 4.f, 1.f, 1.f } }, 1.f, 3000);
+		for (uint32_t cell : { 0u, 1u }) {
+			pvs.SetVisible(cell, 0);
+			pvs.SetVisible(cell, 2999);
+		}
+		pvs.SetVisible(2, 1500);
+		return pvs;
+	}
+
+	// Two triangles on the square from corner spanned by u and v, facing along u x v
+	void AddQuad(std::vector<float>& positions, const float* corner, const float* u, const float* v)
+	{
+		const float weights[6][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 0, 1 } };
+		for (const auto& weight : weights) {
+			for (int axis = 0; axis < 3; axis++)
+				positions.push_back(corner[axis] + weight[0] * u[axis] + weight[1] * v[axis]);
+		}
+	}
+
+	// A cube with its faces facing out
+	std::vector<float> MakeBox(const float* min, float size)
+	{
+		const float x[3] = { size, 0.f, 0.f };
+		const float y[3] = { 0.f, size, 0.f };
+		const float z[3] = { 0.f, 0.f, size };
+		const float max_x[3] = { min[0] + size, min[1], min[2] };
+		const float max_y[3] = { min[0], min[1] + size, min[2] };
+		const float max_z[3] = { min[0], min[1], min[2] + size };
+		std::vector<float> positions;
+		AddQuad(positions, min, z, y);
+		AddQuad(positions, max_x, y, z);
+		AddQuad(positions, min, x, z);
+		AddQuad(positions, max_y, z, x);
+		AddQuad(positions, min, y, x);
+		AddQuad(positions, max_z, x, y);
+		return positions;
+	}
+}
+
+TEST(PvsRoundTripsThroughAFile)
+{
+	TempFile file("pvs_tests.bin");
+	const PotentiallyVisibleSet pvs = MakeSparseSet();
+	// 375 bytes per cell, unchanged and empty stretches take zero runs longer than 255 bytes:
+	// 01 [0 255] [0 118] 80, [0 255] [0 120], 01 [0 186] 10 [0 186] 80, [0 187] 10 [0 187]
+	CHECK_EQUAL(1500u, pvs.GetUncompressedSize());
+	CHECK_EQUAL(22u, pvs.GetCompressedSize());
+	pvs.Save(file.path);
+
+	PotentiallyVisibleSet loaded;
+	CHECK(loaded.Load(file.path));
+	CHECK_EQUAL(4u, loaded.GetCellCount());
+	CHECK_EQUAL(3000u, loaded.GetShapeCount());
+	CHECK_EQUAL(1.f, loaded.GetCellSize());
+	CHECK_EQUAL(4.f, loaded.GetBounds().max[0]);
+	for (uint32_t cell = 0; cell < 4; cell++) {
+		for (uint32_t shape = 0; shape < 3000; shape++)
+			CHECK_EQUAL(pvs.IsVisible(cell, shape), loaded.IsVisible(cell, shape));
+	}
+	CHECK(loaded.IsVisible(1, 2999) && loaded.IsVisible(2, 1500) && !loaded.IsVisible(3, 1500));
+
+	// A set of one cell and no shapes still round trips
+	PotentiallyVisibleSet empty;
+	empty.Reset({ { 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f } }, 1.f, 0);
+	empty.Save(file.path);
+	CHECK(loaded.Load(file.path));
+	CHECK_EQUAL(1u, loaded.GetCellCount());
+	CHECK(!loaded.IsEmpty());
+}
+
+TEST(PvsRejectsTruncatedAndCorruptFiles)
+{
+	TempFile file("pvs_tests.bin");
+	const PotentiallyVisibleSet pvs = MakeSparseSet();
+	pvs.Save(file.path);
+	const std::vector<uint8_t> saved = ReadFile(file.path);
+	const size_t header_size = saved.size() - pvs.GetCompressedSize();
+
+	PotentiallyVisibleSet loaded;
+	auto load = [&](const std::vector<uint8_t>& data) {
+		// A failed load leaves the set empty, whatever it held before
+		CHECK(loaded.Load(file.path));
+		WriteFile(file.path, data);
+		const bool result = loaded.Load(file.path);
+		CHECK_EQUAL(!result, loaded.IsEmpty());
+		pvs.Save(file.path);
+		return result;
+	};
+	CHECK(load(saved));
+
+	std::vector<uint8_t> data(saved.begin(), saved.begin() + header_size - 1);
+	CHECK(!load(data));
+	data.assign(saved.begin(), saved.end() - 1);
+	CHECK(!load(data));
+	// A stream cut short of the cells' size
+	Patch(data, data_size_offset, static_cast<uint64_t>(data.size() - header_size));
+	CHECK(!load(data));
+	// Or running past it
+	data = saved;
+	data.push_back(1);
+	Patch(data, data_size_offset, static_cast<uint64_t>(data.size() - header_size));
+	CHECK(!load(data));
+	data = saved;
+	data[0] ^= 1;
+	CHECK(!load(data));
+
+	// A zero run of no bytes, and one that ends the stream without its length
+	data = saved;
+	CHECK_EQUAL(0, data[header_size + 1]);
+	data[header_size + 2] = 0;
+	CHECK(!load(data));
+	data = saved;
+	data.push_back(0);
+	Patch(data, data_size_offset, static_cast<uint64_t>(data.size() - header_size));
+	CHECK(!load(data));
+
+	// Headers asking for more than the stream can expand to fail before allocating: 2^24 cells
+	// of 2^28 bytes, and shape counts whose bytes per cell wrap in 32 bits
+	data = saved;
+	const uint32_t cells[3] = { 256, 256, 256 };
+	Patch(data, cells_offset, cells);
+	Patch(data, shape_count_offset, 0x7fffffffu);
+	CHECK(!load(data));
+	for (uint32_t shape_count : { 0xfffffff9u, 0xffffffffu }) {
+		data = saved;
+		Patch(data, shape_count_offset, shape_count);
+		CHECK(!load(data));
+	}
+
+	CHECK(!loaded.Load(file.path + ".missing"));
+	CHECK(loaded.IsEmpty());
+}
+
+TEST(PvsFindsCellsUpToTheBoundsEdges)
+{
+	PotentiallyVisibleSet pvs;
+	CHECK_THROWS(pvs.Reset({ { 0.f, 0.f, 0.f }, { 1.f, 1.f, 1.f } }, 0.f, 1), std::invalid_argument);
+	CHECK_THROWS(pvs.Reset({ { 1.f, 0.f, 0.f }, { 0.f, 1.f, 1.f } }, 1.f, 1), std::invalid_argument);
+
+	// The grid rounds 3.5 up to whole cells, 4 x 2 x 1 of them
+	pvs.Reset({ { -1.f, 0.f, 0.f }, { 2.5f, 2.f, 1.f } }, 1.f, 8);
+	CHECK_EQUAL(8u, pvs.GetCellCount());
+	CHECK_EQUAL(3.f, pvs.GetBounds().max[0]);
+	CHECK_EQUAL(0u, pvs.FindCell(-1.f, 0.f, 0.f));
+	CHECK_EQUAL(3u, pvs.FindCell(2.75f, 0.f, 0.f));
+	CHECK_EQUAL(7u, pvs.FindCell(2.999f, 1.999f, .999f));
+	CHECK_EQUAL(5u, pvs.FindCell(0.f, 1.f, .5f));
+	// Minimum edges are inside, maximum edges outside
+	CHECK_EQUAL(PotentiallyVisibleSet::no_cell, pvs.FindCell(3.f, 0.f, 0.f));
+	CHECK_EQUAL(PotentiallyVisibleSet::no_cell, pvs.FindCell(0.f, 2.f, 0.f));
+	CHECK_EQUAL(PotentiallyVisibleSet::no_cell, pvs.FindCell(0.f, 0.f, 1.f));
+	CHECK_EQUAL(PotentiallyVisibleSet::no_cell, pvs.FindCell(-1.001f, 0.f, 0.f));
+	CHECK_EQUAL(PotentiallyVisibleSet::no_cell, pvs.FindCell(0.f, -.001f, 0.f));
+	CHECK_EQUAL(PotentiallyVisibleSet::no_cell, pvs.FindCell(NAN, 0.f, 0.f));
+
+	const Aabb cell = pvs.GetCellBounds(7);
+	CHECK_EQUAL(2.f, cell.min[0]);
+	CHECK_EQUAL(1.f, cell.min[1]);
+	CHECK_EQUAL(1.f, cell.max[2]);
+	CHECK_EQUAL(7u, pvs.FindCell(cell.min[0], cell.min[1], cell.min[2]));
+}
+
+TEST(PvsBakerHidesBoxesBehindAWall)
+{
+	// Four cells along x, a wall drawn from both sides at x = 2.5 and a box beyond either end
+	PvsBaker baker;
+	std::vector<float> wall;
+	const float wall_corner[3] = { 2.5f, -10.f, -10.f };
+	const float y[3] = { 0.f, 20.f, 0.f };
+	const float z[3] = { 0.f, 0.f, 20.f };
+	AddQuad(wall, wall_corner, z, y);
+	AddQuad(wall, wall_corner, y, z);
+	baker.AddShape(wall.data(), wall.size() / 3);
+	const float left_min[3] = { -2.f, 0.f, 0.f };
+	const float right_min[3] = { 5.f, 0.f, 0.f };
+	const std::vector<float> left = MakeBox(left_min, 1.f);
+	const std::vector<float> right = MakeBox(right_min, 1.f);
+	baker.AddShape(left.data(), left.size() / 3);
+	baker.AddShape(right.data(), right.size() / 3);
+	CHECK_THROWS(baker.AddShape(left.data(), 4), std::invalid_argument);
+
+	PvsBaker::Settings settings = {};
+	settings.bounds = { { 0.f, 0.f, 0.f }, { 4.f, 1.f, 1.f } };
+	settings.cell_size = 1.f;
+	settings.samples_per_cell = 16;
+	settings.targets_per_shape = 16;
+	settings.seed = 1;
+	settings.thread_count = 1;
+	const PotentiallyVisibleSet pvs = baker.Bake(settings);
+	const PvsBaker::Stats stats = baker.GetStats();
+
+	// The cell the wall runs through sees past it both ways
+	const bool expected[4][3] = { { true, true, false }, { true, true, false }, { true, true, true }, { true, false, true } };
+	CHECK_EQUAL(4u, pvs.GetCellCount());
+	for (uint32_t cell = 0; cell < 4; cell++) {
+		for (uint32_t shape = 0; shape < 3; shape++)
+			CHECK_EQUAL(expected[cell][shape], pvs.IsVisible(cell, shape));
+	}
+	CHECK_EQUAL(9u, stats.visible_pairs);
+
+	// Cells are seeded on their own, any thread count bakes the same set with the same rays
+	for (uint32_t thread_count : { 0u, 2u, 4u }) {
+		settings.thread_count = thread_count;
+		const PotentiallyVisibleSet parallel = baker.Bake(settings);
+		for (uint32_t cell = 0; cell < 4; cell++) {
+			for (uint32_t shape = 0; shape < 3; shape++)
+				CHECK_EQUAL(pvs.IsVisible(cell, shape), parallel.IsVisible(cell, shape));
+		}
+		CHECK_EQUAL(stats.rays, baker.GetStats().rays);
+		CHECK_EQUAL(stats.visible_pairs, baker.GetStats().visible_pairs);
+	}
+}
@@ -0,0 +1,101 @@
+#include "test.h"
+
+#include "readback_ring.h"
+#include "rhi_null.h"
+
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+	// A texture whose tightly packed rows hold a pattern unique to seed
+	std::unique_ptr<RHI::Resource> MakeTexture(RHI::Device& device, uint32_t width, uint32_t height, uint8_t seed)
+	{
+		auto texture = device.CreateTexture2D(width, height, RHI::Format::R8G8B8A8Unorm, RHI::ResourceState::CopySource);
+		auto* resource = static_cast<RHI::NullResource*>(texture.get());
+		for (size_t i = 0; i < resource->GetStorageSize(); i++)
+			resource->GetStorage()[i] = static_cast<uint8_t>(i * 7 + seed);
+		return texture;
+	}
+
+	bool Matches(const ReadbackImage& image, RHI::Resource* texture)
+	{
+		auto* resource = static_cast<RHI::NullResource*>(texture);
+		return image.pixels.size() == resource->GetStorageSize() && memcmp(image.pixels.data(), resource->GetStorage(), image.pixels.size()) == 0;
+	}
+}
+
+TEST(ReadbackRingResolvesCopiesOnceTheirFenceCompletes)
+{
+	RHI::NullDevice device;
+	auto queue = device.CreateCommandQueue(RHI::CommandListType::Direct);
+	static_cast<RHI::NullCommandQueue*>(queue.get())->SetSimulatedGpuTime(std::chrono::milliseconds(20));
+	auto fence = device.CreateFence(0);
+	auto allocator = device.CreateCommandAllocator(RHI::CommandListType::Direct);
+	auto list = device.CreateCommandList(RHI::CommandListType::Direct, allocator.get(), nullptr);
+
+	// 100 pixel rows need 400 bytes, the copy pads them to the pitch alignment and Poll packs them again
+	auto texture = MakeTexture(device, 100, 7, 1);
+	ReadbackRing ring(device, 2);
+	std::future<ReadbackImage> screenshot = ring.ReadTexture(*list, texture.get(), 1);
+	list->Close();
+	RHI::CommandList* lists[] = { list.get() };
+	queue->ExecuteCommandLists(1, lists);
+	queue->Signal(fence.get(), 1);
+
+	// The CPU doesn't wait, the image isn't there before the simulated GPU finishes
+	CHECK_EQUAL(0u, ring.Poll(fence->GetCompletedValue()));
+	CHECK(screenshot.wait_for(std::chrono::seconds(0)) == std::future_status::timeout);
+	CHECK_EQUAL(1u, ring.GetPendingCount());
+
+	fence->Wait(1);
+	CHECK_EQUAL(1u, ring.Poll(fence->GetCompletedValue()));
+	const ReadbackImage image = screenshot.get();
+	CHECK_EQUAL(100u, image.width);
+	CHECK_EQUAL(7u, image.height);
+	CHECK(image.format == RHI::Format::R8G8B8A8Unorm);
+	CHECK(Matches(image, texture.get()));
+	CHECK_EQUAL(1u, ring.GetResolvedCount());
+}
+
+TEST(ReadbackRingReusesSlotsInOrder)
+{
+	RHI::NullDevice device;
+	auto queue = device.CreateCommandQueue(RHI::CommandListType::Direct);
+	auto fence = device.CreateFence(0);
+	auto allocator = device.CreateCommandAllocator(RHI::CommandListType::Direct);
+	auto list = device.CreateCommandList(RHI::CommandListType::Direct, allocator.get(), nullptr);
+	auto small = MakeTexture(device, 16, 16, 2);
+	auto large = MakeTexture(device, 64, 32, 3);
+
+	ReadbackRing ring(device, 2);
+	std::future<ReadbackImage> first = ring.ReadTexture(*list, small.get(), 1);
+	std::future<ReadbackImage> second = ring.ReadTexture(*list, large.get(), 2);
+	CHECK(!ring.HasFreeSlot());
+	CHECK_THROWS(ring.ReadTexture(*list, small.get(), 2), std::runtime_error);
+	list->Close();
+	RHI::CommandList* lists[] = { list.get() };
+	queue->ExecuteCommandLists(1, lists);
+	queue->Signal(fence.get(), 2);
+
+	// Only copies up to the completed value resolve, and a slot frees up for the next frame
+	CHECK_EQUAL(1u, ring.Poll(1));
+	CHECK(Matches(first.get(), small.get()));
+	CHECK(ring.HasFreeSlot());
+	CHECK_EQUAL(1u, ring.Poll(2));
+	CHECK(Matches(second.get(), large.get()));
+
+	// The first slot grows to fit a larger texture than it held before
+	allocator->Reset();
+	list->Reset(allocator.get(), nullptr);
+	std::future<ReadbackImage> third = ring.ReadTexture(*list, large.get(), 3);
+	list->Close();
+	queue->ExecuteCommandLists(1, lists);
+	queue->Signal(fence.get(), 3);
+	CHECK_EQUAL(1u, ring.Poll(fence->GetCompletedValue()));
+	CHECK(Matches(third.get(), large.get()));
+
+	auto buffer = device.CreateBuffer(RHI::HeapType::Default, 256, RHI::ResourceState::CopySource);
+	CHECK_THROWS(ring.ReadTexture(*list, buffer.get(), 4), std::invalid_argument);
+	CHECK_THROWS(ReadbackRing(device, 0), std::invalid_argument);
+}
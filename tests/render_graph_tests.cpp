@@ -0,0 +1,223 @@
+#include "test.h"
+
+#include "render_graph.h"
+#include "rhi_null.h"
+
+#include <string>
+#include <vector>
+
+using State = RHI::ResourceState;
+
+namespace
+{
+	struct BarrierBatches
+	{
+		size_t batches = 0;
+		size_t barriers = 0;
+		size_t aliasing = 0;
+	};
+
+	BarrierBatches CountBarriers(const RHI::CommandStream& stream)
+	{
+		BarrierBatches counts;
+		stream.ForEach([&](const RHI::CommandHeader& header, const uint8_t* payload) {
+			if (header.id != RHI::CommandId::ResourceBarrier)
+				return;
+			const auto* command = reinterpret_cast<const RHI::Commands::ResourceBarrier*>(payload);
+			const auto* records = reinterpret_cast<const RHI::Commands::Barrier*>(command + 1);
+			counts.batches++;
+			counts.barriers += command->count;
+			for (uint32_t i = 0; i < command->count; i++)
+				counts.aliasing += records[i].type == RHI::ResourceBarrierType::Aliasing;
+		});
+		return counts;
+	}
+}
+
+TEST(RenderGraphCullsAliasesAndBatches)
+{
+	RHI::NullDevice device;
+	RenderGraph graph;
+	const RenderGraph::TextureDesc hdr_desc = { 1920, 1080, RHI::Format::R16G16B16A16Float };
+	const RenderGraph::TextureDesc depth_desc = { 1920, 1080, RHI::Format::D32Float };
+	const RenderGraph::TextureDesc shadow_desc = { 2048, 2048, RHI::Format::D32Float };
+	const RenderGraph::ResourceHandle back_buffer = graph.Import("back buffer", State::Present, State::Present);
+	const RenderGraph::ResourceHandle depth = graph.CreateTexture("depth", depth_desc);
+	const RenderGraph::ResourceHandle shadow = graph.CreateTexture("shadow", shadow_desc);
+	const RenderGraph::ResourceHandle hdr = graph.CreateTexture("hdr", hdr_desc);
+	const RenderGraph::ResourceHandle bloom = graph.CreateTexture("bloom", hdr_desc);
+	const RenderGraph::ResourceHandle debug_target = graph.CreateTexture("debug", hdr_desc);
+
+	std::vector<std::string> executed;
+	auto add_pass = [&](const char* name) {
+		return graph.AddPass(name, [&executed, name](RenderGraph::Context&) { executed.push_back(name); });
+	};
+	const RenderGraph::PassHandle shadow_pass = add_pass("shadow");
+	graph.Write(shadow_pass, shadow, State::DepthWrite);
+	const RenderGraph::PassHandle prepass = add_pass("prepass");
+	graph.Write(prepass, depth, State::DepthWrite);
+	const RenderGraph::PassHandle scene = add_pass("scene");
+	graph.Read(scene, depth, State::DepthRead);
+	graph.Read(scene, shadow, State::PixelShaderResource);
+	graph.Write(scene, hdr, State::RenderTarget);
+	// Nothing reads what the debug pass writes
+	const RenderGraph::PassHandle debug = add_pass("debug");
+	graph.Read(debug, hdr, State::PixelShaderResource);
+	graph.Write(debug, debug_target, State::RenderTarget);
+	const RenderGraph::PassHandle bloom_pass = add_pass("bloom");
+	graph.Read(bloom_pass, hdr, State::PixelShaderResource);
+	graph.Write(bloom_pass, bloom, State::RenderTarget);
+	const RenderGraph::PassHandle tonemap = add_pass("tonemap");
+	graph.Read(tonemap, hdr, State::PixelShaderResource);
+	graph.Read(tonemap, hdr, State::NonPixelShaderResource);
+	graph.Read(tonemap, bloom, State::PixelShaderResource);
+	graph.Write(tonemap, back_buffer, State::RenderTarget);
+	graph.Compile(device);
+
+	const RenderGraph::Stats& stats = graph.GetStats();
+	CHECK(graph.IsCulled(debug));
+	CHECK(!graph.IsCulled(shadow_pass) && !graph.IsCulled(tonemap));
+	CHECK_EQUAL(5u, stats.passes);
+	CHECK_EQUAL(1u, stats.culled_passes);
+	CHECK_EQUAL(~0ull, graph.GetHeapOffset(debug_target));
+
+	// The shadow map is dead once the scene read it, bloom takes its memory
+	auto size = [&](const RenderGraph::TextureDesc& desc) { return device.GetTexture2DAllocationSize(desc.width, desc.height, desc.format); };
+	CHECK_EQUAL(4u, stats.transient_textures);
+	CHECK_EQUAL(size(depth_desc) + size(shadow_desc) + 2 * size(hdr_desc), stats.transient_bytes);
+	CHECK_EQUAL(graph.GetHeapOffset(shadow), graph.GetHeapOffset(bloom));
+	CHECK_EQUAL(stats.transient_bytes - size(hdr_desc), stats.heap_bytes);
+	CHECK_EQUAL(12u, stats.barriers);
+	CHECK_EQUAL(2u, stats.aliasing_barriers);
+	CHECK_EQUAL(6u, stats.barrier_batches);
+
+	// The recorded frame holds exactly the compiled barriers, and every frame records the same
+	auto back_buffer_texture = device.CreateTexture2D(1920, 1080, RHI::Format::R8G8B8A8Unorm, State::Present);
+	graph.SetImportedResource(back_buffer, back_buffer_texture.get());
+	for (uint32_t frame = 0; frame < 2; frame++) {
+		executed.clear();
+		RHI::RecordingCommandList list;
+		graph.Execute(list);
+		const BarrierBatches counts = CountBarriers(list.GetStream());
+		CHECK_EQUAL(static_cast<size_t>(stats.barriers), counts.barriers);
+		CHECK_EQUAL(static_cast<size_t>(stats.aliasing_barriers), counts.aliasing);
+		CHECK_EQUAL(static_cast<size_t>(stats.barrier_batches), counts.batches);
+		CHECK(executed == std::vector<std::string>({ "shadow", "prepass", "scene", "bloom", "tonemap" }));
+	}
+}
+
+TEST(RenderGraphRejectsInvalidAccesses)
+{
+	RHI::NullDevice device;
+	RenderGraph graph;
+	const RenderGraph::ResourceHandle texture = graph.CreateTexture("texture", { 64, 64, RHI::Format::R8G8B8A8Unorm });
+	const RenderGraph::ResourceHandle back_buffer = graph.Import("back buffer", State::Present, State::Present);
+	const RenderGraph::PassHandle pass = graph.AddPass("pass", nullptr);
+	graph.Read(pass, texture, State::PixelShaderResource);
+	graph.Write(pass, back_buffer, State::RenderTarget);
+	CHECK_THROWS(graph.Write(pass, texture, State::RenderTarget), std::logic_error);
+	CHECK_THROWS(graph.Compile(device), std::logic_error);
+	CHECK(!graph.IsCompiled());
+}
+
+TEST(RenderGraphOverlapsAsyncCompute)
+{
+	using Queue = RenderGraph::Queue;
+	RHI::NullDevice device;
+	RenderGraph graph;
+	const RenderGraph::TextureDesc hdr_desc = { 1920, 1080, RHI::Format::R16G16B16A16Float };
+	const RenderGraph::ResourceHandle back_buffer = graph.Import("back buffer", State::Present, State::Present);
+	const RenderGraph::ResourceHandle depth = graph.CreateTexture("depth", { 1920, 1080, RHI::Format::D32Float });
+	const RenderGraph::ResourceHandle bins = graph.CreateTexture("light bins", { 120, 68, RHI::Format::R32G32Float });
+	const RenderGraph::ResourceHandle shadow = graph.CreateTexture("shadow", { 2048, 2048, RHI::Format::D32Float });
+	const RenderGraph::ResourceHandle hdr = graph.CreateTexture("hdr", hdr_desc);
+	const RenderGraph::ResourceHandle particles = graph.CreateTexture("particles", hdr_desc);
+
+	std::vector<std::string> executed;
+	auto add_pass = [&](const char* name, Queue queue) {
+		return graph.AddPass(name, [&executed, name](RenderGraph::Context&) { executed.push_back(name); }, queue);
+	};
+	const RenderGraph::PassHandle prepass = add_pass("prepass", Queue::Graphics);
+	graph.Write(prepass, depth, State::DepthWrite);
+	const RenderGraph::PassHandle binning = add_pass("binning", Queue::AsyncCompute);
+	graph.Read(binning, depth, State::NonPixelShaderResource);
+	graph.Write(binning, bins, State::UnorderedAccess);
+	const RenderGraph::PassHandle shadow_pass = add_pass("shadow", Queue::Graphics);
+	graph.Write(shadow_pass, shadow, State::DepthWrite);
+	const RenderGraph::PassHandle scene = add_pass("scene", Queue::Graphics);
+	graph.Read(scene, depth, State::DepthRead);
+	graph.Read(scene, bins, State::PixelShaderResource);
+	graph.Read(scene, shadow, State::PixelShaderResource);
+	graph.Write(scene, hdr, State::RenderTarget);
+	const RenderGraph::PassHandle particle_pass = add_pass("particles", Queue::AsyncCompute);
+	graph.Write(particle_pass, particles, State::UnorderedAccess);
+	const RenderGraph::PassHandle tonemap = add_pass("tonemap", Queue::Graphics);
+	graph.Read(tonemap, hdr, State::PixelShaderResource);
+	graph.Read(tonemap, particles, State::PixelShaderResource);
+	graph.Write(tonemap, back_buffer, State::RenderTarget);
+	CHECK_THROWS(graph.Write(particle_pass, particles, State::RenderTarget), std::invalid_argument);
+	graph.Compile(device);
+
+	// The scene waits for the binning but the shadow pass doesn't, it gets a segment of its own
+	const std::vector<RenderGraph::Segment>& segments = graph.GetSegments();
+	CHECK_EQUAL(6u, segments.size());
+	CHECK_EQUAL(2u, graph.GetStats().async_passes);
+	CHECK_EQUAL(3u, graph.GetStats().queue_waits);
+	CHECK(segments[1].queue == Queue::AsyncCompute && segments[1].wait == 0);
+	CHECK(segments[2].queue == Queue::Graphics && segments[2].wait == ~0u);
+	CHECK(segments[3].wait == 1);
+	CHECK(segments.back().queue == Queue::Graphics && segments.back().wait == 4);
+	// Transients the async passes use aren't aliased
+	CHECK_EQUAL(graph.GetStats().transient_bytes, graph.GetStats().heap_bytes);
+
+	const RenderGraph::Timeline timeline = graph.SimulateTimeline([&](RenderGraph::PassHandle pass) {
+		if (pass == binning || pass == shadow_pass)
+			return 2.0;
+		if (pass == scene)
+			return 4.0;
+		if (pass == particle_pass)
+			return 3.0;
+		return 1.0;
+	});
+	auto overlaps = [&](uint32_t a, uint32_t b) {
+		return timeline.segments[a].start < timeline.segments[b].end && timeline.segments[b].start < timeline.segments[a].end;
+	};
+	// Shadows render while the lights are binned, particles simulate while the scene renders
+	CHECK(overlaps(1, 2));
+	CHECK(overlaps(3, 4));
+	CHECK(timeline.segments[3].start >= timeline.segments[1].end);
+	CHECK(timeline.segments[5].start >= timeline.segments[4].end);
+	CHECK_EQUAL(13.0, timeline.serial_time);
+	CHECK_EQUAL(8.0, timeline.frame_time);
+
+	// Executes on null queues frame after frame, single list execution is for graphs without async passes
+	auto back_buffer_texture = device.CreateTexture2D(1920, 1080, RHI::Format::R8G8B8A8Unorm, State::Present);
+	graph.SetImportedResource(back_buffer, back_buffer_texture.get());
+	auto graphics_queue = device.CreateCommandQueue(RHI::CommandListType::Direct);
+	auto compute_queue = device.CreateCommandQueue(RHI::CommandListType::Compute);
+	auto graphics_fence = device.CreateFence(0);
+	auto compute_fence = device.CreateFence(0);
+	std::vector<std::unique_ptr<RHI::CommandAllocator>> allocators;
+	std::vector<std::unique_ptr<RHI::CommandList>> lists;
+	auto acquire = [&](RHI::CommandListType type) {
+		return [&, type]() {
+			allocators.push_back(device.CreateCommandAllocator(type));
+			lists.push_back(device.CreateCommandList(type, allocators.back().get(), nullptr));
+			return lists.back().get();
+		};
+	};
+	RenderGraph::QueueSubmission graphics = { graphics_queue.get(), graphics_fence.get(), 0, acquire(RHI::CommandListType::Direct) };
+	RenderGraph::QueueSubmission compute = { compute_queue.get(), compute_fence.get(), 0, acquire(RHI::CommandListType::Compute) };
+	for (uint32_t frame = 0; frame < 2; frame++) {
+		executed.clear();
+		graph.Execute(graphics, compute);
+		graphics_queue->Signal(graphics_fence.get(), ++graphics.fence_value);
+		graphics_fence->Wait(graphics.fence_value);
+		CHECK(executed == std::vector<std::string>({ "prepass", "binning", "shadow", "scene", "particles", "tonemap" }));
+	}
+	CHECK_EQUAL(12u, lists.size());
+	CHECK_EQUAL(4u, compute.fence_value);
+	CHECK_EQUAL(compute.fence_value, compute_fence->GetCompletedValue());
+	RHI::RecordingCommandList list;
+	CHECK_THROWS(graph.Execute(list), std::logic_error);
+}
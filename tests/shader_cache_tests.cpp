@@ -0,0 +1,68 @@
+#include "test.h"
+
+#include "shader_cache.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+TEST(ShaderVariantParsesEntryTargetAndDefines)
+{
+	const ShaderVariant plain = ParseShaderVariant("VSMain:vs_6_0");
+	CHECK_EQUAL(std::string("VSMain"), plain.entry_point);
+	CHECK_EQUAL(std::string("vs_6_0"), plain.target);
+	CHECK(plain.defines.empty());
+
+	// A define without a value is set to 1, a value may contain '='
+	const ShaderVariant defined = ParseShaderVariant("PSMain:ps_6_0:BINDLESS,LIGHTS=4,EXPR=a=b");
+	CHECK_EQUAL(3u, defined.defines.size());
+	CHECK_EQUAL(std::string("BINDLESS"), defined.defines[0].name);
+	CHECK_EQUAL(std::string("1"), defined.defines[0].value);
+	CHECK_EQUAL(std::string("4"), defined.defines[1].value);
+	CHECK_EQUAL(std::string("EXPR"), defined.defines[2].name);
+	CHECK_EQUAL(std::string("a=b"), defined.defines[2].value);
+
+	CHECK_THROWS(ParseShaderVariant("VSMain"), std::invalid_argument);
+	CHECK_THROWS(ParseShaderVariant(":vs_6_0"), std::invalid_argument);
+	CHECK_THROWS(ParseShaderVariant("VSMain::A"), std::invalid_argument);
+	CHECK_THROWS(ParseShaderVariant("VSMain:vs_6_0:A,,B"), std::invalid_argument);
+	CHECK_THROWS(ParseShaderVariant("VSMain:vs_6_0:=1"), std::invalid_argument);
+}
+
+TEST(ShaderKeyChangesWithSourceAndVariant)
+{
+	const std::string source = "float4 PSMain() : SV_TARGET { return 1; }";
+	const ShaderVariant variant = ParseShaderVariant("PSMain:ps_6_0:A=1");
+	const uint64_t key = GetShaderKey(source, variant);
+	CHECK_EQUAL(key, GetShaderKey(source, ParseShaderVariant("PSMain:ps_6_0:A")));
+
+	// Any change to the source text or the variant misses the cache
+	CHECK(key != GetShaderKey(source + " ", variant));
+	CHECK(key != GetShaderKey(source, ParseShaderVariant("PSMain:ps_6_1:A=1")));
+	CHECK(key != GetShaderKey(source, ParseShaderVariant("PSMain:ps_6_0:A=0")));
+	CHECK(key != GetShaderKey(source, ParseShaderVariant("PSMain:ps_6_0")));
+	CHECK(key != GetShaderKey(source, ParseShaderVariant("PSMain:ps_6_0:A=1,B=1")));
+	ShaderVariant debug = variant;
+	debug.flags = 1;
+	CHECK(key != GetShaderKey(source, debug));
+
+	// Define boundaries are part of the key
+	CHECK(GetShaderKey(source, ParseShaderVariant("PSMain:ps_6_0:AB=C")) != GetShaderKey(source, ParseShaderVariant("PSMain:ps_6_0:A=BC")));
+}
+
+TEST(ShaderSourceReadsWholeFiles)
+{
+	const std::string path = (std::filesystem::temp_directory_path() / "shader_cache_tests.hlsl").string();
+	const std::string text = std::string("#define A 1\r\n") + '\0' + "tail";
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(text.data(), text.size());
+	}
+	std::string source;
+	const bool read = ReadShaderSource(path, source);
+	std::remove(path.c_str());
+	CHECK(read);
+	// Read in binary, so line endings hash the same on every platform
+	CHECK(source == text);
+	CHECK(!ReadShaderSource(path, source));
+}
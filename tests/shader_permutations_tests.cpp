@@ -0,0 +1,64 @@
+#include "test.h"
+
+#include "shader_permutations.h"
+
+TEST(ShaderPermutationsDefineEveryFeature)
+{
+	const ShaderPermutationSet set({ "A", "B", "C" });
+	CHECK_EQUAL(8u, set.GetPermutationCount());
+	CHECK_EQUAL(4u, set.GetMask("C"));
+	CHECK_THROWS(set.GetMask("D"), std::invalid_argument);
+
+	// Base defines come first, disabled features are defined to 0 rather than left out
+	const std::vector<ShaderDefine> defines = set.GetDefines(5, { { "BINDLESS", "1" } });
+	CHECK_EQUAL(4u, defines.size());
+	CHECK_EQUAL(std::string("BINDLESS"), defines[0].name);
+	CHECK_EQUAL(std::string("1"), defines[1].value);
+	CHECK_EQUAL(std::string("0"), defines[2].value);
+	CHECK_EQUAL(std::string("1"), defines[3].value);
+	CHECK_EQUAL(std::string("A|C"), set.Describe(5));
+	CHECK_EQUAL(std::string("none"), set.Describe(0));
+	CHECK_EQUAL(8u, set.GetDistinctPermutations().size());
+
+	CHECK_THROWS(ShaderPermutationSet({ "A", "A" }), std::invalid_argument);
+	CHECK_THROWS(ShaderPermutationSet({ "A", "" }), std::invalid_argument);
+	CHECK_THROWS(ShaderPermutationSet(std::vector<std::string>(17, "A")), std::invalid_argument);
+}
+
+TEST(ShaderPermutationsSkipFeaturesWithoutTheirRequirement)
+{
+	// The renderer's pixel features: bump mapping only perturbs the lit normal
+	const ShaderPermutationSet set({ "BUMP_MAPPING", "POINT_LIGHT" }, { { "BUMP_MAPPING", "POINT_LIGHT" } });
+	const uint32_t bump = set.GetMask("BUMP_MAPPING");
+	const uint32_t light = set.GetMask("POINT_LIGHT");
+	CHECK_EQUAL(4u, set.GetPermutationCount());
+	const std::vector<uint32_t> distinct = set.GetDistinctPermutations();
+	CHECK_EQUAL(3u, distinct.size());
+	CHECK(!set.IsDistinct(bump));
+	CHECK_EQUAL(0u, set.Resolve(bump));
+	CHECK_EQUAL(bump | light, set.Resolve(bump | light));
+	CHECK_EQUAL(light, set.Resolve(light));
+
+	// Requirements chain, clearing one feature clears what requires it
+	const ShaderPermutationSet chain({ "A", "B", "C" }, { { "C", "B" }, { "B", "A" } });
+	CHECK_EQUAL(0u, chain.Resolve(6));
+	CHECK_EQUAL(3u, chain.Resolve(3));
+	CHECK_EQUAL(4u, chain.GetDistinctPermutations().size());
+
+	CHECK_THROWS(ShaderPermutationSet({ "A" }, { { "A", "B" } }), std::invalid_argument);
+	CHECK_THROWS(ShaderPermutationSet({ "A" }, { { "A", "A" } }), std::invalid_argument);
+}
+
+TEST(ShaderPermutationsParseFeatureLists)
+{
+	CHECK_EQUAL(0u, ShaderPermutationSet::Parse("").GetFeatureCount());
+	CHECK_EQUAL(1u, ShaderPermutationSet::Parse("").GetPermutationCount());
+
+	// Requirements may name a feature declared after them, as the build's shader specs do
+	const ShaderPermutationSet set = ShaderPermutationSet::Parse("BUMP_MAPPING+POINT_LIGHT,POINT_LIGHT");
+	CHECK_EQUAL(2u, set.GetFeatureCount());
+	CHECK_EQUAL(std::string("BUMP_MAPPING"), set.GetFeatures()[0]);
+	CHECK_EQUAL(3u, set.GetDistinctPermutations().size());
+	CHECK_THROWS(ShaderPermutationSet::Parse("A+B"), std::invalid_argument);
+	CHECK_THROWS(ShaderPermutationSet::Parse("A,,B"), std::invalid_argument);
+}
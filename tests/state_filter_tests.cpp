@@ -0,0 +1,169 @@
+#include "test.h"
+
+#include "frame_recorder.h"
+#include "rhi_null.h"
+#include "state_filter.h"
+
+#include <vector>
+
+using RHI::CommandId;
+
+namespace
+{
+	struct RecordedBarrier
+	{
+		uint32_t resource;
+		RHI::ResourceState before;
+		RHI::ResourceState after;
+		RHI::ResourceBarrierType type;
+	};
+
+	// Barriers of every ResourceBarrier call in the stream, flattened in order
+	std::vector<RecordedBarrier> GetBarriers(const RHI::CommandStream& stream, size_t* calls = nullptr)
+	{
+		std::vector<RecordedBarrier> barriers;
+		if (calls)
+			*calls = 0;
+		stream.ForEach([&](const RHI::CommandHeader& header, const uint8_t* payload) {
+			if (header.id != CommandId::ResourceBarrier)
+				return;
+			if (calls)
+				(*calls)++;
+			const auto* command = reinterpret_cast<const RHI::Commands::ResourceBarrier*>(payload);
+			const auto* records = reinterpret_cast<const RHI::Commands::Barrier*>(command + 1);
+			for (uint32_t i = 0; i < command->count; i++)
+				barriers.push_back({ records[i].resource, records[i].before, records[i].after, records[i].type });
+		});
+		return barriers;
+	}
+
+	uint64_t Issued(const StateFilterCommandList& filter, CommandId id) { return filter.GetStats().issued[static_cast<size_t>(id)]; }
+	uint64_t Elided(const StateFilterCommandList& filter, CommandId id) { return filter.GetStats().elided[static_cast<size_t>(id)]; }
+}
+
+TEST(StateFilterElidesRepeatedSceneState)
+{
+	RHI::NullDevice device;
+	auto root_signature = device.CreateRootSignature();
+	auto pipeline = device.CreatePipelineState();
+	RHI::PipelineState* pipelines[1] = { pipeline.get() };
+
+	FrameContext frame = {};
+	frame.root_signature = root_signature.get();
+	frame.rtv = { 1 };
+	frame.view_port = { 0.f, 0.f, 1280.f, 720.f, 0.f, 1.f };
+	frame.scissor_rect = { 0, 0, 1280, 720 };
+	frame.vertex_buffer_view = { 1ull << 32, 3 * 1000 * 32, 32 };
+	frame.pipeline_states = pipelines;
+
+	// Every draw of a scene sharing one pipeline and one constant buffer
+	const uint32_t draw_count = 1000;
+	std::vector<DrawItem> draws;
+	for (uint32_t i = 0; i < draw_count; i++)
+		draws.push_back({ i * 3, 3, 1ull << 32, 0, 0 });
+
+	RHI::RecordingCommandList unfiltered;
+	RecordFrame(unfiltered, frame, draws);
+
+	RHI::RecordingCommandList inner;
+	StateFilterCommandList filter(&inner);
+	filter.Reset(nullptr, nullptr);
+	RecordFrame(filter, frame, draws);
+	filter.Close();
+
+	const RHI::CommandStream& stream = inner.GetStream();
+	CHECK_EQUAL(draw_count, stream.GetCommandCount(CommandId::DrawInstanced));
+	CHECK_EQUAL(1u, stream.GetCommandCount(CommandId::SetPipelineState));
+	CHECK_EQUAL(1u, stream.GetCommandCount(CommandId::SetGraphicsRootConstantBufferView));
+	CHECK_EQUAL(draw_count, unfiltered.GetStream().GetCommandCount(CommandId::SetPipelineState));
+	CHECK_EQUAL(draw_count - 1, Elided(filter, CommandId::SetPipelineState));
+	CHECK_EQUAL(draw_count - 1, Elided(filter, CommandId::SetGraphicsRootConstantBufferView));
+	// Everything the filter let through reached the inner list
+	CHECK_EQUAL(stream.GetCommandCount(CommandId::SetPipelineState), Issued(filter, CommandId::SetPipelineState));
+}
+
+TEST(StateFilterBatchesAndCancelsTransitions)
+{
+	RHI::NullDevice device;
+	auto a = device.CreateBuffer(RHI::HeapType::Default, 256, RHI::ResourceState::Common);
+	auto b = device.CreateBuffer(RHI::HeapType::Default, 256, RHI::ResourceState::Common);
+
+	RHI::RecordingCommandList inner;
+	StateFilterCommandList filter(&inner);
+	filter.Reset(nullptr, nullptr);
+	const RHI::ResourceBarrier a_to_copy = { a.get(), RHI::ResourceState::Common, RHI::ResourceState::CopyDest };
+	const RHI::ResourceBarrier a_to_read = { a.get(), RHI::ResourceState::CopyDest, RHI::ResourceState::GenericRead };
+	const RHI::ResourceBarrier b_to_target = { b.get(), RHI::ResourceState::Present, RHI::ResourceState::RenderTarget };
+	const RHI::ResourceBarrier b_to_present = { b.get(), RHI::ResourceState::RenderTarget, RHI::ResourceState::Present };
+	filter.ResourceBarrier(1, &a_to_copy);
+	filter.ResourceBarrier(1, &b_to_target);
+	filter.ResourceBarrier(1, &a_to_read);
+	filter.ResourceBarrier(1, &b_to_present);
+	filter.DrawInstanced(3, 1, 0, 0);
+
+	// a's transitions merge into one, b's cancel out, four calls become one
+	size_t calls = 0;
+	const std::vector<RecordedBarrier> barriers = GetBarriers(inner.GetStream(), &calls);
+	CHECK_EQUAL(1u, calls);
+	CHECK_EQUAL(1u, barriers.size());
+	CHECK_EQUAL(a->GetId(), barriers[0].resource);
+	CHECK(barriers[0].before == RHI::ResourceState::Common);
+	CHECK(barriers[0].after == RHI::ResourceState::GenericRead);
+	CHECK_EQUAL(1u, Issued(filter, CommandId::ResourceBarrier));
+	CHECK_EQUAL(3u, Elided(filter, CommandId::ResourceBarrier));
+	CHECK_EQUAL(4u, filter.GetStats().barriers_requested);
+	CHECK_EQUAL(1u, filter.GetStats().barriers_issued);
+}
+
+TEST(StateFilterCountsCancelledBatchesAsElided)
+{
+	RHI::NullDevice device;
+	auto a = device.CreateBuffer(RHI::HeapType::Default, 256, RHI::ResourceState::Common);
+
+	RHI::RecordingCommandList inner;
+	StateFilterCommandList filter(&inner);
+	filter.Reset(nullptr, nullptr);
+	const RHI::ResourceBarrier there = { a.get(), RHI::ResourceState::Common, RHI::ResourceState::CopySource };
+	const RHI::ResourceBarrier back = { a.get(), RHI::ResourceState::CopySource, RHI::ResourceState::Common };
+	filter.ResourceBarrier(1, &there);
+	filter.ResourceBarrier(1, &back);
+	filter.Close();
+
+	CHECK_EQUAL(0u, inner.GetStream().GetCommandCount(CommandId::ResourceBarrier));
+	CHECK_EQUAL(0u, Issued(filter, CommandId::ResourceBarrier));
+	CHECK_EQUAL(2u, Elided(filter, CommandId::ResourceBarrier));
+
+	// A second frame counts from a clean slate
+	filter.ResetStats();
+	filter.Reset(nullptr, nullptr);
+	filter.ResourceBarrier(1, &there);
+	filter.Close();
+	CHECK_EQUAL(1u, Issued(filter, CommandId::ResourceBarrier));
+	CHECK_EQUAL(0u, Elided(filter, CommandId::ResourceBarrier));
+}
+
+TEST(StateFilterKeepsTransitionsAfterPendingAliasing)
+{
+	RHI::NullDevice device;
+	auto heap = device.CreateHeap(RHI::HeapType::Default, 1 << 20);
+	auto placed = device.CreatePlacedBuffer(heap.get(), 0, 1024, RHI::ResourceState::Common);
+
+	RHI::RecordingCommandList inner;
+	StateFilterCommandList filter(&inner);
+	filter.Reset(nullptr, nullptr);
+	const RHI::ResourceBarrier to_copy = { placed.get(), RHI::ResourceState::Common, RHI::ResourceState::CopyDest };
+	RHI::ResourceBarrier aliasing = { placed.get(), RHI::ResourceState::Common, RHI::ResourceState::Common };
+	aliasing.type = RHI::ResourceBarrierType::Aliasing;
+	const RHI::ResourceBarrier to_read = { placed.get(), RHI::ResourceState::CopyDest, RHI::ResourceState::GenericRead };
+	filter.ResourceBarrier(1, &to_copy);
+	filter.ResourceBarrier(1, &aliasing);
+	filter.ResourceBarrier(1, &to_read);
+	filter.Close();
+
+	// The transition after the aliasing barrier stays after it instead of merging into the first
+	const std::vector<RecordedBarrier> barriers = GetBarriers(inner.GetStream());
+	CHECK_EQUAL(3u, barriers.size());
+	CHECK(barriers[0].type == RHI::ResourceBarrierType::Transition && barriers[0].after == RHI::ResourceState::CopyDest);
+	CHECK(barriers[1].type == RHI::ResourceBarrierType::Aliasing);
+	CHECK(barriers[2].type == RHI::ResourceBarrierType::Transition && barriers[2].before == RHI::ResourceState::CopyDest);
+}
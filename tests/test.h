@@ -0,0 +1,48 @@
+#pragma once
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+// Minimal test registry for the Tests project. TEST defines a case that runs in registration
+// order, CHECK and CHECK_EQUAL throw TestFailure so a failing case stops at its first failure.
+struct TestFailure : std::runtime_error
+{
+	TestFailure(const char* file, int line, const std::string& message)
+		: std::runtime_error(std::string(file) + ":" + std::to_string(line) + ": " + message) {}
+};
+
+struct TestRegistration
+{
+	TestRegistration(const char* name, void (*function)());
+};
+
+#define TEST(name) \
+	static void name(); \
+	static TestRegistration name##_registration(#name, name); \
+	static void name()
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) \
+			throw TestFailure(__FILE__, __LINE__, "CHECK(" #condition ") failed"); \
+	} while (false)
+
+#define CHECK_EQUAL(expected, actual) \
+	do { \
+		const auto& expected_value = (expected); \
+		const auto& actual_value = (actual); \
+		if (!(expected_value == actual_value)) { \
+			std::ostringstream message; \
+			message << #actual " is " << actual_value << ", expected " << expected_value; \
+			throw TestFailure(__FILE__, __LINE__, message.str()); \
+		} \
+	} while (false)
+
+#define CHECK_THROWS(statement, exception) \
+	do { \
+		bool thrown = false; \
+		try { statement; } catch (const exception&) { thrown = true; } \
+		if (!thrown) \
+			throw TestFailure(__FILE__, __LINE__, #statement " didn't throw " #exception); \
+	} while (false)
@@ -0,0 +1,55 @@
+#include "test.h"
+
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <vector>
+
+namespace
+{
+	struct TestCase
+	{
+		const char* name;
+		void (*function)();
+	};
+
+	// Function local so registrations in other translation units can't run before it exists
+	std::vector<TestCase>& GetTests()
+	{
+		static std::vector<TestCase> tests;
+		return tests;
+	}
+}
+
+TestRegistration::TestRegistration(const char* name, void (*function)())
+{
+	GetTests().push_back({ name, function });
+}
+
+// Runs every test whose name contains one of the arguments, or all of them without arguments
+int main(int argc, char** argv)
+{
+	size_t run = 0;
+	size_t failed = 0;
+	for (const TestCase& test : GetTests()) {
+		bool selected = argc < 2;
+		for (int i = 1; i < argc && !selected; i++)
+			selected = strstr(test.name, argv[i]) != nullptr;
+		if (!selected)
+			continue;
+
+		run++;
+		try
+		{
+			test.function();
+			printf("[  OK  ] %s\n", test.name);
+		}
+		catch (const std::exception& e)
+		{
+			failed++;
+			printf("[FAILED] %s\n  %s\n", test.name, e.what());
+		}
+	}
+	printf("%zu of %zu tests passed\n", run - failed, run);
+	return failed == 0 && run > 0 ? 0 : 1;
+}
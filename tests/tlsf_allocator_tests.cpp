@@ -0,0 +1,136 @@
+#include "test.h"
+
+#include "gpu_heap_allocator.h"
+#include "rhi_null.h"
+#include "tlsf_allocator.h"
+
+#include <map>
+#include <random>
+#include <vector>
+
+TEST(TlsfAllocatorSplitsAndCoalesces)
+{
+	TlsfAllocator allocator(4096, 256);
+	TlsfAllocator::Allocation a, b, c;
+	CHECK(allocator.Allocate(100, 1, a));
+	CHECK(allocator.Allocate(256, 1, b));
+	CHECK(allocator.Allocate(600, 1, c));
+	CHECK_EQUAL(0u, a.offset);
+	CHECK_EQUAL(256u, b.offset);
+	CHECK_EQUAL(512u, c.offset);
+	// Sizes round up to the granularity
+	CHECK_EQUAL(768u, c.size);
+	CHECK_EQUAL(1280u, allocator.GetUsedSize());
+
+	// A hole between two allocations stays its own block until a neighbour is freed
+	allocator.Free(b);
+	TlsfAllocator::Stats stats = allocator.GetStats();
+	CHECK_EQUAL(2u, stats.free_blocks);
+	CHECK_EQUAL(4096u - 1280u, stats.largest_free_block);
+	CHECK_EQUAL(768u, stats.compaction_bytes);
+	CHECK(stats.fragmentation > 0.0);
+
+	allocator.Free(a);
+	allocator.Free(c);
+	stats = allocator.GetStats();
+	CHECK(allocator.IsEmpty());
+	CHECK_EQUAL(1u, stats.free_blocks);
+	CHECK_EQUAL(4096u, stats.largest_free_block);
+	CHECK_EQUAL(0.0, stats.fragmentation);
+	CHECK_THROWS(allocator.Free(c), std::logic_error);
+}
+
+TEST(TlsfAllocatorAlignsAndRejectsWhatDoesntFit)
+{
+	TlsfAllocator allocator(64 * 1024, 256);
+	TlsfAllocator::Allocation small, aligned, too_large;
+	CHECK(allocator.Allocate(256, 256, small));
+	CHECK(allocator.Allocate(1024, 16 * 1024, aligned));
+	CHECK_EQUAL(16u * 1024, aligned.offset);
+	// The padding in front of the aligned block is still free
+	TlsfAllocator::Allocation padding;
+	CHECK(allocator.Allocate(15 * 1024, 256, padding));
+	CHECK_EQUAL(256u, padding.offset);
+
+	CHECK(!allocator.Allocate(0, 256, too_large));
+	CHECK(!allocator.Allocate(64 * 1024 + 1, 256, too_large));
+	CHECK(!allocator.Allocate(48 * 1024, 256, too_large));
+	CHECK_THROWS(TlsfAllocator(4096, 100), std::invalid_argument);
+	CHECK_THROWS(TlsfAllocator(128, 256), std::invalid_argument);
+}
+
+TEST(TlsfAllocatorStress)
+{
+	// Random allocations and frees keep a few hundred blocks alive, live blocks must never overlap
+	// and freeing everything must coalesce back into one free block
+	const uint64_t capacity = 64ull * 1024 * 1024;
+	TlsfAllocator allocator(capacity, 256);
+	std::mt19937 random(11);
+	std::vector<TlsfAllocator::Allocation> live;
+	// Live allocations by offset, the neighbours of a new one are the only ones it can overlap
+	std::map<uint64_t, uint64_t> ranges;
+	uint64_t failures = 0;
+	for (uint32_t operation = 0; operation < 400000; operation++) {
+		if (!live.empty() && random() % 2 == 0) {
+			const size_t index = random() % live.size();
+			CHECK_EQUAL(1u, ranges.erase(live[index].offset));
+			allocator.Free(live[index]);
+			live[index] = live.back();
+			live.pop_back();
+			continue;
+		}
+
+		const uint64_t alignment = uint64_t(1) << (8 + random() % 9);
+		// Mostly small buffers with the occasional large one
+		const uint64_t size = random() % 8 ? 1 + random() % (64 * 1024) : 1 + random() % (4 * 1024 * 1024);
+		TlsfAllocator::Allocation allocation;
+		if (!allocator.Allocate(size, alignment, allocation)) {
+			failures++;
+			continue;
+		}
+		CHECK_EQUAL(0u, allocation.offset % alignment);
+		CHECK(allocation.size >= size);
+		CHECK(allocation.offset + allocation.size <= capacity);
+		const auto next = ranges.lower_bound(allocation.offset);
+		if (next != ranges.end())
+			CHECK(allocation.offset + allocation.size <= next->first);
+		if (next != ranges.begin())
+			CHECK(std::prev(next)->first + std::prev(next)->second <= allocation.offset);
+		ranges.emplace(allocation.offset, allocation.size);
+		live.push_back(allocation);
+	}
+	CHECK_EQUAL(live.size(), static_cast<size_t>(allocator.GetAllocationCount()));
+	CHECK(failures > 0);
+
+	for (const TlsfAllocator::Allocation& allocation : live)
+		allocator.Free(allocation);
+	const TlsfAllocator::Stats stats = allocator.GetStats();
+	CHECK_EQUAL(0u, stats.used);
+	CHECK_EQUAL(1u, stats.free_blocks);
+	CHECK_EQUAL(capacity, stats.largest_free_block);
+}
+
+TEST(GpuHeapAllocatorPlacesBuffersInPages)
+{
+	RHI::NullDevice device;
+	GpuHeapAllocator allocator(device, 1024 * 1024);
+	GpuAllocation a = allocator.CreateBuffer(RHI::HeapType::Default, 1000, RHI::ResourceState::Common);
+	GpuAllocation b = allocator.CreateBuffer(RHI::HeapType::Default, 1000, RHI::ResourceState::Common);
+	GpuAllocation upload = allocator.CreateBuffer(RHI::HeapType::Upload, 1000, RHI::ResourceState::GenericRead);
+	GpuAllocation large = allocator.CreateBuffer(RHI::HeapType::Default, 3 * 1024 * 1024, RHI::ResourceState::Common);
+
+	// Buffers of one heap type share a page, other heap types and oversized buffers get their own
+	CHECK_EQUAL(a.page, b.page);
+	CHECK(upload.page != a.page);
+	CHECK(large.page != a.page && large.page != upload.page);
+	CHECK_EQUAL(3u, allocator.GetStats().pages);
+	CHECK(static_cast<RHI::NullResource*>(upload.resource.get())->GetHeapType() == RHI::HeapType::Upload);
+
+	allocator.Release(large);
+	CHECK_EQUAL(2u, allocator.GetStats().pages);
+	allocator.Release(a);
+	allocator.Release(b);
+	allocator.Release(upload);
+	CHECK_EQUAL(0u, allocator.GetStats().allocations);
+	CHECK_EQUAL(0u, allocator.GetStats().used_bytes);
+}
@@ -0,0 +1,162 @@
+#include "test.h"
+
+#include "rhi_null.h"
+#include "upload_ring.h"
+
+#include <deque>
+#include <random>
+#include <vector>
+
+namespace
+{
+	struct Range
+	{
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	bool Overlaps(const Range& a, const Range& b)
+	{
+		return a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+	}
+}
+
+TEST(RingAllocatorAlignsAndRejectsOversizedRequests)
+{
+	RingAllocator ring(4096);
+	CHECK_EQUAL(0u, ring.Allocate(10, 256));
+	CHECK_EQUAL(256u, ring.Allocate(10, 256));
+	CHECK_EQUAL(272u, ring.Allocate(16, 16));
+	// Padding before an aligned allocation counts as used
+	CHECK_EQUAL(288u, ring.GetUsedSize());
+	CHECK_EQUAL(RingAllocator::invalid_offset, ring.Allocate(0, 256));
+	CHECK_EQUAL(RingAllocator::invalid_offset, ring.Allocate(4097, 256));
+}
+
+TEST(RingAllocatorRetiresFramesByFenceValue)
+{
+	RingAllocator ring(1024);
+	CHECK_EQUAL(0u, ring.Allocate(512, 256));
+	ring.EndFrame(1);
+	CHECK_EQUAL(512u, ring.Allocate(512, 256));
+	ring.EndFrame(2);
+	CHECK_EQUAL(2u, ring.GetFramesInFlight());
+
+	// Full until the GPU finishes a frame
+	CHECK_EQUAL(RingAllocator::invalid_offset, ring.Allocate(256, 256));
+	ring.Retire(0);
+	CHECK_EQUAL(RingAllocator::invalid_offset, ring.Allocate(256, 256));
+
+	// Frames retire in order, only up to the completed value
+	ring.Retire(1);
+	CHECK_EQUAL(1u, ring.GetFramesInFlight());
+	CHECK_EQUAL(512u, ring.GetUsedSize());
+	CHECK_EQUAL(0u, ring.Allocate(256, 256));
+	ring.EndFrame(3);
+	ring.Retire(3);
+	CHECK_EQUAL(0u, ring.GetFramesInFlight());
+	CHECK_EQUAL(0u, ring.GetUsedSize());
+
+	// Frames without allocations aren't tracked
+	ring.EndFrame(4);
+	CHECK_EQUAL(0u, ring.GetFramesInFlight());
+}
+
+TEST(RingAllocatorWrapsAroundPastTheEnd)
+{
+	RingAllocator ring(1024);
+	CHECK_EQUAL(0u, ring.Allocate(384, 256));
+	ring.EndFrame(1);
+	CHECK_EQUAL(512u, ring.Allocate(384, 256));
+	ring.EndFrame(2);
+	ring.Retire(1);
+
+	// 128 bytes left at the end are too few, the allocation wraps to the start and the skipped
+	// end stays used until its frame retires
+	CHECK_EQUAL(0u, ring.Allocate(256, 256));
+	CHECK_EQUAL(512u + 128u + 256u, ring.GetUsedSize());
+	// Behind the tail only the gap up to it is free
+	CHECK_EQUAL(RingAllocator::invalid_offset, ring.Allocate(256, 256));
+	CHECK_EQUAL(256u, ring.Allocate(128, 128));
+	CHECK_EQUAL(RingAllocator::invalid_offset, ring.Allocate(1, 1));
+	ring.EndFrame(3);
+	ring.Retire(2);
+	CHECK_EQUAL(128u + 256u + 128u, ring.GetUsedSize());
+	// The gap now reaches frame 2's end, the skipped end of the buffer is still frame 3's
+	CHECK_EQUAL(RingAllocator::invalid_offset, ring.Allocate(640, 128));
+	CHECK_EQUAL(384u, ring.Allocate(512, 128));
+	ring.EndFrame(4);
+	ring.Retire(4);
+	CHECK_EQUAL(0u, ring.GetUsedSize());
+}
+
+TEST(RingAllocatorStress)
+{
+	// Frames allocate random sizes while up to three frames are in flight, live allocations must
+	// never overlap and the ring must be empty once everything retired
+	const uint64_t capacity = 64 * 1024;
+	RingAllocator ring(capacity);
+	std::mt19937 random(7);
+	std::deque<std::vector<Range>> frames_in_flight;
+	std::vector<Range> frame;
+	uint64_t fence_value = 0;
+	uint64_t failures = 0;
+	for (uint32_t operation = 0; operation < 200000; operation++) {
+		if (random() % 16 == 0) {
+			ring.EndFrame(++fence_value);
+			frames_in_flight.push_back(std::move(frame));
+			frame.clear();
+			if (frames_in_flight.size() > 3) {
+				ring.Retire(fence_value - 3);
+				frames_in_flight.pop_front();
+			}
+			continue;
+		}
+
+		const uint64_t alignment = uint64_t(1) << (random() % 9);
+		const uint64_t size = 1 + random() % 4096;
+		const uint64_t offset = ring.Allocate(size, alignment);
+		if (offset == RingAllocator::invalid_offset) {
+			failures++;
+			continue;
+		}
+		const Range range = { offset, size };
+		CHECK_EQUAL(0u, offset % alignment);
+		CHECK(offset + size <= capacity);
+		for (const Range& other : frame)
+			CHECK(!Overlaps(range, other));
+		for (const std::vector<Range>& in_flight : frames_in_flight) {
+			for (const Range& other : in_flight)
+				CHECK(!Overlaps(range, other));
+		}
+		frame.push_back(range);
+	}
+	// The ring was full at times, and it recovers from it
+	CHECK(failures > 0);
+
+	ring.EndFrame(++fence_value);
+	ring.Retire(fence_value);
+	CHECK_EQUAL(0u, ring.GetUsedSize());
+	CHECK_EQUAL(0u, ring.GetFramesInFlight());
+}
+
+TEST(UploadRingHandsOutMappedConstantSlices)
+{
+	RHI::NullDevice device;
+	UploadRing upload(device, 4096);
+	const float constants[16] = { 1.f, 2.f, 3.f };
+	const UploadAllocation first = upload.Push(constants);
+	const UploadAllocation second = upload.Push(constants);
+	CHECK_EQUAL(0u, first.offset);
+	CHECK_EQUAL(UploadRing::constant_alignment, second.offset);
+	CHECK_EQUAL(upload.GetResource()->GetGpuAddress() + second.offset, second.gpu_address);
+	CHECK_EQUAL(3.f, reinterpret_cast<const float*>(second.cpu_address)[2]);
+	CHECK(static_cast<uint8_t*>(upload.GetResource()->Map()) + second.offset == second.cpu_address);
+
+	UploadAllocation allocation;
+	CHECK(!upload.TryAllocate(4096, UploadRing::constant_alignment, allocation));
+	CHECK_THROWS(upload.Allocate(4096), std::runtime_error);
+	upload.EndFrame(1);
+	upload.Retire(1);
+	CHECK(upload.TryAllocate(4096, UploadRing::constant_alignment, allocation));
+}
@@ -0,0 +1,125 @@
+#include "test.h"
+
+#include "vertex_formats.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
+using VertexLayout::FloatToHalf;
+
+namespace
+{
+	// ColorVertex of dx12_labs.h with DirectXMath's XMFLOAT3 and XMFLOAT4 spelled out as floats
+	struct ColorVertexMirror
+	{
+		float position[3];
+		float color[4];
+		float norm[3];
+	};
+}
+
+TEST(FloatToHalfRoundsToNearestEven)
+{
+	CHECK_EQUAL(0x0000, FloatToHalf(0.f));
+	CHECK_EQUAL(0x8000, FloatToHalf(-0.f));
+	CHECK_EQUAL(0x3c00, FloatToHalf(1.f));
+	CHECK_EQUAL(0xc000, FloatToHalf(-2.f));
+
+	// The largest half, and the first value rounding past it
+	CHECK_EQUAL(0x7bff, FloatToHalf(65504.f));
+	CHECK_EQUAL(0x7bff, FloatToHalf(65519.f));
+	CHECK_EQUAL(0x7c00, FloatToHalf(65520.f));
+	CHECK_EQUAL(0xfc00, FloatToHalf(-65520.f));
+	CHECK_EQUAL(0x7c00, FloatToHalf(std::numeric_limits<float>::infinity()));
+	CHECK_EQUAL(0x7e00, FloatToHalf(std::numeric_limits<float>::quiet_NaN()));
+
+	// 2^-14 is the smallest normal half, below it halves are multiples of 2^-24
+	CHECK_EQUAL(0x0400, FloatToHalf(std::ldexp(1.f, -14)));
+	CHECK_EQUAL(0x03ff, FloatToHalf(std::ldexp(1.f, -14) - std::ldexp(1.f, -24)));
+	CHECK_EQUAL(0x0001, FloatToHalf(std::ldexp(1.f, -24)));
+	CHECK_EQUAL(0x0000, FloatToHalf(std::ldexp(1.f, -25)));
+	CHECK_EQUAL(0x0002, FloatToHalf(std::ldexp(3.f, -25)));
+
+	// Ties go to the even mantissa, anything past the tie rounds up
+	CHECK_EQUAL(0x3c00, FloatToHalf(1.f + std::ldexp(1.f, -11)));
+	CHECK_EQUAL(0x3c02, FloatToHalf(1.f + std::ldexp(3.f, -11)));
+	CHECK_EQUAL(0x3c01, FloatToHalf(1.f + std::ldexp(1.f, -11) + std::ldexp(1.f, -20)));
+	// A carry out of the mantissa moves into the exponent
+	CHECK_EQUAL(0x4000, FloatToHalf(2.f - std::ldexp(1.f, -12)));
+}
+
+TEST(NormalizedEncodersClampAndZeroFill)
+{
+	uint8_t bytes[4];
+	const float unorm[4] = { -.5f, .5f, 2.f, 1.f };
+	VertexLayout::Unorm4x8::Encode(unorm, 4, bytes);
+	CHECK_EQUAL(0, bytes[0]);
+	CHECK_EQUAL(128, bytes[1]);
+	CHECK_EQUAL(255, bytes[2]);
+	CHECK_EQUAL(255, bytes[3]);
+
+	const float snorm[4] = { -2.f, -1.f, .5f, 3.f };
+	VertexLayout::Snorm4x8::Encode(snorm, 4, bytes);
+	CHECK_EQUAL(-127, static_cast<int8_t>(bytes[0]));
+	CHECK_EQUAL(-127, static_cast<int8_t>(bytes[1]));
+	CHECK_EQUAL(64, static_cast<int8_t>(bytes[2]));
+	CHECK_EQUAL(127, static_cast<int8_t>(bytes[3]));
+
+	// A normal has three components, the fourth byte is zero rather than stale
+	memset(bytes, 0xff, sizeof(bytes));
+	VertexLayout::Snorm4x8::Encode(snorm, 3, bytes);
+	CHECK_EQUAL(0, bytes[3]);
+	memset(bytes, 0xff, sizeof(bytes));
+	VertexLayout::Unorm4x8::Encode(unorm, 2, bytes);
+	CHECK_EQUAL(0, bytes[2]);
+	CHECK_EQUAL(0, bytes[3]);
+
+	uint16_t halves[4];
+	memset(halves, 0xff, sizeof(halves));
+	const float position[3] = { 1.f, -2.f, 65504.f };
+	VertexLayout::Half4::Encode(position, 3, reinterpret_cast<uint8_t*>(halves));
+	CHECK_EQUAL(0x3c00, halves[0]);
+	CHECK_EQUAL(0xc000, halves[1]);
+	CHECK_EQUAL(0x7bff, halves[2]);
+	CHECK_EQUAL(0, halves[3]);
+
+	float floats[4];
+	memset(floats, 0xff, sizeof(floats));
+	VertexLayout::Float4::Encode(position, 3, reinterpret_cast<uint8_t*>(floats));
+	CHECK_EQUAL(65504.f, floats[2]);
+	CHECK_EQUAL(0.f, floats[3]);
+}
+
+TEST(VertexFormatsDeriveOffsetsAndSignatures)
+{
+	using namespace VertexFormats;
+	CHECK_EQUAL(static_cast<uint32_t>(sizeof(ColorVertexMirror)), Standard::stride);
+	CHECK_EQUAL(static_cast<uint32_t>(offsetof(ColorVertexMirror, position)), Standard::OffsetOf<Position>());
+	CHECK_EQUAL(static_cast<uint32_t>(offsetof(ColorVertexMirror, color)), Standard::OffsetOf<Color>());
+	CHECK_EQUAL(static_cast<uint32_t>(offsetof(ColorVertexMirror, norm)), Standard::OffsetOf<Normal>());
+	CHECK_EQUAL(16u, Compact::OffsetOf<Normal>());
+	CHECK(!Standard::Has<TexCoord>());
+	CHECK(Compact::IsNormalized<Color>() && !Compact::IsNormalized<Position>());
+
+	const auto elements = Standard::GetInputElements();
+	CHECK_EQUAL(std::string("COLOR"), std::string(elements[1].semantic_name));
+	CHECK(elements[1].format == RHI::Format::R32G32B32A32Float);
+	CHECK_EQUAL(12u, elements[1].aligned_byte_offset);
+
+	// The default VERTEX_INPUT of shaders.hlsl
+	CHECK_EQUAL(std::string("float3 position : POSITION, float4 color : COLOR, float3 norm : NORMAL"), GetHlslInputSignature("Standard"));
+	CHECK_THROWS(GetHlslInputSignature("Unknown"), std::invalid_argument);
+
+	// Set encodes into the attribute's bytes, the fourth half of the position stays zero
+	Half::Vertex vertex = {};
+	memset(vertex.bytes, 0xff, sizeof(vertex.bytes));
+	vertex.Set<Position>({ 1.f, 2.f, 3.f });
+	uint16_t halves[4];
+	memcpy(halves, vertex.bytes + Half::OffsetOf<Position>(), sizeof(halves));
+	CHECK_EQUAL(0x3c00, halves[0]);
+	CHECK_EQUAL(0x4000, halves[1]);
+	CHECK_EQUAL(0, halves[3]);
+	CHECK_EQUAL(0xff, vertex.bytes[Half::OffsetOf<Color>()]);
+}